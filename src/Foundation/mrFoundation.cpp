@@ -61,6 +61,44 @@ void SleepMS(millisec v)
     std::this_thread::sleep_for(std::chrono::milliseconds(v));
 }
 
+
+class SystemClock : public RefCount<IClock>
+{
+public:
+    nanosec now() override;
+    void sleepFor(nanosec duration) override;
+    void sleepUntil(nanosec time) override;
+    void onRefCountZero() override {} // static instance
+};
+
+nanosec SystemClock::now()
+{
+    return NowNS();
+}
+
+void SystemClock::sleepFor(nanosec duration)
+{
+    std::this_thread::sleep_for(std::chrono::nanoseconds(duration));
+}
+
+void SystemClock::sleepUntil(nanosec time)
+{
+    // OS sleep can overshoot by a scheduler tick (~1ms with timeBeginPeriod(1)).
+    // sleep until SpinThreshold before the time and spin the rest.
+    const nanosec SpinThreshold = 2000000;
+    nanosec t = NowNS();
+    if (t + SpinThreshold < time)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(time - t - SpinThreshold));
+    while (NowNS() < time)
+        std::this_thread::yield();
+}
+
+mrAPI IClock* GetSystemClock_()
+{
+    static SystemClock s_clock;
+    return &s_clock;
+}
+
 std::string GetCurrentModuleDirectory()
 {
     HMODULE mod{};
@@ -109,37 +147,70 @@ const char* Scan(const std::string& str, const std::regex& exp, const std::funct
     return Scan(str, exp, [&body](std::cmatch& m) { body(m.str(1)); });
 }
 
-const char* ScanKVP(const char* s, const std::function<void(std::string k, std::string v)>& body)
+static inline bool IsWordChar(char c)
 {
-    auto ex_key = std::regex(R"((\w+)\s*:\s*)");
-    auto ex_value = std::regex(R"(^([^ ]+))");
-    auto ex_parenthesis = std::regex(R"(^\{([^}]+)\})");
-    std::cmatch match;
-    for (;;) {
-        std::regex_search(s, match, ex_key);
-        if (!match.empty()) {
-            std::string key, value;
-            key = match.str(1);
-            s += match.position() + match.length();
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
 
-            if (std::regex_search(s, match, ex_parenthesis) || std::regex_search(s, match, ex_value)) {
-                value = match.str(1);
-                s += match.position() + match.length();
+static inline bool IsSpaceChar(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
 
-                body(key, value);
+// single pass equivalent of regex key "(\w+)\s*:\s*" followed by value "\{([^}]+)\}" or "([^ ]+)"
+const char* ScanKVP(const char* s, const std::function<void(std::string_view k, std::string_view v)>& body)
+{
+    for (;;) {
+        // key: a run of word chars followed by optional spaces and ':'
+        const char* key_begin = nullptr;
+        const char* key_end = nullptr;
+        for (const char* p = s; *p;) {
+            if (!IsWordChar(*p)) {
+                ++p;
+                continue;
             }
-            else {
+            const char* b = p;
+            while (IsWordChar(*p))
+                ++p;
+            const char* e = p;
+            while (IsSpaceChar(*p))
+                ++p;
+            if (*p == ':') {
+                key_begin = b;
+                key_end = e;
+                s = p + 1;
                 break;
             }
         }
-        else {
+        if (!key_begin)
             break;
+        while (IsSpaceChar(*s))
+            ++s;
+
+        // value
+        const char* value_begin = s;
+        const char* value_end = nullptr;
+        if (*s == '{') {
+            const char* close = std::strchr(s + 1, '}');
+            if (close && close != s + 1) {
+                value_begin = s + 1;
+                value_end = close;
+                s = close + 1;
+            }
         }
+        if (!value_end) {
+            while (*s && *s != ' ')
+                ++s;
+            if (s == value_begin)
+                break;
+            value_end = s;
+        }
+        body({ key_begin, size_t(key_end - key_begin) }, { value_begin, size_t(value_end - value_begin) });
     }
     return s;
 }
 
-const char* ScanKVP(const std::string& str, const std::function<void(std::string k, std::string v)>& body)
+const char* ScanKVP(const std::string& str, const std::function<void(std::string_view k, std::string_view v)>& body)
 {
     return ScanKVP(str.c_str(), body);
 }
@@ -161,35 +232,66 @@ std::string Replace(const std::string& str, const std::string& before, const std
 }
 
 
-template<> bool ToValue(const std::string& str)
+// copy to null terminated buffer for strto*(). values are short, so truncation doesn't matter in practice.
+struct ValueBuffer
+{
+    char data[64];
+
+    ValueBuffer(std::string_view str)
+    {
+        size_t n = std::min(str.size(), std::size(data) - 1);
+        memcpy(data, str.data(), n);
+        data[n] = '\0';
+    }
+};
+
+// same errors as std::stoi() / std::stof(): std::invalid_argument if there is no number and std::out_of_range if it
+// doesn't fit.
+template<> int ToValue(std::string_view str)
+{
+    ValueBuffer buf(str);
+    char* end = nullptr;
+    errno = 0;
+    long r = std::strtol(buf.data, &end, 10);
+    if (end == buf.data)
+        throw std::invalid_argument("ToValue<int>");
+    if (errno == ERANGE || r < INT_MIN || r > INT_MAX)
+        throw std::out_of_range("ToValue<int>");
+    return (int)r;
+}
+
+template<> bool ToValue(std::string_view str)
 {
     if (str == "true")
         return true;
     else if (str == "false")
         return false;
     else
-        return std::stoi(str) != 0;
-}
-
-template<> int ToValue(const std::string& str)
-{
-    return std::stoi(str);
+        return ToValue<int>(str) != 0;
 }
 
-template<> float ToValue(const std::string& str)
+template<> float ToValue(std::string_view str)
 {
-    return std::stof(str);
+    ValueBuffer buf(str);
+    char* end = nullptr;
+    errno = 0;
+    float r = std::strtof(buf.data, &end);
+    if (end == buf.data)
+        throw std::invalid_argument("ToValue<float>");
+    if (errno == ERANGE)
+        throw std::out_of_range("ToValue<float>");
+    return r;
 }
 
-template<> float2 ToValue(const std::string& str)
+template<> float2 ToValue(std::string_view str)
 {
     float2 r{};
-    if (sscanf(str.c_str(), "%f,%f", &r.x, & r.y) == 2)
+    if (sscanf(ValueBuffer(str).data, "%f,%f", &r.x, & r.y) == 2)
         return r;
     return float2{};
 }
 
-template<> std::string ToValue(const std::string& str)
+template<> std::string ToValue(std::string_view str)
 {
     if (str.size() >= 2 && str.front() == '"' && str.back() == '"')
         return std::string(str.begin() + 1, str.end() - 1);
@@ -231,6 +333,163 @@ ProfileTimer::~ProfileTimer()
 }
 
 
+ThreadPool& ThreadPool::instance()
+{
+    static ThreadPool s_inst;
+    return s_inst;
+}
+
+ThreadPool::ThreadPool(int num_threads)
+{
+    if (num_threads <= 0)
+        num_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    for (int i = 0; i < num_threads; ++i)
+        m_threads.emplace_back([this]() { process(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    for (auto& t : m_threads)
+        t.join();
+}
+
+int ThreadPool::getConcurrency() const
+{
+    return (int)m_threads.size();
+}
+
+void ThreadPool::enqueue(const std::function<void()>& v)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_tasks.push_back(v);
+    }
+    m_cond.notify_one();
+}
+
+void ThreadPool::process()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ParallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body)
+{
+    if (end <= begin)
+        return;
+    grain = std::max(grain, 1);
+    int num_chunks = ceildiv(end - begin, grain);
+    if (num_chunks == 1) {
+        body(begin, end);
+        return;
+    }
+
+    // chunks are taken by an atomic counter. the caller also processes chunks, so nested ParallelFor never deadlocks.
+    struct State
+    {
+        const std::function<void(int, int)>* body;
+        int begin, end, grain, num_chunks;
+        std::atomic_int next{ 0 };
+        std::atomic_int done{ 0 };
+        std::mutex mutex;
+        std::condition_variable cond;
+
+        void run()
+        {
+            for (;;) {
+                int i = next++;
+                if (i >= num_chunks)
+                    break;
+                int b = begin + grain * i;
+                (*body)(b, std::min(b + grain, end));
+                if (++done == num_chunks) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.notify_all();
+                }
+            }
+        }
+    };
+    auto state = std::make_shared<State>();
+    state->body = &body;
+    state->begin = begin;
+    state->end = end;
+    state->grain = grain;
+    state->num_chunks = num_chunks;
+
+    auto& pool = ThreadPool::instance();
+    int num_helpers = std::min(pool.getConcurrency(), num_chunks - 1);
+    for (int i = 0; i < num_helpers; ++i)
+        pool.enqueue([state]() { state->run(); });
+
+    state->run();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cond.wait(lock, [&]() { return state->done == state->num_chunks; });
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* path)
+{
+    close();
+
+    m_file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    // empty files can't be mapped
+    if (!::GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+        close();
+        return false;
+    }
+    m_mapping = ::CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_data = (const byte*)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_data) {
+        close();
+        return false;
+    }
+    m_size = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data) {
+        ::UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping) {
+        ::CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        ::CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
+
+
 static std::vector<std::function<void()>>& GetInitializeHandlers()
 {
     static std::vector<std::function<void()>> s_obj;
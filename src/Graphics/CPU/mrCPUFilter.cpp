@@ -0,0 +1,1839 @@
+#include "pch.h"
+#include "mrCPUFoundation.h"
+
+// CPU implementations of Graphics/Shaders/*.hlsl.
+// results should be same as the shaders except for floating point errors.
+
+namespace mr {
+
+static const int RowGrain = 8;
+
+static inline uint32_t lshift(uint32_t a, uint32_t b, uint32_t s)
+{
+    return s == 0 ? a : (a >> s) | (b << (32 - s));
+}
+
+// min and max packed in float2. x: min, y: max
+static inline float2 CombineMinMax(float2 a, float2 b)
+{
+    return { std::min(a.x, b.x), std::max(a.y, b.y) };
+}
+static const float2 MinMaxIdentity{ std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+// van Herk/Gil-Werman running min & max. dst[i] = min & max of src[i .. i + w * 2].
+// src has n + w * 2 elements. 3 comparisons per element regardless of w.
+static void RunningMinMax(const float2* src, float2* dst, int n, int w, std::vector<float2>& buf)
+{
+    if (w == 0) {
+        std::copy(src, src + n, dst);
+        return;
+    }
+
+    int k = w * 2 + 1;
+    int len = n + w * 2;
+    buf.resize(len * 2);
+    float2* prefix = buf.data();
+    float2* suffix = prefix + len;
+    for (int i = 0; i < len; ++i)
+        prefix[i] = i % k == 0 ? src[i] : CombineMinMax(prefix[i - 1], src[i]);
+    for (int i = len - 1; i >= 0; --i)
+        suffix[i] = i % k == k - 1 || i == len - 1 ? src[i] : CombineMinMax(suffix[i + 1], src[i]);
+    for (int i = 0; i < n; ++i)
+        dst[i] = CombineMinMax(suffix[i], prefix[i + k - 1]);
+}
+
+// min & max of the disc around each texel in [tl, br). dst is in scanline order of the region.
+// load(int2) gives the value of a texel in the image of 'size'. it is called only for texels in [tl - radius, br + radius).
+// the disc is approximated by GetDiscRects() and each rectangle is done by separable running min & max,
+// so the cost per texel doesn't depend on the radius.
+template<class Load>
+static void DiscMinMax(int2 ss, int2 tl, int2 br, float radius, const Load& load, std::vector<float2>& dst, bool parallel = true)
+{
+    auto for_each = [parallel](int begin, int end, const auto& body) {
+        if (parallel)
+            ParallelFor(begin, end, RowGrain, body);
+        else
+            body(begin, end);
+    };
+
+    int2 size = br - tl;
+    dst.assign(size.x * size.y, MinMaxIdentity);
+
+    std::vector<float2> tmp;
+    for (int2 hs : GetDiscRects(radius)) {
+        // horizontal pass: rows that the vertical pass reads
+        int top = std::max(tl.y - hs.y, 0);
+        int bottom = std::min(br.y + hs.y, ss.y);
+        tmp.resize(size.x * (bottom - top));
+        for_each(top, bottom, [&](int begin, int end) {
+            std::vector<float2> line(size.x + hs.x * 2), buf;
+            for (int y = begin; y < end; ++y) {
+                for (int i = 0; i < (int)line.size(); ++i) {
+                    int x = tl.x - hs.x + i;
+                    line[i] = x >= 0 && x < ss.x ? float2::set(load(int2{ x, y })) : MinMaxIdentity;
+                }
+                RunningMinMax(line.data(), &tmp[size.x * (y - top)], size.x, hs.x, buf);
+            }
+            });
+
+        // vertical pass
+        for_each(0, size.x, [&](int begin, int end) {
+            std::vector<float2> line(size.y + hs.y * 2), column(size.y), buf;
+            for (int x = begin; x < end; ++x) {
+                for (int i = 0; i < (int)line.size(); ++i) {
+                    int y = tl.y - hs.y + i;
+                    line[i] = y >= top && y < bottom ? tmp[size.x * (y - top) + x] : MinMaxIdentity;
+                }
+                RunningMinMax(line.data(), column.data(), size.y, hs.y, buf);
+                for (int y = 0; y < size.y; ++y) {
+                    auto& d = dst[size.x * y + x];
+                    d = CombineMinMax(d, column[y]);
+                }
+            }
+            });
+    }
+}
+
+// OR of bits [b - w, b + w] for each bit b of c. p and n are the words on the left and right. w must be < 32.
+// spreads by doubling the span, so it takes log2(w) steps.
+static inline uint32_t DilateBits(uint32_t p, uint32_t c, uint32_t n, int w)
+{
+    uint64_t r = uint64_t(c) | (uint64_t(n) << 32);
+    uint64_t l = uint64_t(p) | (uint64_t(c) << 32);
+    for (int len = 1; len <= w; ) {
+        int s = std::min(len, w + 1 - len);
+        r |= r >> s;
+        l |= l << s;
+        len += s;
+    }
+    return uint32_t(r) | uint32_t(l >> 32);
+}
+
+
+template<class T>
+class CPUFilterCommon : public RefCount<T>
+{
+public:
+    void setSrc(ITexture2DPtr v) override { m_src = ToCPU(v); }
+    void setDst(ITexture2DPtr v) override { m_dst = ToCPU(v); }
+
+public:
+    CPUTexture2DPtr m_src;
+    CPUTexture2DPtr m_dst;
+};
+
+
+class CPUTransform : public CPUFilterCommon<ITransform>
+{
+public:
+    void setSrcRegion(Rect v) override { m_region = v; }
+    void setColorRange(float2 v) override { m_color_range = v; }
+    void setGrayscale(bool v) override { m_grayscale = v; }
+    void setFillAlpha(bool v) override { m_fill_alpha = v; }
+    void setFiltering(bool v) override { m_filtering = v; }
+    void setDstRegion(Rect v) override { m_dst_region = v; }
+    void dispatch() override;
+
+public:
+    Rect m_region{};
+    Rect m_dst_region{};
+    float2 m_color_range{ 0.0f, 1.0f };
+    bool m_grayscale = false;
+    bool m_fill_alpha = false;
+    bool m_filtering = false;
+};
+
+// same as SampleTextureCatmullRom() in TextureFilter.hlsl
+static float4 SampleCatmullRom(const CPUTexture2D& s, float2 uv)
+{
+    float2 tex_size = float2(s.getInternalSize());
+    float2 sample_pos = uv * tex_size;
+    float2 tex_pos1 = floor(sample_pos - 0.5f) + 0.5f;
+    float2 f = sample_pos - tex_pos1;
+
+    float2 w0 = f * (-0.5f + f * (1.0f - 0.5f * f));
+    float2 w1 = 1.0f + f * f * (-2.5f + 1.5f * f);
+    float2 w2 = f * (0.5f + f * (2.0f - 1.5f * f));
+    float2 w3 = f * f * (-0.5f + 0.5f * f);
+
+    float2 w12 = w1 + w2;
+    float2 offset12 = w2 / w12;
+
+    float2 tex_pos0 = (tex_pos1 - 1.0f) / tex_size;
+    float2 tex_pos3 = (tex_pos1 + 2.0f) / tex_size;
+    float2 tex_pos12 = (tex_pos1 + offset12) / tex_size;
+
+    float4 r = float4::zero();
+    r += s.sample({ tex_pos0.x, tex_pos0.y }) * (w0.x * w0.y);
+    r += s.sample({ tex_pos12.x, tex_pos0.y }) * (w12.x * w0.y);
+    r += s.sample({ tex_pos3.x, tex_pos0.y }) * (w3.x * w0.y);
+
+    r += s.sample({ tex_pos0.x, tex_pos12.y }) * (w0.x * w12.y);
+    r += s.sample({ tex_pos12.x, tex_pos12.y }) * (w12.x * w12.y);
+    r += s.sample({ tex_pos3.x, tex_pos12.y }) * (w3.x * w12.y);
+
+    r += s.sample({ tex_pos0.x, tex_pos3.y }) * (w0.x * w3.y);
+    r += s.sample({ tex_pos12.x, tex_pos3.y }) * (w12.x * w3.y);
+    r += s.sample({ tex_pos3.x, tex_pos3.y }) * (w3.x * w3.y);
+    return r;
+}
+
+void CPUTransform::dispatch()
+{
+    if (!m_src || !m_dst) {
+        mrDbgPrint("*** CPUTransform::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    int2 src_size = m_src->getSize();
+    int2 dst_size = m_dst->getSize();
+    int2 size = m_region.size == int2::zero() ? src_size : m_region.size;
+
+    float2 pixel_size = 1.0f / float2(src_size);
+    float2 pixel_offset = pixel_size * m_region.pos;
+    float2 sample_step = (float2(size) / float2(src_size)) / float2(dst_size);
+    float2 bias = float2{ m_color_range.x, 1.0f / (m_color_range.y - m_color_range.x) };
+    // Transform.hlsl uses CatmullRom for all filters other than 0
+    bool catmull_rom = m_filtering && dst_size.x != src_size.x;
+
+    int2 tl, br;
+    if (!GetTexelRegion(dst_size, m_dst->getFormat(), m_dst_region, tl, br))
+        return;
+    ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            for (int x = tl.x; x < br.x; ++x) {
+                float2 uv = (sample_step * float2{ float(x), float(y) }) + pixel_offset + (sample_step * 0.5f);
+                float4 p = catmull_rom ? SampleCatmullRom(*m_src, uv) : m_src->sample(uv);
+
+                if (m_grayscale) {
+                    float c = dot(float3{ p.x, p.y, p.z }, float3{ 0.2126f, 0.7152f, 0.0722f });
+                    m_dst->store({ x, y }, float4::set(clamp01((c - bias.x) * bias.y)));
+                }
+                else {
+                    if (m_fill_alpha)
+                        p.w = 1.0f;
+                    m_dst->store({ x, y }, clamp01((p - bias.x) * bias.y));
+                }
+            }
+        }
+        });
+}
+
+ITransformPtr CreateCPUTransform()
+{
+    return make_ref<CPUTransform>();
+}
+
+
+class CPUNormalize : public CPUFilterCommon<INormalize>
+{
+public:
+    void setMax(float v) override { m_rmax = 1.0f / v; }
+    void setMax(uint32_t v) override { setMax(float(v)); }
+    void dispatch() override;
+
+public:
+    float m_rmax = 1.0f;
+};
+
+void CPUNormalize::dispatch()
+{
+    if (!m_src || !m_dst) {
+        mrDbgPrint("*** CPUNormalize::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    auto ts = m_dst->getInternalSize();
+    ParallelFor(0, ts.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y)
+            for (int x = 0; x < ts.x; ++x)
+                m_dst->store({ x, y }, float4::set(m_src->load({ x, y }).x * m_rmax));
+        });
+}
+
+INormalizePtr CreateCPUNormalize()
+{
+    return make_ref<CPUNormalize>();
+}
+
+
+class CPUBinarize : public CPUFilterCommon<IBinarize>
+{
+public:
+    void setThreshold(float v) override { m_threshold = v; }
+    void setDstRegion(Rect v) override { m_dst_region = v; }
+    void dispatch() override;
+
+public:
+    float m_threshold = 0.5f;
+    Rect m_dst_region{};
+};
+
+void CPUBinarize::dispatch()
+{
+    if (!m_src || !m_dst) {
+        mrDbgPrint("*** CPUBinarize::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    int w = m_src->getInternalSize().x;
+    int2 tl, br;
+    if (!GetTexelRegion(m_dst->getSize(), m_dst->getFormat(), m_dst_region, tl, br))
+        return;
+    ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            for (int x = tl.x; x < br.x; ++x) {
+                uint32_t r = 0;
+                for (int i = 0; i < 32; ++i) {
+                    int px = x * 32 + i;
+                    if (px < w && m_src->load({ px, y }).x > m_threshold)
+                        r |= 1u << i;
+                }
+                m_dst->storeU({ x, y }, r);
+            }
+        }
+        });
+}
+
+IBinarizePtr CreateCPUBinarize()
+{
+    return make_ref<CPUBinarize>();
+}
+
+
+class CPUContour : public CPUFilterCommon<IContour>
+{
+public:
+    void setRadius(float v) override { m_radius = v; }
+    void setDstRegion(Rect v) override { m_dst_region = v; }
+    void dispatch() override;
+
+public:
+    float m_radius = 1.0f;
+    float m_strength = 1.0f;
+    Rect m_dst_region{};
+};
+
+void CPUContour::dispatch()
+{
+    if (!m_src || !m_dst) {
+        mrDbgPrint("*** CPUContour::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    int2 tl, br;
+    if (!GetTexelRegion(m_dst->getSize(), m_dst->getFormat(), m_dst_region, tl, br))
+        return;
+
+    // same as Contour.hlsl
+    std::vector<float2> minmax;
+    DiscMinMax(m_src->getInternalSize(), tl, br, m_radius, [&](int2 p) { return m_src->load(p).x; }, minmax);
+    int width = br.x - tl.x;
+    ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            for (int x = tl.x; x < br.x; ++x) {
+                float2 c = minmax[width * (y - tl.y) + (x - tl.x)];
+                m_dst->store({ x, y }, float4::set(clamp01((c.y - c.x) * m_strength)));
+            }
+        }
+        });
+}
+
+IContourPtr CreateCPUContour()
+{
+    return make_ref<CPUContour>();
+}
+
+
+class CPUExpand : public CPUFilterCommon<IExpand>
+{
+public:
+    void setRadius(float v) override { m_radius = v; }
+    void dispatch() override;
+
+    void expandGrayscale();
+    void expandBinary();
+
+public:
+    float m_radius = 1.0f;
+};
+
+void CPUExpand::dispatch()
+{
+    if (!m_src || !m_dst) {
+        mrDbgPrint("*** CPUExpand::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    if (m_src->getFormat() == TextureFormat::Binary)
+        expandBinary();
+    else
+        expandGrayscale();
+}
+
+void CPUExpand::expandGrayscale()
+{
+    // same as Expand_Grayscale.hlsl
+    auto ts = m_dst->getInternalSize();
+    std::vector<float2> minmax;
+    DiscMinMax(m_src->getInternalSize(), {}, ts, m_radius, [&](int2 p) { return m_src->load(p).x; }, minmax);
+    ParallelFor(0, ts.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y)
+            for (int x = 0; x < ts.x; ++x)
+                m_dst->store({ x, y }, float4::set(minmax[ts.x * y + x].y));
+        });
+}
+
+void CPUExpand::expandBinary()
+{
+    // same as Expand_Binary.hlsl
+    auto widths = GetDiscRowWidths(m_radius);
+    for (int& w : widths)
+        w = std::min(w, 31);
+    int radius = (int)widths.size() - 1;
+    auto ss = m_src->getInternalSize();
+    auto ts = m_dst->getInternalSize();
+    ParallelFor(0, ts.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            int top = std::max(y - radius, 0);
+            int bottom = std::min(y + radius + 1, ss.y);
+            for (int x = 0; x < ts.x; ++x) {
+                uint32_t r = 0;
+                for (int py = top; py < bottom; ++py) {
+                    r |= DilateBits(
+                        m_src->loadU({ x - 1, py }), m_src->loadU({ x, py }), m_src->loadU({ x + 1, py }),
+                        widths[std::abs(py - y)]);
+                }
+                m_dst->storeU({ x, y }, r);
+            }
+        }
+        });
+}
+
+IExpandPtr CreateCPUExpand()
+{
+    return make_ref<CPUExpand>();
+}
+
+
+class CPUDistanceTransform : public CPUFilterCommon<IDistanceTransform>
+{
+public:
+    void setMaxDistance(float v) override { m_max_distance = v; }
+    void setDstRegion(Rect v) override { m_dst_region = v; }
+    void dispatch() override;
+
+public:
+    float m_max_distance = 4.0f;
+    Rect m_dst_region{};
+    std::vector<uint32_t> m_cols;
+};
+
+void CPUDistanceTransform::dispatch()
+{
+    if (!m_src || !m_dst || m_src->getFormat() != TextureFormat::Binary || m_src->getSize() != m_dst->getSize() || m_max_distance <= 0.0f) {
+        mrDbgPrint("*** CPUDistanceTransform::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    int2 tl, br;
+    if (!GetTexelRegion(m_dst->getSize(), m_dst->getFormat(), m_dst_region, tl, br))
+        return;
+
+    // same as DistanceTransform_Cols.hlsl and DistanceTransform_Rows.hlsl.
+    // pass 1: distance to the nearest set bit in the column. radius + 1 if there is none within radius.
+    // columns within radius of the region are needed by pass 2.
+    auto size = m_dst->getSize();
+    int radius = (int)std::ceil(m_max_distance);
+    int cl = std::max(tl.x - radius, 0);
+    int cr = std::min(br.x + radius, size.x);
+    int cw = cr - cl;
+    m_cols.resize(size_t(cw) * size_t(br.y - tl.y));
+    auto bit = [this](int x, int y) { return (m_src->getRow<uint32_t>(y)[x >> 5] >> (x & 31)) & 1; };
+    ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            uint32_t* cols = &m_cols[size_t(cw) * size_t(y - tl.y)];
+            for (int x = cl; x < cr; ++x) {
+                uint32_t d = radius + 1;
+                for (int dy = 0; dy <= radius; ++dy) {
+                    if ((y - dy >= 0 && bit(x, y - dy)) || (y + dy < size.y && bit(x, y + dy))) {
+                        d = dy;
+                        break;
+                    }
+                }
+                cols[x - cl] = d;
+            }
+        }
+        });
+
+    // pass 2: the nearest of the column distances within radius in the row
+    ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            const uint32_t* cols = &m_cols[size_t(cw) * size_t(y - tl.y)];
+            float* dst = m_dst->getRow<float>(y);
+            for (int x = tl.x; x < br.x; ++x) {
+                uint32_t d2 = ~0u;
+                int sr = std::min(x + radius + 1, size.x);
+                for (int sx = std::max(x - radius, 0); sx < sr; ++sx) {
+                    uint32_t dy = cols[sx - cl];
+                    uint32_t dx = std::abs(sx - x);
+                    if (dy <= (uint32_t)radius)
+                        d2 = std::min(d2, dx * dx + dy * dy);
+                }
+                dst[x] = d2 == ~0u ? 1.0f : std::min(std::sqrt(float(d2)) / m_max_distance, 1.0f);
+            }
+        }
+        });
+}
+
+IDistanceTransformPtr CreateCPUDistanceTransform()
+{
+    return make_ref<CPUDistanceTransform>();
+}
+
+
+// same as storing to and loading from Ru8
+static inline float RoundUnorm8(float v)
+{
+    return float(int(clamp01(v) * 255.0f + 0.5f)) * (1.0f / 255.0f);
+}
+
+class CPUPreprocess : public RefCount<IPreprocess>
+{
+public:
+    void setSrc(ITexture2DPtr v) override { m_src = ToCPU(v); }
+    void setRGB(ITexture2DPtr v) override { m_rgb = ToCPU(v); }
+    void setGrayscale(ITexture2DPtr v) override { m_grayscale = ToCPU(v); }
+    void setBinary(ITexture2DPtr v) override { m_binary = ToCPU(v); }
+    void setContour(ITexture2DPtr v) override { m_contour = ToCPU(v); }
+    void setContourBinary(ITexture2DPtr v) override { m_contour_b = ToCPU(v); }
+    void setColorRange(float2 v) override { m_color_range = v; }
+    void setThreshold(float v) override { m_threshold = v; }
+    void setContourRadius(float v) override { m_contour_radius = v; }
+    void setDstRegion(Rect v) override { m_dst_region = v; }
+    void dispatch() override;
+
+public:
+    CPUTexture2DPtr m_src;
+    CPUTexture2DPtr m_rgb;
+    CPUTexture2DPtr m_grayscale;
+    CPUTexture2DPtr m_binary;
+    CPUTexture2DPtr m_contour;
+    CPUTexture2DPtr m_contour_b;
+    float2 m_color_range{ 0.0f, 1.0f };
+    float m_threshold = 0.5f;
+    float m_contour_radius = 1.0f;
+    Rect m_dst_region{};
+};
+
+void CPUPreprocess::dispatch()
+{
+    CPUTexture2D* outputs[] = { m_rgb, m_grayscale, m_binary, m_contour, m_contour_b };
+    auto it = std::find_if(std::begin(outputs), std::end(outputs), [](auto* v) { return v != nullptr; });
+    if (!m_src || it == std::end(outputs)) {
+        mrDbgPrint("*** CPUPreprocess::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    // same as Transform.hlsl with the entire src.
+    // rgb is filtered if the size differs, grayscale is filtered only when shrinking. (same as IFilterSet::transform() and grayscale())
+    int2 src_size = m_src->getSize();
+    int2 size = (*it)->getSize();
+    float2 sample_step = (float2(src_size) / float2(src_size)) / float2(size);
+    float2 bias = float2{ m_color_range.x, 1.0f / (m_color_range.y - m_color_range.x) };
+    bool rgb_filter = size.x != src_size.x;
+    bool gray_filter = size.x < src_size.x;
+
+    bool need_contour = m_contour || m_contour_b;
+    int halo = need_contour ? int(std::ceil(m_contour_radius)) : 0;
+    Rect screen{ {}, size };
+    Rect region = m_dst_region.size.x ? m_dst_region.expand(halo).intersect(screen) : screen;
+    if (region.empty())
+        return;
+
+    // x is aligned to 32 for Binary outputs
+    int2 tl{ region.pos.x / 32 * 32, region.pos.y };
+    int2 br{ std::min(ceildiv(region.pos.x + region.size.x, 32) * 32, size.x), region.pos.y + region.size.y };
+
+    // process tiles of full width and TileHeight rows. grayscale of a tile and its halo stays in the cache,
+    // so the intermediate images are never written unless they are outputs.
+    const int TileHeight = 32;
+    int tile_count = ceildiv(br.y - tl.y, TileHeight);
+    ParallelFor(0, tile_count, 1, [&](int begin, int end) {
+        std::vector<float> gray;
+        std::vector<float2> minmax;
+        for (int ti = begin; ti < end; ++ti) {
+            int y0 = tl.y + TileHeight * ti;
+            int y1 = std::min(y0 + TileHeight, br.y);
+            int2 gtl{ std::max(tl.x - halo, 0), std::max(y0 - halo, 0) };
+            int2 gbr{ std::min(br.x + halo, size.x), std::min(y1 + halo, size.y) };
+            int gw = gbr.x - gtl.x;
+            gray.resize(gw * (gbr.y - gtl.y));
+
+            for (int y = gtl.y; y < gbr.y; ++y) {
+                bool core_row = y >= y0 && y < y1;
+                uint32_t bits = 0;
+                for (int x = gtl.x; x < gbr.x; ++x) {
+                    bool core = core_row && x >= tl.x && x < br.x;
+                    float2 uv = (sample_step * float2{ float(x), float(y) }) + (sample_step * 0.5f);
+                    float4 p = gray_filter ? SampleCatmullRom(*m_src, uv) : m_src->sample(uv);
+                    float c = dot(float3{ p.x, p.y, p.z }, float3{ 0.2126f, 0.7152f, 0.0722f });
+                    float g = RoundUnorm8((c - bias.x) * bias.y);
+                    gray[gw * (y - gtl.y) + (x - gtl.x)] = g;
+                    if (!core)
+                        continue;
+
+                    if (m_rgb) {
+                        if (rgb_filter != gray_filter)
+                            p = rgb_filter ? SampleCatmullRom(*m_src, uv) : m_src->sample(uv);
+                        m_rgb->store({ x, y }, clamp01(p));
+                    }
+                    if (m_grayscale)
+                        m_grayscale->store({ x, y }, float4::set(g));
+                    if (g > m_threshold)
+                        bits |= 1u << (x % 32);
+                    if (m_binary && (x % 32 == 31 || x + 1 == br.x)) {
+                        m_binary->storeU({ x / 32, y }, bits);
+                        bits = 0;
+                    }
+                }
+            }
+
+            if (need_contour) {
+                // same as Contour.hlsl + Binarize.hlsl
+                DiscMinMax(size, { tl.x, y0 }, { br.x, y1 }, m_contour_radius,
+                    [&](int2 p) { return gray[gw * (p.y - gtl.y) + (p.x - gtl.x)]; }, minmax, false);
+                int w = br.x - tl.x;
+                for (int y = y0; y < y1; ++y) {
+                    uint32_t bits = 0;
+                    for (int x = tl.x; x < br.x; ++x) {
+                        float2 mm = minmax[w * (y - y0) + (x - tl.x)];
+                        float c = RoundUnorm8(mm.y - mm.x);
+                        if (m_contour)
+                            m_contour->store({ x, y }, float4::set(c));
+                        if (c > m_threshold)
+                            bits |= 1u << (x % 32);
+                        if (m_contour_b && (x % 32 == 31 || x + 1 == br.x)) {
+                            m_contour_b->storeU({ x / 32, y }, bits);
+                            bits = 0;
+                        }
+                    }
+                }
+            }
+        }
+        });
+}
+
+IPreprocessPtr CreateCPUPreprocess()
+{
+    return make_ref<CPUPreprocess>();
+}
+
+
+// store: [](int x, int y, float score) -> void. matches row y of the range.
+template<class Store>
+static void MatchGrayscaleRow(const CPUTexture2D& src, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range, int y, const Store& store)
+{
+    // same as TemplateMatch_Grayscale.hlsl
+    auto tsize = tmpl.getInternalSize();
+    const bool use_mask = mask && mask->getInternalSize() == tsize;
+
+    // Ru8 without mask: sum up differences as integers while the template is inside the image.
+    const bool fast_path = !use_mask &&
+        src.getFormat() == TextureFormat::Ru8 && tmpl.getFormat() == TextureFormat::Ru8;
+    const int2 ssize = src.getInternalSize();
+
+    for (int x = 0; x < range.x; ++x) {
+        int2 bpos = tl + int2{ x, y };
+        if (fast_path && bpos.x >= 0 && bpos.y >= 0 && bpos.x + tsize.x <= ssize.x && bpos.y + tsize.y <= ssize.y) {
+            uint32_t sum = 0;
+            for (int i = 0; i < tsize.y; ++i) {
+                auto* s = src.getRow(bpos.y + i) + bpos.x;
+                auto* t = tmpl.getRow(i);
+                for (int j = 0; j < tsize.x; ++j)
+                    sum += std::abs(int(s[j]) - int(t[j]));
+            }
+            store(x, y, float(sum) / 255.0f);
+            continue;
+        }
+
+        float r = 0.0f;
+        for (int i = 0; i < tsize.y; ++i) {
+            for (int j = 0; j < tsize.x; ++j) {
+                int2 tpos{ j, i };
+                float diff = std::abs(src.load(bpos + tpos).x - tmpl.load(tpos).x);
+                if (use_mask)
+                    diff *= mask->load(tpos).x;
+                r += diff;
+            }
+        }
+        store(x, y, r);
+    }
+}
+
+template<class Store>
+static void MatchRGBRow(const CPUTexture2D& src, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range, int y, const Store& store)
+{
+    // same as TemplateMatch_RGB.hlsl
+    auto tsize = tmpl.getInternalSize();
+    const bool use_mask = mask && mask->getInternalSize() == tsize;
+
+    // RGBAu8 without mask: sum up differences as integers while the template is inside the image.
+    const bool fast_path = !use_mask &&
+        src.getFormat() == TextureFormat::RGBAu8 && tmpl.getFormat() == TextureFormat::RGBAu8;
+    const int2 ssize = src.getInternalSize();
+
+    for (int x = 0; x < range.x; ++x) {
+        int2 bpos = tl + int2{ x, y };
+        if (fast_path && bpos.x >= 0 && bpos.y >= 0 && bpos.x + tsize.x <= ssize.x && bpos.y + tsize.y <= ssize.y) {
+            uint32_t sum = 0;
+            for (int i = 0; i < tsize.y; ++i) {
+                auto* s = src.getRow(bpos.y + i) + bpos.x * 4;
+                auto* t = tmpl.getRow(i);
+                for (int j = 0; j < tsize.x * 4; j += 4) {
+                    int dr = std::abs(int(s[j + 0]) - int(t[j + 0]));
+                    int dg = std::abs(int(s[j + 1]) - int(t[j + 1]));
+                    int db = std::abs(int(s[j + 2]) - int(t[j + 2]));
+                    sum += std::max(std::max(dr, dg), db);
+                }
+            }
+            store(x, y, float(sum) / 255.0f);
+            continue;
+        }
+
+        float r = 0.0f;
+        for (int i = 0; i < tsize.y; ++i) {
+            for (int j = 0; j < tsize.x; ++j) {
+                int2 tpos{ j, i };
+                float4 s = src.load(bpos + tpos);
+                float4 t = tmpl.load(tpos);
+                float3 diff = abs(float3{ s.x - t.x, s.y - t.y, s.z - t.z });
+                if (use_mask)
+                    diff *= mask->load(tpos).x;
+                r += std::max(std::max(diff.x, diff.y), diff.z);
+            }
+        }
+        store(x, y, r);
+    }
+}
+
+// store: [](int x, int y, float score) -> void. called from multiple threads, but each row is processed by one thread.
+template<class Store>
+static void MatchGrayscale(const CPUTexture2D& src, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range, const Store& store)
+{
+    ParallelFor(0, range.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y)
+            MatchGrayscaleRow(src, tmpl, mask, tl, range, y, store);
+        });
+}
+
+template<class Store>
+static void MatchRGB(const CPUTexture2D& src, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range, const Store& store)
+{
+    ParallelFor(0, range.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y)
+            MatchRGBRow(src, tmpl, mask, tl, range, y, store);
+        });
+}
+
+
+class CPUTemplateMatch : public CPUFilterCommon<ITemplateMatch>
+{
+public:
+    void setTemplate(ITexture2DPtr v) override { m_template = ToCPU(v); }
+    void setMask(ITexture2DPtr v) override { m_mask_template = ToCPU(v); }
+    void setRegion(Rect v) override { m_region = v; }
+    void dispatch() override;
+
+    int2 getSize() const;
+
+public:
+    CPUTexture2DPtr m_template;
+    CPUTexture2DPtr m_mask_template;
+    Rect m_region{};
+    BinaryMatcher m_binary_matcher;
+};
+
+int2 CPUTemplateMatch::getSize() const
+{
+    return m_region.size.x == 0 ? m_src->getSize() : m_region.size;
+}
+
+void CPUTemplateMatch::dispatch()
+{
+    if (!m_src || !m_dst || !m_template) {
+        mrDbgPrint("*** CPUTemplateMatch::dispatch(): invaid params ***\n");
+        return;
+    }
+    if (m_src->getFormat() != m_template->getFormat()) {
+        mrDbgPrint("*** CPUTemplateMatch::dispatch(): format mismatch ***\n");
+        return;
+    }
+    auto size = getSize();
+    if (size.x < 0 || size.y < 0) {
+        mrDbgPrint("*** CPUTemplateMatch::dispatch(): size < 0 ***\n");
+        return;
+    }
+
+    auto store = [this](int x, int y, float v) { m_dst->store({ x, y }, float4::set(v)); };
+    switch (m_src->getFormat()) {
+    case TextureFormat::Binary:
+        m_binary_matcher.match(*m_dst, *m_src, *m_template, m_mask_template, m_region.pos, size);
+        break;
+    case TextureFormat::Ru8:
+    case TextureFormat::Rf16:
+    case TextureFormat::Rf32:
+        MatchGrayscale(*m_src, *m_template, m_mask_template, m_region.pos, size, store);
+        break;
+    default:
+        MatchRGB(*m_src, *m_template, m_mask_template, m_region.pos, size, store);
+        break;
+    }
+}
+
+ITemplateMatchPtr CreateCPUTemplateMatch()
+{
+    return make_ref<CPUTemplateMatch>();
+}
+
+
+// minimum of each row of a score map. the first one in scanline order wins on ties.
+// float scores are not negative, so they can be compared by bits as the shader does.
+struct RowMin
+{
+    uint32_t score = ~0u;
+    int x = 0;
+    bool exact = true; // false if all positions of the row were pruned. score is a lower bound then.
+};
+
+// integral image of an area of a Ru8 texture. sums wrap around, but differences of them are exact as long as the sum
+// of a box fits in 32 bits.
+struct IntegralImage
+{
+    Rect area{};
+    int pitch = 0;
+    std::vector<uint32_t> data;
+
+    void build(const CPUTexture2D& src, Rect a)
+    {
+        area = a;
+        pitch = a.size.x + 1;
+        data.assign(size_t(pitch) * (a.size.y + 1), 0);
+        ParallelFor(0, a.size.y, RowGrain, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                auto* s = src.getRow(a.pos.y + y) + a.pos.x;
+                auto* d = &data[size_t(pitch) * (y + 1) + 1];
+                uint32_t sum = 0;
+                for (int x = 0; x < a.size.x; ++x)
+                    d[x] = sum += s[x];
+            }
+            });
+        ParallelFor(0, a.size.x, 64, [&](int begin, int end) {
+            for (int y = 1; y < a.size.y; ++y) {
+                auto* prev = &data[size_t(pitch) * y + 1];
+                auto* d = prev + pitch;
+                for (int x = begin; x < end; ++x)
+                    d[x] += prev[x];
+            }
+            });
+    }
+
+    // sum of the box. x, y are relative to area.pos.
+    uint32_t box(int x, int y, int w, int h) const
+    {
+        auto* r0 = &data[size_t(pitch) * y + x];
+        auto* r1 = r0 + size_t(pitch) * h;
+        return r1[w] - r1[0] - r0[w] + r0[0];
+    }
+};
+
+// MatchGrayscale() + min for Ru8 without mask. gives the same result as scanning all scores.
+// lower bounds of the score by block sums (successive elimination: |sum(s) - sum(t)| <= sum(|s - t|) for each band of
+// rows) reject most positions without touching the template pixels, and the rest stop accumulating differences
+// as soon as the partial sum plus the bound of the remaining bands can't win.
+// positions can't win if the score is greater than the cutoff, or not less than an earlier best.
+// all positions with the template must be inside src and the area of integral. returns the number of pixels compared.
+static uint64_t MatchGrayscaleMin(const CPUTexture2D& src, const CPUTexture2D& tmpl, const IntegralImage& integral,
+    int2 tl, int2 range, uint32_t cutoff, std::vector<RowMin>& rows)
+{
+    static const int BandHeight = 4;
+
+    const int2 tsize = tmpl.getInternalSize();
+    const int nbands = ceildiv(tsize.y, BandHeight);
+    std::vector<uint32_t> tsums(nbands);
+    for (int i = 0; i < tsize.y; ++i) {
+        auto* t = tmpl.getRow(i);
+        for (int j = 0; j < tsize.x; ++j)
+            tsums[i / BandHeight] += t[j];
+    }
+    uint32_t ttotal = 0;
+    for (auto v : tsums)
+        ttotal += v;
+
+    const int2 ioffset = tl - integral.area.pos;
+    auto box = [&](int x, int y, int w, int h) { return integral.box(ioffset.x + x, ioffset.y + y, w, h); };
+    auto diff = [](uint32_t a, uint32_t b) { return a > b ? a - b : b - a; };
+    auto band_bound = [&](int x, int y, int b) {
+        int h = std::min(BandHeight, tsize.y - b * BandHeight);
+        return diff(box(x, y + b * BandHeight, tsize.x, h), tsums[b]);
+    };
+    auto sad = [&](int x, int y, int i0, int i1) {
+        uint32_t sum = 0;
+        for (int i = i0; i < i1; ++i) {
+            auto* s = src.getRow(tl.y + y + i) + (tl.x + x);
+            auto* t = tmpl.getRow(i);
+            for (int j = 0; j < tsize.x; ++j)
+                sum += std::abs(int(s[j]) - int(t[j]));
+        }
+        return sum;
+    };
+
+    // lower bounds of all positions. the position with the smallest one is likely to be the best, and its score
+    // is a good initial bound to reject others. without it, positions before the best in scanline order aren't rejected.
+    std::vector<uint32_t> lower(size_t(range.x) * range.y);
+    std::vector<std::pair<uint32_t, int>> row_lower(range.y, { ~0u, 0 });
+    ParallelFor(0, range.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            auto* dst = &lower[size_t(range.x) * y];
+            for (int x = 0; x < range.x; ++x) {
+                // bound of the whole template first. it is looser but enough to reject most positions by the cutoff.
+                uint32_t v = diff(box(x, y, tsize.x, tsize.y), ttotal);
+                if (v <= cutoff) {
+                    v = 0;
+                    for (int b = 0; b < nbands; ++b)
+                        v += band_bound(x, y, b);
+                }
+                dst[x] = v;
+                if (v < row_lower[y].first)
+                    row_lower[y] = { v, x };
+            }
+        }
+        });
+    int seed_y = int(std::min_element(row_lower.begin(), row_lower.end(), [](auto& a, auto& b) { return a.first < b.first; }) - row_lower.begin());
+    uint32_t seed = sad(row_lower[seed_y].second, seed_y, 0, tsize.y);
+
+    std::atomic<uint32_t> global_best{ seed };
+    std::atomic<uint64_t> compared{ uint64_t(tsize.x) * tsize.y };
+    ParallelFor(0, range.y, RowGrain, [&](int begin, int end) {
+        std::vector<uint32_t> bounds(nbands);
+        uint32_t local_best = ~0u; // best of earlier rows of this thread. equal scores lose to it.
+        uint64_t local_compared = 0;
+        for (int y = begin; y < end; ++y) {
+            auto& row = rows[y];
+            uint32_t row_best = ~0u, pruned_bound = ~0u;
+            int pruned_x = 0;
+            auto reject = [&](uint32_t bound, int x) {
+                // later positions of the row and rows of this thread come later in scanline order
+                uint32_t g = global_best.load(std::memory_order_relaxed);
+                if (bound > cutoff || bound > g || bound >= std::min(row_best, local_best)) {
+                    if (bound < pruned_bound) {
+                        pruned_bound = bound;
+                        pruned_x = x;
+                    }
+                    return true;
+                }
+                return false;
+            };
+
+            const auto* lrow = &lower[size_t(range.x) * y];
+            for (int x = 0; x < range.x; ++x) {
+                if (reject(lrow[x], x))
+                    continue;
+
+                uint32_t rest = 0;
+                for (int b = 0; b < nbands; ++b) {
+                    bounds[b] = band_bound(x, y, b);
+                    rest += bounds[b];
+                }
+
+                uint32_t sum = 0;
+                bool rejected = false;
+                for (int b = 0; b < nbands && !rejected; ++b) {
+                    int i0 = b * BandHeight, i1 = std::min(i0 + BandHeight, tsize.y);
+                    sum += sad(x, y, i0, i1);
+                    local_compared += uint64_t(i1 - i0) * tsize.x;
+                    rest -= bounds[b];
+                    rejected = reject(sum + rest, x);
+                }
+                if (rejected)
+                    continue;
+
+                row_best = sum;
+                row.score = std::bit_cast<uint32_t>(float(sum) / 255.0f);
+                row.x = x;
+            }
+
+            if (row_best != ~0u) {
+                local_best = std::min(local_best, row_best);
+                uint32_t g = global_best.load(std::memory_order_relaxed);
+                while (row_best < g && !global_best.compare_exchange_weak(g, row_best, std::memory_order_relaxed)) {}
+            }
+            else if (pruned_bound != ~0u) {
+                row.score = std::bit_cast<uint32_t>(float(pruned_bound) / 255.0f);
+                row.x = pruned_x;
+                row.exact = false;
+            }
+        }
+        compared += local_compared;
+        });
+    return compared;
+}
+
+// MatchRGB() + min for RGBAu8 without mask. gives the same result as scanning all scores.
+// there are no cheap lower bounds for the max of channel differences, so positions are only rejected while being
+// summed up: differences only grow, and a position stops as soon as its partial sum can't win (see MatchGrayscaleMin()).
+// all positions with the template must be inside src.
+static void MatchRGBMin(const CPUTexture2D& src, const CPUTexture2D& tmpl, int2 tl, int2 range, std::vector<RowMin>& rows)
+{
+    const int2 tsize = tmpl.getInternalSize();
+    std::atomic<uint32_t> global_best{ ~0u };
+    ParallelFor(0, range.y, RowGrain, [&](int begin, int end) {
+        uint32_t local_best = ~0u; // best of earlier rows of this thread. equal scores lose to it.
+        for (int y = begin; y < end; ++y) {
+            auto& row = rows[y];
+            uint32_t row_best = ~0u;
+            for (int x = 0; x < range.x; ++x) {
+                uint32_t earlier = std::min(row_best, local_best);
+                uint32_t sum = 0;
+                bool rejected = false;
+                for (int i = 0; i < tsize.y && !rejected; ++i) {
+                    auto* s = src.getRow(tl.y + y + i) + (tl.x + x) * 4;
+                    auto* t = tmpl.getRow(i);
+                    for (int j = 0; j < tsize.x * 4; j += 4) {
+                        int dr = std::abs(int(s[j + 0]) - int(t[j + 0]));
+                        int dg = std::abs(int(s[j + 1]) - int(t[j + 1]));
+                        int db = std::abs(int(s[j + 2]) - int(t[j + 2]));
+                        sum += std::max(std::max(dr, dg), db);
+                    }
+                    // later positions of the row and rows of this thread come later in scanline order
+                    rejected = sum >= earlier || sum > global_best.load(std::memory_order_relaxed);
+                }
+                if (rejected)
+                    continue;
+
+                row_best = sum;
+                row.score = std::bit_cast<uint32_t>(float(sum) / 255.0f);
+                row.x = x;
+            }
+
+            if (row_best != ~0u) {
+                local_best = std::min(local_best, row_best);
+                uint32_t g = global_best.load(std::memory_order_relaxed);
+                while (row_best < g && !global_best.compare_exchange_weak(g, row_best, std::memory_order_relaxed)) {}
+            }
+        }
+        });
+}
+
+// cutoff of MatchGrayscaleMin(). raw scores are sums of differences in 0-255. +1 not to prune by rounding errors.
+static uint32_t GetRawCutoff(float cutoff)
+{
+    return cutoff < 0.0f ? ~0u : uint32_t(std::min(double(cutoff) * 255.0 + 1.0, double(~0u)));
+}
+
+static IReduceMinMax::Result ReduceRows(const std::vector<RowMin>& rows)
+{
+    // rows whose positions are all pruned lose to any exact one
+    int best = 0;
+    for (int y = 1; y < (int)rows.size(); ++y) {
+        auto& r = rows[y];
+        auto& b = rows[best];
+        if ((r.exact && !b.exact) || (r.exact == b.exact && r.score < b.score))
+            best = y;
+    }
+    IReduceMinMax::Result ret{};
+    ret.pos_min = { rows[best].x, best };
+    ret.vali_min = rows[best].score; // valf_min for float scores
+    return ret;
+}
+
+class CPUTemplateMatchMin : public RefCount<ITemplateMatchMin>
+{
+public:
+    void setSrc(ITexture2DPtr v) override { m_src = ToCPU(v); }
+    void setTemplate(ITexture2DPtr v) override { m_template = ToCPU(v); }
+    void setMask(ITexture2DPtr v) override { m_mask_template = ToCPU(v); }
+    void setRegion(Rect v) override { m_region = v; }
+    void setCutoff(float v) override { m_cutoff = v; }
+    IReduceMinMax::Result getResult() override { return m_result; }
+    float getPruningRate() override { return m_pruning_rate; }
+    void dispatch() override;
+
+public:
+    CPUTexture2DPtr m_src;
+    CPUTexture2DPtr m_template;
+    CPUTexture2DPtr m_mask_template;
+    Rect m_region{};
+    float m_cutoff = -1.0f;
+    BinaryMatcher m_binary_matcher;
+    IReduceMinMax::Result m_result{};
+    float m_pruning_rate{};
+};
+
+void CPUTemplateMatchMin::dispatch()
+{
+    m_result = {};
+    m_pruning_rate = 0.0f;
+    if (!m_src || !m_template) {
+        mrDbgPrint("*** CPUTemplateMatchMin::dispatch(): invaid params ***\n");
+        return;
+    }
+    if (m_src->getFormat() != m_template->getFormat()) {
+        mrDbgPrint("*** CPUTemplateMatchMin::dispatch(): format mismatch ***\n");
+        return;
+    }
+    auto size = m_region.size.x == 0 ? m_src->getSize() : m_region.size;
+    if (size.x <= 0 || size.y <= 0) {
+        mrDbgPrint("*** CPUTemplateMatchMin::dispatch(): size <= 0 ***\n");
+        return;
+    }
+
+    std::vector<RowMin> rows(size.y);
+    auto store = [&rows](int x, int y, uint32_t v) {
+        auto& r = rows[y];
+        if (v < r.score || (v == r.score && x < r.x)) {
+            r.score = v;
+            r.x = x;
+        }
+    };
+    auto store_f = [&store](int x, int y, float v) { store(x, y, std::bit_cast<uint32_t>(v)); };
+
+    auto tsize = m_template->getSize();
+    auto tl = m_region.pos;
+    auto br = tl + size + tsize - 1;
+    bool inside = tl.x >= 0 && tl.y >= 0 && br.x <= m_src->getSize().x && br.y <= m_src->getSize().y;
+
+    switch (m_src->getFormat()) {
+    case TextureFormat::Binary:
+        m_binary_matcher.match([&store, width = size.x](int y, const uint32_t* scores) {
+            for (int x = 0; x < width; ++x)
+                store(x, y, scores[x]);
+            }, *m_src, *m_template, m_mask_template, m_region.pos, size);
+        break;
+    case TextureFormat::Ru8:
+        if (!m_mask_template && inside) {
+            uint32_t cutoff = GetRawCutoff(m_cutoff);
+            IntegralImage integral;
+            integral.build(*m_src, Rect{ tl, size + tsize - 1 });
+            uint64_t compared = MatchGrayscaleMin(*m_src, *m_template, integral, tl, size, cutoff, rows);
+            double total = double(size.x) * double(size.y) * double(tsize.x) * double(tsize.y);
+            m_pruning_rate = float(1.0 - double(compared) / total);
+            break;
+        }
+        [[fallthrough]];
+    case TextureFormat::Rf16:
+    case TextureFormat::Rf32:
+        MatchGrayscale(*m_src, *m_template, m_mask_template, m_region.pos, size, store_f);
+        break;
+    default:
+        if (!m_mask_template && inside && m_src->getFormat() == TextureFormat::RGBAu8) {
+            MatchRGBMin(*m_src, *m_template, tl, size, rows);
+            break;
+        }
+        MatchRGB(*m_src, *m_template, m_mask_template, m_region.pos, size, store_f);
+        break;
+    }
+
+    m_result = ReduceRows(rows);
+}
+
+ITemplateMatchMinPtr CreateCPUTemplateMatchMin()
+{
+    return make_ref<CPUTemplateMatchMin>();
+}
+
+
+class CPUTemplateMatchMinMulti : public RefCount<ITemplateMatchMinMulti>
+{
+public:
+    void setSrc(ITexture2DPtr v) override { m_src = ToCPU(v); }
+    void addTemplate(ITexture2DPtr tmpl, Rect region, float cutoff) override { m_templates.push_back({ ToCPU(tmpl), region, cutoff }); }
+    void clearTemplates() override { m_templates.clear(); }
+    std::vector<IReduceMinMax::Result> getResult() override { return m_results; }
+    void dispatch() override;
+
+public:
+    struct Item
+    {
+        CPUTexture2DPtr tmpl;
+        Rect region;
+        float cutoff;
+    };
+    CPUTexture2DPtr m_src;
+    std::vector<Item> m_templates;
+    std::vector<IReduceMinMax::Result> m_results;
+};
+
+void CPUTemplateMatchMinMulti::dispatch()
+{
+    m_results.assign(m_templates.size(), {});
+    if (!m_src) {
+        mrDbgPrint("*** CPUTemplateMatchMinMulti::dispatch(): invaid params ***\n");
+        return;
+    }
+    if (m_src->getFormat() == TextureFormat::Binary) {
+        mrDbgPrint("*** CPUTemplateMatchMinMulti::dispatch(): Binary is not supported ***\n");
+        return;
+    }
+
+    // Ru8 templates inside src are matched by MatchGrayscaleMin() with the integral image of the area of all of them.
+    // others are matched by bands of rows. all templates are matched for a band before the next, so the rows of src
+    // are still in the cache for the next template.
+    const int n = (int)m_templates.size();
+    const int2 ssize = m_src->getSize();
+    std::vector<Rect> regions(n);
+    std::vector<std::vector<RowMin>> rows(n);
+    std::vector<int> pruned, banded;
+    Rect pruned_area{}, banded_area{};
+    for (int i = 0; i < n; ++i) {
+        auto& item = m_templates[i];
+        if (!item.tmpl || item.tmpl->getFormat() != m_src->getFormat()) {
+            mrDbgPrint("*** CPUTemplateMatchMinMulti::dispatch(): format mismatch ***\n");
+            continue;
+        }
+        Rect region{ item.region.pos, item.region.size.x == 0 ? ssize : item.region.size };
+        if (region.size.x <= 0 || region.size.y <= 0) {
+            mrDbgPrint("*** CPUTemplateMatchMinMulti::dispatch(): size <= 0 ***\n");
+            continue;
+        }
+        regions[i] = region;
+        rows[i].resize(region.size.y);
+
+        auto tsize = item.tmpl->getSize();
+        Rect window{ region.pos, region.size + tsize - 1 };
+        if (window.intersect(Rect{ {}, ssize }) == window && m_src->getFormat() == TextureFormat::Ru8) {
+            pruned.push_back(i);
+            pruned_area = pruned_area.merge(window);
+        }
+        else {
+            banded.push_back(i);
+            banded_area = banded_area.merge(region);
+        }
+    }
+
+    if (!pruned.empty()) {
+        IntegralImage integral;
+        integral.build(*m_src, pruned_area);
+        for (int i : pruned) {
+            auto& item = m_templates[i];
+            MatchGrayscaleMin(*m_src, *item.tmpl, integral, regions[i].pos, regions[i].size, GetRawCutoff(item.cutoff), rows[i]);
+        }
+    }
+
+    auto match_bands = [&](const auto& match_row) {
+        ParallelFor(0, banded_area.size.y, RowGrain, [&](int begin, int end) {
+            for (int i : banded) {
+                auto& region = regions[i];
+                auto& r = rows[i];
+                auto store = [&r](int x, int y, float v) {
+                    uint32_t u = std::bit_cast<uint32_t>(v);
+                    if (u < r[y].score) {
+                        r[y].score = u;
+                        r[y].x = x;
+                    }
+                };
+                int y0 = std::max(banded_area.pos.y + begin - region.pos.y, 0);
+                int y1 = std::min(banded_area.pos.y + end - region.pos.y, region.size.y);
+                for (int y = y0; y < y1; ++y)
+                    match_row(*m_src, *m_templates[i].tmpl, region, y, store);
+            }
+            });
+    };
+    switch (m_src->getFormat()) {
+    case TextureFormat::Ru8:
+    case TextureFormat::Rf16:
+    case TextureFormat::Rf32:
+        match_bands([](auto& src, auto& tmpl, Rect region, int y, auto& store) { MatchGrayscaleRow(src, tmpl, nullptr, region.pos, region.size, y, store); });
+        break;
+    default:
+        match_bands([](auto& src, auto& tmpl, Rect region, int y, auto& store) { MatchRGBRow(src, tmpl, nullptr, region.pos, region.size, y, store); });
+        break;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        if (!rows[i].empty())
+            m_results[i] = ReduceRows(rows[i]);
+    }
+}
+
+ITemplateMatchMinMultiPtr CreateCPUTemplateMatchMinMulti()
+{
+    return make_ref<CPUTemplateMatchMinMulti>();
+}
+
+
+
+using complexf = std::complex<float>;
+
+// radix-2 FFT of a fixed size. same as FFT() in TemplateMatchFFT_Common.hlsl.
+class FFT
+{
+public:
+    void setup(int n)
+    {
+        if (n == m_n)
+            return;
+        m_n = n;
+        int bits = std::countr_zero(uint32_t(n));
+        m_bitrev.resize(n);
+        for (int i = 0; i < n; ++i)
+            m_bitrev[i] = bits == 0 ? 0 : int(reverse_bits(uint32_t(i)) >> (32 - bits));
+        m_twiddles.resize(std::max(n / 2, 1));
+        for (int i = 0; i < n / 2; ++i) {
+            double a = -2.0 * 3.14159265358979323846 * double(i) / double(n);
+            m_twiddles[i] = complexf(float(std::cos(a)), float(std::sin(a)));
+        }
+    }
+
+    // in place. the inverse is not scaled.
+    void transform(complexf* data, bool inverse) const
+    {
+        int n = m_n;
+        for (int i = 0; i < n; ++i) {
+            int j = m_bitrev[i];
+            if (i < j)
+                std::swap(data[i], data[j]);
+        }
+        for (int half = 1; half < n; half *= 2) {
+            int step = n / (half * 2);
+            for (int base = 0; base < n; base += half * 2) {
+                for (int j = 0; j < half; ++j) {
+                    complexf w = m_twiddles[j * step];
+                    if (inverse)
+                        w = std::conj(w);
+                    complexf t = data[base + j + half] * w;
+                    data[base + j + half] = data[base + j] - t;
+                    data[base + j] += t;
+                }
+            }
+        }
+    }
+
+    int size() const { return m_n; }
+
+private:
+    static uint32_t reverse_bits(uint32_t v)
+    {
+        v = ((v >> 1) & 0x55555555) | ((v & 0x55555555) << 1);
+        v = ((v >> 2) & 0x33333333) | ((v & 0x33333333) << 2);
+        v = ((v >> 4) & 0x0f0f0f0f) | ((v & 0x0f0f0f0f) << 4);
+        v = ((v >> 8) & 0x00ff00ff) | ((v & 0x00ff00ff) << 8);
+        return (v >> 16) | (v << 16);
+    }
+
+    int m_n = 0;
+    std::vector<int> m_bitrev;
+    std::vector<complexf> m_twiddles;
+};
+
+// 2D FFT of a real image. dst is fft_size.y rows of fft_size.x / 2 + 1 (the rest is conjugate symmetric).
+// rows are transformed in pairs packed to the real and imaginary parts.
+// load: [](int x, int y) -> float. called from multiple threads.
+template<class Load>
+static void ForwardFFT2D(const FFT& fx, const FFT& fy, const Load& load, complexf* dst)
+{
+    const int nx = fx.size(), ny = fy.size(), h = nx / 2 + 1;
+    ParallelFor(0, ny / 2, RowGrain / 2, [&](int begin, int end) {
+        std::vector<complexf> z(nx);
+        for (int p = begin; p < end; ++p) {
+            int y = p * 2;
+            for (int x = 0; x < nx; ++x)
+                z[x] = complexf(load(x, y), load(x, y + 1));
+            fx.transform(z.data(), false);
+
+            auto* a = dst + (h * y);
+            auto* b = a + h;
+            for (int k = 0; k < h; ++k) {
+                complexf zk = z[k], zn = std::conj(z[(nx - k) & (nx - 1)]);
+                a[k] = (zk + zn) * 0.5f;
+                b[k] = (zk - zn) * complexf(0.0f, -0.5f);
+            }
+        }
+        });
+    ParallelFor(0, h, RowGrain, [&](int begin, int end) {
+        std::vector<complexf> col(ny);
+        for (int k = begin; k < end; ++k) {
+            for (int y = 0; y < ny; ++y)
+                col[y] = dst[h * y + k];
+            fy.transform(col.data(), false);
+            for (int y = 0; y < ny; ++y)
+                dst[h * y + k] = col[y];
+        }
+        });
+}
+
+// inverse of ForwardFFT2D. src is destroyed.
+// store: [](int x, int y, float v) -> void. v is scaled by 1 / (fft_size.x * fft_size.y). called from multiple threads.
+template<class Store>
+static void InverseFFT2D(const FFT& fx, const FFT& fy, complexf* src, const Store& store)
+{
+    const int nx = fx.size(), ny = fy.size(), h = nx / 2 + 1;
+    ParallelFor(0, h, RowGrain, [&](int begin, int end) {
+        std::vector<complexf> col(ny);
+        for (int k = begin; k < end; ++k) {
+            for (int y = 0; y < ny; ++y)
+                col[y] = src[h * y + k];
+            fy.transform(col.data(), true);
+            for (int y = 0; y < ny; ++y)
+                src[h * y + k] = col[y];
+        }
+        });
+
+    const float scale = 1.0f / float(nx * ny);
+    ParallelFor(0, ny / 2, RowGrain / 2, [&](int begin, int end) {
+        std::vector<complexf> z(nx);
+        for (int p = begin; p < end; ++p) {
+            int y = p * 2;
+            auto* a = src + (h * y);
+            auto* b = a + h;
+            for (int k = 0; k < nx; ++k) {
+                complexf ak = k < h ? a[k] : std::conj(a[nx - k]);
+                complexf bk = k < h ? b[k] : std::conj(b[nx - k]);
+                z[k] = ak + bk * complexf(0.0f, 1.0f);
+            }
+            fx.transform(z.data(), true);
+            for (int x = 0; x < nx; ++x) {
+                store(x, y, z[x].real() * scale);
+                store(x, y + 1, z[x].imag() * scale);
+            }
+        }
+        });
+}
+
+class CPUTemplateMatchFFT : public CPUFilterCommon<ITemplateMatchFFT>
+{
+public:
+    void setTemplate(ITexture2DPtr v) override { m_template = ToCPU(v); }
+    void setRegion(Rect v) override { m_region = v; }
+    void dispatch() override;
+
+    // conjugates of the spectra of each channel and the box of the template size, and the sum of squares of the template
+    struct Spectrum
+    {
+        CPUTexture2DPtr tmpl;
+        int2 fft_size{};
+        std::vector<complexf> planes;
+        float sum_sq{};
+    };
+    Spectrum& getSpectrum(int2 fft_size, int channels);
+
+public:
+    CPUTexture2DPtr m_template;
+    Rect m_region{};
+    FFT m_fft_x, m_fft_y;
+    std::deque<Spectrum> m_spectra; // most recently used first
+    std::vector<complexf> m_work, m_acc;
+};
+
+CPUTemplateMatchFFT::Spectrum& CPUTemplateMatchFFT::getSpectrum(int2 fft_size, int channels)
+{
+    auto it = std::find_if(m_spectra.begin(), m_spectra.end(), [&](auto& s) { return s.tmpl == m_template && s.fft_size == fft_size; });
+    if (it != m_spectra.end()) {
+        if (it != m_spectra.begin()) {
+            auto tmp = std::move(*it);
+            m_spectra.erase(it);
+            m_spectra.push_front(std::move(tmp));
+        }
+        return m_spectra.front();
+    }
+
+    if ((int)m_spectra.size() >= FFTSpectrumCacheSize)
+        m_spectra.pop_back();
+    m_spectra.push_front({ m_template, fft_size, {}, 0.0f });
+    auto& ret = m_spectra.front();
+
+    const auto& tmpl = *m_template;
+    const int2 tsize = tmpl.getSize();
+    const size_t plane_size = size_t(fft_size.y) * (fft_size.x / 2 + 1);
+    ret.planes.resize(plane_size * (channels + 1));
+    for (int c = 0; c <= channels; ++c) {
+        auto* plane = ret.planes.data() + (plane_size * c);
+        if (c < channels)
+            ForwardFFT2D(m_fft_x, m_fft_y, [&](int x, int y) { return tmpl.load({ x, y })[c]; }, plane);
+        else
+            ForwardFFT2D(m_fft_x, m_fft_y, [&](int x, int y) { return x < tsize.x && y < tsize.y ? 1.0f : 0.0f; }, plane);
+        for (size_t i = 0; i < plane_size; ++i)
+            plane[i] = std::conj(plane[i]);
+    }
+
+    double sum_sq = 0.0;
+    for (int y = 0; y < tsize.y; ++y) {
+        for (int x = 0; x < tsize.x; ++x) {
+            float4 t = tmpl.load({ x, y });
+            for (int c = 0; c < channels; ++c)
+                sum_sq += double(t[c] * t[c]);
+        }
+    }
+    ret.sum_sq = float(sum_sq);
+    return ret;
+}
+
+void CPUTemplateMatchFFT::dispatch()
+{
+    if (!m_src || !m_dst || !m_template) {
+        mrDbgPrint("*** CPUTemplateMatchFFT::dispatch(): invaid params ***\n");
+        return;
+    }
+    if (m_src->getFormat() != m_template->getFormat() || m_src->getFormat() == TextureFormat::Binary) {
+        mrDbgPrint("*** CPUTemplateMatchFFT::dispatch(): format mismatch ***\n");
+        return;
+    }
+    auto range = m_region.size.x == 0 ? m_src->getSize() : m_region.size;
+    FFTPlan plan;
+    if (!GetFFTPlan(range, m_template->getSize(), plan)) {
+        mrDbgPrint("*** CPUTemplateMatchFFT::dispatch(): invalid size ***\n");
+        return;
+    }
+
+    int channels = 3;
+    switch (m_src->getFormat()) {
+    case TextureFormat::Ru8:
+    case TextureFormat::Rf16:
+    case TextureFormat::Rf32:
+        channels = 1;
+        break;
+    default:
+        break;
+    }
+
+    m_fft_x.setup(plan.fft_size.x);
+    m_fft_y.setup(plan.fft_size.y);
+    auto& spectrum = getSpectrum(plan.fft_size, channels);
+    const size_t plane_size = size_t(plan.fft_size.y) * (plan.fft_size.x / 2 + 1);
+    m_work.resize(plane_size);
+    m_acc.resize(plane_size);
+
+    // ssd(p) = sum(t^2) - 2 * sum(s * t) + sum(s^2 over the template window).
+    // the correlations are products of the spectra, and they are accumulated before one inverse transform.
+    const auto& src = *m_src;
+    auto accumulate = [&](int plane, float weight, bool init) {
+        const auto* t = spectrum.planes.data() + (plane_size * plane);
+        for (size_t i = 0; i < plane_size; ++i) {
+            complexf v = m_work[i] * t[i] * weight;
+            m_acc[i] = init ? v : m_acc[i] + v;
+        }
+    };
+    for (int ty = 0; ty < plan.tiles.y; ++ty) {
+        for (int tx = 0; tx < plan.tiles.x; ++tx) {
+            int2 tile_pos = plan.tile_range * int2{ tx, ty };
+            int2 origin = m_region.pos + tile_pos;
+            int2 tile_range = min(plan.tile_range, range - tile_pos);
+
+            for (int c = 0; c < channels; ++c) {
+                ForwardFFT2D(m_fft_x, m_fft_y, [&](int x, int y) { return src.load(origin + int2{ x, y })[c]; }, m_work.data());
+                accumulate(c, -2.0f, c == 0);
+            }
+            ForwardFFT2D(m_fft_x, m_fft_y, [&](int x, int y) {
+                float4 s = src.load(origin + int2{ x, y });
+                float r = 0.0f;
+                for (int c = 0; c < channels; ++c)
+                    r += s[c] * s[c];
+                return r;
+                }, m_work.data());
+            accumulate(channels, 1.0f, false);
+
+            InverseFFT2D(m_fft_x, m_fft_y, m_acc.data(), [&](int x, int y, float v) {
+                if (x < tile_range.x && y < tile_range.y)
+                    m_dst->store(tile_pos + int2{ x, y }, float4::set(std::max(v + spectrum.sum_sq, 0.0f)));
+                });
+        }
+    }
+}
+
+ITemplateMatchFFTPtr CreateCPUTemplateMatchFFT()
+{
+    return make_ref<CPUTemplateMatchFFT>();
+}
+
+
+// same as ChamferMatch.hlsl. points are summed in the order, so scores are same as the shader's. out of bounds reads
+// are 0. the sum stops as soon as it exceeds limit.
+static float ChamferScore(const CPUTexture2D& src, const std::vector<int2>& points, int2 pos, float limit)
+{
+    auto size = src.getSize();
+    float r = 0.0f;
+    for (auto& p : points) {
+        int2 q = pos + p;
+        if (q.x >= 0 && q.y >= 0 && q.x < size.x && q.y < size.y)
+            r += src.getRow<float>(q.y)[q.x];
+        if (r > limit)
+            break;
+    }
+    return r;
+}
+
+class CPUChamferMatch : public CPUFilterCommon<IChamferMatch>
+{
+public:
+    void setPoints(std::span<const int2> v) override { m_points.assign(v.begin(), v.end()); }
+    void setRegion(Rect v) override { m_region = v; }
+    void dispatch() override;
+
+public:
+    std::vector<int2> m_points;
+    Rect m_region{};
+};
+
+void CPUChamferMatch::dispatch()
+{
+    if (!m_src || !m_dst || m_src->getFormat() != TextureFormat::Rf32) {
+        mrDbgPrint("*** CPUChamferMatch::dispatch(): invaid params ***\n");
+        return;
+    }
+    auto size = m_region.size.x == 0 ? m_src->getSize() : m_region.size;
+    if (size.x < 0 || size.y < 0) {
+        mrDbgPrint("*** CPUChamferMatch::dispatch(): size < 0 ***\n");
+        return;
+    }
+
+    ParallelFor(0, size.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            for (int x = 0; x < size.x; ++x) {
+                float r = ChamferScore(*m_src, m_points, m_region.pos + int2{ x, y }, std::numeric_limits<float>::max());
+                m_dst->store({ x, y }, float4::set(r));
+            }
+        }
+        });
+}
+
+IChamferMatchPtr CreateCPUChamferMatch()
+{
+    return make_ref<CPUChamferMatch>();
+}
+
+
+class CPUChamferMatchMin : public RefCount<IChamferMatchMin>
+{
+public:
+    void setSrc(ITexture2DPtr v) override { m_src = ToCPU(v); }
+    void setPoints(std::span<const int2> v) override { m_points.assign(v.begin(), v.end()); }
+    void setRegion(Rect v) override { m_region = v; }
+    void setCutoff(float v) override { m_cutoff = v; }
+    IReduceMinMax::Result getResult() override { return m_result; }
+    void dispatch() override;
+
+public:
+    CPUTexture2DPtr m_src;
+    std::vector<int2> m_points;
+    Rect m_region{};
+    float m_cutoff = -1.0f;
+    IReduceMinMax::Result m_result{};
+};
+
+void CPUChamferMatchMin::dispatch()
+{
+    m_result = {};
+    if (!m_src || m_src->getFormat() != TextureFormat::Rf32) {
+        mrDbgPrint("*** CPUChamferMatchMin::dispatch(): invaid params ***\n");
+        return;
+    }
+    auto size = m_region.size.x == 0 ? m_src->getSize() : m_region.size;
+    if (size.x <= 0 || size.y <= 0) {
+        mrDbgPrint("*** CPUChamferMatchMin::dispatch(): size <= 0 ***\n");
+        return;
+    }
+
+    // partial sums that exceed the cutoff are lower bounds greater than it. the minimum is exact if it is not
+    // greater than the cutoff, as the sums of such positions never exceed it.
+    float limit = m_cutoff < 0.0f ? std::numeric_limits<float>::max() : m_cutoff;
+    std::vector<RowMin> rows(size.y);
+    ParallelFor(0, size.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            auto& row = rows[y];
+            for (int x = 0; x < size.x; ++x) {
+                uint32_t v = std::bit_cast<uint32_t>(ChamferScore(*m_src, m_points, m_region.pos + int2{ x, y }, limit));
+                if (v < row.score) {
+                    row.score = v;
+                    row.x = x;
+                }
+            }
+        }
+        });
+    m_result = ReduceRows(rows);
+}
+
+IChamferMatchMinPtr CreateCPUChamferMatchMin()
+{
+    return make_ref<CPUChamferMatchMin>();
+}
+
+
+class CPUSparseMatch : public CPUFilterCommon<ISparseMatch>
+{
+public:
+    void setSamples(std::span<const SparseSample> v) override { m_samples.assign(v.begin(), v.end()); }
+    void setRegion(Rect v) override { m_region = v; }
+    void setCutoff(float v) override { m_cutoff = v; }
+    void dispatch() override;
+
+public:
+    std::vector<SparseSample> m_samples;
+    Rect m_region{};
+    float m_cutoff = -1.0f;
+};
+
+void CPUSparseMatch::dispatch()
+{
+    if (!m_src || !m_dst) {
+        mrDbgPrint("*** CPUSparseMatch::dispatch(): invaid params ***\n");
+        return;
+    }
+    auto format = m_src->getFormat();
+    if (format != TextureFormat::Ru8 && format != TextureFormat::RGBAu8) {
+        mrDbgPrint("*** CPUSparseMatch::dispatch(): src must be Ru8 or RGBAu8 ***\n");
+        return;
+    }
+    auto size = m_region.size.x == 0 ? m_src->getSize() : m_region.size;
+    if (size.x < 0 || size.y < 0) {
+        mrDbgPrint("*** CPUSparseMatch::dispatch(): size < 0 ***\n");
+        return;
+    }
+
+    // same as SparseMatch.hlsl. differences are summed up as integers in 0-255 as the fast path of MatchGrayscaleRow()
+    // and MatchRGBRow(). out of bounds texels are 0.
+    const bool rgb = format == TextureFormat::RGBAu8;
+    const int2 ssize = m_src->getInternalSize();
+    const uint32_t limit = GetRawCutoff(m_cutoff);
+    static const byte s_zero[4]{};
+    ParallelFor(0, size.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            for (int x = 0; x < size.x; ++x) {
+                int2 bpos = m_region.pos + int2{ x, y };
+                uint32_t sum = 0;
+                for (auto& sample : m_samples) {
+                    int2 p = bpos + sample.pos;
+                    const byte* s = s_zero;
+                    if (p.x >= 0 && p.y >= 0 && p.x < ssize.x && p.y < ssize.y)
+                        s = m_src->getRow(p.y) + p.x * (rgb ? 4 : 1);
+                    auto* t = (const byte*)&sample.color;
+                    if (rgb) {
+                        int dr = std::abs(int(s[0]) - int(t[0]));
+                        int dg = std::abs(int(s[1]) - int(t[1]));
+                        int db = std::abs(int(s[2]) - int(t[2]));
+                        sum += std::max(std::max(dr, dg), db);
+                    }
+                    else {
+                        sum += std::abs(int(s[0]) - int(t[0]));
+                    }
+                    if (sum > limit)
+                        break;
+                }
+                m_dst->store({ x, y }, float4::set(float(sum) / 255.0f));
+            }
+        }
+        });
+}
+
+ISparseMatchPtr CreateCPUSparseMatch()
+{
+    return make_ref<CPUSparseMatch>();
+}
+
+
+class CPUShape : public RefCount<IShape>
+{
+public:
+    enum class ShapeType : int
+    {
+        Unknown,
+        Circle,
+        Rect,
+    };
+    struct ShapeData
+    {
+        ShapeType type;
+        float border;
+        int2 pos;
+        float4 color;
+        float radius;
+        int2 rect_size;
+    };
+
+    void setDst(ITexture2DPtr v) override { m_dst = ToCPU(v); }
+    void addCircle(int2 pos, float radius, float border, float4 color) override;
+    void addRect(Rect rect, float border, float4 color) override;
+    void clearShapes() override;
+    void dispatch() override;
+
+public:
+    CPUTexture2DPtr m_dst;
+    std::vector<ShapeData> m_shapes;
+};
+
+void CPUShape::addCircle(int2 pos, float radius, float border, float4 color)
+{
+    ShapeData tmp{};
+    tmp.type = ShapeType::Circle;
+    tmp.pos = pos;
+    tmp.radius = radius;
+    tmp.border = border;
+    tmp.color = color;
+    m_shapes.push_back(tmp);
+}
+
+void CPUShape::addRect(Rect rect, float border, float4 color)
+{
+    ShapeData tmp{};
+    tmp.type = ShapeType::Rect;
+    tmp.pos = rect.pos;
+    tmp.rect_size = rect.size;
+    tmp.border = border;
+    tmp.color = color;
+    m_shapes.push_back(tmp);
+}
+
+void CPUShape::clearShapes()
+{
+    m_shapes.clear();
+}
+
+void CPUShape::dispatch()
+{
+    if (!m_dst || m_shapes.empty())
+        return;
+
+    // same as Shape.hlsl
+    auto set_color = [this](int2 tid, float4 color) {
+        float4 c = m_dst->load(tid);
+        c.x += (color.x - c.x) * color.w;
+        c.y += (color.y - c.y) * color.w;
+        c.z += (color.z - c.z) * color.w;
+        m_dst->store(tid, c);
+    };
+
+    auto ts = m_dst->getInternalSize();
+    ParallelFor(0, ts.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            for (int x = 0; x < ts.x; ++x) {
+                int2 tid{ x, y };
+                for (auto& s : m_shapes) {
+                    if (s.type == ShapeType::Rect) {
+                        int2 pos = tid - s.pos;
+                        int2 br = s.rect_size;
+                        if (pos.x >= 0 && pos.x <= br.x && pos.y >= 0 && pos.y <= br.y) {
+                            int dx = std::min(pos.x, std::abs(pos.x - br.x));
+                            int dy = std::min(pos.y, std::abs(pos.y - br.y));
+                            if (std::min(dx, dy) < s.border)
+                                set_color(tid, s.color);
+                        }
+                    }
+                    else if (s.type == ShapeType::Circle) {
+                        float d = length(float2(tid - s.pos));
+                        if (d <= s.radius && s.radius - d <= s.border)
+                            set_color(tid, s.color);
+                    }
+                    else {
+                        break;
+                    }
+                }
+            }
+        }
+        });
+}
+
+IShapePtr CreateCPUShape()
+{
+    return make_ref<CPUShape>();
+}
+
+} // namespace mr
@@ -0,0 +1,259 @@
+#include "pch.h"
+#include "mrCPUFoundation.h"
+
+namespace mr {
+
+static inline float LoadUnorm8(byte v) { return float(v) * (1.0f / 255.0f); }
+static inline byte StoreUnorm8(float v) { return byte(clamp01(v) * 255.0f + 0.5f); }
+
+
+CPUTexture2DPtr CPUTexture2D::create(int w, int h, TextureFormat format, const void* data, int pitch)
+{
+    if (w <= 0 || h <= 0 || GetTexelSize(format) == 0)
+        return nullptr;
+
+    auto ret = make_ref<CPUTexture2D>();
+    ret->m_size = { w, h };
+    ret->m_format = format;
+
+    auto ts = ret->getInternalSize();
+    ret->m_pitch = ts.x * GetTexelSize(format);
+    ret->m_data.resize(size_t(ret->m_pitch) * ts.y);
+    if (data) {
+        if (pitch == 0)
+            pitch = ret->m_pitch;
+        int line = std::min(pitch, ret->m_pitch);
+        for (int i = 0; i < ts.y; ++i)
+            memcpy(ret->getRow(i), (const byte*)data + (size_t(pitch) * i), line);
+    }
+    return ret;
+}
+
+CPUTexture2DPtr CPUTexture2D::create(const char* path)
+{
+    CPUTexture2DPtr ret;
+    ReadImageFile(path, [&ret](int2 size, TextureFormat format, const void* data, int pitch) {
+        ret = create(size.x, size.y, format, data, pitch);
+        });
+    return ret;
+}
+
+int2 CPUTexture2D::getSize() const { return m_size; }
+int2 CPUTexture2D::getInternalSize() const
+{
+    auto ret = m_size;
+    if (m_format == TextureFormat::Binary)
+        ret.x = ceildiv(ret.x, 32);
+    return ret;
+}
+TextureFormat CPUTexture2D::getFormat() const { return m_format; }
+int CPUTexture2D::getPitch() const { return m_pitch; }
+
+void CPUTexture2D::download()
+{
+    // nothing to do. data is always on system memory.
+}
+
+bool CPUTexture2D::map(const ReadCallback& callback)
+{
+    callback(m_data.data(), m_pitch);
+    return true;
+}
+
+bool CPUTexture2D::read(const ReadCallback& callback)
+{
+    return map(callback);
+}
+
+bool CPUTexture2D::save(const std::string& path)
+{
+    return WriteImageFile(path, m_size, m_format, m_data.data(), m_pitch);
+}
+
+std::future<bool> CPUTexture2D::saveAsync(const std::string& path)
+{
+    return std::async(std::launch::async, [path, size = m_size, format = m_format, pitch = m_pitch, buf = m_data]() {
+        return WriteImageFile(path, size, format, buf.data(), pitch);
+        });
+}
+
+float4 CPUTexture2D::load(int2 pos) const
+{
+    auto ts = getInternalSize();
+    if (pos.x < 0 || pos.y < 0 || pos.x >= ts.x || pos.y >= ts.y)
+        return float4::zero();
+
+    auto row = getRow(pos.y);
+    switch (m_format) {
+    case TextureFormat::Ru8:
+    {
+        return { LoadUnorm8(row[pos.x]), 0.0f, 0.0f, 1.0f };
+    }
+    case TextureFormat::RGBAu8:
+    {
+        auto s = row + (pos.x * 4);
+        return { LoadUnorm8(s[0]), LoadUnorm8(s[1]), LoadUnorm8(s[2]), LoadUnorm8(s[3]) };
+    }
+    case TextureFormat::BGRAu8:
+    {
+        auto s = row + (pos.x * 4);
+        return { LoadUnorm8(s[2]), LoadUnorm8(s[1]), LoadUnorm8(s[0]), LoadUnorm8(s[3]) };
+    }
+    case TextureFormat::Rf16:
+    {
+        return { (float)((const half*)row)[pos.x], 0.0f, 0.0f, 1.0f };
+    }
+    case TextureFormat::RGBAf16:
+    {
+        auto s = (const half*)row + (pos.x * 4);
+        return { (float)s[0], (float)s[1], (float)s[2], (float)s[3] };
+    }
+    case TextureFormat::Rf32:
+    {
+        return { ((const float*)row)[pos.x], 0.0f, 0.0f, 1.0f };
+    }
+    case TextureFormat::RGBAf32:
+    {
+        return ((const float4*)row)[pos.x];
+    }
+    case TextureFormat::Ri32:
+    case TextureFormat::Binary:
+    {
+        return { (float)((const uint32_t*)row)[pos.x], 0.0f, 0.0f, 1.0f };
+    }
+    default:
+        return float4::zero();
+    }
+}
+
+uint32_t CPUTexture2D::loadU(int2 pos) const
+{
+    auto ts = getInternalSize();
+    if (pos.x < 0 || pos.y < 0 || pos.x >= ts.x || pos.y >= ts.y)
+        return 0;
+
+    if (m_format == TextureFormat::Ri32 || m_format == TextureFormat::Binary)
+        return ((const uint32_t*)getRow(pos.y))[pos.x];
+    else
+        return (uint32_t)load(pos).x;
+}
+
+void CPUTexture2D::store(int2 pos, float4 v)
+{
+    auto ts = getInternalSize();
+    if (pos.x < 0 || pos.y < 0 || pos.x >= ts.x || pos.y >= ts.y)
+        return;
+
+    auto row = getRow(pos.y);
+    switch (m_format) {
+    case TextureFormat::Ru8:
+    {
+        row[pos.x] = StoreUnorm8(v.x);
+        break;
+    }
+    case TextureFormat::RGBAu8:
+    {
+        auto d = row + (pos.x * 4);
+        d[0] = StoreUnorm8(v.x); d[1] = StoreUnorm8(v.y); d[2] = StoreUnorm8(v.z); d[3] = StoreUnorm8(v.w);
+        break;
+    }
+    case TextureFormat::BGRAu8:
+    {
+        auto d = row + (pos.x * 4);
+        d[0] = StoreUnorm8(v.z); d[1] = StoreUnorm8(v.y); d[2] = StoreUnorm8(v.x); d[3] = StoreUnorm8(v.w);
+        break;
+    }
+    case TextureFormat::Rf16:
+    {
+        ((half*)row)[pos.x] = v.x;
+        break;
+    }
+    case TextureFormat::RGBAf16:
+    {
+        auto d = (half*)row + (pos.x * 4);
+        d[0] = v.x; d[1] = v.y; d[2] = v.z; d[3] = v.w;
+        break;
+    }
+    case TextureFormat::Rf32:
+    {
+        ((float*)row)[pos.x] = v.x;
+        break;
+    }
+    case TextureFormat::RGBAf32:
+    {
+        ((float4*)row)[pos.x] = v;
+        break;
+    }
+    case TextureFormat::Ri32:
+    case TextureFormat::Binary:
+    {
+        ((uint32_t*)row)[pos.x] = (uint32_t)v.x;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void CPUTexture2D::storeU(int2 pos, uint32_t v)
+{
+    auto ts = getInternalSize();
+    if (pos.x < 0 || pos.y < 0 || pos.x >= ts.x || pos.y >= ts.y)
+        return;
+
+    if (m_format == TextureFormat::Ri32 || m_format == TextureFormat::Binary)
+        ((uint32_t*)getRow(pos.y))[pos.x] = v;
+    else
+        store(pos, float4::set((float)v));
+}
+
+float4 CPUTexture2D::sample(float2 uv) const
+{
+    auto ts = getInternalSize();
+    float2 p = uv * float2(ts) - 0.5f;
+    float2 fp = floor(p);
+    float2 f = p - fp;
+    int2 p0 = int2(fp);
+
+    auto fetch = [&](int x, int y) {
+        return load({ std::clamp(x, 0, ts.x - 1), std::clamp(y, 0, ts.y - 1) });
+    };
+    float4 t0 = fetch(p0.x, p0.y) * (1.0f - f.x) + fetch(p0.x + 1, p0.y) * f.x;
+    float4 t1 = fetch(p0.x, p0.y + 1) * (1.0f - f.x) + fetch(p0.x + 1, p0.y + 1) * f.x;
+    return t0 * (1.0f - f.y) + t1 * f.y;
+}
+
+
+CPUBufferPtr CPUBuffer::create(int size, int stride, const void* data)
+{
+    if (size <= 0)
+        return nullptr;
+
+    auto ret = make_ref<CPUBuffer>();
+    ret->m_stride = stride;
+    ret->m_data.resize(size);
+    if (data)
+        memcpy(ret->m_data.data(), data, size);
+    return ret;
+}
+
+int CPUBuffer::getSize() const { return (int)m_data.size(); }
+int CPUBuffer::getStride() const { return m_stride; }
+
+void CPUBuffer::download(int size)
+{
+    // nothing to do. data is always on system memory.
+}
+
+bool CPUBuffer::map(const ReadCallback& callback)
+{
+    callback(m_data.data());
+    return true;
+}
+
+bool CPUBuffer::read(const ReadCallback& callback, int size)
+{
+    return map(callback);
+}
+
+} // namespace mr
@@ -0,0 +1,114 @@
+#pragma once
+#include "Graphics/mrImage.h"
+
+namespace mr {
+
+mrDeclPtr(CPUTexture2D);
+mrDeclPtr(CPUBuffer);
+
+
+// texture on system memory. the layout of texels is same as D3D11 texture of same format.
+// (Binary is packed to uint32 and internal width is ceil(width / 32))
+class CPUTexture2D : public RefCount<ITexture2D>
+{
+public:
+    static CPUTexture2DPtr create(int w, int h, TextureFormat format, const void* data = nullptr, int pitch = 0);
+    static CPUTexture2DPtr create(const char* path);
+
+    int2 getSize() const override;
+    int2 getInternalSize() const;
+    TextureFormat getFormat() const override;
+    int getPitch() const;
+
+    void download() override;
+    bool map(const ReadCallback& callback) override;
+    bool read(const ReadCallback& callback) override;
+
+    bool save(const std::string& path) override;
+    std::future<bool> saveAsync(const std::string& path) override;
+
+    byte* getRow(int y) { return m_data.data() + (m_pitch * y); }
+    const byte* getRow(int y) const { return m_data.data() + (m_pitch * y); }
+    template<class T> T* getRow(int y) { return (T*)getRow(y); }
+    template<class T> const T* getRow(int y) const { return (const T*)getRow(y); }
+
+    // texel access that behave like shader's:
+    // out of bounds reads return 0 and out of bounds writes are discarded.
+    // load() always returns rgba order (BGRAu8 is swizzled). int formats are converted to float.
+    float4 load(int2 pos) const;
+    uint32_t loadU(int2 pos) const;
+    void store(int2 pos, float4 v);
+    void storeU(int2 pos, uint32_t v);
+
+    // equivalent to SampleLevel() with the linear & clamp sampler
+    float4 sample(float2 uv) const;
+
+private:
+    int2 m_size{};
+    TextureFormat m_format{};
+    int m_pitch{};
+    std::vector<byte> m_data;
+};
+inline CPUTexture2D* ToCPU(ITexture2D* v) { return static_cast<CPUTexture2D*>(v); }
+
+
+class CPUBuffer : public RefCount<IBuffer>
+{
+public:
+    static CPUBufferPtr create(int size, int stride, const void* data = nullptr);
+
+    int getSize() const override;
+    int getStride() const override;
+
+    void download(int size = 0) override;
+    bool map(const ReadCallback& callback) override;
+    bool read(const ReadCallback& callback, int size = 0) override;
+
+    byte* data() { return m_data.data(); }
+    template<class T> T& at(int i) { return ((T*)m_data.data())[i]; }
+
+private:
+    int m_stride{};
+    std::vector<byte> m_data;
+};
+
+
+// template matching for Binary textures. results are identical to TemplateMatch_Binary.hlsl.
+// uses AVX2 or NEON if available. implemented in mrCPUMatchBinary.cpp.
+class BinaryMatcher
+{
+public:
+    struct Word
+    {
+        size_t offset; // offset in the shifted image
+        uint32_t tv;   // template
+        uint32_t tm;   // mask
+    };
+
+    // receives scores of positions [0, range.x) of row y. called from multiple threads, but once for each row.
+    using RowCallback = std::function<void(int y, const uint32_t* scores)>;
+
+    void setSIMDEnabled(bool v);
+    void match(CPUTexture2D& dst, const CPUTexture2D& image, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range);
+    void match(const RowCallback& row, const CPUTexture2D& image, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range);
+    void matchReference(CPUTexture2D& dst, const CPUTexture2D& image, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range);
+    void matchReference(const RowCallback& row, const CPUTexture2D& image, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range);
+
+private:
+    bool m_simd = true;
+    std::vector<uint32_t> m_shifted;
+    std::vector<Word> m_words;
+};
+
+
+// context factories. implemented in mrCPUFilter.cpp and mrCPUReducer.cpp.
+#define Body(Name) I##Name##Ptr CreateCPU##Name();
+mrEachCS(Body)
+#undef Body
+
+IScreenCapture* CreateCPUScreenCapture_();
+mrDefShared(CreateCPUScreenCapture);
+
+IGfxInterface* CreateCPUGfxInterface_();
+
+} // namespace mr
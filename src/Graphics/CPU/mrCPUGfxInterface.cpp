@@ -0,0 +1,79 @@
+#include "pch.h"
+#include "mrCPUFoundation.h"
+
+namespace mr {
+
+// IGfxInterface without GPU. all dispatches are done on ThreadPool and complete before return.
+class CPUGfxInterface : public RefCount<IGfxInterface>
+{
+public:
+    ITexture2DPtr createTexture(int w, int h, TextureFormat f, const void* data, int pitch) override;
+    ITexture2DPtr createTextureFromFile(const char* path) override;
+    IScreenCapturePtr createScreenCapture() override;
+
+#define Body(Name) I##Name##Ptr create##Name() override;
+mrEachCS(Body)
+#undef Body
+
+    void flush() override;
+    void sync(int timeout_ms) override;
+    bool supportsConcurrentDispatch() const override;
+
+    void lock() override;
+    void unlock() override;
+
+private:
+    std::mutex m_mutex;
+};
+
+
+ITexture2DPtr CPUGfxInterface::createTexture(int w, int h, TextureFormat f, const void* data, int pitch)
+{
+    return CPUTexture2D::create(w, h, f, data, pitch);
+}
+
+ITexture2DPtr CPUGfxInterface::createTextureFromFile(const char* path)
+{
+    return CPUTexture2D::create(path);
+}
+
+IScreenCapturePtr CPUGfxInterface::createScreenCapture()
+{
+    return CreateCPUScreenCapture();
+}
+
+#define Body(Name) I##Name##Ptr CPUGfxInterface::create##Name() { return CreateCPU##Name(); }
+mrEachCS(Body)
+#undef Body
+
+
+void CPUGfxInterface::flush()
+{
+}
+
+void CPUGfxInterface::sync(int timeout_ms)
+{
+}
+
+bool CPUGfxInterface::supportsConcurrentDispatch() const
+{
+    return true;
+}
+
+void CPUGfxInterface::lock()
+{
+    m_mutex.lock();
+}
+
+void CPUGfxInterface::unlock()
+{
+    m_mutex.unlock();
+}
+
+
+IGfxInterface* CreateCPUGfxInterface_()
+{
+    return new CPUGfxInterface();
+}
+
+} // namespace mr
@@ -0,0 +1,322 @@
+#include "pch.h"
+#include "mrCPUFoundation.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+    #define mrEnableAVX2
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define mrTargetAVX2
+    #else
+        #define mrTargetAVX2 __attribute__((target("avx2")))
+    #endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+    #define mrEnableNEON
+    #include <arm_neon.h>
+#endif
+
+namespace mr {
+
+// how it works:
+// TemplateMatch_Binary.hlsl makes image words by lshift(image[px], image[px + 1], x % 32) for each x.
+// positions that have same (x % 32) share the shifted words, so shifted image rows are made once for each shift
+// and then 16 positions (x, x+32, ..., x+480) are processed at once by contiguous loads of the shifted row.
+
+static const int LaneCount = 16;
+static const int RowGrain = 8;
+
+static inline uint32_t lshift(uint32_t a, uint32_t b, uint32_t s)
+{
+    return s == 0 ? a : (a >> s) | (b << (32 - s));
+}
+
+// acc[i] = sum of popcount((base[w.offset + i] ^ w.tv) & w.tm) for all words
+using MatchLanesFunc = void(*)(uint32_t* acc, const uint32_t* base, const BinaryMatcher::Word* words, size_t num_words);
+
+static void MatchLanes_Scalar(uint32_t* acc, const uint32_t* base, const BinaryMatcher::Word* words, size_t num_words)
+{
+    uint32_t r[LaneCount]{};
+    for (size_t wi = 0; wi < num_words; ++wi) {
+        auto& w = words[wi];
+        auto* p = base + w.offset;
+        for (int i = 0; i < LaneCount; ++i)
+            r[i] += std::popcount((p[i] ^ w.tv) & w.tm);
+    }
+    for (int i = 0; i < LaneCount; ++i)
+        acc[i] = r[i];
+}
+
+#ifdef mrEnableAVX2
+
+static bool HasAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // AVX and OS support of ymm registers are required too
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+        return false;
+    if ((_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+mrTargetAVX2 static inline __m256i WidenBytes_AVX2(__m256i bytes)
+{
+    // sum up 4 bytes to uint32
+    __m256i u16 = _mm256_maddubs_epi16(bytes, _mm256_set1_epi8(1));
+    return _mm256_madd_epi16(u16, _mm256_set1_epi16(1));
+}
+
+mrTargetAVX2 static inline __m256i PopcountBytes_AVX2(__m256i v)
+{
+    // popcount of each byte by nibble lookup
+    const __m256i lut = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low4 = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low4));
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low4));
+    return _mm256_add_epi8(lo, hi);
+}
+
+mrTargetAVX2 static void MatchLanes_AVX2(uint32_t* acc, const uint32_t* base, const BinaryMatcher::Word* words, size_t num_words)
+{
+    // byte counts are accumulated up to 31 times (8 * 31 < 256) before widening.
+    __m256i total0 = _mm256_setzero_si256(), total1 = _mm256_setzero_si256();
+    __m256i bytes0 = _mm256_setzero_si256(), bytes1 = _mm256_setzero_si256();
+    int n = 0;
+    for (size_t wi = 0; wi < num_words; ++wi) {
+        auto& w = words[wi];
+        auto* p = base + w.offset;
+        __m256i tv = _mm256_set1_epi32((int)w.tv);
+        __m256i tm = _mm256_set1_epi32((int)w.tm);
+        __m256i v0 = _mm256_and_si256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)p), tv), tm);
+        __m256i v1 = _mm256_and_si256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p + 8)), tv), tm);
+        bytes0 = _mm256_add_epi8(bytes0, PopcountBytes_AVX2(v0));
+        bytes1 = _mm256_add_epi8(bytes1, PopcountBytes_AVX2(v1));
+        if (++n == 31) {
+            total0 = _mm256_add_epi32(total0, WidenBytes_AVX2(bytes0));
+            total1 = _mm256_add_epi32(total1, WidenBytes_AVX2(bytes1));
+            bytes0 = bytes1 = _mm256_setzero_si256();
+            n = 0;
+        }
+    }
+    total0 = _mm256_add_epi32(total0, WidenBytes_AVX2(bytes0));
+    total1 = _mm256_add_epi32(total1, WidenBytes_AVX2(bytes1));
+    _mm256_storeu_si256((__m256i*)acc, total0);
+    _mm256_storeu_si256((__m256i*)(acc + 8), total1);
+}
+
+#endif // mrEnableAVX2
+
+#ifdef mrEnableNEON
+
+static void MatchLanes_NEON(uint32_t* acc, const uint32_t* base, const BinaryMatcher::Word* words, size_t num_words)
+{
+    // byte counts are accumulated up to 31 times (8 * 31 < 256) before widening.
+    uint32x4_t total[4];
+    uint8x16_t bytes[4];
+    for (int i = 0; i < 4; ++i) {
+        total[i] = vdupq_n_u32(0);
+        bytes[i] = vdupq_n_u8(0);
+    }
+
+    int n = 0;
+    for (size_t wi = 0; wi < num_words; ++wi) {
+        auto& w = words[wi];
+        auto* p = base + w.offset;
+        uint32x4_t tv = vdupq_n_u32(w.tv);
+        uint32x4_t tm = vdupq_n_u32(w.tm);
+        for (int i = 0; i < 4; ++i) {
+            uint32x4_t v = vandq_u32(veorq_u32(vld1q_u32(p + i * 4), tv), tm);
+            bytes[i] = vaddq_u8(bytes[i], vcntq_u8(vreinterpretq_u8_u32(v)));
+        }
+        if (++n == 31) {
+            for (int i = 0; i < 4; ++i) {
+                total[i] = vaddq_u32(total[i], vpaddlq_u16(vpaddlq_u8(bytes[i])));
+                bytes[i] = vdupq_n_u8(0);
+            }
+            n = 0;
+        }
+    }
+    for (int i = 0; i < 4; ++i) {
+        total[i] = vaddq_u32(total[i], vpaddlq_u16(vpaddlq_u8(bytes[i])));
+        vst1q_u32(acc + i * 4, total[i]);
+    }
+}
+
+#endif // mrEnableNEON
+
+static MatchLanesFunc GetMatchLanesFunc(bool simd)
+{
+    if (simd) {
+#if defined(mrEnableAVX2)
+        static const bool s_avx2 = HasAVX2();
+        if (s_avx2)
+            return &MatchLanes_AVX2;
+#elif defined(mrEnableNEON)
+        return &MatchLanes_NEON;
+#endif
+    }
+    return &MatchLanes_Scalar;
+}
+
+
+void BinaryMatcher::setSIMDEnabled(bool v)
+{
+    m_simd = v;
+}
+
+// row callback that writes scores to dst as the shader does
+static BinaryMatcher::RowCallback StoreRows(CPUTexture2D& dst, int width)
+{
+    return [&dst, width](int y, const uint32_t* scores) {
+        for (int x = 0; x < width; ++x)
+            dst.storeU({ x, y }, scores[x]);
+    };
+}
+
+void BinaryMatcher::match(CPUTexture2D& dst, const CPUTexture2D& image, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range)
+{
+    match(StoreRows(dst, range.x), image, tmpl, mask, tl, range);
+}
+
+void BinaryMatcher::match(const RowCallback& row, const CPUTexture2D& image, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range)
+{
+    if (range.x <= 0 || range.y <= 0)
+        return;
+    if (tl.x < 0) {
+        // positions in negative x are rare. leave them to the straightforward implementation.
+        matchReference(row, image, tmpl, mask, tl, range);
+        return;
+    }
+
+    auto isize = image.getInternalSize();
+    auto tsize = tmpl.getInternalSize();
+    const int tw = tsize.x;
+    const int th = tsize.y;
+    const uint32_t edge_mask = (1u << (tmpl.getSize().x % 32)) - 1;
+    const bool use_mask = mask && mask->getInternalSize().x == tw;
+
+    // shifted image rows. [shift][row][word]
+    // stride has extra words to allow loads of LaneCount words from any position.
+    const int w_min = tl.x / 32;
+    const int w_max = (tl.x + range.x - 1) / 32;
+    const int num_words = w_max - w_min + tw;
+    const int stride = ceildiv(num_words, LaneCount) * LaneCount + LaneCount;
+    const int num_rows = range.y + th - 1;
+    const size_t shift_stride = size_t(stride) * num_rows;
+    m_shifted.resize(shift_stride * 32);
+
+    ParallelFor(0, num_rows, RowGrain, [&](int begin, int end) {
+        for (int r = begin; r < end; ++r) {
+            int py = tl.y + r;
+            const uint32_t* src = py >= 0 && py < isize.y ? image.getRow<uint32_t>(py) : nullptr;
+            auto load = [&](int px) { return src && px < isize.x ? src[px] : 0u; };
+
+            for (int s = 0; s < 32; ++s) {
+                uint32_t* d = &m_shifted[shift_stride * s + size_t(stride) * r];
+                for (int k = 0; k < num_words; ++k)
+                    d[k] = lshift(load(w_min + k), load(w_min + k + 1), s);
+                std::fill(d + num_words, d + stride, 0u);
+            }
+        }
+        });
+
+    // template words. fully masked words (e.g. the last word if width % 32 == 0) are skipped.
+    m_words.clear();
+    for (int i = 0; i < th; ++i) {
+        for (int j = 0; j < tw; ++j) {
+            uint32_t tm = ~0u;
+            if (j == tw - 1)
+                tm &= edge_mask;
+            if (use_mask)
+                tm &= mask->loadU({ j, i });
+            if (tm != 0)
+                m_words.push_back({ size_t(stride) * i + j, tmpl.loadU({ j, i }), tm });
+        }
+    }
+
+    auto match_lanes = GetMatchLanesFunc(m_simd);
+    ParallelFor(0, range.y, RowGrain, [&](int begin, int end) {
+        uint32_t acc[LaneCount];
+        std::vector<uint32_t> scores(range.x);
+        for (int y = begin; y < end; ++y) {
+            for (int s = 0; s < 32; ++s) {
+                // positions that have bit shift s: x = x0 + 32 * n
+                int x0 = (s - (tl.x % 32)) & 31;
+                if (x0 >= range.x)
+                    continue;
+                int count = (range.x - 1 - x0) / 32 + 1;
+                const uint32_t* base = &m_shifted[shift_stride * s + size_t(stride) * y + ((tl.x + x0) / 32 - w_min)];
+
+                for (int n = 0; n < count; n += LaneCount) {
+                    match_lanes(acc, base + n, m_words.data(), m_words.size());
+                    int lanes = std::min(LaneCount, count - n);
+                    for (int i = 0; i < lanes; ++i)
+                        scores[x0 + 32 * (n + i)] = acc[i];
+                }
+            }
+            row(y, scores.data());
+        }
+        });
+}
+
+void BinaryMatcher::matchReference(CPUTexture2D& dst, const CPUTexture2D& image, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range)
+{
+    matchReference(StoreRows(dst, range.x), image, tmpl, mask, tl, range);
+}
+
+void BinaryMatcher::matchReference(const RowCallback& row, const CPUTexture2D& image, const CPUTexture2D& tmpl, const CPUTexture2D* mask, int2 tl, int2 range)
+{
+    // straightforward port of TemplateMatch_Binary.hlsl.
+    // coordinates are uint as the shader does. negative positions wrap around and read 0.
+    auto tsize = tmpl.getInternalSize();
+    const int tw = tsize.x;
+    const int th = tsize.y;
+    const uint32_t edge_mask = (1u << (tmpl.getSize().x % 32)) - 1;
+    const bool use_mask = mask && mask->getInternalSize().x == tw;
+
+    auto load = [&image](uint32_t x, uint32_t y) {
+        return x < uint32_t(INT_MAX) && y < uint32_t(INT_MAX) ? image.loadU({ int(x), int(y) }) : 0u;
+    };
+
+    ParallelFor(0, range.y, RowGrain, [&](int begin, int end) {
+        std::vector<uint32_t> scores(range.x);
+        for (int y = begin; y < end; ++y) {
+            for (int x = 0; x < range.x; ++x) {
+                const uint32_t px_offset = uint32_t(tl.x + x) / 32;
+                const uint32_t bit_shift = uint32_t(tl.x + x) % 32;
+
+                uint32_t r = 0;
+                for (int i = 0; i < th; ++i) {
+                    uint32_t py = uint32_t(tl.y + y + i);
+                    for (int j = 0; j < tw; ++j) {
+                        uint32_t px = px_offset + j;
+                        uint32_t iv = lshift(load(px, py), load(px + 1, py), bit_shift);
+                        uint32_t bits = iv ^ tmpl.loadU({ j, i });
+                        if (j == tw - 1)
+                            bits &= edge_mask;
+                        if (use_mask)
+                            bits &= mask->loadU({ j, i });
+                        r += std::popcount(bits);
+                    }
+                }
+                scores[x] = r;
+            }
+            row(y, scores.data());
+        }
+        });
+}
+
+} // namespace mr
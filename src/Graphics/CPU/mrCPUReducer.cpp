@@ -0,0 +1,361 @@
+#include "pch.h"
+#include "mrCPUFoundation.h"
+
+namespace mr {
+
+static const int RowGrain = 16;
+
+template<class T>
+class CPUReduceCommon : public RefCount<T>
+{
+public:
+    void setSrc(ITexture2DPtr v) override { m_src = ToCPU(v); }
+    void setRegion(Rect v) override { m_region = v; }
+    int2 getSize() const override;
+    Rect getRegion() const override;
+    IBufferPtr getDst() const override { return m_dst; }
+
+    // region clipped by the texture. x is in uint32 for Binary.
+    bool getClippedRegion(int2& tl, int2& br) const;
+
+    template<class R>
+    R getResultImpl()
+    {
+        R ret{};
+        if (m_dst)
+            m_dst->map([&ret](const void* v) { ret = *(const R*)v; });
+        return ret;
+    }
+
+    template<class R>
+    void setResultImpl(const R& v)
+    {
+        if (!m_dst)
+            m_dst = CPUBuffer::create(sizeof(R), sizeof(R));
+        m_dst->template at<R>(0) = v;
+    }
+
+public:
+    CPUTexture2DPtr m_src;
+    CPUBufferPtr m_dst;
+    Rect m_region{};
+};
+
+template<class T> int2 CPUReduceCommon<T>::getSize() const
+{
+    return m_region.size.x == 0 ? (m_src ? m_src->getSize() : int2::zero()) : m_region.size;
+}
+
+template<class T> Rect CPUReduceCommon<T>::getRegion() const
+{
+    return { m_region.pos, getSize() };
+}
+
+template<class T> bool CPUReduceCommon<T>::getClippedRegion(int2& tl, int2& br) const
+{
+    auto size = getSize();
+    if (size.x < 0 || size.y < 0)
+        return false;
+
+    auto ts = m_src->getInternalSize();
+    tl = max(m_region.pos, int2::zero());
+    br = min(m_region.pos + size, ts);
+    return tl.x < br.x && tl.y < br.y;
+}
+
+
+class CPUReduceTotal : public CPUReduceCommon<IReduceTotal>
+{
+public:
+    Result getResult() override { return getResultImpl<Result>(); }
+    void dispatch() override;
+};
+
+void CPUReduceTotal::dispatch()
+{
+    if (!m_src)
+        return;
+
+    Result ret{};
+    int2 tl, br;
+    if (getClippedRegion(tl, br)) {
+        // sum up each line and then lines in order to get the same result regardless of threads
+        bool is_int = IsIntFormat(m_src->getFormat());
+        std::vector<Result> lines(br.y - tl.y);
+        ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                Result r{};
+                for (int x = tl.x; x < br.x; ++x) {
+                    if (is_int)
+                        r.vali += m_src->loadU({ x, y });
+                    else
+                        r.valf += m_src->load({ x, y }).x;
+                }
+                lines[y - tl.y] = r;
+            }
+            });
+        for (auto& r : lines) {
+            if (is_int)
+                ret.vali += r.vali;
+            else
+                ret.valf += r.valf;
+        }
+    }
+    setResultImpl(ret);
+}
+
+IReduceTotalPtr CreateCPUReduceTotal()
+{
+    return make_ref<CPUReduceTotal>();
+}
+
+
+class CPUReduceCountBits : public CPUReduceCommon<IReduceCountBits>
+{
+public:
+    Result getResult() override { return getResultImpl<Result>(); }
+    void dispatch() override;
+};
+
+void CPUReduceCountBits::dispatch()
+{
+    if (!m_src)
+        return;
+
+    Result ret{};
+    int2 tl, br;
+    if (getClippedRegion(tl, br)) {
+        std::vector<Result> lines(br.y - tl.y);
+        ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                auto row = m_src->getRow<uint32_t>(y);
+                Result r{};
+                for (int x = tl.x; x < br.x; ++x)
+                    r += std::popcount(row[x]);
+                lines[y - tl.y] = r;
+            }
+            });
+        for (auto r : lines)
+            ret += r;
+    }
+    setResultImpl(ret);
+}
+
+IReduceCountBitsPtr CreateCPUReduceCountBits()
+{
+    return make_ref<CPUReduceCountBits>();
+}
+
+
+class CPUReduceMinMax : public CPUReduceCommon<IReduceMinMax>
+{
+public:
+    Result getResult() override { return getResultImpl<Result>(); }
+    void dispatch() override;
+
+    // load: [](int2 pos) -> V
+    template<class V, class Load>
+    void reduce(int2 tl, int2 br, V Result::* vmin, V Result::* vmax, const Load& load);
+};
+
+template<class V, class Load>
+void CPUReduceMinMax::reduce(int2 tl, int2 br, V Result::* vmin, V Result::* vmax, const Load& load)
+{
+    // find first occurrence in each line, then reduce lines from top to bottom.
+    std::vector<Result> lines(br.y - tl.y);
+    ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            Result r{};
+            r.pos_min = r.pos_max = { tl.x, y };
+            r.*vmin = r.*vmax = load({ tl.x, y });
+            for (int x = tl.x + 1; x < br.x; ++x) {
+                V v = load({ x, y });
+                if (v < r.*vmin) {
+                    r.*vmin = v;
+                    r.pos_min = { x, y };
+                }
+                if (v > r.*vmax) {
+                    r.*vmax = v;
+                    r.pos_max = { x, y };
+                }
+            }
+            lines[y - tl.y] = r;
+        }
+        });
+
+    Result ret = lines.front();
+    for (auto& r : lines) {
+        if (r.*vmin < ret.*vmin) {
+            ret.*vmin = r.*vmin;
+            ret.pos_min = r.pos_min;
+        }
+        if (r.*vmax > ret.*vmax) {
+            ret.*vmax = r.*vmax;
+            ret.pos_max = r.pos_max;
+        }
+    }
+    setResultImpl(ret);
+}
+
+void CPUReduceMinMax::dispatch()
+{
+    if (!m_src)
+        return;
+
+    int2 tl, br;
+    if (!getClippedRegion(tl, br)) {
+        setResultImpl(Result{});
+        return;
+    }
+
+    if (IsIntFormat(m_src->getFormat()))
+        reduce<uint32_t>(tl, br, &Result::vali_min, &Result::vali_max, [this](int2 p) { return m_src->loadU(p); });
+    else
+        reduce<float>(tl, br, &Result::valf_min, &Result::valf_max, [this](int2 p) { return m_src->load(p).x; });
+}
+
+IReduceMinMaxPtr CreateCPUReduceMinMax()
+{
+    return make_ref<CPUReduceMinMax>();
+}
+
+
+class CPUReduceTopK : public CPUReduceCommon<IReduceTopK>
+{
+public:
+    void setThreshold(float v) override { m_threshold = v; }
+    void setMaxCount(int v) override { m_max_count = v; }
+    void setSuppressionSize(int2 v) override { m_suppression = v; }
+    Result getResult() override { return m_result; }
+    void dispatch() override;
+
+    // load: [](int2 pos) -> V
+    template<class V, class Load>
+    void reduce(int2 tl, int2 br, V threshold, V Candidate::* val, const Load& load);
+
+public:
+    float m_threshold = 0.0f;
+    int m_max_count = 32;
+    int2 m_suppression{ 1, 1 };
+    Result m_result;
+};
+
+template<class V, class Load>
+void CPUReduceTopK::reduce(int2 tl, int2 br, V threshold, V Candidate::* val, const Load& load)
+{
+    // pick local minima under the threshold in each line. same rules as ReduceTopK.hlsl.
+    std::vector<Result> lines(br.y - tl.y);
+    ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            auto& line = lines[y - tl.y];
+            for (int x = tl.x; x < br.x; ++x) {
+                V v = load({ x, y });
+                if (v > threshold)
+                    continue;
+
+                bool minimum = true;
+                for (int dy = -1; dy <= 1 && minimum; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        int2 n{ x + dx, y + dy };
+                        if ((dx == 0 && dy == 0) || n.x < tl.x || n.y < tl.y || n.x >= br.x || n.y >= br.y)
+                            continue;
+
+                        // ties are resolved in scanline order so that a flat bottom gives one candidate
+                        V nv = load(n);
+                        bool earlier = dy < 0 || (dy == 0 && dx < 0);
+                        if (nv < v || (nv == v && earlier)) {
+                            minimum = false;
+                            break;
+                        }
+                    }
+                }
+                if (minimum) {
+                    Candidate c;
+                    c.pos = int2{ x, y } - m_region.pos;
+                    c.*val = v;
+                    line.push_back(c);
+                }
+            }
+        }
+        });
+
+    for (auto& line : lines)
+        m_result.insert(m_result.end(), line.begin(), line.end());
+}
+
+void CPUReduceTopK::dispatch()
+{
+    m_result.clear();
+    if (!m_src)
+        return;
+
+    int2 tl, br;
+    if (!getClippedRegion(tl, br))
+        return;
+
+    bool is_int = IsIntFormat(m_src->getFormat());
+    if (is_int) {
+        // nothing can be under a negative threshold on int formats
+        if (m_threshold < 0.0f)
+            return;
+        auto threshold = (uint32_t)std::min((double)m_threshold, (double)UINT32_MAX);
+        reduce<uint32_t>(tl, br, threshold, &Candidate::vali, [this](int2 p) { return m_src->loadU(p); });
+    }
+    else {
+        reduce<float>(tl, br, m_threshold, &Candidate::valf, [this](int2 p) { return m_src->load(p).x; });
+    }
+    SelectTopK(m_result, !is_int, m_max_count, m_suppression);
+}
+
+IReduceTopKPtr CreateCPUReduceTopK()
+{
+    return make_ref<CPUReduceTopK>();
+}
+
+
+class CPUReduceHistogram : public CPUReduceCommon<IReduceHistogram>
+{
+public:
+    Result getResult() override { return getResultImpl<Result>(); }
+    void dispatch() override;
+};
+
+void CPUReduceHistogram::dispatch()
+{
+    if (!m_src)
+        return;
+
+    Result ret{};
+    int2 tl, br;
+    if (getClippedRegion(tl, br)) {
+        // each block of rows counts in its own bins, which are added up at the end
+        bool is_u8 = m_src->getFormat() == TextureFormat::Ru8;
+        std::mutex mutex;
+        ParallelFor(tl.y, br.y, RowGrain, [&](int begin, int end) {
+            Result bins{};
+            for (int y = begin; y < end; ++y) {
+                if (is_u8) {
+                    auto* row = m_src->getRow(y);
+                    for (int x = tl.x; x < br.x; ++x)
+                        ++bins[row[x]];
+                }
+                else {
+                    for (int x = tl.x; x < br.x; ++x)
+                        ++bins[uint32_t(std::clamp(m_src->load({ x, y }).x, 0.0f, 1.0f) * 255.0f + 0.5f)];
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < 256; ++i)
+                ret[i] += bins[i];
+            });
+    }
+    setResultImpl(ret);
+}
+
+IReduceHistogramPtr CreateCPUReduceHistogram()
+{
+    return make_ref<CPUReduceHistogram>();
+}
+
+} // namespace mr
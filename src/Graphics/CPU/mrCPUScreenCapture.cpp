@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "mrCPUFoundation.h"
+
+namespace mr {
+
+// GDI based capture. each getFrame() captures the target synchronously.
+// changed regions are detected by comparing with the previous frame.
+class CPUScreenCapture : public RefCount<IScreenCapture>
+{
+public:
+    ~CPUScreenCapture() override;
+    bool startCapture(HWND hwnd) override;
+    bool startCapture(HMONITOR hmon) override;
+    void stopCapture() override;
+    bool isCapturing() const override;
+
+    FrameInfo getFrame() override;
+    FrameInfo waitNextFrame() override;
+    void setOnFrameArrived(const Callback& cb) override;
+
+private:
+    HWND m_hwnd{};
+    HMONITOR m_hmon{};
+    Callback m_callback;
+    FrameInfo m_frame_info;
+    std::mutex m_mutex;
+};
+
+static const int DiffTileSize = 32;
+
+// compare frames by tiles and return changed regions. changed tiles adjacent in a row are merged.
+static std::vector<Rect> DiffFrames(const CPUTexture2D& a, const CPUTexture2D& b)
+{
+    int2 size = a.getSize();
+    int texel_size = GetTexelSize(a.getFormat());
+    int tiles_x = ceildiv(size.x, DiffTileSize);
+    int tiles_y = ceildiv(size.y, DiffTileSize);
+
+    std::vector<std::vector<Rect>> rows(tiles_y);
+    ParallelFor(0, tiles_y, 1, [&](int begin, int end) {
+        std::vector<bool> changed(tiles_x);
+        for (int ty = begin; ty < end; ++ty) {
+            int y0 = ty * DiffTileSize;
+            int y1 = std::min(y0 + DiffTileSize, size.y);
+
+            std::fill(changed.begin(), changed.end(), false);
+            for (int y = y0; y < y1; ++y) {
+                auto ra = a.getRow(y);
+                auto rb = b.getRow(y);
+                for (int tx = 0; tx < tiles_x; ++tx) {
+                    if (changed[tx])
+                        continue;
+                    int x0 = tx * DiffTileSize;
+                    int x1 = std::min(x0 + DiffTileSize, size.x);
+                    if (memcmp(ra + (x0 * texel_size), rb + (x0 * texel_size), (x1 - x0) * texel_size) != 0)
+                        changed[tx] = true;
+                }
+            }
+
+            for (int tx = 0; tx < tiles_x;) {
+                if (!changed[tx]) {
+                    ++tx;
+                    continue;
+                }
+                int te = tx;
+                while (te < tiles_x && changed[te])
+                    ++te;
+                int x0 = tx * DiffTileSize;
+                int x1 = std::min(te * DiffTileSize, size.x);
+                rows[ty].push_back(Rect{ { x0, y0 }, { x1 - x0, y1 - y0 } });
+                tx = te;
+            }
+        }
+        });
+
+    std::vector<Rect> ret;
+    for (auto& r : rows)
+        ret.insert(ret.end(), r.begin(), r.end());
+    return ret;
+}
+
+IScreenCapture* CreateCPUScreenCapture_()
+{
+    return new CPUScreenCapture();
+}
+
+CPUScreenCapture::~CPUScreenCapture()
+{
+    stopCapture();
+}
+
+bool CPUScreenCapture::startCapture(HWND hwnd)
+{
+    stopCapture();
+    m_hwnd = hwnd;
+    return m_hwnd != nullptr;
+}
+
+bool CPUScreenCapture::startCapture(HMONITOR hmon)
+{
+    stopCapture();
+    m_hmon = hmon;
+    return m_hmon != nullptr;
+}
+
+void CPUScreenCapture::stopCapture()
+{
+    m_hwnd = nullptr;
+    m_hmon = nullptr;
+    m_frame_info = {};
+}
+
+bool CPUScreenCapture::isCapturing() const
+{
+    return m_hwnd || m_hmon;
+}
+
+IScreenCapture::FrameInfo CPUScreenCapture::getFrame()
+{
+    std::unique_lock l(m_mutex);
+
+    FrameInfo ret;
+    auto on_capture = [&ret](const void* data, int w, int h) {
+        // GDI's bitmap is bottom-up
+        int pitch = w * 4;
+        auto tex = CPUTexture2D::create(w, h, TextureFormat::BGRAu8);
+        if (!tex)
+            return;
+        for (int i = 0; i < h; ++i)
+            memcpy(tex->getRow(i), (const byte*)data + (pitch * (h - i - 1)), pitch);
+        ret.surface = tex;
+        ret.size = { w, h };
+        ret.present_time = NowNS();
+    };
+
+    if (m_hwnd)
+        CaptureWindow(m_hwnd, on_capture);
+    else if (m_hmon)
+        CaptureMonitor(m_hmon, on_capture);
+
+    if (!ret.surface)
+        return ret;
+
+    auto& prev = m_frame_info;
+    if (prev.surface && prev.size == ret.size) {
+        auto rects = DiffFrames(*ToCPU(ret.surface), *ToCPU(prev.surface));
+        if (rects.empty()) {
+            // nothing changed. return the previous frame so that the consumers can skip it.
+            return prev;
+        }
+        ret.dirty_rects = std::move(rects);
+        ret.prev_present_time = prev.present_time;
+    }
+    m_frame_info = ret;
+
+    if (m_callback)
+        m_callback(ret);
+    return ret;
+}
+
+IScreenCapture::FrameInfo CPUScreenCapture::waitNextFrame()
+{
+    return getFrame();
+}
+
+void CPUScreenCapture::setOnFrameArrived(const Callback& cb)
+{
+    std::unique_lock l(m_mutex);
+    m_callback = cb;
+}
+
+} // namespace mr
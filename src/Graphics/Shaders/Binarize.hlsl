@@ -1,15 +1,17 @@
 cbuffer Constants : register(b0)
 {
     float g_threshold;
-    int3 g_pad;
+    int g_pad;
+    uint2 g_dst_offset; // x is in uint32
 };
 
 Texture2D<float> g_image : register(t0);
 RWTexture2D<uint> g_result : register(u0);
 
 [numthreads(1, 32, 1)]
-void main(uint2 tid : SV_DispatchThreadID)
+void main(uint2 tid_ : SV_DispatchThreadID)
 {
+    uint2 tid = tid_ + g_dst_offset;
     uint w, h;
     g_image.GetDimensions(w, h);
 
@@ -0,0 +1,34 @@
+cbuffer Constants : register(b0)
+{
+    uint2 g_range;
+    uint2 g_tl;
+    uint2 g_br;
+    uint g_num_points;
+    uint g_pad;
+};
+
+Texture2D<float> g_image : register(t0); // distance map
+StructuredBuffer<uint2> g_points : register(t1);
+#ifdef EnableMatchMin
+#include "TemplateMatchMin_Common.hlsl"
+#else
+RWTexture2D<float> g_result : register(u0);
+#endif
+
+[numthreads(32, 32, 1)]
+void main(uint2 tid : SV_DispatchThreadID, uint2 gid : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    const uint2 bpos = g_tl + tid;
+
+    float r = 0.0f;
+    for (uint i = 0; i < g_num_points; ++i)
+        r += g_image[bpos + g_points[i]];
+
+#ifdef EnableMatchMin
+    StoreWinner(tid, gid, gi, asuint(r));
+#else
+    if (tid.x < g_range.x && tid.y < g_range.y) {
+        g_result[tid] = r;
+    }
+#endif
+}
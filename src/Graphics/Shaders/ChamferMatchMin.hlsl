@@ -0,0 +1,2 @@
+#define EnableMatchMin
+#include "ChamferMatch.hlsl"
@@ -1,33 +1,23 @@
 cbuffer Constants : register(b0)
 {
-    float g_radius;
     float g_strength;
-    int2 g_pad;
+    int g_pad;
+    uint2 g_dst_offset;
+    uint2 g_dst_size;
+    uint2 g_pad2;
 };
 
-Texture2D<float> g_image : register(t0);
+Texture2D<float4> g_minmax : register(t0); // result of DiscMinMax.hlsl
 RWTexture2D<float> g_result : register(u0);
 
 [numthreads(32, 32, 1)]
-void main(uint2 tid : SV_DispatchThreadID)
+void main(uint2 tid_ : SV_DispatchThreadID)
 {
-    uint w, h;
-    g_image.GetDimensions(w, h);
+    // g_minmax is valid only in the dst region
+    if (tid_.x >= g_dst_size.x || tid_.y >= g_dst_size.y)
+        return;
 
-    int radius = int(g_radius);
-    int2 ul = max(int2(tid) - radius, 0);
-    int2 br = min(int2(tid) + radius + 1, int2(w, h));
-
-    float cmin, cmax;
-    cmin = cmax = g_image[tid];
-    for (int i = ul.y; i < br.y; ++i) {
-        for (int j = ul.x; j < br.x; ++j) {
-            if (distance(float2(tid), float2(j, i)) <= g_radius) {
-                float c = g_image[uint2(j, i)];
-                cmin = min(c, cmin);
-                cmax = max(c, cmax);
-            }
-        }
-    }
-    g_result[tid] = saturate((cmax - cmin) * g_strength);
+    uint2 tid = tid_ + g_dst_offset;
+    float2 c = g_minmax[tid].xy;
+    g_result[tid] = saturate((c.y - c.x) * g_strength);
 }
@@ -0,0 +1,41 @@
+// one pass of the separable running min & max used by Contour and Expand.
+// the window of g_src is extended by g_step on both sides. as the step can be up to twice the current half width + 1,
+// a half width w takes only log3(w) passes. reads are clamped to the edges, which never give values outside of the window.
+cbuffer Constants : register(b0)
+{
+    int2 g_step;
+    uint2 g_offset;
+    uint g_flags; // 1: g_src is the source image. 2: combine with g_acc
+    uint3 g_pad;
+};
+
+Texture2D<float4> g_src : register(t0);
+Texture2D<float4> g_acc : register(t1);
+RWTexture2D<float4> g_result : register(u0); // x: min, y: max
+
+float2 fetch(int2 pos, int2 size)
+{
+    float4 v = g_src[clamp(pos, 0, size - 1)];
+    return (g_flags & 1) ? v.xx : v.xy;
+}
+
+[numthreads(32, 32, 1)]
+void main(uint2 tid_ : SV_DispatchThreadID)
+{
+    uint2 tid = tid_ + g_offset;
+    uint w, h;
+    g_src.GetDimensions(w, h);
+    if (tid.x >= w || tid.y >= h)
+        return;
+
+    int2 size = int2(w, h);
+    float2 a = fetch(int2(tid) - g_step, size);
+    float2 b = fetch(int2(tid), size);
+    float2 c = fetch(int2(tid) + g_step, size);
+    float2 r = float2(min(min(a.x, b.x), c.x), max(max(a.y, b.y), c.y));
+    if (g_flags & 2) {
+        float2 t = g_acc[tid].xy;
+        r = float2(min(r.x, t.x), max(r.y, t.y));
+    }
+    g_result[tid] = float4(r, 0, 0);
+}
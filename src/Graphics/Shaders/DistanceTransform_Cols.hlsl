@@ -0,0 +1,36 @@
+cbuffer Constants : register(b0)
+{
+    int2 g_tl;      // dst region
+    int2 g_br;
+    int2 g_cols_tl; // columns needed by DistanceTransform_Rows.hlsl
+    int2 g_cols_br;
+    int2 g_size;
+    int g_radius;   // ceil(max distance)
+    float g_max_distance;
+};
+
+Texture2D<uint> g_image : register(t0); // Binary
+RWTexture2D<uint> g_cols : register(u0);
+
+bool GetBit(int x, int y)
+{
+    return (g_image[uint2(x / 32, y)] >> (x % 32)) & 1;
+}
+
+// distance to the nearest set bit in the column. g_radius + 1 if there is none within g_radius.
+[numthreads(32, 32, 1)]
+void main(uint2 tid : SV_DispatchThreadID)
+{
+    int2 p = g_cols_tl + int2(tid);
+    if (p.x >= g_cols_br.x || p.y >= g_cols_br.y)
+        return;
+
+    uint d = g_radius + 1;
+    for (int dy = 0; dy <= g_radius; ++dy) {
+        if ((p.y - dy >= 0 && GetBit(p.x, p.y - dy)) || (p.y + dy < g_size.y && GetBit(p.x, p.y + dy))) {
+            d = dy;
+            break;
+        }
+    }
+    g_cols[p] = d;
+}
@@ -0,0 +1,32 @@
+cbuffer Constants : register(b0)
+{
+    int2 g_tl;      // dst region
+    int2 g_br;
+    int2 g_cols_tl;
+    int2 g_cols_br;
+    int2 g_size;
+    int g_radius;   // ceil(max distance)
+    float g_max_distance;
+};
+
+Texture2D<uint> g_cols : register(t0); // made by DistanceTransform_Cols.hlsl
+RWTexture2D<float> g_result : register(u0);
+
+// the nearest of the column distances within g_radius in the row
+[numthreads(32, 32, 1)]
+void main(uint2 tid : SV_DispatchThreadID)
+{
+    int2 p = g_tl + int2(tid);
+    if (p.x >= g_br.x || p.y >= g_br.y)
+        return;
+
+    uint d2 = 0xffffffff;
+    int sr = min(p.x + g_radius + 1, g_size.x);
+    for (int sx = max(p.x - g_radius, 0); sx < sr; ++sx) {
+        uint dy = g_cols[int2(sx, p.y)];
+        uint dx = abs(sx - p.x);
+        if (dy <= uint(g_radius))
+            d2 = min(d2, dx * dx + dy * dy);
+    }
+    g_result[p] = d2 == 0xffffffff ? 1.0f : min(sqrt(float(d2)) / g_max_distance, 1.0f);
+}
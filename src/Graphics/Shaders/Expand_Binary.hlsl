@@ -1,16 +1,37 @@
 cbuffer Constants : register(b0)
 {
-    float g_radius; // assume < 16
+    int g_radius;
     int3 g_pad;
+    uint4 g_widths[8]; // half width of each row of the disc. [0] is the center row. all < 32
 };
 
 Texture2D<uint> g_image : register(t0);
 RWTexture2D<uint> g_result : register(u0);
 
 
-uint lshift(uint a, uint b, uint s)
+// 64 bit shifts. 0 < s < 32
+uint2 shr64(uint2 v, uint s)
 {
-    return s == 0 ? a : (a >> s) | (b << (32 - s));
+    return uint2((v.x >> s) | (v.y << (32 - s)), v.y >> s);
+}
+uint2 shl64(uint2 v, uint s)
+{
+    return uint2(v.x << s, (v.y << s) | (v.x >> (32 - s)));
+}
+
+// OR of bits [b - w, b + w] for each bit b of c. p and n are the words on the left and right.
+// spreads by doubling the span, so it takes log2(w) steps.
+uint dilate(uint p, uint c, uint n, uint w)
+{
+    uint2 r = uint2(c, n);
+    uint2 l = uint2(p, c);
+    for (uint len = 1; len <= w; ) {
+        uint s = min(len, w + 1 - len);
+        r |= shr64(r, s);
+        l |= shl64(l, s);
+        len += s;
+    }
+    return r.x | l.y;
 }
 
 [numthreads(32, 32, 1)]
@@ -19,32 +40,15 @@ void main(uint2 tid : SV_DispatchThreadID)
     uint w, h;
     g_image.GetDimensions(w, h);
 
-    int radius = int(g_radius);
-    uint top = max(int(tid.y) - radius, 0);
-    uint bottom = min(tid.y + radius + 1, h);
+    int top = max(int(tid.y) - g_radius, 0);
+    int bottom = min(int(tid.y) + g_radius + 1, int(h));
 
     uint r = 0;
-    for (uint b = 0; b < 32; ++b) {
-        uint bx = tid.x * 32 + b;
-        uint left = max(int(bx) - radius, 0);
-        uint right = min(bx + radius + 1, w * 32);
-
-        uint px = left / 32;
-        uint shift = left % 32;
-        //uint mask = (1 << (right - left)) - 1;
-
-        uint bits = 0;
-        for (uint py = top; py < bottom; ++py) {
-            uint mask = 0;
-            for (uint x = left; x < right; ++x)
-                if (distance(float2(bx, tid.y), float2(x, py)) <= g_radius)
-                    mask |= 1 << (x - left);
-
-            uint p = lshift(g_image[uint2(px, py)], g_image[uint2(px + 1, py)], shift);
-            bits += countbits(p & mask);
-        }
-        if (bits)
-            r |= 1 << b;
+    for (int py = top; py < bottom; ++py) {
+        uint dy = abs(py - int(tid.y));
+        r |= dilate(
+            g_image[uint2(tid.x - 1, py)], g_image[uint2(tid.x, py)], g_image[uint2(tid.x + 1, py)],
+            g_widths[dy / 4][dy % 4]);
     }
     g_result[tid] = r;
 }
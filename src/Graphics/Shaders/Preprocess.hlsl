@@ -0,0 +1,151 @@
+#include "TextureFilter.hlsl"
+
+// Transform (grayscale) -> Binarize -> Contour -> Binarize of a captured surface in one pass.
+// a group makes a 32x32 tile. grayscale of the tile and its halo is kept in groupshared memory
+// and the contour is made from it, so intermediates are written only if they are outputs.
+
+#define TileSize 32
+#define MaxHalo 8
+#define GridSize (TileSize + MaxHalo * 2)
+
+#define F_RGB               0x01
+#define F_Grayscale         0x02
+#define F_Binary            0x04
+#define F_Contour           0x08
+#define F_ContourBinary     0x10
+#define F_FilterRGB         0x20
+#define F_FilterGrayscale   0x40
+
+cbuffer Constants : register(b0)
+{
+    float2 g_sample_step;
+    float2 g_bias;
+    uint2 g_offset;     // top-left of the region. x is aligned to 32
+    uint2 g_end;        // bottom-right of the region
+    uint2 g_dst_size;
+    uint g_flags;
+    float g_threshold;
+    int g_halo;         // <= MaxHalo
+    uint g_rect_count;
+    uint2 g_pad;
+    int4 g_rects[2];    // half sizes of the rectangles approximating the disc. xy: [i * 2], zw: [i * 2 + 1]
+};
+
+Texture2D<float4> g_src : register(t0);
+RWTexture2D<float4> g_rgb : register(u0);
+RWTexture2D<float> g_grayscale : register(u1);
+RWTexture2D<uint> g_binary : register(u2);
+RWTexture2D<float> g_contour : register(u3);
+RWTexture2D<uint> g_contour_b : register(u4);
+SamplerState g_sampler_point : register(s0);
+SamplerState g_sampler_linear : register(s1);
+
+groupshared float gs_gray[GridSize * GridSize]; // negative if out of the image
+groupshared float2 gs_minmax[GridSize * TileSize];
+groupshared uint gs_bits[TileSize];
+groupshared uint gs_contour_bits[TileSize];
+
+// same as storing to and loading from Ru8
+float round8(float v)
+{
+    return floor(saturate(v) * 255.0f + 0.5f) * (1.0f / 255.0f);
+}
+
+float4 sample_src(float2 uv, bool filter)
+{
+    // not ?: as it evaluates both sides
+    if (filter)
+        return SampleTextureCatmullRom(g_src, g_sampler_linear, uv);
+    else
+        return SampleTexture1x1(g_src, g_sampler_linear, uv);
+}
+
+[numthreads(TileSize, TileSize, 1)]
+void main(uint2 gid : SV_GroupID, uint2 gtid : SV_GroupThreadID, uint gi : SV_GroupIndex)
+{
+    int2 tile = int2(g_offset + gid * TileSize);
+    int halo = g_halo;
+    int gsize = TileSize + halo * 2;
+    bool filter_gray = (g_flags & F_FilterGrayscale) != 0;
+    bool filter_rgb = (g_flags & F_FilterRGB) != 0;
+
+    if (gi < TileSize) {
+        gs_bits[gi] = 0;
+        gs_contour_bits[gi] = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // grayscale of the tile and its halo. pixels in the tile also make rgb, grayscale and binary.
+    for (uint i = gi; i < uint(gsize * gsize); i += TileSize * TileSize) {
+        int2 lp = int2(i % gsize, i / gsize);
+        int2 pos = tile - halo + lp;
+        int2 tp = lp - halo;
+        float g = -1.0f;
+        if (all(pos >= 0) && all(pos < int2(g_dst_size))) {
+            float2 uv = (g_sample_step * float2(pos)) + (g_sample_step * 0.5f);
+            float4 p = sample_src(uv, filter_gray);
+            float c = dot(p.rgb, float3(0.2126f, 0.7152f, 0.0722f));
+            g = round8((c - g_bias.x) * g_bias.y);
+
+            if (all(tp >= 0) && all(tp < TileSize) && all(pos < int2(g_end))) {
+                if (g_flags & F_RGB) {
+                    if (filter_rgb != filter_gray)
+                        p = sample_src(uv, filter_rgb);
+                    g_rgb[pos] = saturate(p);
+                }
+                if (g_flags & F_Grayscale)
+                    g_grayscale[pos] = g;
+                if (g > g_threshold)
+                    InterlockedOr(gs_bits[tp.y], 1u << tp.x);
+            }
+        }
+        gs_gray[gsize * lp.y + lp.x] = g;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    int2 pos = tile + int2(gtid);
+    bool inside = all(pos < int2(g_end));
+    bool row_inside = pos.y < int(g_end.y);
+    if ((g_flags & F_Binary) && gtid.x == 0 && row_inside)
+        g_binary[uint2(tile.x / 32, pos.y)] = gs_bits[gtid.y];
+
+    if (g_flags & (F_Contour | F_ContourBinary)) {
+        // same as DiscMinMax.hlsl + Contour.hlsl on the groupshared tile
+        float2 r = float2(1.0f, 0.0f);
+        for (uint ri = 0; ri < g_rect_count; ++ri) {
+            int2 hs = ri % 2 == 0 ? g_rects[ri / 2].xy : g_rects[ri / 2].zw;
+
+            // horizontal: all rows of the grid
+            for (uint i = gi; i < uint(gsize * TileSize); i += TileSize * TileSize) {
+                int2 lp = int2(i % TileSize, i / TileSize);
+                float2 m = float2(1.0f, 0.0f);
+                for (int x = -hs.x; x <= hs.x; ++x) {
+                    float v = gs_gray[gsize * lp.y + (lp.x + halo + x)];
+                    if (v >= 0.0f)
+                        m = float2(min(m.x, v), max(m.y, v));
+                }
+                gs_minmax[TileSize * lp.y + lp.x] = m;
+            }
+            GroupMemoryBarrierWithGroupSync();
+
+            // vertical: pixels in the tile
+            for (int y = -hs.y; y <= hs.y; ++y) {
+                float2 m = gs_minmax[TileSize * (int(gtid.y) + halo + y) + gtid.x];
+                r = float2(min(r.x, m.x), max(r.y, m.y));
+            }
+            GroupMemoryBarrierWithGroupSync();
+        }
+
+        float c = round8(r.y - r.x);
+        if (inside) {
+            if (g_flags & F_Contour)
+                g_contour[pos] = c;
+            if (c > g_threshold)
+                InterlockedOr(gs_contour_bits[gtid.y], 1u << gtid.x);
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        if ((g_flags & F_ContourBinary) && gtid.x == 0 && row_inside)
+            g_contour_b[uint2(tile.x / 32, pos.y)] = gs_contour_bits[gtid.y];
+    }
+}
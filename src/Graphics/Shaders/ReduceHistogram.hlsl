@@ -0,0 +1,43 @@
+#include "Reduce_Common.hlsl"
+
+#define TILE 64
+
+Texture2D<float> g_image : register(t0);
+RWStructuredBuffer<uint> g_result : register(u0); // 256 bins
+
+groupshared uint s_bins[256];
+
+
+// count texels of a TILE x TILE block in bins private to the group, and then add them to the global bins.
+// assume Dispatch(ceil(range.x / TILE), ceil(range.y / TILE), 1)
+[numthreads(16, 16, 1)]
+void Pass1(uint2 gid : SV_GroupID, uint2 gtid : SV_GroupThreadID, uint gi : SV_GroupIndex)
+{
+    s_bins[gi] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    uint2 dim;
+    g_image.GetDimensions(dim.x, dim.y);
+    int2 br = min(int2(g_br), int2(dim));
+    for (uint i = 0; i < TILE; i += 16) {
+        for (uint j = 0; j < TILE; j += 16) {
+            int2 p = int2(g_tl) + int2(gid * TILE + gtid + uint2(j, i));
+            if (all(p >= 0) && all(p < br)) {
+                uint b = uint(saturate(g_image[p]) * 255.0f + 0.5f);
+                InterlockedAdd(s_bins[b], 1);
+            }
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (s_bins[gi] != 0)
+        InterlockedAdd(g_result[gi], s_bins[gi]);
+}
+
+// reset the bins
+// assume Dispatch(1, 1, 1)
+[numthreads(256, 1, 1)]
+void Clear(uint gi : SV_GroupIndex)
+{
+    g_result[gi] = 0;
+}
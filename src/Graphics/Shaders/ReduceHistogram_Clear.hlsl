@@ -0,0 +1,2 @@
+#define Clear main
+#include "ReduceHistogram.hlsl"
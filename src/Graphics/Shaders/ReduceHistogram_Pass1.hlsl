@@ -0,0 +1,2 @@
+#define Pass1 main
+#include "ReduceHistogram.hlsl"
@@ -0,0 +1,66 @@
+cbuffer Constants : register(b0)
+{
+    uint2 g_range;
+    uint2 g_tl;
+    uint g_threshold; // as_value() gives the threshold in value_type
+    uint g_capacity;
+    uint2 g_pad;
+};
+
+struct Candidate
+{
+    int2 pos;
+    uint value;
+    uint pad;
+};
+
+Texture2D<value_type> g_image : register(t0);
+RWStructuredBuffer<Candidate> g_result : register(u0); // g_result[0].value is the count. candidates follow it.
+
+
+// pick local minima under the threshold. sorting and suppression are done on the CPU as candidates are few.
+// assume Dispatch(ceil(range.x / 8), ceil(range.y / 8), 1)
+[numthreads(8, 8, 1)]
+void Pass1(uint2 tid : SV_DispatchThreadID)
+{
+    if (tid.x >= g_range.x || tid.y >= g_range.y)
+        return;
+
+    int2 p = int2(tid);
+    value_type v = g_image[g_tl + tid];
+    if (v > as_value(g_threshold))
+        return;
+
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            int2 n = p + int2(dx, dy);
+            if ((dx == 0 && dy == 0) || any(n < 0) || any(n >= int2(g_range)))
+                continue;
+
+            // ties are resolved in scanline order so that a flat bottom gives one candidate
+            value_type nv = g_image[g_tl + uint2(n)];
+            bool earlier = dy < 0 || (dy == 0 && dx < 0);
+            if (nv < v || (nv == v && earlier))
+                return;
+        }
+    }
+
+    uint i;
+    InterlockedAdd(g_result[0].value, 1, i);
+    if (i < g_capacity) {
+        Candidate c;
+        c.pos = p;
+        c.value = asuint(v);
+        c.pad = 0;
+        g_result[i + 1] = c;
+    }
+}
+
+// reset the count
+// assume Dispatch(1, 1, 1)
+[numthreads(1, 1, 1)]
+void Clear()
+{
+    Candidate c = (Candidate)0;
+    g_result[0] = c;
+}
@@ -0,0 +1,4 @@
+#define value_type uint
+#define as_value asuint
+#define Clear main
+#include "ReduceTopK.hlsl"
@@ -0,0 +1,4 @@
+#define value_type float
+#define as_value asfloat
+#define Pass1 main
+#include "ReduceTopK.hlsl"
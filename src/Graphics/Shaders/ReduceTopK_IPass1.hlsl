@@ -0,0 +1,4 @@
+#define value_type uint
+#define as_value asuint
+#define Pass1 main
+#include "ReduceTopK.hlsl"
@@ -0,0 +1,47 @@
+cbuffer Constants : register(b0)
+{
+    uint2 g_range;
+    uint2 g_tl;
+    uint2 g_br;
+    uint g_num_samples;
+    float g_cutoff; // negative disables it
+    uint g_rgb;     // 0: Ru8, 1: RGBAu8
+    uint3 g_pad;
+};
+
+struct Sample
+{
+    uint2 pos;
+    uint color; // unorm8x4
+};
+
+Texture2D<float4> g_image : register(t0);
+StructuredBuffer<Sample> g_samples : register(t1);
+RWTexture2D<float> g_result : register(u0);
+
+float3 Unpack(uint c)
+{
+    return float3(c & 0xff, (c >> 8) & 0xff, (c >> 16) & 0xff) / 255.0f;
+}
+
+[numthreads(32, 32, 1)]
+void main(uint2 tid : SV_DispatchThreadID)
+{
+    const uint2 bpos = g_tl + tid;
+    const float cutoff = g_cutoff < 0.0f ? 3.402823466e+38f : g_cutoff;
+
+    float r = 0.0f;
+    for (uint i = 0; i < g_num_samples; ++i) {
+        Sample sample = g_samples[i];
+        float3 s = g_image[bpos + sample.pos].rgb;
+        float3 t = Unpack(sample.color);
+        float3 diff = abs(s - t);
+        r += g_rgb ? max(max(diff.x, diff.y), diff.z) : diff.x;
+        if (r > cutoff)
+            break;
+    }
+
+    if (tid.x < g_range.x && tid.y < g_range.y) {
+        g_result[tid] = r;
+    }
+}
@@ -0,0 +1,31 @@
+#include "TemplateMatchFFT_Common.hlsl"
+
+// one group for each column (n.x / 2 + 1 groups)
+[numthreads(FFTThreads, 1, 1)]
+void main(uint2 gid : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    uint n = g_fft_size.y;
+    uint h = g_fft_size.x / 2 + 1;
+    uint k = gid.x;
+    bool inverse = g_mode == ColsInverse;
+
+    for (uint i = gi; i < n; i += FFTThreads) {
+        s_data[BitReverse(i, n)] = inverse ? g_acc[h * i + k] : g_work[h * i + k];
+    }
+    FFT(n, gi, inverse);
+
+    for (uint j = gi; j < n; j += FFTThreads) {
+        uint idx = h * j + k;
+        float2 v = s_data[j];
+        if (g_mode == ColsStore) {
+            g_spectrum[g_offset + idx] = Conj(v);
+        }
+        else if (g_mode == ColsAccumulate) {
+            float2 r = Mul(v, g_spectrum[g_offset + idx]) * g_weight;
+            g_acc[idx] = (g_flags & FlagInit) ? r : g_acc[idx] + r;
+        }
+        else {
+            g_work[idx] = v;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+// FFT based template matching (sum of squared differences). same as CPUTemplateMatchFFT.
+// 2D real FFTs are done by a row pass (TemplateMatchFFT_Rows.hlsl) and a column pass (TemplateMatchFFT_Cols.hlsl).
+// rows are transformed in pairs packed to the real and imaginary parts, and only fft_size.x / 2 + 1 columns are kept.
+// a group transforms a row pair or a column in groupshared memory.
+
+#define FFTThreads 256
+#define MaxFFTSize 1024
+#define PI 3.14159265358979323846
+
+// g_mode of TemplateMatchFFT_Rows.hlsl
+#define RowsChannel0    0 // 0-2: a channel of g_src
+#define RowsSumSq       3 // sum of squares of the channels
+#define RowsBox         4 // 1 inside [0, g_range), 0 outside
+// g_mode of TemplateMatchFFT_Cols.hlsl
+#define ColsStore       0 // g_spectrum[g_offset + i] = conj(FFT(g_work))
+#define ColsAccumulate  1 // g_acc[i] += FFT(g_work) * g_spectrum[g_offset + i] * g_weight
+#define ColsInverse     2 // g_work = IFFT(g_acc)
+
+#define FlagInit        1 // ColsAccumulate: g_acc is overwritten instead of added
+
+cbuffer Constants : register(b0)
+{
+    int2 g_origin;      // top-left of the tile in g_src
+    uint2 g_fft_size;
+    uint2 g_range;      // positions to write in TemplateMatchFFT_RowsInv.hlsl. the box size for RowsBox
+    uint2 g_dst_pos;    // position of the tile in g_dst
+    uint g_mode;
+    float g_weight;
+    uint g_offset;      // offset of the plane in g_spectrum
+    uint g_flags;       // FlagInit | (channels << 8)
+};
+
+Texture2D<float4> g_src : register(t0);
+RWStructuredBuffer<float2> g_work : register(u0);
+RWStructuredBuffer<float2> g_acc : register(u1);
+RWStructuredBuffer<float2> g_spectrum : register(u2);
+RWStructuredBuffer<float> g_sum_sq : register(u3);
+RWTexture2D<float> g_dst : register(u4);
+
+groupshared float2 s_data[MaxFFTSize];
+
+uint GetChannels()
+{
+    return g_flags >> 8;
+}
+
+float2 Mul(float2 a, float2 b)
+{
+    return float2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+float2 Conj(float2 a)
+{
+    return float2(a.x, -a.y);
+}
+
+// index of i in the bit reversed order. n is power of 2 and >= 2.
+uint BitReverse(uint i, uint n)
+{
+    return reversebits(i) >> (32 - firstbitlow(n));
+}
+
+// radix-2 FFT of s_data[0, n) in place. s_data must be stored in the bit reversed order. the inverse is not scaled.
+void FFT(uint n, uint gi, bool inverse)
+{
+    float dir = inverse ? 1.0f : -1.0f;
+    for (uint h = 1; h < n; h <<= 1) {
+        GroupMemoryBarrierWithGroupSync();
+        for (uint i = gi; i < n / 2; i += FFTThreads) {
+            uint j = i % h;
+            uint a = (i / h) * h * 2 + j;
+            uint b = a + h;
+            float s, c;
+            sincos(dir * PI * float(j) / float(h), s, c);
+            float2 t = Mul(s_data[b], float2(c, s));
+            s_data[b] = s_data[a] - t;
+            s_data[a] = s_data[a] + t;
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+}
@@ -0,0 +1,44 @@
+#include "TemplateMatchFFT_Common.hlsl"
+
+float LoadValue(int2 pos)
+{
+    if (g_mode == RowsBox) {
+        return all(pos >= 0) && all(pos < int2(g_range)) ? 1.0f : 0.0f;
+    }
+
+    uint2 size;
+    g_src.GetDimensions(size.x, size.y);
+    if (any(pos < 0) || any(pos >= int2(size))) {
+        return 0.0f;
+    }
+
+    float4 v = g_src[pos];
+    if (g_mode == RowsSumSq) {
+        float3 w = GetChannels() == 1 ? float3(1.0f, 0.0f, 0.0f) : float3(1.0f, 1.0f, 1.0f);
+        return dot(v.rgb * v.rgb, w);
+    }
+    return v[g_mode];
+}
+
+// one group for each row pair. writes g_work[y * (n / 2 + 1) + k].
+[numthreads(FFTThreads, 1, 1)]
+void main(uint2 gid : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    uint n = g_fft_size.x;
+    uint h = n / 2 + 1;
+    uint y = gid.x * 2;
+
+    for (uint i = gi; i < n; i += FFTThreads) {
+        int2 pos = g_origin + int2(i, y);
+        s_data[BitReverse(i, n)] = float2(LoadValue(pos), LoadValue(pos + int2(0, 1)));
+    }
+    FFT(n, gi, false);
+
+    // split the spectrum of a + ib into the ones of a and b
+    for (uint k = gi; k < h; k += FFTThreads) {
+        float2 z = s_data[k];
+        float2 zn = Conj(s_data[(n - k) & (n - 1)]);
+        g_work[h * y + k] = (z + zn) * 0.5f;
+        g_work[h * (y + 1) + k] = Mul(z - zn, float2(0.0f, -0.5f));
+    }
+}
@@ -0,0 +1,37 @@
+#include "TemplateMatchFFT_Common.hlsl"
+
+// one group for each row pair. inverse of TemplateMatchFFT_Rows.hlsl, and writes ssd to g_dst.
+[numthreads(FFTThreads, 1, 1)]
+void main(uint2 gid : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    uint n = g_fft_size.x;
+    uint h = n / 2 + 1;
+    uint y = gid.x * 2;
+
+    // restore the other half by the conjugate symmetry, and pack a and b to a + ib
+    for (uint k = gi; k < n; k += FFTThreads) {
+        float2 a, b;
+        if (k < h) {
+            a = g_work[h * y + k];
+            b = g_work[h * (y + 1) + k];
+        }
+        else {
+            a = Conj(g_work[h * y + (n - k)]);
+            b = Conj(g_work[h * (y + 1) + (n - k)]);
+        }
+        s_data[BitReverse(k, n)] = float2(a.x - b.y, a.y + b.x);
+    }
+    FFT(n, gi, true);
+
+    float scale = 1.0f / float(n * g_fft_size.y);
+    float sum_sq = g_sum_sq[0];
+    for (uint x = gi; x < g_range.x; x += FFTThreads) {
+        float2 v = s_data[x] * scale;
+        if (y < g_range.y) {
+            g_dst[g_dst_pos + uint2(x, y)] = max(v.x + sum_sq, 0.0f);
+        }
+        if (y + 1 < g_range.y) {
+            g_dst[g_dst_pos + uint2(x, y + 1)] = max(v.y + sum_sq, 0.0f);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#include "TemplateMatchFFT_Common.hlsl"
+
+groupshared float s_sums[FFTThreads];
+
+// assume Dispatch(1, 1, 1). g_sum_sq[0] = sum of squares of the channels of g_src in [0, g_range).
+[numthreads(FFTThreads, 1, 1)]
+void main(uint gi : SV_GroupIndex)
+{
+    float3 w = GetChannels() == 1 ? float3(1.0f, 0.0f, 0.0f) : float3(1.0f, 1.0f, 1.0f);
+    uint count = g_range.x * g_range.y;
+    float r = 0.0f;
+    for (uint i = gi; i < count; i += FFTThreads) {
+        float4 v = g_src[uint2(i % g_range.x, i / g_range.x)];
+        r += dot(v.rgb * v.rgb, w);
+    }
+    s_sums[gi] = r;
+
+    for (uint s = FFTThreads / 2; s > 0; s >>= 1) {
+        GroupMemoryBarrierWithGroupSync();
+        if (gi < s) {
+            s_sums[gi] += s_sums[gi + s];
+        }
+    }
+    if (gi == 0) {
+        g_sum_sq[0] = s_sums[0];
+    }
+}
@@ -0,0 +1,56 @@
+// TemplateMatchMin for multiple templates packed into an atlas.
+// each group matches all templates for its 32x32 tile of positions, so the tile of the image is read from the cache
+// for all of them. the winners of template i are g_winners[g_group_count * i + (index of the group)], and
+// TemplateMatchMinMulti_Reduce.hlsl reduces them to g_results[i].
+// the includer of the match pass defines Pixel (float or float3) and float Diff(Pixel s, Pixel t).
+
+cbuffer Constants : register(b0)
+{
+    uint2 g_range;  // bounding box of the regions of all templates
+    uint2 g_tl;
+    uint g_template_count;
+    uint g_group_count;
+    uint2 g_pad;
+};
+
+struct Entry
+{
+    uint2 atlas_pos;
+    uint2 size;
+    uint2 tl;       // region of the template
+    uint2 range;
+};
+
+#include "TemplateMatchMin_Common.hlsl"
+
+#ifdef Pixel
+Texture2D<Pixel> g_image : register(t0);
+Texture2D<Pixel> g_atlas : register(t1);
+StructuredBuffer<Entry> g_entries : register(t2);
+
+[numthreads(32, 32, 1)]
+void main(uint2 tid : SV_DispatchThreadID, uint2 gid : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    const uint2 bpos = g_tl + tid;
+    const uint group = ((g_range.x + 31) / 32) * gid.y + gid.x;
+
+    for (uint ti = 0; ti < g_template_count; ++ti) {
+        Entry e = g_entries[ti];
+
+        // relative to the region of the template. positions before it wrap around and are out of range.
+        uint2 pos = bpos - e.tl;
+        bool valid = pos.x < e.range.x && pos.y < e.range.y;
+
+        float r = 0.0f;
+        if (valid) {
+            for (uint i = 0; i < e.size.y; ++i) {
+                for (uint j = 0; j < e.size.x; ++j) {
+                    uint2 tpos = uint2(j, i);
+                    r += Diff(g_image[bpos + tpos], g_atlas[e.atlas_pos + tpos]);
+                }
+            }
+        }
+        StoreWinnerAt(pos, valid, gi, g_group_count * ti + group, asuint(r));
+    }
+}
+#endif
@@ -0,0 +1,8 @@
+#define Pixel float
+
+float Diff(float s, float t)
+{
+    return abs(s - t);
+}
+
+#include "TemplateMatchMinMulti_Common.hlsl"
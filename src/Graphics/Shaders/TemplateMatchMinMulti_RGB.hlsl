@@ -0,0 +1,9 @@
+#define Pixel float3
+
+float Diff(float3 s, float3 t)
+{
+    float3 d = abs(s - t);
+    return max(max(d.x, d.y), d.z);
+}
+
+#include "TemplateMatchMinMulti_Common.hlsl"
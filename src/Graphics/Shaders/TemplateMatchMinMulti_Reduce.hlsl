@@ -0,0 +1,28 @@
+#include "TemplateMatchMinMulti_Common.hlsl"
+
+RWStructuredBuffer<Winner> g_results : register(u1);
+
+// assume Dispatch(g_template_count, 1, 1). each group reduces the winners of one template.
+[numthreads(1024, 1, 1)]
+void main(uint gi : SV_GroupIndex, uint3 gid : SV_GroupID)
+{
+    uint base = g_group_count * gid.x;
+    uint rs = 0xffffffff, rp = 0xffffffff;
+    for (uint i = gi; i < g_group_count; i += 1024) {
+        Winner w = g_winners[base + i];
+        if (Less(w.score, w.pos, rs, rp)) {
+            rs = w.score;
+            rp = w.pos;
+        }
+    }
+    MatchMinScores[gi] = rs;
+    MatchMinPositions[gi] = rp;
+    ReduceGroup(gi);
+
+    if (gi == 0) {
+        Winner w;
+        w.score = MatchMinScores[0];
+        w.pos = MatchMinPositions[0];
+        g_results[gid.x] = w;
+    }
+}
@@ -0,0 +1,67 @@
+// template matching fused with min reduction.
+// each thread computes the score of one position as TemplateMatch_*.hlsl does, and each group writes only its winner.
+// TemplateMatchMin_Reduce.hlsl reduces the winners of all groups to g_winners[0].
+// the includer must declare the Constants cbuffer of TemplateMatch_*.hlsl.
+
+struct Winner
+{
+    uint score; // float scores are stored by asuint(). they are not negative, so the order is kept.
+    uint pos;   // (y << 16) | x relative to g_tl. ties are resolved by this (= scanline order).
+};
+RWStructuredBuffer<Winner> g_winners : register(u0);
+
+#ifndef MatchMinScores
+groupshared uint s_scores[1024];
+groupshared uint s_positions[1024];
+#define MatchMinScores s_scores
+#define MatchMinPositions s_positions
+#endif
+
+bool Less(uint as, uint ap, uint bs, uint bp)
+{
+    return as < bs || (as == bs && ap < bp);
+}
+
+uint GetWinnerCount()
+{
+    return ((g_range.x + 31) / 32) * ((g_range.y + 31) / 32);
+}
+
+// reduce MatchMinScores[0-1023] to MatchMinScores[0]
+void ReduceGroup(uint gi)
+{
+    GroupMemoryBarrierWithGroupSync();
+    for (uint s = 512; s > 0; s >>= 1) {
+        if (gi < s) {
+            uint bs = MatchMinScores[gi + s];
+            uint bp = MatchMinPositions[gi + s];
+            if (Less(bs, bp, MatchMinScores[gi], MatchMinPositions[gi])) {
+                MatchMinScores[gi] = bs;
+                MatchMinPositions[gi] = bp;
+            }
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
+
+// all threads of the [numthreads(32, 32, 1)] group must call this. the winner of the group is written to g_winners[index].
+void StoreWinnerAt(uint2 pos, bool valid, uint gi, uint index, uint score)
+{
+    GroupMemoryBarrierWithGroupSync();
+    MatchMinScores[gi] = valid ? score : 0xffffffff;
+    MatchMinPositions[gi] = valid ? (pos.y << 16) | pos.x : 0xffffffff;
+    ReduceGroup(gi);
+
+    if (gi == 0) {
+        Winner w;
+        w.score = MatchMinScores[0];
+        w.pos = MatchMinPositions[0];
+        g_winners[index] = w;
+    }
+}
+
+void StoreWinner(uint2 tid, uint2 gid, uint gi, uint score)
+{
+    bool valid = tid.x < g_range.x && tid.y < g_range.y;
+    StoreWinnerAt(tid, valid, gi, ((g_range.x + 31) / 32) * gid.y + gid.x, score);
+}
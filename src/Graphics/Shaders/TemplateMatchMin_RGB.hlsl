@@ -0,0 +1,2 @@
+#define EnableMatchMin
+#include "TemplateMatch_RGB.hlsl"
@@ -0,0 +1,34 @@
+cbuffer Constants : register(b0)
+{
+    uint2 g_range;
+    uint2 g_tl;
+    uint2 g_br;
+    uint2 g_template_size;
+};
+
+#include "TemplateMatchMin_Common.hlsl"
+
+// assume Dispatch(1, 1, 1)
+[numthreads(1024, 1, 1)]
+void main(uint gi : SV_GroupIndex)
+{
+    uint n = GetWinnerCount();
+    uint rs = 0xffffffff, rp = 0xffffffff;
+    for (uint i = gi; i < n; i += 1024) {
+        Winner w = g_winners[i];
+        if (Less(w.score, w.pos, rs, rp)) {
+            rs = w.score;
+            rp = w.pos;
+        }
+    }
+    MatchMinScores[gi] = rs;
+    MatchMinPositions[gi] = rp;
+    ReduceGroup(gi);
+
+    if (gi == 0) {
+        Winner w;
+        w.score = MatchMinScores[0];
+        w.pos = MatchMinPositions[0];
+        g_winners[0] = w;
+    }
+}
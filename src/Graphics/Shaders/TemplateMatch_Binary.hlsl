@@ -8,9 +8,11 @@ cbuffer Constants : register(b0)
 
 Texture2D<uint> g_image : register(t0);
 Texture2D<uint> g_template : register(t1);
-Texture2D<float> g_mask_image : register(t2);
-Texture2D<float> g_mask_template : register(t3);
+Texture2D<uint> g_mask_image : register(t2); // binary as the image
+Texture2D<uint> g_mask_template : register(t3);
+#ifndef EnableMatchMin
 RWTexture2D<uint> g_result : register(u0);
+#endif
 
 
 uint lshift(uint a, uint b, uint s)
@@ -26,8 +28,15 @@ uint lshift(uint a, uint b, uint s)
 groupshared uint s_template[CacheCapacity];
 groupshared uint s_mask[CacheCapacity];
 
+#ifdef EnableMatchMin
+// the template cache is not used after matching. reuse it for the reduction.
+#define MatchMinScores s_template
+#define MatchMinPositions s_mask
+#include "TemplateMatchMin_Common.hlsl"
+#endif
+
 [numthreads(32, 32, 1)]
-void main(uint2 tid : SV_DispatchThreadID, uint gi : SV_GroupIndex)
+void main(uint2 tid : SV_DispatchThreadID, uint2 gid : SV_GroupID, uint gi : SV_GroupIndex)
 {
     // template_size.x is divided by 32 as the image is binary and the texture format is uint32.
     // g_template_size.x is actual width.
@@ -109,15 +118,23 @@ void main(uint2 tid : SV_DispatchThreadID, uint gi : SV_GroupIndex)
         }
     }
 
+#ifdef EnableMatchMin
+    StoreWinner(tid, gid, gi, r);
+#else
     if (tid.x < g_range.x && tid.y < g_range.y) {
         g_result[tid] = r;
     }
+#endif
 }
 
 #else // EnableGroupShared
 
+#ifdef EnableMatchMin
+#include "TemplateMatchMin_Common.hlsl"
+#endif
+
 [numthreads(32, 32, 1)]
-void main(uint2 tid : SV_DispatchThreadID)
+void main(uint2 tid : SV_DispatchThreadID, uint2 gid : SV_GroupID, uint gi : SV_GroupIndex)
 {
     uint2 template_size, mask_size;
     g_template.GetDimensions(template_size.x, template_size.y);
@@ -165,9 +182,13 @@ void main(uint2 tid : SV_DispatchThreadID)
         }
     }
 
+#ifdef EnableMatchMin
+    StoreWinner(tid, gid, gi, r);
+#else
     if (tid.x < g_range.x && tid.y < g_range.y) {
         g_result[tid] = r;
     }
+#endif
 }
 
 #endif // EnableGroupShared
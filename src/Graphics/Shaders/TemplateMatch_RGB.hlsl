@@ -10,7 +10,11 @@ Texture2D<float3> g_image : register(t0);
 Texture2D<float3> g_template : register(t1);
 Texture2D<float> g_mask_image : register(t2);
 Texture2D<float> g_mask_template : register(t3);
+#ifdef EnableMatchMin
+#include "TemplateMatchMin_Common.hlsl"
+#else
 RWTexture2D<float> g_result : register(u0);
+#endif
 
 
 float GetMaskValue(uint2 ipos, uint2 tpos)
@@ -35,7 +39,7 @@ float GetMaskValue(uint2 ipos, uint2 tpos)
 }
 
 [numthreads(32, 32, 1)]
-void main(uint2 tid : SV_DispatchThreadID)
+void main(uint2 tid : SV_DispatchThreadID, uint2 gid : SV_GroupID, uint gi : SV_GroupIndex)
 {
     uint2 template_size, mask_size;
     g_template.GetDimensions(template_size.x, template_size.y);
@@ -57,7 +61,11 @@ void main(uint2 tid : SV_DispatchThreadID)
         }
     }
 
+#ifdef EnableMatchMin
+    StoreWinner(tid, gid, gi, asuint(r));
+#else
     if (tid.x < g_range.x && tid.y < g_range.y) {
         g_result[tid] = r;
     }
+#endif
 }
@@ -11,7 +11,7 @@ cbuffer Constants : register(b0)
     float2 g_bias;
     uint g_flags;
     uint g_filter;
-    uint2 g_pad;
+    uint2 g_dst_offset;
 };
 
 Texture2D<float4> g_src : register(t0);
@@ -22,8 +22,9 @@ SamplerState g_sampler_linear : register(s1);
 
 
 [numthreads(32, 32, 1)]
-void main(uint2 tid : SV_DispatchThreadID)
+void main(uint2 tid_ : SV_DispatchThreadID)
 {
+    uint2 tid = tid_ + g_dst_offset;
     float2 uv = (g_sample_step * float2(tid)) + g_pixel_offset + (g_sample_step * 0.5f);
     float4 p;
     switch (g_filter) {
@@ -6,12 +6,30 @@
 #include "Normalize_F.hlsl.h"
 #include "Normalize_I.hlsl.h"
 #include "Binarize.hlsl.h"
+#include "DiscMinMax.hlsl.h"
 #include "Contour.hlsl.h"
 #include "Expand_Grayscale.hlsl.h"
 #include "Expand_Binary.hlsl.h"
+#include "DistanceTransform_Cols.hlsl.h"
+#include "DistanceTransform_Rows.hlsl.h"
+#include "Preprocess.hlsl.h"
 #include "TemplateMatch_Grayscale.hlsl.h"
 #include "TemplateMatch_Binary.hlsl.h"
 #include "TemplateMatch_RGB.hlsl.h"
+#include "TemplateMatchMin_Grayscale.hlsl.h"
+#include "TemplateMatchMin_Binary.hlsl.h"
+#include "TemplateMatchMin_RGB.hlsl.h"
+#include "TemplateMatchMin_Reduce.hlsl.h"
+#include "TemplateMatchMinMulti_Grayscale.hlsl.h"
+#include "TemplateMatchMinMulti_RGB.hlsl.h"
+#include "TemplateMatchMinMulti_Reduce.hlsl.h"
+#include "TemplateMatchFFT_Rows.hlsl.h"
+#include "TemplateMatchFFT_Cols.hlsl.h"
+#include "TemplateMatchFFT_RowsInv.hlsl.h"
+#include "TemplateMatchFFT_SumSq.hlsl.h"
+#include "ChamferMatch.hlsl.h"
+#include "ChamferMatchMin.hlsl.h"
+#include "SparseMatch.hlsl.h"
 #include "Shape.hlsl.h"
 
 #define mrBytecode(A) A, std::size(A)
@@ -43,10 +61,11 @@ class Transform : public FilterCommon<ITransform>
 {
 using super = FilterCommon<ITransform>;
 public:
-    enum class Flag
+    // same as F_* in Transform.hlsl
+    enum class Flag : uint32_t
     {
-        Grayscale,
-        FillAlpha,
+        Grayscale = 0x01,
+        FillAlpha = 0x02,
     };
 
     Transform(TransformCS* v);
@@ -57,6 +76,7 @@ public:
     void setGrayscale(bool v) override;
     void setFillAlpha(bool v) override;
     void setFiltering(bool v) override;
+    void setDstRegion(Rect v) override;
     void dispatch() override;
 
 public:
@@ -64,6 +84,8 @@ public:
     BufferPtr m_const;
 
     Rect m_region{};
+    Rect m_dst_region{};
+    int2 m_dst_tl{}, m_dst_br{};
     float2 m_color_range{ 0.0f, 1.0f };
     bool m_grayscale = false;
     bool m_fill_alpha = false;
@@ -79,6 +101,7 @@ void Transform::setColorRange(float2 v) { mrCheckDirty(m_color_range == v); m_co
 void Transform::setGrayscale(bool v) { mrCheckDirty(m_grayscale == v); m_grayscale = v; }
 void Transform::setFillAlpha(bool v) { mrCheckDirty(m_fill_alpha == v); m_fill_alpha = v; }
 void Transform::setFiltering(bool v) { mrCheckDirty(m_filtering == v); m_filtering = v; }
+void Transform::setDstRegion(Rect v) { mrCheckDirty(m_dst_region == v); m_dst_region = v; }
 
 void Transform::dispatch()
 {
@@ -100,7 +123,7 @@ void Transform::dispatch()
             float2 bias;
             uint32_t flags;
             int filter;
-            int2 pad;
+            int2 dst_offset;
         } params{};
         params.pixel_size = 1.0f / float2(src_size);
         params.pixel_offset = params.pixel_size * m_region.pos;
@@ -120,9 +143,14 @@ void Transform::dispatch()
             else if (dst_size.x < src_size.x / 1) params.filter = 2;
         }
 
+        GetTexelRegion(dst_size, m_dst->getFormat(), m_dst_region, m_dst_tl, m_dst_br);
+        params.dst_offset = m_dst_tl;
+
         m_const = Buffer::createConstant(params);
         m_dirty = false;
     }
+    if (m_dst_tl.x >= m_dst_br.x || m_dst_tl.y >= m_dst_br.y)
+        return;
     m_cs->dispatch(*this);
 }
 
@@ -141,7 +169,7 @@ void TransformCS::dispatch(ICSContext& ctx)
     m_cs.setSRV(c.m_src);
     m_cs.setUAV(c.m_dst);
 
-    auto dst_size = c.m_dst->getInternalSize();
+    auto dst_size = c.m_dst_br - c.m_dst_tl;
     m_cs.dispatch(
         ceildiv(dst_size.x, 32),
         ceildiv(dst_size.y, 32));
@@ -223,9 +251,12 @@ INormalizePtr NormalizeCS::createContext()
 
 class Binarize : public FilterCommon<IBinarize>
 {
+using super = FilterCommon<IBinarize>;
 public:
     Binarize(BinarizeCS* v);
+    void setDst(ITexture2DPtr v) override;
     void setThreshold(float v) override;
+    void setDstRegion(Rect v) override;
     void dispatch() override;
 
 public:
@@ -233,6 +264,8 @@ public:
     BufferPtr m_const;
 
     float m_threshold = 0.5f;
+    Rect m_dst_region{};
+    int2 m_dst_tl{}, m_dst_br{};
     bool m_dirty = true;
 };
 
@@ -242,7 +275,9 @@ IBinarizePtr BinarizeCS::createContext()
 }
 
 Binarize::Binarize(BinarizeCS* v) : m_cs(v) {}
+void Binarize::setDst(ITexture2DPtr v) { mrCheckDirty(m_dst.get() == v.get()); super::setDst(v); }
 void Binarize::setThreshold(float v) { mrCheckDirty(v == m_threshold); m_threshold = v; }
+void Binarize::setDstRegion(Rect v) { mrCheckDirty(m_dst_region == v); m_dst_region = v; }
 
 void Binarize::dispatch()
 {
@@ -252,16 +287,22 @@ void Binarize::dispatch()
     }
 
     if (m_dirty) {
+        GetTexelRegion(m_dst->getSize(), m_dst->getFormat(), m_dst_region, m_dst_tl, m_dst_br);
+
         struct
         {
             float threshold;
-            int3 pad;
+            int pad;
+            int2 dst_offset;
         } params{};
         params.threshold = m_threshold;
+        params.dst_offset = m_dst_tl;
 
         m_const = Buffer::createConstant(params);
         m_dirty = false;
     }
+    if (m_dst_tl.x >= m_dst_br.x || m_dst_tl.y >= m_dst_br.y)
+        return;
 
     m_cs->dispatch(*this);
 }
@@ -279,31 +320,145 @@ void BinarizeCS::dispatch(ICSContext& ctx)
     m_cs.setUAV(c.m_dst);
     m_cs.setCBuffer(c.m_const);
 
-    auto size = c.m_dst->getInternalSize();
+    auto size = c.m_dst_br - c.m_dst_tl;
     m_cs.dispatch(
         size.x,
         ceildiv(size.y, 32));
 }
 
 
+// running min & max over the disc approximated by GetDiscRects(). shared by Contour and Expand.
+// each rectangle is done by horizontal and vertical passes of DiscMinMax.hlsl. a pass can extend the window
+// up to 3 times, so the number of passes grows only logarithmically with the radius.
+class DiscMinMax
+{
+public:
+    // [tl, br): region where the result is needed
+    void setup(int2 size, int2 tl, int2 br, float radius);
+    void dispatch(ComputeShader& cs, Texture2D* src);
+    // x: min, y: max
+    Texture2D* getResult();
+
+private:
+    struct Pass
+    {
+        BufferPtr params;
+        int2 size{};
+        int src{}; // index of m_textures. -1: source image
+        int acc{}; // -1: none
+        int dst{};
+    };
+    std::vector<Pass> m_passes;
+    Texture2DPtr m_textures[4]; // [0-1]: ping-pong, [2-3]: accumulation
+    int m_result = 0;
+
+    int2 m_size{}, m_tl{}, m_br{};
+    float m_radius = -1.0f;
+};
+
+void DiscMinMax::setup(int2 size, int2 tl, int2 br, float radius)
+{
+    if (size == m_size && tl == m_tl && br == m_br && radius == m_radius)
+        return;
+    m_size = size;
+    m_tl = tl;
+    m_br = br;
+    m_radius = radius;
+
+    if (!m_textures[0] || m_textures[0]->getSize() != size) {
+        for (auto& t : m_textures)
+            t = Texture2D::create(size.x, size.y, TextureFormat::RGBAf32);
+    }
+
+    m_passes.clear();
+    auto rects = GetDiscRects(radius);
+    for (int ri = 0; ri < (int)rects.size(); ++ri) {
+        int2 hs = rects[ri];
+
+        // window grows from a to a + s. s <= a * 2 + 1 keeps the window contiguous.
+        std::vector<int2> steps;
+        for (int a = 0; a < hs.x; a += steps.back().x)
+            steps.push_back({ std::min(a * 2 + 1, hs.x - a), 0 });
+        for (int a = 0; a < hs.y; a += steps.back().y)
+            steps.push_back({ 0, std::min(a * 2 + 1, hs.y - a) });
+        if (steps.empty())
+            steps.push_back({ 0, 0 });
+
+        // values out of the domain are not valid, but errors spread only as far as the window, so they don't reach [tl, br).
+        int2 dtl{ std::max(tl.x - hs.x, 0), std::max(tl.y - hs.y, 0) };
+        int2 dbr{ std::min(br.x + hs.x, size.x), std::min(br.y + hs.y, size.y) };
+        for (int si = 0; si < (int)steps.size(); ++si) {
+            bool first = si == 0;
+            bool last = si + 1 == (int)steps.size();
+
+            struct
+            {
+                int2 step;
+                int2 offset;
+                uint32_t flags;
+                int3 pad;
+            } params{};
+            params.step = steps[si];
+            params.offset = dtl;
+            params.flags = (first ? 1 : 0) | (last && ri > 0 ? 2 : 0);
+
+            Pass pass;
+            pass.params = Buffer::createConstant(params);
+            pass.size = dbr - dtl;
+            pass.src = first ? -1 : (si - 1) % 2;
+            pass.acc = last && ri > 0 ? 2 + (ri - 1) % 2 : -1;
+            pass.dst = last ? 2 + ri % 2 : si % 2;
+            m_passes.push_back(pass);
+        }
+        m_result = 2 + ri % 2;
+    }
+}
+
+void DiscMinMax::dispatch(ComputeShader& cs, Texture2D* src)
+{
+    for (auto& pass : m_passes) {
+        cs.setSRV(pass.src < 0 ? src : m_textures[pass.src].get(), 0);
+        cs.setSRV(pass.acc < 0 ? nullptr : m_textures[pass.acc].get(), 1);
+        cs.setUAV(m_textures[pass.dst]);
+        cs.setCBuffer(pass.params);
+        cs.dispatch(
+            ceildiv(pass.size.x, 32),
+            ceildiv(pass.size.y, 32));
+    }
+}
+
+Texture2D* DiscMinMax::getResult()
+{
+    return m_textures[m_result];
+}
+
+
 class Contour : public FilterCommon<IContour>
 {
+using super = FilterCommon<IContour>;
 public:
     Contour(ContourCS* v);
+    void setDst(ITexture2DPtr v) override;
     void setRadius(float v) override;
+    void setDstRegion(Rect v) override;
     void dispatch() override;
 
 public:
     ContourCS* m_cs{};
     BufferPtr m_const;
+    DiscMinMax m_minmax;
 
     float m_radius = 1.0f;
     float m_strength = 1.0f;
+    Rect m_dst_region{};
+    int2 m_dst_tl{}, m_dst_br{};
     bool m_dirty = true;
 };
 
 Contour::Contour(ContourCS* v) : m_cs(v) {}
+void Contour::setDst(ITexture2DPtr v) { mrCheckDirty(m_dst.get() == v.get()); super::setDst(v); }
 void Contour::setRadius(float v) { mrCheckDirty(v == m_radius); m_radius = v; }
+void Contour::setDstRegion(Rect v) { mrCheckDirty(m_dst_region == v); m_dst_region = v; }
 
 void Contour::dispatch()
 {
@@ -313,36 +468,47 @@ void Contour::dispatch()
     }
 
     if (m_dirty) {
+        GetTexelRegion(m_dst->getSize(), m_dst->getFormat(), m_dst_region, m_dst_tl, m_dst_br);
+
         struct
         {
-            float radius;
             float strength;
-            int2 pad;
+            int pad;
+            int2 dst_offset;
+            int2 dst_size;
+            int2 pad2;
         } params{};
-        params.radius = m_radius;
         params.strength = m_strength;
+        params.dst_offset = m_dst_tl;
+        params.dst_size = m_dst_br - m_dst_tl;
 
         m_const = Buffer::createConstant(params);
         m_dirty = false;
     }
+    if (m_dst_tl.x >= m_dst_br.x || m_dst_tl.y >= m_dst_br.y)
+        return;
 
+    m_minmax.setup(m_src->getSize(), m_dst_tl, m_dst_br, m_radius);
     m_cs->dispatch(*this);
 }
 
 ContourCS::ContourCS()
 {
     m_cs.initialize(mrBytecode(g_hlsl_Contour));
+    m_cs_minmax.initialize(mrBytecode(g_hlsl_DiscMinMax));
 }
 
 void ContourCS::dispatch(ICSContext& ctx)
 {
     auto& c = static_cast<Contour&>(ctx);
 
-    m_cs.setSRV(c.m_src);
+    c.m_minmax.dispatch(m_cs_minmax, c.m_src);
+
+    m_cs.setSRV(c.m_minmax.getResult());
     m_cs.setUAV(c.m_dst);
     m_cs.setCBuffer(c.m_const);
 
-    auto size = c.m_dst->getInternalSize();
+    auto size = c.m_dst_br - c.m_dst_tl;
     m_cs.dispatch(
         ceildiv(size.x, 32),
         ceildiv(size.y, 32));
@@ -364,6 +530,7 @@ public:
 public:
     ExpandCS* m_cs{};
     BufferPtr m_const;
+    DiscMinMax m_minmax;
 
     float m_radius = 1.0f;
     bool m_dirty = true;
@@ -379,16 +546,26 @@ void Expand::dispatch()
         return;
     }
 
-    if (m_dirty) {
-        struct
-        {
-            float radius;
-            int3 pad;
-        } params{};
-        params.radius = m_radius;
-
-        m_const = Buffer::createConstant(params);
-        m_dirty = false;
+    if (m_src->getFormat() == TextureFormat::Binary) {
+        if (m_dirty) {
+            struct
+            {
+                int radius;
+                int3 pad;
+                int widths[32];
+            } params{};
+            auto widths = GetDiscRowWidths(m_radius);
+            widths.resize(std::min((int)widths.size(), 32));
+            params.radius = (int)widths.size() - 1;
+            for (int i = 0; i < (int)widths.size(); ++i)
+                params.widths[i] = std::min(widths[i], 31);
+
+            m_const = Buffer::createConstant(params);
+            m_dirty = false;
+        }
+    }
+    else {
+        m_minmax.setup(m_src->getSize(), {}, m_dst->getInternalSize(), m_radius);
     }
 
     m_cs->dispatch(*this);
@@ -398,6 +575,7 @@ ExpandCS::ExpandCS()
 {
     m_cs_grayscale.initialize(mrBytecode(g_hlsl_Expand_Grayscale));
     m_cs_binary.initialize(mrBytecode(g_hlsl_Expand_Binary));
+    m_cs_minmax.initialize(mrBytecode(g_hlsl_DiscMinMax));
 }
 
 void ExpandCS::dispatch(ICSContext& ctx)
@@ -414,9 +592,10 @@ void ExpandCS::dispatch(ICSContext& ctx)
             ceildiv(size.y, 32));
     }
     else {
-        m_cs_grayscale.setSRV(c.m_src);
+        c.m_minmax.dispatch(m_cs_minmax, c.m_src);
+
+        m_cs_grayscale.setSRV(c.m_minmax.getResult());
         m_cs_grayscale.setUAV(c.m_dst);
-        m_cs_grayscale.setCBuffer(c.m_const);
         m_cs_grayscale.dispatch(
             ceildiv(size.x, 32),
             ceildiv(size.y, 32));
@@ -429,6 +608,329 @@ IExpandPtr ExpandCS::createContext()
 }
 
 
+class DistanceTransform : public FilterCommon<IDistanceTransform>
+{
+using super = FilterCommon<IDistanceTransform>;
+public:
+    DistanceTransform(DistanceTransformCS* v);
+    void setDst(ITexture2DPtr v) override;
+    void setMaxDistance(float v) override;
+    void setDstRegion(Rect v) override;
+    void dispatch() override;
+
+public:
+    DistanceTransformCS* m_cs{};
+    BufferPtr m_const;
+    Texture2DPtr m_cols; // distance to the nearest bit in the column
+
+    float m_max_distance = 4.0f;
+    Rect m_dst_region{};
+    int2 m_dst_size{};
+    int2 m_tl{}, m_br{};
+    int2 m_cols_tl{}, m_cols_br{};
+    bool m_dirty = true;
+};
+
+DistanceTransform::DistanceTransform(DistanceTransformCS* v) : m_cs(v) {}
+
+void DistanceTransform::setDst(ITexture2DPtr v)
+{
+    super::setDst(v);
+    int2 s = v ? v->getSize() : int2{};
+    mrCheckDirty(m_dst_size == s);
+    m_dst_size = s;
+}
+
+void DistanceTransform::setMaxDistance(float v) { mrCheckDirty(v == m_max_distance); m_max_distance = v; }
+void DistanceTransform::setDstRegion(Rect v) { mrCheckDirty(v == m_dst_region); m_dst_region = v; }
+
+void DistanceTransform::dispatch()
+{
+    if (!m_src || !m_dst || m_max_distance <= 0.0f) {
+        mrDbgPrint("*** DistanceTransform::dispatch(): invaid params ***\n");
+        return;
+    }
+    if (m_src->getFormat() != TextureFormat::Binary || m_src->getSize() != m_dst_size) {
+        mrDbgPrint("*** DistanceTransform::dispatch(): src must be a Binary texture of the same size as dst ***\n");
+        return;
+    }
+
+    if (m_dirty) {
+        int radius = (int)std::ceil(m_max_distance);
+        if (!GetTexelRegion(m_dst_size, TextureFormat::Rf32, m_dst_region, m_tl, m_br))
+            m_tl = m_br = {}; // nothing to update
+        // pass 2 looks up columns within the radius of the dst region
+        m_cols_tl = { std::max(m_tl.x - radius, 0), m_tl.y };
+        m_cols_br = { std::min(m_br.x + radius, m_dst_size.x), m_br.y };
+
+        struct
+        {
+            int2 tl;
+            int2 br;
+            int2 cols_tl;
+            int2 cols_br;
+            int2 size;
+            int radius;
+            float max_distance;
+        } params{};
+        params.tl = m_tl;
+        params.br = m_br;
+        params.cols_tl = m_cols_tl;
+        params.cols_br = m_cols_br;
+        params.size = m_dst_size;
+        params.radius = radius;
+        params.max_distance = m_max_distance;
+
+        m_const = Buffer::createConstant(params);
+        if (!m_cols || m_cols->getSize() != m_dst_size)
+            m_cols = Texture2D::create(m_dst_size.x, m_dst_size.y, TextureFormat::Ri32);
+        m_dirty = false;
+    }
+
+    m_cs->dispatch(*this);
+}
+
+DistanceTransformCS::DistanceTransformCS()
+{
+    m_cs_cols.initialize(mrBytecode(g_hlsl_DistanceTransform_Cols));
+    m_cs_rows.initialize(mrBytecode(g_hlsl_DistanceTransform_Rows));
+}
+
+void DistanceTransformCS::dispatch(ICSContext& ctx)
+{
+    auto& c = static_cast<DistanceTransform&>(ctx);
+
+    auto size = c.m_br - c.m_tl;
+    auto cols_size = c.m_cols_br - c.m_cols_tl;
+    if (size.x <= 0 || size.y <= 0)
+        return;
+
+    // pass 1: vertical distances
+    m_cs_cols.setCBuffer(c.m_const);
+    m_cs_cols.setSRV(c.m_src);
+    m_cs_cols.setUAV(c.m_cols);
+    m_cs_cols.dispatch(
+        ceildiv(cols_size.x, 32),
+        ceildiv(cols_size.y, 32));
+
+    // pass 2: combine them along rows
+    m_cs_rows.setCBuffer(c.m_const);
+    m_cs_rows.setSRV(c.m_cols);
+    m_cs_rows.setUAV(c.m_dst);
+    m_cs_rows.dispatch(
+        ceildiv(size.x, 32),
+        ceildiv(size.y, 32));
+}
+
+IDistanceTransformPtr DistanceTransformCS::createContext()
+{
+    return make_ref<DistanceTransform>(this);
+}
+
+
+class Preprocess : public RefCount<IPreprocess>
+{
+public:
+    // same as F_* in Preprocess.hlsl
+    enum class Flag : uint32_t
+    {
+        RGB             = 0x01,
+        Grayscale       = 0x02,
+        Binary          = 0x04,
+        Contour         = 0x08,
+        ContourBinary   = 0x10,
+        FilterRGB       = 0x20,
+        FilterGrayscale = 0x40,
+    };
+    // same as Preprocess.hlsl. contours of larger radii are made by separate filters.
+    static const int MaxHalo = 8;
+
+    Preprocess(PreprocessCS* v);
+    void setSrc(ITexture2DPtr v) override;
+    void setRGB(ITexture2DPtr v) override;
+    void setGrayscale(ITexture2DPtr v) override;
+    void setBinary(ITexture2DPtr v) override;
+    void setContour(ITexture2DPtr v) override;
+    void setContourBinary(ITexture2DPtr v) override;
+    void setColorRange(float2 v) override;
+    void setThreshold(float v) override;
+    void setContourRadius(float v) override;
+    void setDstRegion(Rect v) override;
+    void dispatch() override;
+
+public:
+    PreprocessCS* m_cs{};
+    BufferPtr m_const;
+
+    Texture2DPtr m_src;
+    Texture2DPtr m_rgb;
+    Texture2DPtr m_grayscale;
+    Texture2DPtr m_binary;
+    Texture2DPtr m_contour;
+    Texture2DPtr m_contour_b;
+    float2 m_color_range{ 0.0f, 1.0f };
+    float m_threshold = 0.5f;
+    float m_contour_radius = 1.0f;
+    Rect m_dst_region{};
+    int2 m_dst_tl{}, m_dst_br{};
+    bool m_dirty = true;
+
+    // for radii larger than MaxHalo
+    bool m_fused_contour = true;
+    Rect m_contour_region{};
+    Texture2DPtr m_tmp_grayscale;
+    Texture2DPtr m_tmp_contour;
+    IContourPtr m_contour_filter;
+    IBinarizePtr m_binarize_filter;
+};
+
+Preprocess::Preprocess(PreprocessCS* v) : m_cs(v) {}
+void Preprocess::setSrc(ITexture2DPtr v) { mrCheckDirty(m_src.get() == v.get()); m_src = cast(v); }
+void Preprocess::setRGB(ITexture2DPtr v) { mrCheckDirty(m_rgb.get() == v.get()); m_rgb = cast(v); }
+void Preprocess::setGrayscale(ITexture2DPtr v) { mrCheckDirty(m_grayscale.get() == v.get()); m_grayscale = cast(v); }
+void Preprocess::setBinary(ITexture2DPtr v) { mrCheckDirty(m_binary.get() == v.get()); m_binary = cast(v); }
+void Preprocess::setContour(ITexture2DPtr v) { mrCheckDirty(m_contour.get() == v.get()); m_contour = cast(v); }
+void Preprocess::setContourBinary(ITexture2DPtr v) { mrCheckDirty(m_contour_b.get() == v.get()); m_contour_b = cast(v); }
+void Preprocess::setColorRange(float2 v) { mrCheckDirty(m_color_range == v); m_color_range = v; }
+void Preprocess::setThreshold(float v) { mrCheckDirty(m_threshold == v); m_threshold = v; }
+void Preprocess::setContourRadius(float v) { mrCheckDirty(m_contour_radius == v); m_contour_radius = v; }
+void Preprocess::setDstRegion(Rect v) { mrCheckDirty(m_dst_region == v); m_dst_region = v; }
+
+void Preprocess::dispatch()
+{
+    Texture2D* outputs[] = { m_rgb, m_grayscale, m_binary, m_contour, m_contour_b };
+    auto it = std::find_if(std::begin(outputs), std::end(outputs), [](auto* v) { return v != nullptr; });
+    if (!m_src || it == std::end(outputs)) {
+        mrDbgPrint("*** Preprocess::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    bool need_contour = m_contour || m_contour_b;
+    if (m_dirty) {
+        int2 src_size = m_src->getSize();
+        int2 size = (*it)->getSize();
+        int halo = need_contour ? int(std::ceil(m_contour_radius)) : 0;
+        m_fused_contour = halo <= MaxHalo;
+
+        Rect screen{ {}, size };
+        Rect region = m_dst_region.size.x ? m_dst_region.expand(halo).intersect(screen) : screen;
+        m_contour_region = region;
+        if (!m_fused_contour && m_dst_region.size.x) {
+            // the contour filter needs grayscale around the region
+            region = region.expand(halo).intersect(screen);
+        }
+        // x is aligned to 32 for Binary outputs
+        m_dst_tl = { region.pos.x / 32 * 32, region.pos.y };
+        m_dst_br = { std::min(ceildiv(region.pos.x + region.size.x, 32) * 32, size.x), region.pos.y + region.size.y };
+
+        struct
+        {
+            float2 sample_step;
+            float2 bias;
+            int2 offset;
+            int2 end;
+            int2 dst_size;
+            uint32_t flags;
+            float threshold;
+            int halo;
+            uint32_t rect_count;
+            int2 pad;
+            int2 rects[4];
+        } params{};
+        params.sample_step = (float2(src_size) / float2(src_size)) / float2(size);
+        params.bias = float2{ m_color_range.x, 1.0f / (m_color_range.y - m_color_range.x) };
+        params.offset = m_dst_tl;
+        params.end = m_dst_br;
+        params.dst_size = size;
+        params.threshold = m_threshold;
+        params.halo = m_fused_contour ? halo : 0;
+
+        // rgb is filtered if the size differs, grayscale is filtered only when shrinking. (same as IFilterSet::transform() and grayscale())
+        if (m_rgb)
+            set_flag(params.flags, Flag::RGB, true);
+        if (m_grayscale || (need_contour && !m_fused_contour))
+            set_flag(params.flags, Flag::Grayscale, true);
+        if (m_binary)
+            set_flag(params.flags, Flag::Binary, true);
+        if (m_contour && m_fused_contour)
+            set_flag(params.flags, Flag::Contour, true);
+        if (m_contour_b && m_fused_contour)
+            set_flag(params.flags, Flag::ContourBinary, true);
+        set_flag(params.flags, Flag::FilterRGB, size.x != src_size.x);
+        set_flag(params.flags, Flag::FilterGrayscale, size.x < src_size.x);
+
+        if (need_contour && m_fused_contour) {
+            auto rects = GetDiscRects(m_contour_radius, 4);
+            params.rect_count = (uint32_t)rects.size();
+            std::copy(rects.begin(), rects.end(), params.rects);
+        }
+        m_const = Buffer::createConstant(params);
+
+        if (need_contour && !m_fused_contour) {
+            if (!m_grayscale && (!m_tmp_grayscale || m_tmp_grayscale->getSize() != size))
+                m_tmp_grayscale = Texture2D::create(size.x, size.y, TextureFormat::Ru8);
+            if (!m_contour && (!m_tmp_contour || m_tmp_contour->getSize() != size))
+                m_tmp_contour = Texture2D::create(size.x, size.y, TextureFormat::Ru8);
+            if (!m_contour_filter)
+                m_contour_filter = mrGfxGetCS(ContourCS)->createContext();
+            if (!m_binarize_filter)
+                m_binarize_filter = mrGfxGetCS(BinarizeCS)->createContext();
+        }
+        m_dirty = false;
+    }
+    if (m_dst_tl.x >= m_dst_br.x || m_dst_tl.y >= m_dst_br.y)
+        return;
+
+    m_cs->dispatch(*this);
+
+    if (need_contour && !m_fused_contour) {
+        ITexture2DPtr contour = m_contour ? m_contour : m_tmp_contour;
+        m_contour_filter->setSrc(m_grayscale ? m_grayscale : m_tmp_grayscale);
+        m_contour_filter->setDst(contour);
+        m_contour_filter->setRadius(m_contour_radius);
+        m_contour_filter->setDstRegion(m_contour_region);
+        m_contour_filter->dispatch();
+        if (m_contour_b) {
+            m_binarize_filter->setSrc(contour);
+            m_binarize_filter->setDst(m_contour_b);
+            m_binarize_filter->setThreshold(m_threshold);
+            m_binarize_filter->setDstRegion(m_contour_region);
+            m_binarize_filter->dispatch();
+        }
+    }
+}
+
+PreprocessCS::PreprocessCS()
+{
+    m_cs.initialize(mrBytecode(g_hlsl_Preprocess));
+    m_cs.setSampler(mrGfxPointSampler(), 0);
+    m_cs.setSampler(mrGfxLinearSampler(), 1);
+}
+
+void PreprocessCS::dispatch(ICSContext& ctx)
+{
+    auto& c = static_cast<Preprocess&>(ctx);
+
+    m_cs.setCBuffer(c.m_const);
+    m_cs.setSRV(c.m_src);
+    m_cs.setUAV(c.m_rgb, 0);
+    m_cs.setUAV(c.m_grayscale ? c.m_grayscale : c.m_tmp_grayscale, 1);
+    m_cs.setUAV(c.m_binary, 2);
+    m_cs.setUAV(c.m_contour, 3);
+    m_cs.setUAV(c.m_contour_b, 4);
+
+    auto size = c.m_dst_br - c.m_dst_tl;
+    m_cs.dispatch(
+        ceildiv(size.x, 32),
+        ceildiv(size.y, 32));
+}
+
+IPreprocessPtr PreprocessCS::createContext()
+{
+    return make_ref<Preprocess>(this);
+}
+
+
 class TemplateMatch : public FilterCommon<ITemplateMatch>
 {
 using super = FilterCommon<ITemplateMatch>;
@@ -571,6 +1073,1092 @@ ITemplateMatchPtr TemplateMatchCS::createContext()
 }
 
 
+class TemplateMatchMin : public RefCount<ITemplateMatchMin>
+{
+public:
+    // same layout as TemplateMatchMin_Common.hlsl
+    struct Winner
+    {
+        uint32_t score;
+        uint32_t pos;
+    };
+
+    TemplateMatchMin(TemplateMatchMinCS* v);
+    void setSrc(ITexture2DPtr v) override;
+    void setTemplate(ITexture2DPtr v) override;
+    void setMask(ITexture2DPtr v) override;
+    void setRegion(Rect v) override;
+    void setCutoff(float v) override {} // all positions are computed anyway
+    IReduceMinMax::Result getResult() override;
+    float getPruningRate() override { return 0.0f; }
+    void dispatch() override;
+
+    int2 getSize() const;
+
+public:
+    TemplateMatchMinCS* m_cs{};
+    Texture2DPtr m_src;
+    Texture2DPtr m_template;
+    Texture2DPtr m_mask_image;
+    Texture2DPtr m_mask_template;
+    BufferPtr m_const;
+    BufferPtr m_winners;
+
+    int2 m_src_size{};
+    int2 m_template_size{};
+    Rect m_region{};
+    bool m_dirty = true;
+};
+
+TemplateMatchMin::TemplateMatchMin(TemplateMatchMinCS* v) : m_cs(v) {}
+
+void TemplateMatchMin::setSrc(ITexture2DPtr v)
+{
+    m_src = cast(v);
+    int2 s = v ? v->getSize() : int2{};
+    mrCheckDirty(m_src_size == s);
+    m_src_size = s;
+}
+
+void TemplateMatchMin::setTemplate(ITexture2DPtr v)
+{
+    m_template = cast(v);
+    int2 s = v ? v->getSize() : int2{};
+    mrCheckDirty(m_template_size == s);
+    m_template_size = s;
+}
+
+void TemplateMatchMin::setMask(ITexture2DPtr v)
+{
+    m_mask_template = cast(v);
+}
+
+void TemplateMatchMin::setRegion(Rect v)
+{
+    mrCheckDirty(m_region == v);
+    m_region = v;
+}
+
+int2 TemplateMatchMin::getSize() const
+{
+    return m_region.size.x == 0 ? m_src_size : m_region.size;
+}
+
+IReduceMinMax::Result TemplateMatchMin::getResult()
+{
+    IReduceMinMax::Result ret{};
+    if (!m_winners)
+        return ret;
+
+    m_winners->map([&ret](const void* v) {
+        auto& w = *(const Winner*)v;
+        ret.pos_min = { int(w.pos & 0xffff), int(w.pos >> 16) };
+        ret.vali_min = w.score; // valf_min for float scores
+        });
+    return ret;
+}
+
+void TemplateMatchMin::dispatch()
+{
+    if (!m_src || !m_template) {
+        mrDbgPrint("*** TemplateMatchMin::dispatch(): invaid params ***\n");
+        return;
+    }
+    if (m_src->getFormat() != m_template->getFormat()) {
+        mrDbgPrint("*** TemplateMatchMin::dispatch(): format mismatch ***\n");
+        return;
+    }
+
+    if (m_dirty) {
+        struct
+        {
+            int2 range;
+            int2 tl;
+            int2 br;
+            int2 template_size;
+        } params{};
+
+        params.range = getSize();
+        params.tl = m_region.pos;
+        params.br = params.tl + params.range;
+        params.template_size = m_template_size;
+
+        m_const = Buffer::createConstant(params);
+        m_dirty = false;
+    }
+
+    // one winner for each 32x32 group
+    auto size = getSize();
+    int num_winners = std::max(ceildiv(size.x, 32) * ceildiv(size.y, 32), 1);
+    int wsize = num_winners * sizeof(Winner);
+    if (!m_winners || m_winners->getSize() < wsize)
+        m_winners = Buffer::createStructured(wsize, sizeof(Winner));
+
+    m_cs->dispatch(*this);
+    m_winners->download(sizeof(Winner));
+}
+
+TemplateMatchMinCS::TemplateMatchMinCS()
+{
+    m_cs_grayscale.initialize(mrBytecode(g_hlsl_TemplateMatchMin_Grayscale));
+    m_cs_binary.initialize(mrBytecode(g_hlsl_TemplateMatchMin_Binary));
+    m_cs_rgb.initialize(mrBytecode(g_hlsl_TemplateMatchMin_RGB));
+    m_cs_reduce.initialize(mrBytecode(g_hlsl_TemplateMatchMin_Reduce));
+}
+
+void TemplateMatchMinCS::dispatch(ICSContext& ctx)
+{
+    auto& c = static_cast<TemplateMatchMin&>(ctx);
+
+    auto size = c.getSize();
+    if (size.x <= 0 || size.y <= 0) {
+        mrDbgPrint("*** TemplateMatchMinCS::dispatch(): size <= 0 ***\n");
+        return;
+    }
+
+    ComputeShader* pcs = nullptr;
+    switch (c.m_src->getFormat()) {
+    case TextureFormat::Binary:
+        pcs = &m_cs_binary;
+        break;
+    case TextureFormat::Ru8:
+    case TextureFormat::Rf16:
+    case TextureFormat::Rf32:
+        pcs = &m_cs_grayscale;
+        break;
+    default:
+        pcs = &m_cs_rgb;
+        break;
+    }
+
+    // pass 1: match and write the winner of each group
+    auto& cs = *pcs;
+    cs.setCBuffer(c.m_const, 0);
+    cs.setSRV(c.m_src, 0);
+    cs.setSRV(c.m_template, 1);
+    cs.setSRV(c.m_mask_image, 2);
+    cs.setSRV(c.m_mask_template, 3);
+    cs.setUAV(c.m_winners);
+    cs.dispatch(
+        ceildiv(size.x, 32),
+        ceildiv(size.y, 32));
+
+    // pass 2: reduce the winners to the first element
+    m_cs_reduce.setCBuffer(c.m_const, 0);
+    m_cs_reduce.setUAV(c.m_winners);
+    m_cs_reduce.dispatch(1, 1);
+}
+
+ITemplateMatchMinPtr TemplateMatchMinCS::createContext()
+{
+    return make_ref<TemplateMatchMin>(this);
+}
+
+
+class TemplateMatchMinMulti : public RefCount<ITemplateMatchMinMulti>
+{
+public:
+    using Winner = TemplateMatchMin::Winner;
+
+    // same layout as TemplateMatchMinMulti_Common.hlsl
+    struct Entry
+    {
+        int2 atlas_pos;
+        int2 size;
+        int2 tl;
+        int2 range;
+
+        bool operator==(const Entry& v) const { return atlas_pos == v.atlas_pos && size == v.size && tl == v.tl && range == v.range; }
+    };
+
+    TemplateMatchMinMulti(TemplateMatchMinMultiCS* v);
+    void setSrc(ITexture2DPtr v) override;
+    void addTemplate(ITexture2DPtr tmpl, Rect region, float cutoff) override;
+    void clearTemplates() override;
+    std::vector<IReduceMinMax::Result> getResult() override;
+    void dispatch() override;
+
+    void updateAtlas();
+
+public:
+    TemplateMatchMinMultiCS* m_cs{};
+    Texture2DPtr m_src;
+    std::vector<Texture2DPtr> m_templates;
+    std::vector<Rect> m_regions;
+
+    // templates are copied into the atlas only when they are changed
+    std::vector<Texture2DPtr> m_atlas_templates;
+    std::vector<int2> m_atlas_pos;
+    Texture2DPtr m_atlas;
+
+    std::vector<Entry> m_entries;
+    BufferPtr m_const;
+    BufferPtr m_entry_buffer;
+    BufferPtr m_winners;
+    BufferPtr m_results;
+    int2 m_src_size{};
+    int2 m_range{};
+    int m_group_count{};
+};
+
+TemplateMatchMinMulti::TemplateMatchMinMulti(TemplateMatchMinMultiCS* v) : m_cs(v) {}
+
+void TemplateMatchMinMulti::setSrc(ITexture2DPtr v)
+{
+    m_src = cast(v);
+    m_src_size = v ? v->getSize() : int2{};
+}
+
+void TemplateMatchMinMulti::addTemplate(ITexture2DPtr tmpl, Rect region, float cutoff)
+{
+    // all positions are computed anyway. cutoff is not used.
+    m_templates.push_back(cast(tmpl));
+    m_regions.push_back(region);
+}
+
+void TemplateMatchMinMulti::clearTemplates()
+{
+    m_templates.clear();
+    m_regions.clear();
+}
+
+std::vector<IReduceMinMax::Result> TemplateMatchMinMulti::getResult()
+{
+    std::vector<IReduceMinMax::Result> ret(m_templates.size());
+    if (!m_results || m_entries.size() != m_templates.size())
+        return ret;
+
+    m_results->map([&ret](const void* v) {
+        auto* w = (const Winner*)v;
+        for (size_t i = 0; i < ret.size(); ++i) {
+            ret[i].pos_min = { int(w[i].pos & 0xffff), int(w[i].pos >> 16) };
+            ret[i].vali_min = w[i].score; // valf_min for float scores
+        }
+        });
+    return ret;
+}
+
+void TemplateMatchMinMulti::updateAtlas()
+{
+    static const int AtlasWidth = 1024;
+
+    // shelf packing. taller ones first to waste less space.
+    size_t n = m_templates.size();
+    std::vector<int> order(n);
+    for (size_t i = 0; i < n; ++i)
+        order[i] = int(i);
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return m_templates[a]->getSize().y > m_templates[b]->getSize().y; });
+
+    int width = AtlasWidth;
+    for (auto& t : m_templates)
+        width = std::max(width, t->getSize().x);
+
+    m_atlas_pos.resize(n);
+    int2 cursor{};
+    int shelf_height = 0;
+    for (int i : order) {
+        auto size = m_templates[i]->getSize();
+        if (cursor.x + size.x > width) {
+            cursor = { 0, cursor.y + shelf_height };
+            shelf_height = 0;
+        }
+        m_atlas_pos[i] = cursor;
+        cursor.x += size.x;
+        shelf_height = std::max(shelf_height, size.y);
+    }
+    int height = cursor.y + shelf_height;
+
+    auto format = m_src->getFormat();
+    if (!m_atlas || m_atlas->getFormat() != format || m_atlas->getSize().x < width || m_atlas->getSize().y < height)
+        m_atlas = Texture2D::create(width, height, format);
+    for (size_t i = 0; i < n; ++i)
+        DispatchCopy(m_atlas->ptr(), m_templates[i]->ptr(), m_templates[i]->getSize(), int2::zero(), m_atlas_pos[i]);
+    m_atlas_templates = m_templates;
+}
+
+void TemplateMatchMinMulti::dispatch()
+{
+    if (!m_src || m_templates.empty()) {
+        mrDbgPrint("*** TemplateMatchMinMulti::dispatch(): invaid params ***\n");
+        return;
+    }
+    if (m_src->getFormat() == TextureFormat::Binary) {
+        mrDbgPrint("*** TemplateMatchMinMulti::dispatch(): Binary is not supported ***\n");
+        return;
+    }
+    for (auto& t : m_templates) {
+        if (!t || t->getFormat() != m_src->getFormat()) {
+            mrDbgPrint("*** TemplateMatchMinMulti::dispatch(): format mismatch ***\n");
+            return;
+        }
+    }
+
+    if (m_atlas_templates != m_templates || m_atlas->getFormat() != m_src->getFormat())
+        updateAtlas();
+
+    std::vector<Entry> entries;
+    Rect bounds{};
+    for (size_t i = 0; i < m_templates.size(); ++i) {
+        Rect region{ m_regions[i].pos, m_regions[i].size.x == 0 ? m_src_size : m_regions[i].size };
+        if (region.size.x <= 0 || region.size.y <= 0) {
+            mrDbgPrint("*** TemplateMatchMinMulti::dispatch(): size <= 0 ***\n");
+            return;
+        }
+        entries.push_back({ m_atlas_pos[i], m_templates[i]->getSize(), region.pos, region.size });
+        bounds = bounds.merge(region);
+    }
+
+    if (entries != m_entries) {
+        struct
+        {
+            int2 range;
+            int2 tl;
+            int template_count;
+            int group_count;
+            int2 pad;
+        } params{};
+
+        m_range = bounds.size;
+        m_group_count = ceildiv(m_range.x, 32) * ceildiv(m_range.y, 32);
+        params.range = m_range;
+        params.tl = bounds.pos;
+        params.template_count = (int)entries.size();
+        params.group_count = m_group_count;
+
+        m_const = Buffer::createConstant(params);
+        m_entry_buffer = Buffer::createStructured(int(entries.size() * sizeof(Entry)), sizeof(Entry), entries.data());
+        m_entries = std::move(entries);
+    }
+
+    // one winner for each 32x32 group and template, and one result for each template
+    int n = (int)m_entries.size();
+    int wsize = m_group_count * n * sizeof(Winner);
+    if (!m_winners || m_winners->getSize() < wsize)
+        m_winners = Buffer::createStructured(wsize, sizeof(Winner));
+    int rsize = n * sizeof(Winner);
+    if (!m_results || m_results->getSize() < rsize)
+        m_results = Buffer::createStructured(rsize, sizeof(Winner));
+
+    m_cs->dispatch(*this);
+    m_results->download(rsize);
+}
+
+TemplateMatchMinMultiCS::TemplateMatchMinMultiCS()
+{
+    m_cs_grayscale.initialize(mrBytecode(g_hlsl_TemplateMatchMinMulti_Grayscale));
+    m_cs_rgb.initialize(mrBytecode(g_hlsl_TemplateMatchMinMulti_RGB));
+    m_cs_reduce.initialize(mrBytecode(g_hlsl_TemplateMatchMinMulti_Reduce));
+}
+
+void TemplateMatchMinMultiCS::dispatch(ICSContext& ctx)
+{
+    auto& c = static_cast<TemplateMatchMinMulti&>(ctx);
+
+    ComputeShader* pcs = nullptr;
+    switch (c.m_src->getFormat()) {
+    case TextureFormat::Ru8:
+    case TextureFormat::Rf16:
+    case TextureFormat::Rf32:
+        pcs = &m_cs_grayscale;
+        break;
+    default:
+        pcs = &m_cs_rgb;
+        break;
+    }
+
+    // pass 1: match all templates and write the winner of each group and template
+    auto& cs = *pcs;
+    cs.setCBuffer(c.m_const, 0);
+    cs.setSRV(c.m_src, 0);
+    cs.setSRV(c.m_atlas, 1);
+    cs.setSRV(c.m_entry_buffer, 2);
+    cs.setUAV(c.m_winners);
+    cs.dispatch(
+        ceildiv(c.m_range.x, 32),
+        ceildiv(c.m_range.y, 32));
+
+    // pass 2: reduce the winners of each template
+    m_cs_reduce.setCBuffer(c.m_const, 0);
+    m_cs_reduce.setUAV(c.m_winners, 0);
+    m_cs_reduce.setUAV(c.m_results, 1);
+    m_cs_reduce.dispatch((int)c.m_entries.size());
+}
+
+ITemplateMatchMinMultiPtr TemplateMatchMinMultiCS::createContext()
+{
+    return make_ref<TemplateMatchMinMulti>(this);
+}
+
+
+
+class TemplateMatchFFT : public FilterCommon<ITemplateMatchFFT>
+{
+using super = FilterCommon<ITemplateMatchFFT>;
+public:
+    // same as TemplateMatchFFT_Common.hlsl
+    enum class Mode : uint32_t
+    {
+        RowsChannel0 = 0,
+        RowsSumSq = 3,
+        RowsBox = 4,
+        ColsStore = 0,
+        ColsAccumulate = 1,
+        ColsInverse = 2,
+    };
+    static const uint32_t FlagInit = 1;
+
+    struct Params
+    {
+        int2 origin;
+        int2 fft_size;
+        int2 range;
+        int2 dst_pos;
+        uint32_t mode;
+        float weight;
+        uint32_t offset;
+        uint32_t flags;
+    };
+
+    enum class Shader
+    {
+        Rows,
+        Cols,
+        RowsInv,
+        SumSq,
+    };
+    struct Pass
+    {
+        Shader shader{};
+        BufferPtr params;
+        int groups{};
+    };
+
+    // conjugates of the spectra of each channel and the box of the template size, and the sum of squares of the template
+    struct Spectrum
+    {
+        Texture2DPtr tmpl;
+        int2 fft_size{};
+        BufferPtr planes;
+        BufferPtr sum_sq;
+    };
+
+    TemplateMatchFFT(TemplateMatchFFTCS* v);
+    void setSrc(ITexture2DPtr v) override;
+    void setTemplate(ITexture2DPtr v) override;
+    void setRegion(Rect v) override;
+    void dispatch() override;
+
+    int2 getSize() const;
+    Pass makePass(Shader shader, Params params, int groups) const;
+    Spectrum& getSpectrum();
+
+public:
+    TemplateMatchFFTCS* m_cs{};
+    Texture2DPtr m_template;
+    BufferPtr m_work;
+    BufferPtr m_acc;
+
+    FFTPlan m_plan{};
+    int m_channels = 1;
+    std::vector<Pass> m_passes;
+    std::vector<Pass> m_spectrum_passes; // to make a new spectrum. cleared after dispatch.
+    std::deque<Spectrum> m_spectra; // most recently used first
+    Spectrum* m_spectrum{};
+
+    int2 m_src_size{};
+    TextureFormat m_src_format{};
+    int2 m_template_size{};
+    Rect m_region{};
+    bool m_dirty = true;
+};
+
+TemplateMatchFFT::TemplateMatchFFT(TemplateMatchFFTCS* v) : m_cs(v) {}
+
+void TemplateMatchFFT::setSrc(ITexture2DPtr v)
+{
+    super::setSrc(v);
+    int2 s = v ? v->getSize() : int2{};
+    TextureFormat f = v ? v->getFormat() : TextureFormat::Unknown;
+    mrCheckDirty(m_src_size == s && m_src_format == f);
+    m_src_size = s;
+    m_src_format = f;
+}
+
+void TemplateMatchFFT::setTemplate(ITexture2DPtr v)
+{
+    m_template = cast(v);
+    int2 s = v ? v->getSize() : int2{};
+    mrCheckDirty(m_template_size == s);
+    m_template_size = s;
+}
+
+void TemplateMatchFFT::setRegion(Rect v)
+{
+    mrCheckDirty(m_region == v);
+    m_region = v;
+}
+
+int2 TemplateMatchFFT::getSize() const
+{
+    return m_region.size.x == 0 ? m_src_size : m_region.size;
+}
+
+TemplateMatchFFT::Pass TemplateMatchFFT::makePass(Shader shader, Params params, int groups) const
+{
+    params.fft_size = m_plan.fft_size;
+    params.flags |= uint32_t(m_channels) << 8;
+    return { shader, Buffer::createConstant(params), groups };
+}
+
+TemplateMatchFFT::Spectrum& TemplateMatchFFT::getSpectrum()
+{
+    auto it = std::find_if(m_spectra.begin(), m_spectra.end(), [&](auto& s) { return s.tmpl == m_template && s.fft_size == m_plan.fft_size; });
+    if (it != m_spectra.end()) {
+        if (it != m_spectra.begin()) {
+            auto tmp = std::move(*it);
+            m_spectra.erase(it);
+            m_spectra.push_front(std::move(tmp));
+        }
+        return m_spectra.front();
+    }
+
+    if ((int)m_spectra.size() >= FFTSpectrumCacheSize)
+        m_spectra.pop_back();
+    m_spectra.push_front({ m_template, m_plan.fft_size });
+    auto& ret = m_spectra.front();
+
+    int2 n = m_plan.fft_size;
+    int plane_size = n.y * (n.x / 2 + 1);
+    ret.planes = Buffer::createStructured(plane_size * (m_channels + 1) * sizeof(float2), sizeof(float2));
+    ret.sum_sq = Buffer::createStructured(sizeof(float), sizeof(float));
+
+    m_spectrum_passes.clear();
+    for (int c = 0; c <= m_channels; ++c) {
+        Params rows{};
+        rows.mode = c < m_channels ? uint32_t(Mode::RowsChannel0) + c : uint32_t(Mode::RowsBox);
+        rows.range = m_template_size;
+        m_spectrum_passes.push_back(makePass(Shader::Rows, rows, n.y / 2));
+
+        Params cols{};
+        cols.mode = uint32_t(Mode::ColsStore);
+        cols.offset = plane_size * c;
+        m_spectrum_passes.push_back(makePass(Shader::Cols, cols, n.x / 2 + 1));
+    }
+    Params sum_sq{};
+    sum_sq.range = m_template_size;
+    m_spectrum_passes.push_back(makePass(Shader::SumSq, sum_sq, 1));
+    return ret;
+}
+
+void TemplateMatchFFT::dispatch()
+{
+    if (!m_src || !m_dst || !m_template) {
+        mrDbgPrint("*** TemplateMatchFFT::dispatch(): invaid params ***\n");
+        return;
+    }
+    if (m_src_format != m_template->getFormat() || m_src_format == TextureFormat::Binary) {
+        mrDbgPrint("*** TemplateMatchFFT::dispatch(): format mismatch ***\n");
+        return;
+    }
+
+    if (m_dirty) {
+        m_passes.clear();
+        auto range = getSize();
+        if (!GetFFTPlan(range, m_template_size, m_plan)) {
+            mrDbgPrint("*** TemplateMatchFFT::dispatch(): invalid size ***\n");
+            return;
+        }
+        switch (m_src_format) {
+        case TextureFormat::Ru8:
+        case TextureFormat::Rf16:
+        case TextureFormat::Rf32:
+            m_channels = 1;
+            break;
+        default:
+            m_channels = 3;
+            break;
+        }
+
+        int2 n = m_plan.fft_size;
+        int plane_size = n.y * (n.x / 2 + 1);
+        int wsize = plane_size * sizeof(float2);
+        if (!m_work || m_work->getSize() < wsize) {
+            m_work = Buffer::createStructured(wsize, sizeof(float2));
+            m_acc = Buffer::createStructured(wsize, sizeof(float2));
+        }
+
+        // ssd(p) = sum(t^2) - 2 * sum(s * t) + sum(s^2 over the template window).
+        // the correlations are products of the spectra, and they are accumulated before one inverse transform.
+        for (int ty = 0; ty < m_plan.tiles.y; ++ty) {
+            for (int tx = 0; tx < m_plan.tiles.x; ++tx) {
+                int2 tile_pos = m_plan.tile_range * int2{ tx, ty };
+                for (int c = 0; c <= m_channels; ++c) {
+                    Params rows{};
+                    rows.origin = m_region.pos + tile_pos;
+                    rows.mode = c < m_channels ? uint32_t(Mode::RowsChannel0) + c : uint32_t(Mode::RowsSumSq);
+                    m_passes.push_back(makePass(Shader::Rows, rows, n.y / 2));
+
+                    Params cols{};
+                    cols.mode = uint32_t(Mode::ColsAccumulate);
+                    cols.weight = c < m_channels ? -2.0f : 1.0f;
+                    cols.offset = plane_size * c;
+                    cols.flags = c == 0 ? FlagInit : 0;
+                    m_passes.push_back(makePass(Shader::Cols, cols, n.x / 2 + 1));
+                }
+
+                Params inv{};
+                inv.mode = uint32_t(Mode::ColsInverse);
+                m_passes.push_back(makePass(Shader::Cols, inv, n.x / 2 + 1));
+
+                Params rows_inv{};
+                rows_inv.range = min(m_plan.tile_range, range - tile_pos);
+                rows_inv.dst_pos = tile_pos;
+                m_passes.push_back(makePass(Shader::RowsInv, rows_inv, n.y / 2));
+            }
+        }
+        m_dirty = false;
+    }
+    if (m_passes.empty())
+        return;
+
+    m_spectrum = &getSpectrum();
+    m_cs->dispatch(*this);
+}
+
+TemplateMatchFFTCS::TemplateMatchFFTCS()
+{
+    m_cs_rows.initialize(mrBytecode(g_hlsl_TemplateMatchFFT_Rows));
+    m_cs_cols.initialize(mrBytecode(g_hlsl_TemplateMatchFFT_Cols));
+    m_cs_rows_inv.initialize(mrBytecode(g_hlsl_TemplateMatchFFT_RowsInv));
+    m_cs_sum_sq.initialize(mrBytecode(g_hlsl_TemplateMatchFFT_SumSq));
+}
+
+void TemplateMatchFFTCS::dispatch(ICSContext& ctx)
+{
+    auto& c = static_cast<TemplateMatchFFT&>(ctx);
+    auto& sp = *c.m_spectrum;
+
+    auto run = [&](std::vector<TemplateMatchFFT::Pass>& passes, Texture2D* src) {
+        for (auto& pass : passes) {
+            ComputeShader* pcs = nullptr;
+            switch (pass.shader) {
+            case TemplateMatchFFT::Shader::Rows: pcs = &m_cs_rows; break;
+            case TemplateMatchFFT::Shader::Cols: pcs = &m_cs_cols; break;
+            case TemplateMatchFFT::Shader::RowsInv: pcs = &m_cs_rows_inv; break;
+            default: pcs = &m_cs_sum_sq; break;
+            }
+
+            auto& cs = *pcs;
+            cs.setCBuffer(pass.params);
+            cs.setSRV(src, 0);
+            cs.setUAV(c.m_work, 0);
+            cs.setUAV(c.m_acc, 1);
+            cs.setUAV(sp.planes, 2);
+            cs.setUAV(sp.sum_sq, 3);
+            cs.setUAV(c.m_dst, 4);
+            cs.dispatch(pass.groups, 1);
+        }
+    };
+
+    // make the spectrum of the template if it is new, and then match each tile
+    run(c.m_spectrum_passes, sp.tmpl);
+    c.m_spectrum_passes.clear();
+    run(c.m_passes, c.m_src);
+}
+
+ITemplateMatchFFTPtr TemplateMatchFFTCS::createContext()
+{
+    return make_ref<TemplateMatchFFT>(this);
+}
+
+
+// uploads points of IChamferMatch / IChamferMatchMin as StructuredBuffer<uint2>
+static BufferPtr CreatePointBuffer(const std::vector<int2>& points)
+{
+    // an empty structured buffer can not be made. g_num_points keeps the dummy element unused.
+    static const int2 s_dummy{};
+    auto* data = points.empty() ? &s_dummy : points.data();
+    int n = std::max((int)points.size(), 1);
+    return Buffer::createStructured(n * sizeof(int2), sizeof(int2), data);
+}
+
+struct ChamferParams
+{
+    int2 range;
+    int2 tl;
+    int2 br;
+    int num_points;
+    int pad;
+};
+
+class ChamferMatch : public FilterCommon<IChamferMatch>
+{
+using super = FilterCommon<IChamferMatch>;
+public:
+    ChamferMatch(ChamferMatchCS* v);
+    void setSrc(ITexture2DPtr v) override;
+    void setPoints(std::span<const int2> v) override;
+    void setRegion(Rect v) override;
+    void dispatch() override;
+
+    int2 getSize() const;
+
+public:
+    ChamferMatchCS* m_cs{};
+    BufferPtr m_const;
+    BufferPtr m_points_buffer;
+
+    std::vector<int2> m_points;
+    int2 m_src_size{};
+    Rect m_region{};
+    bool m_dirty = true;
+    bool m_dirty_points = true;
+};
+
+ChamferMatch::ChamferMatch(ChamferMatchCS* v) : m_cs(v) {}
+
+void ChamferMatch::setSrc(ITexture2DPtr v)
+{
+    super::setSrc(v);
+    int2 s = v ? v->getSize() : int2{};
+    mrCheckDirty(m_src_size == s);
+    m_src_size = s;
+}
+
+void ChamferMatch::setPoints(std::span<const int2> v)
+{
+    if (std::equal(v.begin(), v.end(), m_points.begin(), m_points.end()))
+        return;
+    m_points.assign(v.begin(), v.end());
+    m_dirty = m_dirty_points = true;
+}
+
+void ChamferMatch::setRegion(Rect v)
+{
+    mrCheckDirty(m_region == v);
+    m_region = v;
+}
+
+int2 ChamferMatch::getSize() const
+{
+    return m_region.size.x == 0 ? m_src_size : m_region.size;
+}
+
+void ChamferMatch::dispatch()
+{
+    if (!m_src || !m_dst) {
+        mrDbgPrint("*** ChamferMatch::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    if (m_dirty) {
+        ChamferParams params{};
+        params.range = getSize();
+        params.tl = m_region.pos;
+        params.br = params.tl + params.range;
+        params.num_points = (int)m_points.size();
+
+        m_const = Buffer::createConstant(params);
+        m_dirty = false;
+    }
+    if (m_dirty_points) {
+        m_points_buffer = CreatePointBuffer(m_points);
+        m_dirty_points = false;
+    }
+
+    m_cs->dispatch(*this);
+}
+
+ChamferMatchCS::ChamferMatchCS()
+{
+    m_cs.initialize(mrBytecode(g_hlsl_ChamferMatch));
+}
+
+void ChamferMatchCS::dispatch(ICSContext& ctx)
+{
+    auto& c = static_cast<ChamferMatch&>(ctx);
+
+    auto size = c.getSize();
+    m_cs.setCBuffer(c.m_const);
+    m_cs.setSRV(c.m_src, 0);
+    m_cs.setSRV(c.m_points_buffer, 1);
+    m_cs.setUAV(c.m_dst);
+    m_cs.dispatch(
+        ceildiv(size.x, 32),
+        ceildiv(size.y, 32));
+}
+
+IChamferMatchPtr ChamferMatchCS::createContext()
+{
+    return make_ref<ChamferMatch>(this);
+}
+
+
+class ChamferMatchMin : public RefCount<IChamferMatchMin>
+{
+public:
+    using Winner = TemplateMatchMin::Winner;
+
+    ChamferMatchMin(ChamferMatchMinCS* v);
+    void setSrc(ITexture2DPtr v) override;
+    void setPoints(std::span<const int2> v) override;
+    void setRegion(Rect v) override;
+    void setCutoff(float v) override {} // all positions are computed anyway
+    IReduceMinMax::Result getResult() override;
+    void dispatch() override;
+
+    int2 getSize() const;
+
+public:
+    ChamferMatchMinCS* m_cs{};
+    Texture2DPtr m_src;
+    BufferPtr m_const;
+    BufferPtr m_points_buffer;
+    BufferPtr m_winners;
+
+    std::vector<int2> m_points;
+    int2 m_src_size{};
+    Rect m_region{};
+    bool m_dirty = true;
+    bool m_dirty_points = true;
+};
+
+ChamferMatchMin::ChamferMatchMin(ChamferMatchMinCS* v) : m_cs(v) {}
+
+void ChamferMatchMin::setSrc(ITexture2DPtr v)
+{
+    m_src = cast(v);
+    int2 s = v ? v->getSize() : int2{};
+    mrCheckDirty(m_src_size == s);
+    m_src_size = s;
+}
+
+void ChamferMatchMin::setPoints(std::span<const int2> v)
+{
+    if (std::equal(v.begin(), v.end(), m_points.begin(), m_points.end()))
+        return;
+    m_points.assign(v.begin(), v.end());
+    m_dirty = m_dirty_points = true;
+}
+
+void ChamferMatchMin::setRegion(Rect v)
+{
+    mrCheckDirty(m_region == v);
+    m_region = v;
+}
+
+int2 ChamferMatchMin::getSize() const
+{
+    return m_region.size.x == 0 ? m_src_size : m_region.size;
+}
+
+IReduceMinMax::Result ChamferMatchMin::getResult()
+{
+    IReduceMinMax::Result ret{};
+    if (!m_winners)
+        return ret;
+
+    m_winners->map([&ret](const void* v) {
+        auto& w = *(const Winner*)v;
+        ret.pos_min = { int(w.pos & 0xffff), int(w.pos >> 16) };
+        ret.vali_min = w.score; // valf_min for float scores
+        });
+    return ret;
+}
+
+void ChamferMatchMin::dispatch()
+{
+    if (!m_src) {
+        mrDbgPrint("*** ChamferMatchMin::dispatch(): invaid params ***\n");
+        return;
+    }
+
+    if (m_dirty) {
+        ChamferParams params{};
+        params.range = getSize();
+        params.tl = m_region.pos;
+        params.br = params.tl + params.range;
+        params.num_points = (int)m_points.size();
+
+        m_const = Buffer::createConstant(params);
+        m_dirty = false;
+    }
+    if (m_dirty_points) {
+        m_points_buffer = CreatePointBuffer(m_points);
+        m_dirty_points = false;
+    }
+
+    auto size = getSize();
+    int num_winners = std::max(ceildiv(size.x, 32) * ceildiv(size.y, 32), 1);
+    int wsize = num_winners * sizeof(Winner);
+    if (!m_winners || m_winners->getSize() < wsize)
+        m_winners = Buffer::createStructured(wsize, sizeof(Winner));
+
+    m_cs->dispatch(*this);
+    m_winners->download(sizeof(Winner));
+}
+
+ChamferMatchMinCS::ChamferMatchMinCS()
+{
+    m_cs.initialize(mrBytecode(g_hlsl_ChamferMatchMin));
+    m_cs_reduce.initialize(mrBytecode(g_hlsl_TemplateMatchMin_Reduce));
+}
+
+void ChamferMatchMinCS::dispatch(ICSContext& ctx)
+{
+    auto& c = static_cast<ChamferMatchMin&>(ctx);
+
+    auto size = c.getSize();
+    if (size.x <= 0 || size.y <= 0) {
+        mrDbgPrint("*** ChamferMatchMinCS::dispatch(): size <= 0 ***\n");
+        return;
+    }
+
+    // pass 1: match and write the winner of each group
+    m_cs.setCBuffer(c.m_const);
+    m_cs.setSRV(c.m_src, 0);
+    m_cs.setSRV(c.m_points_buffer, 1);
+    m_cs.setUAV(c.m_winners);
+    m_cs.dispatch(
+        ceildiv(size.x, 32),
+        ceildiv(size.y, 32));
+
+    // pass 2: reduce the winners to the first element. the cbuffer starts with g_range as TemplateMatchMin_Reduce.hlsl expects.
+    m_cs_reduce.setCBuffer(c.m_const);
+    m_cs_reduce.setUAV(c.m_winners);
+    m_cs_reduce.dispatch(1, 1);
+}
+
+IChamferMatchMinPtr ChamferMatchMinCS::createContext()
+{
+    return make_ref<ChamferMatchMin>(this);
+}
+
+
+class SparseMatch : public FilterCommon<ISparseMatch>
+{
+using super = FilterCommon<ISparseMatch>;
+public:
+    SparseMatch(SparseMatchCS* v);
+    void setSrc(ITexture2DPtr v) override;
+    void setSamples(std::span<const SparseSample> v) override;
+    void setRegion(Rect v) override;
+    void setCutoff(float v) override;
+    void dispatch() override;
+
+    int2 getSize() const;
+
+public:
+    SparseMatchCS* m_cs{};
+    BufferPtr m_const;
+    BufferPtr m_samples_buffer;
+
+    std::vector<SparseSample> m_samples;
+    int2 m_src_size{};
+    TextureFormat m_src_format{};
+    Rect m_region{};
+    float m_cutoff = -1.0f;
+    bool m_dirty = true;
+    bool m_dirty_samples = true;
+};
+
+SparseMatch::SparseMatch(SparseMatchCS* v) : m_cs(v) {}
+
+void SparseMatch::setSrc(ITexture2DPtr v)
+{
+    super::setSrc(v);
+    int2 s = v ? v->getSize() : int2{};
+    auto f = v ? v->getFormat() : TextureFormat::Unknown;
+    mrCheckDirty(m_src_size == s && m_src_format == f);
+    m_src_size = s;
+    m_src_format = f;
+}
+
+void SparseMatch::setSamples(std::span<const SparseSample> v)
+{
+    auto same = [](const SparseSample& a, const SparseSample& b) { return a.pos == b.pos && a.color == b.color; };
+    if (std::equal(v.begin(), v.end(), m_samples.begin(), m_samples.end(), same))
+        return;
+    m_samples.assign(v.begin(), v.end());
+    m_dirty = m_dirty_samples = true;
+}
+
+void SparseMatch::setRegion(Rect v) { mrCheckDirty(m_region == v); m_region = v; }
+void SparseMatch::setCutoff(float v) { mrCheckDirty(m_cutoff == v); m_cutoff = v; }
+
+int2 SparseMatch::getSize() const
+{
+    return m_region.size.x == 0 ? m_src_size : m_region.size;
+}
+
+void SparseMatch::dispatch()
+{
+    if (!m_src || !m_dst) {
+        mrDbgPrint("*** SparseMatch::dispatch(): invaid params ***\n");
+        return;
+    }
+    if (m_src_format != TextureFormat::Ru8 && m_src_format != TextureFormat::RGBAu8) {
+        mrDbgPrint("*** SparseMatch::dispatch(): src must be Ru8 or RGBAu8 ***\n");
+        return;
+    }
+
+    if (m_dirty) {
+        struct
+        {
+            int2 range;
+            int2 tl;
+            int2 br;
+            int num_samples;
+            float cutoff;
+            int rgb;
+            int3 pad;
+        } params{};
+        params.range = getSize();
+        params.tl = m_region.pos;
+        params.br = params.tl + params.range;
+        params.num_samples = (int)m_samples.size();
+        params.cutoff = m_cutoff;
+        params.rgb = m_src_format == TextureFormat::RGBAu8 ? 1 : 0;
+
+        m_const = Buffer::createConstant(params);
+        m_dirty = false;
+    }
+    if (m_dirty_samples) {
+        // an empty structured buffer can not be made. g_num_samples keeps the dummy element unused.
+        static const SparseSample s_dummy{};
+        auto* data = m_samples.empty() ? &s_dummy : m_samples.data();
+        int n = std::max((int)m_samples.size(), 1);
+        m_samples_buffer = Buffer::createStructured(n * sizeof(SparseSample), sizeof(SparseSample), data);
+        m_dirty_samples = false;
+    }
+
+    m_cs->dispatch(*this);
+}
+
+SparseMatchCS::SparseMatchCS()
+{
+    m_cs.initialize(mrBytecode(g_hlsl_SparseMatch));
+}
+
+void SparseMatchCS::dispatch(ICSContext& ctx)
+{
+    auto& c = static_cast<SparseMatch&>(ctx);
+
+    auto size = c.getSize();
+    m_cs.setCBuffer(c.m_const);
+    m_cs.setSRV(c.m_src, 0);
+    m_cs.setSRV(c.m_samples_buffer, 1);
+    m_cs.setUAV(c.m_dst);
+    m_cs.dispatch(
+        ceildiv(size.x, 32),
+        ceildiv(size.y, 32));
+}
+
+ISparseMatchPtr SparseMatchCS::createContext()
+{
+    return make_ref<SparseMatch>(this);
+}
+
 
 class Shape : public RefCount<IShape>
 {
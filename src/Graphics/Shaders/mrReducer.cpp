@@ -15,6 +15,13 @@
 #include "ReduceMinMax_IPass1.hlsl.h"
 #include "ReduceMinMax_IPass2.hlsl.h"
 
+#include "ReduceTopK_FPass1.hlsl.h"
+#include "ReduceTopK_IPass1.hlsl.h"
+#include "ReduceTopK_Clear.hlsl.h"
+
+#include "ReduceHistogram_Pass1.hlsl.h"
+#include "ReduceHistogram_Clear.hlsl.h"
+
 #define mrBytecode(A) A, std::size(A)
 
 #define mrCheckDirty(...)\
@@ -333,4 +340,212 @@ IReduceMinMaxPtr ReduceMinMaxCS::createContext()
     return make_ref<ReduceMinMax>(this);
 }
 
+
+
+class ReduceTopK : public ReduceCommon<IReduceTopK>
+{
+public:
+    // candidates more than this are dropped in arbitrary order. the threshold should be tight enough.
+    static const int Capacity = 1024;
+
+    ReduceTopK(ReduceTopKCS* v);
+    void setThreshold(float v) override;
+    void setMaxCount(int v) override;
+    void setSuppressionSize(int2 v) override;
+    Result getResult() override;
+    void dispatch() override;
+
+    int2 getClippedSize() const;
+    BufferPtr getParamsBuffer();
+
+public:
+    ReduceTopKCS* m_cs{};
+    float m_threshold = 0.0f;
+    int m_max_count = 32;
+    int2 m_suppression{ 1, 1 };
+    bool m_skipped = false;
+};
+
+ReduceTopK::ReduceTopK(ReduceTopKCS* v) : m_cs(v) {}
+
+void ReduceTopK::setThreshold(float v)
+{
+    mrCheckDirty(m_threshold == v);
+    m_threshold = v;
+}
+
+void ReduceTopK::setMaxCount(int v)
+{
+    m_max_count = v;
+}
+
+void ReduceTopK::setSuppressionSize(int2 v)
+{
+    m_suppression = v;
+}
+
+ReduceTopK::Result ReduceTopK::getResult()
+{
+    Result ret;
+    if (!m_dst || m_skipped)
+        return ret;
+
+    m_dst->map([&ret](const void* v) {
+        auto* data = (const Candidate*)v;
+        uint32_t count = data[0].vali;
+        if (count > Capacity) {
+            mrDbgPrint("*** ReduceTopK::getResult(): too many candidates (%u) ***\n", count);
+            count = Capacity;
+        }
+        ret.assign(data + 1, data + 1 + count);
+        });
+    SelectTopK(ret, !IsIntFormat(m_src->getFormat()), m_max_count, m_suppression);
+    return ret;
+}
+
+int2 ReduceTopK::getClippedSize() const
+{
+    return min(getSize(), m_src->getSize() - m_region.pos);
+}
+
+BufferPtr ReduceTopK::getParamsBuffer()
+{
+    if (m_src && m_dirty) {
+        struct {
+            int2 range;
+            int2 tl;
+            uint32_t threshold;
+            uint32_t capacity;
+            int2 pad;
+        } params{};
+        params.range = getClippedSize();
+        params.tl = m_region.pos;
+        if (IsIntFormat(m_src->getFormat()))
+            params.threshold = (uint32_t)std::min((double)m_threshold, (double)UINT32_MAX);
+        else
+            params.threshold = std::bit_cast<uint32_t>(m_threshold);
+        params.capacity = Capacity;
+
+        m_buf_params = Buffer::createConstant(params);
+        m_dirty = false;
+    }
+    return m_buf_params;
+}
+
+void ReduceTopK::dispatch()
+{
+    if (!m_src)
+        return;
+
+    // nothing can be under a negative threshold on int formats
+    m_skipped = IsIntFormat(m_src->getFormat()) && m_threshold < 0.0f;
+    if (m_skipped)
+        return;
+
+    if (!m_dst)
+        m_dst = Buffer::createStructured(sizeof(Candidate) * (Capacity + 1), sizeof(Candidate));
+
+    m_cs->dispatch(*this);
+    m_dst->download();
+}
+
+ReduceTopKCS::ReduceTopKCS()
+{
+    m_cs_fpass1.initialize(mrBytecode(g_hlsl_ReduceTopK_FPass1));
+    m_cs_ipass1.initialize(mrBytecode(g_hlsl_ReduceTopK_IPass1));
+    m_cs_clear.initialize(mrBytecode(g_hlsl_ReduceTopK_Clear));
+}
+
+void ReduceTopKCS::dispatch(ICSContext& ctx_)
+{
+    auto& ctx = static_cast<ReduceTopK&>(ctx_);
+    auto size = ctx.getClippedSize();
+    if (size.x < 0 || size.y < 0) {
+        mrDbgPrint("*** ReduceTopKCS::dispatch(): size < 0 ***\n");
+        return;
+    }
+
+    m_cs_clear.setUAV(ctx.m_dst);
+    m_cs_clear.dispatch(1, 1);
+
+    auto& pass1 = IsIntFormat(ctx.m_src->getFormat()) ? m_cs_ipass1 : m_cs_fpass1;
+    pass1.setCBuffer(ctx.getParamsBuffer());
+    pass1.setSRV(ctx.m_src);
+    pass1.setUAV(ctx.m_dst);
+    pass1.dispatch(ceildiv(size.x, 8), ceildiv(size.y, 8));
+}
+
+IReduceTopKPtr ReduceTopKCS::createContext()
+{
+    return make_ref<ReduceTopK>(this);
+}
+
+
+
+class ReduceHistogram : public ReduceCommon<IReduceHistogram>
+{
+public:
+    ReduceHistogram(ReduceHistogramCS* v);
+    Result getResult() override;
+    void dispatch() override;
+
+public:
+    ReduceHistogramCS* m_cs{};
+};
+
+ReduceHistogram::ReduceHistogram(ReduceHistogramCS* v) : m_cs(v) {}
+
+ReduceHistogram::Result ReduceHistogram::getResult()
+{
+    Result ret{};
+    if (!m_dst)
+        return ret;
+
+    m_dst->map([&ret](const void* v) {
+        ret = *(Result*)v;
+        });
+    return ret;
+}
+
+void ReduceHistogram::dispatch()
+{
+    if (!m_src)
+        return;
+
+    if (!m_dst)
+        m_dst = Buffer::createStructured(sizeof(Result), sizeof(uint32_t));
+
+    m_cs->dispatch(*this);
+    m_dst->download();
+}
+
+ReduceHistogramCS::ReduceHistogramCS()
+{
+    m_cs_pass1.initialize(mrBytecode(g_hlsl_ReduceHistogram_Pass1));
+    m_cs_clear.initialize(mrBytecode(g_hlsl_ReduceHistogram_Clear));
+}
+
+void ReduceHistogramCS::dispatch(ICSContext& ctx_)
+{
+    auto& ctx = static_cast<ReduceHistogram&>(ctx_);
+    auto size = ctx.getSize();
+    if (size.x < 0 || size.y < 0) {
+        mrDbgPrint("*** ReduceHistogramCS::dispatch(): size < 0 ***\n");
+        return;
+    }
+
+    m_cs_clear.setUAV(ctx.m_dst);
+    m_cs_clear.dispatch(1, 1);
+
+    m_cs_pass1.setCBuffer(ctx.getParamsBuffer());
+    m_cs_pass1.setSRV(ctx.m_src);
+    m_cs_pass1.setUAV(ctx.m_dst);
+    m_cs_pass1.dispatch(ceildiv(size.x, 64), ceildiv(size.y, 64));
+}
+
+IReduceHistogramPtr ReduceHistogramCS::createContext()
+{
+    return make_ref<ReduceHistogram>(this);
+}
+
 } // namespace mr
@@ -19,11 +19,13 @@ public:
     bool isCapturing() const override;
 
     bool getFrameInternal(int timeout_ms);
+    bool getDirtyRects(const DXGI_OUTDUPL_FRAME_INFO& frame_info);
     FrameInfo getFrame() override;
     FrameInfo waitNextFrame() override;
 
 private:
     com_ptr<IDXGIOutputDuplication> m_duplication;
+    std::vector<byte> m_metadata;
 };
 
 
@@ -125,6 +127,9 @@ bool DesktopDuplication::getFrameInternal(int timeout_ms)
                 m_frame_info.surface = Texture2D::create(desc.Width, desc.Height, GetMRFormat(desc.Format));
                 m_frame_info.size = m_frame_info.surface->getSize();
             }
+            // metadata is relative to the last acquired frame. it is valid only if the frame was acquired by us.
+            uint64_t prev_time = m_frame_info.present_time;
+            m_frame_info.prev_present_time = prev_time != 0 && getDirtyRects(frame_info) ? prev_time : 0;
             m_frame_info.present_time = time;
 
             // ReleaseFrame() seems invalidate surface. so, need to dispatch copy at this point.
@@ -144,6 +149,33 @@ bool DesktopDuplication::getFrameInternal(int timeout_ms)
     return ret;
 }
 
+bool DesktopDuplication::getDirtyRects(const DXGI_OUTDUPL_FRAME_INFO& frame_info)
+{
+    auto& rects = m_frame_info.dirty_rects;
+    rects.clear();
+
+    UINT buf_size = frame_info.TotalMetadataBufferSize;
+    if (buf_size == 0)
+        return false;
+    m_metadata.resize(buf_size);
+
+    // destinations of move rects and dirty rects are the changed regions
+    UINT move_size = 0;
+    auto moves = (DXGI_OUTDUPL_MOVE_RECT*)m_metadata.data();
+    if (FAILED(m_duplication->GetFrameMoveRects(buf_size, moves, &move_size)))
+        return false;
+    for (UINT i = 0; i < move_size / sizeof(DXGI_OUTDUPL_MOVE_RECT); ++i)
+        rects.push_back(ToRect(moves[i].DestinationRect));
+
+    UINT dirty_size = 0;
+    auto dirties = (RECT*)m_metadata.data();
+    if (FAILED(m_duplication->GetFrameDirtyRects(buf_size, dirties, &dirty_size)))
+        return false;
+    for (UINT i = 0; i < dirty_size / sizeof(RECT); ++i)
+        rects.push_back(ToRect(dirties[i]));
+    return true;
+}
+
 IScreenCapture::FrameInfo DesktopDuplication::getFrame()
 {
     // AcquireNextFrame() before the first vsync seems result empty frame. so, wait before the first call.
@@ -0,0 +1,415 @@
+#include "pch.h"
+#include "mrInternal.h"
+#include "mrImage.h"
+
+namespace mr {
+
+// frame file layout:
+//   FrameFileHeader
+//   frames: { uint64_t present_time; pixels (height rows of width * texel size, no padding) }
+struct FrameFileHeader
+{
+    char magic[4] = { 'M', 'R', 'F', 'R' };
+    uint32_t version = 1;
+    int2 size{};
+    TextureFormat format{};
+    uint32_t pad{};
+};
+
+static const nanosec DefaultFrameInterval = 16666667; // 60 fps
+
+
+class FileScreenCapture : public RefCount<IFileScreenCapture>
+{
+public:
+    FileScreenCapture(const char* path, const Params& params);
+    ~FileScreenCapture() override;
+    bool valid() const;
+
+    bool startCapture(HWND hwnd) override;
+    bool startCapture(HMONITOR hmon) override;
+    void stopCapture() override;
+    bool isCapturing() const override;
+
+    FrameInfo getFrame() override;
+    FrameInfo waitNextFrame() override;
+    void setOnFrameArrived(const Callback& cb) override;
+
+    int getFrameCount() const override;
+    int2 getFrameSize() const override;
+
+private:
+    bool openDirectory(const std::string& path);
+    bool openFile(const std::string& path);
+    bool start();
+
+    // position is the index of frames counting loops. (position % frame count) is the actual frame.
+    nanosec getTime(int64_t pos) const; // relative to the first frame
+    int64_t getPosition(nanosec time) const;
+    ITexture2DPtr loadFrame(int index);
+    FrameInfo stepTo(int64_t pos);
+
+private:
+    Params m_params;
+    std::vector<std::string> m_files; // PNGs
+    std::ifstream m_file; // frame file
+    size_t m_frame_bytes{};
+    std::vector<nanosec> m_times;
+    nanosec m_period{}; // duration of all frames including the interval of the last frame
+    int2 m_size{};
+    TextureFormat m_format{};
+
+    bool m_capturing{};
+    nanosec m_start_time{};
+    int64_t m_position = -1;
+    FrameInfo m_frame_info;
+    Callback m_callback;
+    std::mutex m_mutex;
+};
+
+
+FileScreenCapture::FileScreenCapture(const char* path, const Params& params)
+    : m_params(params)
+{
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec))
+        openDirectory(path);
+    else
+        openFile(path);
+
+    if (!m_times.empty()) {
+        // present_time 0 means no frame. make sure it is not.
+        if (m_times.front() == 0) {
+            for (auto& t : m_times)
+                ++t;
+        }
+
+        nanosec interval = DefaultFrameInterval;
+        if (m_times.size() > 1)
+            interval = (m_times.back() - m_times.front()) / (m_times.size() - 1);
+        m_period = m_times.back() - m_times.front() + interval;
+    }
+}
+
+FileScreenCapture::~FileScreenCapture()
+{
+    stopCapture();
+}
+
+bool FileScreenCapture::valid() const
+{
+    return !m_times.empty() && m_size.x > 0 && m_size.y > 0;
+}
+
+bool FileScreenCapture::openDirectory(const std::string& path)
+{
+    std::error_code ec;
+    for (auto& entry : std::filesystem::directory_iterator(path, ec)) {
+        auto& p = entry.path();
+        if (entry.is_regular_file(ec) && _stricmp(p.extension().string().c_str(), ".png") == 0)
+            m_files.push_back(p.string());
+    }
+    std::sort(m_files.begin(), m_files.end());
+    if (m_files.empty())
+        return false;
+
+    // take the last number in each file name as the timestamp. use fixed interval if any of them doesn't have it.
+    static const std::regex s_number(R"((\d+)\D*$)");
+    bool has_time = true;
+    for (auto& f : m_files) {
+        std::smatch m;
+        auto stem = std::filesystem::path(f).stem().string();
+        if (std::regex_search(stem, m, s_number)) {
+            m_times.push_back(std::stoull(m[1].str()));
+        }
+        else {
+            has_time = false;
+            break;
+        }
+    }
+    // numbers that are too close are considered sequence numbers, not timestamps
+    if (!has_time || !std::is_sorted(m_times.begin(), m_times.end()) ||
+        (m_times.size() > 1 && (m_times.back() - m_times.front()) / (m_times.size() - 1) < 1000000)) {
+        m_times.resize(m_files.size());
+        for (size_t i = 0; i < m_times.size(); ++i)
+            m_times[i] = DefaultFrameInterval * (i + 1);
+    }
+
+    ReadImageFile(m_files.front().c_str(), [this](int2 size, TextureFormat format, const void*, int) {
+        m_size = size;
+        m_format = format;
+        });
+    return m_size.x > 0;
+}
+
+bool FileScreenCapture::openFile(const std::string& path)
+{
+    m_file.open(path, std::ios::in | std::ios::binary);
+    if (!m_file)
+        return false;
+
+    FrameFileHeader header;
+    FrameFileHeader expected;
+    if (!m_file.read((char*)&header, sizeof(header)) ||
+        memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.version != expected.version) {
+        mrDbgPrint("*** FileScreenCapture: %s is not a frame file ***\n", path.c_str());
+        m_file.close();
+        return false;
+    }
+    m_size = header.size;
+    m_format = header.format;
+    m_frame_bytes = size_t(m_size.x) * m_size.y * GetTexelSize(m_format);
+    if (m_frame_bytes == 0)
+        return false;
+
+    // the number of frames is determined by the file size. an incomplete last frame is ignored.
+    m_file.seekg(0, std::ios::end);
+    size_t file_size = (size_t)m_file.tellg();
+    size_t count = (file_size - sizeof(header)) / (sizeof(uint64_t) + m_frame_bytes);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t time;
+        m_file.seekg(sizeof(header) + (sizeof(uint64_t) + m_frame_bytes) * i);
+        m_file.read((char*)&time, sizeof(time));
+        m_times.push_back(time);
+    }
+    if (!std::is_sorted(m_times.begin(), m_times.end())) {
+        for (size_t i = 0; i < m_times.size(); ++i)
+            m_times[i] = DefaultFrameInterval * (i + 1);
+    }
+    return !m_times.empty();
+}
+
+bool FileScreenCapture::startCapture(HWND hwnd)
+{
+    return start();
+}
+
+bool FileScreenCapture::startCapture(HMONITOR hmon)
+{
+    return start();
+}
+
+bool FileScreenCapture::start()
+{
+    std::unique_lock l(m_mutex);
+    if (!valid())
+        return false;
+
+    m_capturing = true;
+    m_start_time = NowNS();
+    m_position = -1;
+    m_frame_info = {};
+    return true;
+}
+
+void FileScreenCapture::stopCapture()
+{
+    std::unique_lock l(m_mutex);
+    m_capturing = false;
+    m_frame_info = {};
+}
+
+bool FileScreenCapture::isCapturing() const
+{
+    // reaching the last frame ends capturing unless looping
+    return m_capturing && (m_params.loop || m_position < (int64_t)m_times.size() - 1);
+}
+
+nanosec FileScreenCapture::getTime(int64_t pos) const
+{
+    int64_t n = (int64_t)m_times.size();
+    return (m_times[pos % n] - m_times.front()) + m_period * (pos / n);
+}
+
+int64_t FileScreenCapture::getPosition(nanosec time) const
+{
+    int64_t n = (int64_t)m_times.size();
+    int64_t loops = m_params.loop ? int64_t(time / m_period) : 0;
+    nanosec t = m_times.front() + (time - m_period * loops);
+    auto it = std::upper_bound(m_times.begin(), m_times.end(), t);
+    int64_t index = std::max<int64_t>(std::distance(m_times.begin(), it) - 1, 0);
+    return n * loops + index;
+}
+
+ITexture2DPtr FileScreenCapture::loadFrame(int index)
+{
+    auto gfx = GetGfxInterface();
+    ITexture2DPtr ret;
+    if (!m_files.empty()) {
+        ReadImageFile(m_files[index].c_str(), [&](int2 size, TextureFormat format, const void* data, int pitch) {
+            if (size == m_size && format == m_format)
+                ret = gfx->createTexture(size.x, size.y, format, data, pitch);
+            });
+    }
+    else {
+        std::vector<byte> buf(m_frame_bytes);
+        m_file.clear();
+        m_file.seekg(sizeof(FrameFileHeader) + (sizeof(uint64_t) + m_frame_bytes) * index + sizeof(uint64_t));
+        if (m_file.read((char*)buf.data(), buf.size()))
+            ret = gfx->createTexture(m_size.x, m_size.y, m_format, buf.data(), m_size.x * GetTexelSize(m_format));
+    }
+    if (!ret)
+        mrDbgPrint("*** FileScreenCapture: failed to load frame %d ***\n", index);
+    return ret;
+}
+
+IScreenCapture::FrameInfo FileScreenCapture::stepTo(int64_t pos)
+{
+    if (!m_params.loop)
+        pos = std::min(pos, (int64_t)m_times.size() - 1);
+    if (pos == m_position)
+        return m_frame_info;
+
+    auto surface = loadFrame(int(pos % (int64_t)m_times.size()));
+    if (!surface)
+        return m_frame_info;
+
+    m_position = pos;
+    m_frame_info = {};
+    m_frame_info.surface = surface;
+    m_frame_info.size = m_size;
+    m_frame_info.present_time = m_times.front() + getTime(pos);
+    if (m_callback)
+        m_callback(m_frame_info);
+    return m_frame_info;
+}
+
+IScreenCapture::FrameInfo FileScreenCapture::getFrame()
+{
+    std::unique_lock l(m_mutex);
+    if (!m_capturing)
+        return {};
+
+    if (m_params.realtime)
+        return stepTo(getPosition(NowNS() - m_start_time));
+    else
+        return stepTo(m_position + 1);
+}
+
+IScreenCapture::FrameInfo FileScreenCapture::waitNextFrame()
+{
+    std::unique_lock l(m_mutex);
+    if (!m_capturing)
+        return {};
+
+    int64_t next = m_position + 1;
+    if (m_params.realtime) {
+        if (!m_params.loop && next >= (int64_t)m_times.size())
+            return m_frame_info;
+
+        nanosec elapsed = NowNS() - m_start_time;
+        nanosec due = getTime(next);
+        if (due > elapsed)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - elapsed));
+        next = std::max(next, getPosition(NowNS() - m_start_time));
+    }
+    return stepTo(next);
+}
+
+void FileScreenCapture::setOnFrameArrived(const Callback& cb)
+{
+    std::unique_lock l(m_mutex);
+    m_callback = cb;
+}
+
+int FileScreenCapture::getFrameCount() const
+{
+    return (int)m_times.size();
+}
+
+int2 FileScreenCapture::getFrameSize() const
+{
+    return m_size;
+}
+
+mrAPI IFileScreenCapture* CreateFileScreenCapture_(const char* path, const IFileScreenCapture::Params& params)
+{
+    auto ret = new FileScreenCapture(path, params);
+    if (!ret->valid()) {
+        mrDbgPrint("*** CreateFileScreenCapture_(): failed to open %s ***\n", path);
+        delete ret;
+        ret = nullptr;
+    }
+    return ret;
+}
+
+
+class FrameFileWriter : public RefCount<IFrameFileWriter>
+{
+public:
+    FrameFileWriter(const char* path);
+    bool valid() const;
+    bool write(ITexture2DPtr surface, uint64_t present_time) override;
+    int getFrameCount() const override;
+
+private:
+    std::ofstream m_file;
+    FrameFileHeader m_header;
+    int m_frame_count{};
+};
+
+FrameFileWriter::FrameFileWriter(const char* path)
+{
+    m_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+}
+
+bool FrameFileWriter::valid() const
+{
+    return m_file.is_open();
+}
+
+bool FrameFileWriter::write(ITexture2DPtr surface, uint64_t present_time)
+{
+    if (!surface)
+        return false;
+
+    auto size = surface->getSize();
+    auto format = surface->getFormat();
+    int row_bytes = size.x * GetTexelSize(format);
+    if (row_bytes == 0 || format == TextureFormat::Binary)
+        return false;
+
+    if (m_frame_count == 0) {
+        m_header.size = size;
+        m_header.format = format;
+        m_file.write((const char*)&m_header, sizeof(m_header));
+    }
+    else if (size != m_header.size || format != m_header.format) {
+        mrDbgPrint("*** FrameFileWriter::write(): size or format mismatch ***\n");
+        return false;
+    }
+
+    if (present_time == 0)
+        present_time = NowNS();
+
+    bool ret = false;
+    surface->read([&](const void* data, int pitch) {
+        m_file.write((const char*)&present_time, sizeof(present_time));
+        for (int y = 0; y < size.y; ++y)
+            m_file.write((const char*)data + (pitch * y), row_bytes);
+        ret = true;
+        });
+    if (ret && m_file) {
+        ++m_frame_count;
+        return true;
+    }
+    return false;
+}
+
+int FrameFileWriter::getFrameCount() const
+{
+    return m_frame_count;
+}
+
+mrAPI IFrameFileWriter* CreateFrameFileWriter_(const char* path)
+{
+    auto ret = new FrameFileWriter(path);
+    if (!ret->valid()) {
+        delete ret;
+        ret = nullptr;
+    }
+    return ret;
+}
+
+} // namespace mr
@@ -10,18 +10,28 @@ public:
     FilterSet();
 
     void copy(ITexture2DPtr dst, ITexture2DPtr src, Rect src_region) override;
-    void transform(ITexture2DPtr dst, ITexture2DPtr src, bool grayscale, bool filtering, Rect src_region) override;
-    void grayscale(ITexture2DPtr dst, ITexture2DPtr src, float2 range) override;
+    void transform(ITexture2DPtr dst, ITexture2DPtr src, bool grayscale, bool filtering, Rect src_region, Rect dst_region) override;
+    void grayscale(ITexture2DPtr dst, ITexture2DPtr src, float2 range, Rect dst_region) override;
 
     void normalize(ITexture2DPtr dst, ITexture2DPtr src, float denom) override;
-    void binarize(ITexture2DPtr dst, ITexture2DPtr src, float threshold) override;
-    void contour(ITexture2DPtr dst, ITexture2DPtr src, float radius) override;
+    void binarize(ITexture2DPtr dst, ITexture2DPtr src, float threshold, Rect dst_region) override;
+    void contour(ITexture2DPtr dst, ITexture2DPtr src, float radius, Rect dst_region) override;
     void expand(ITexture2DPtr dst, ITexture2DPtr src, float radius) override;
+    void distanceTransform(ITexture2DPtr dst, ITexture2DPtr src, float max_distance, Rect dst_region) override;
+    void preprocess(const PreprocessTargets& dst, ITexture2DPtr src, float2 color_range, float threshold, float contour_radius, Rect dst_region) override;
     void match(ITexture2DPtr dst, ITexture2DPtr src, ITexture2DPtr tmp, ITexture2DPtr mask, Rect region) override;
+    std::future<IReduceMinMax::Result> matchMin(ITexture2DPtr src, ITexture2DPtr tmp, ITexture2DPtr mask, Rect region, float cutoff) override;
+    std::future<std::vector<IReduceMinMax::Result>> matchMinMulti(ITexture2DPtr src, std::span<const MatchMinTarget> targets) override;
+    void matchFFT(ITexture2DPtr dst, ITexture2DPtr src, ITexture2DPtr tmp, Rect region) override;
+    void matchChamfer(ITexture2DPtr dst, ITexture2DPtr src, std::span<const int2> points, Rect region) override;
+    std::future<IReduceMinMax::Result> matchChamferMin(ITexture2DPtr src, std::span<const int2> points, Rect region, float cutoff) override;
+    void matchSparse(ITexture2DPtr dst, ITexture2DPtr src, std::span<const SparseSample> samples, Rect region, float cutoff) override;
 
     std::future<IReduceTotal::Result> total(ITexture2DPtr src, Rect region) override;
     std::future<IReduceCountBits::Result> countBits(ITexture2DPtr src, Rect region) override;
     std::future<IReduceMinMax::Result> minmax(ITexture2DPtr src, Rect region) override;
+    std::future<IReduceTopK::Result> topK(ITexture2DPtr src, float threshold, int max_count, int2 suppression, Rect region) override;
+    std::future<IReduceHistogram::Result> histogram(ITexture2DPtr src, Rect region) override;
 
 public:
     IGfxInterfacePtr m_gfx;
@@ -33,11 +43,21 @@ public:
     IBinarizePtr m_binarize;
     IContourPtr m_contour;
     IExpandPtr m_expand;
+    IDistanceTransformPtr m_distance_transform;
+    IPreprocessPtr m_preprocess;
     ITemplateMatchPtr m_match;
+    std::vector<ITemplateMatchMinPtr> m_match_min; // pooled as results may be pending
+    std::vector<ITemplateMatchMinMultiPtr> m_match_min_multi; // pooled as results may be pending
+    ITemplateMatchFFTPtr m_match_fft;
+    IChamferMatchPtr m_chamfer_match;
+    std::vector<IChamferMatchMinPtr> m_chamfer_match_min; // pooled as results may be pending
+    ISparseMatchPtr m_sparse_match;
 
     IReduceTotalPtr m_total;
     IReduceCountBitsPtr m_count_bits;
     IReduceMinMaxPtr m_minmax;
+    std::vector<IReduceTopKPtr> m_top_k; // pooled as results may be pending
+    IReduceHistogramPtr m_histogram;
 };
 mrDeclPtr(FilterSet);
 
@@ -46,6 +66,40 @@ mrAPI IFilterSet* CreateFilterSet_()
     return new FilterSet();
 }
 
+mrAPI float GetOtsuThreshold(const IReduceHistogram::Result& hist)
+{
+    double total = 0.0, sum = 0.0;
+    for (int i = 0; i < 256; ++i) {
+        total += hist[i];
+        sum += double(i) * hist[i];
+    }
+
+    // class 0 is bins [0, t] and class 1 is bins (t, 255]. between-class variance is w0 * w1 * (mean0 - mean1)^2.
+    // empty bins between the classes give the same variance, and the middle of them is taken.
+    double w0 = 0.0, sum0 = 0.0, best = 0.0;
+    int first = -1, last = -1;
+    for (int t = 0; t < 255; ++t) {
+        w0 += hist[t];
+        sum0 += double(t) * hist[t];
+        double w1 = total - w0;
+        if (w0 == 0.0 || w1 == 0.0)
+            continue;
+
+        double d = sum0 / w0 - (sum - sum0) / w1;
+        double v = w0 * w1 * d * d;
+        if (v > best) {
+            best = v;
+            first = last = t;
+        }
+        else if (v == best && last == t - 1) {
+            last = t;
+        }
+    }
+    if (first < 0)
+        return 0.5f;
+    return (float(first + last) * 0.5f + 0.5f) / 255.0f;
+}
+
 FilterSet::FilterSet()
     : m_gfx(GetGfxInterface())
 {
@@ -65,22 +119,24 @@ void FilterSet::copy(ITexture2DPtr dst, ITexture2DPtr src, Rect src_region)
     filter->dispatch();
 }
 
-void FilterSet::transform(ITexture2DPtr dst, ITexture2DPtr src, bool grayscale, bool filtering, Rect src_region)
+void FilterSet::transform(ITexture2DPtr dst, ITexture2DPtr src, bool grayscale, bool filtering, Rect src_region, Rect dst_region)
 {
     mrMakeFilter(m_transform, Transform);
     filter->setDst(dst);
     filter->setSrc(src);
     filter->setSrcRegion(src_region);
+    filter->setDstRegion(dst_region);
     filter->setGrayscale(grayscale);
     filter->setFiltering(filtering);
     filter->dispatch();
 }
 
-void FilterSet::grayscale(ITexture2DPtr dst, ITexture2DPtr src, float2 range)
+void FilterSet::grayscale(ITexture2DPtr dst, ITexture2DPtr src, float2 range, Rect dst_region)
 {
     mrMakeFilter(m_grayscale, Transform);
     filter->setDst(dst);
     filter->setSrc(src);
+    filter->setDstRegion(dst_region);
     filter->setColorRange(range);
     filter->setGrayscale(true);
     if (src && dst)
@@ -97,21 +153,23 @@ void FilterSet::normalize(ITexture2DPtr dst, ITexture2DPtr src, float denom)
     filter->dispatch();
 }
 
-void FilterSet::binarize(ITexture2DPtr dst, ITexture2DPtr src, float threshold)
+void FilterSet::binarize(ITexture2DPtr dst, ITexture2DPtr src, float threshold, Rect dst_region)
 {
     mrMakeFilter(m_binarize, Binarize);
     filter->setDst(dst);
     filter->setSrc(src);
     filter->setThreshold(threshold);
+    filter->setDstRegion(dst_region);
     filter->dispatch();
 }
 
-void FilterSet::contour(ITexture2DPtr dst, ITexture2DPtr src, float radius)
+void FilterSet::contour(ITexture2DPtr dst, ITexture2DPtr src, float radius, Rect dst_region)
 {
     mrMakeFilter(m_contour, Contour);
     filter->setDst(dst);
     filter->setSrc(src);
     filter->setRadius(radius);
+    filter->setDstRegion(dst_region);
     filter->dispatch();
 }
 
@@ -124,6 +182,32 @@ void FilterSet::expand(ITexture2DPtr dst, ITexture2DPtr src, float radius)
     filter->dispatch();
 }
 
+void FilterSet::distanceTransform(ITexture2DPtr dst, ITexture2DPtr src, float max_distance, Rect dst_region)
+{
+    mrMakeFilter(m_distance_transform, DistanceTransform);
+    filter->setDst(dst);
+    filter->setSrc(src);
+    filter->setMaxDistance(max_distance);
+    filter->setDstRegion(dst_region);
+    filter->dispatch();
+}
+
+void FilterSet::preprocess(const PreprocessTargets& dst, ITexture2DPtr src, float2 color_range, float threshold, float contour_radius, Rect dst_region)
+{
+    mrMakeFilter(m_preprocess, Preprocess);
+    filter->setSrc(src);
+    filter->setRGB(dst.rgb);
+    filter->setGrayscale(dst.grayscale);
+    filter->setBinary(dst.binary);
+    filter->setContour(dst.contour);
+    filter->setContourBinary(dst.contour_b);
+    filter->setColorRange(color_range);
+    filter->setThreshold(threshold);
+    filter->setContourRadius(contour_radius);
+    filter->setDstRegion(dst_region);
+    filter->dispatch();
+}
+
 void FilterSet::match(ITexture2DPtr dst, ITexture2DPtr src, ITexture2DPtr tmp, ITexture2DPtr mask, Rect region)
 {
     mrMakeFilter(m_match, TemplateMatch);
@@ -135,6 +219,107 @@ void FilterSet::match(ITexture2DPtr dst, ITexture2DPtr src, ITexture2DPtr tmp, I
     filter->dispatch();
 }
 
+std::future<IReduceMinMax::Result> FilterSet::matchMin(ITexture2DPtr src, ITexture2DPtr tmp, ITexture2DPtr mask, Rect region, float cutoff)
+{
+    ITemplateMatchMinPtr filter;
+    if (!m_match_min.empty()) {
+        filter = m_match_min.back();
+        m_match_min.pop_back();
+    }
+    else {
+        filter = m_gfx->createTemplateMatchMin();
+    }
+    filter->setSrc(src);
+    filter->setTemplate(tmp);
+    filter->setMask(mask);
+    filter->setRegion(region);
+    filter->setCutoff(cutoff);
+    filter->dispatch();
+    return std::async(std::launch::deferred,
+        [this, filter]() mutable {
+            auto ret = filter->getResult();
+            m_match_min.push_back(filter);
+            return ret;
+        });
+}
+
+std::future<std::vector<IReduceMinMax::Result>> FilterSet::matchMinMulti(ITexture2DPtr src, std::span<const MatchMinTarget> targets)
+{
+    ITemplateMatchMinMultiPtr filter;
+    if (!m_match_min_multi.empty()) {
+        filter = m_match_min_multi.back();
+        m_match_min_multi.pop_back();
+    }
+    else {
+        filter = m_gfx->createTemplateMatchMinMulti();
+    }
+    filter->setSrc(src);
+    filter->clearTemplates();
+    for (auto& t : targets)
+        filter->addTemplate(t.tmpl, t.region, t.cutoff);
+    filter->dispatch();
+    return std::async(std::launch::deferred,
+        [this, filter]() mutable {
+            auto ret = filter->getResult();
+            m_match_min_multi.push_back(filter);
+            return ret;
+        });
+}
+
+void FilterSet::matchFFT(ITexture2DPtr dst, ITexture2DPtr src, ITexture2DPtr tmp, Rect region)
+{
+    mrMakeFilter(m_match_fft, TemplateMatchFFT);
+    filter->setDst(dst);
+    filter->setSrc(src);
+    filter->setTemplate(tmp);
+    filter->setRegion(region);
+    filter->dispatch();
+}
+
+void FilterSet::matchChamfer(ITexture2DPtr dst, ITexture2DPtr src, std::span<const int2> points, Rect region)
+{
+    mrMakeFilter(m_chamfer_match, ChamferMatch);
+    filter->setDst(dst);
+    filter->setSrc(src);
+    filter->setPoints(points);
+    filter->setRegion(region);
+    filter->dispatch();
+}
+
+std::future<IReduceMinMax::Result> FilterSet::matchChamferMin(ITexture2DPtr src, std::span<const int2> points, Rect region, float cutoff)
+{
+    IChamferMatchMinPtr filter;
+    if (!m_chamfer_match_min.empty()) {
+        filter = m_chamfer_match_min.back();
+        m_chamfer_match_min.pop_back();
+    }
+    else {
+        filter = m_gfx->createChamferMatchMin();
+    }
+    filter->setSrc(src);
+    filter->setPoints(points);
+    filter->setRegion(region);
+    filter->setCutoff(cutoff);
+    filter->dispatch();
+    return std::async(std::launch::deferred,
+        [this, filter]() mutable {
+            auto ret = filter->getResult();
+            m_chamfer_match_min.push_back(filter);
+            return ret;
+        });
+}
+
+void FilterSet::matchSparse(ITexture2DPtr dst, ITexture2DPtr src, std::span<const SparseSample> samples, Rect region, float cutoff)
+{
+    mrMakeFilter(m_sparse_match, SparseMatch);
+    filter->setDst(dst);
+    filter->setSrc(src);
+    filter->setSamples(samples);
+    filter->setRegion(region);
+    filter->setCutoff(cutoff);
+    filter->dispatch();
+}
+
 
 std::future<IReduceTotal::Result> FilterSet::total(ITexture2DPtr src, Rect region)
 {
@@ -166,4 +351,38 @@ std::future<IReduceMinMax::Result> FilterSet::minmax(ITexture2DPtr src, Rect reg
         [filter]() mutable { return filter->getResult(); });
 }
 
+std::future<IReduceTopK::Result> FilterSet::topK(ITexture2DPtr src, float threshold, int max_count, int2 suppression, Rect region)
+{
+    IReduceTopKPtr filter;
+    if (!m_top_k.empty()) {
+        filter = m_top_k.back();
+        m_top_k.pop_back();
+    }
+    else {
+        filter = m_gfx->createReduceTopK();
+    }
+    filter->setSrc(src);
+    filter->setRegion(region);
+    filter->setThreshold(threshold);
+    filter->setMaxCount(max_count);
+    filter->setSuppressionSize(suppression);
+    filter->dispatch();
+    return std::async(std::launch::deferred,
+        [this, filter]() mutable {
+            auto ret = filter->getResult();
+            m_top_k.push_back(filter);
+            return ret;
+        });
+}
+
+std::future<IReduceHistogram::Result> FilterSet::histogram(ITexture2DPtr src, Rect region)
+{
+    mrMakeFilter(m_histogram, ReduceHistogram);
+    filter->setSrc(src);
+    filter->setRegion(region);
+    filter->dispatch();
+    return std::async(std::launch::deferred,
+        [filter]() mutable { return filter->getResult(); });
+}
+
 } // namespace mr
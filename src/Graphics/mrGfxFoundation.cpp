@@ -2,11 +2,6 @@
 #include "mrGfxFoundation.h"
 #include "mrShader.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image.h>
-#include <stb_image_write.h>
-
 #pragma comment(lib, "d3d11.lib")
 
 namespace mr {
@@ -320,35 +315,9 @@ Texture2DPtr Texture2D::create(uint32_t w, uint32_t h, TextureFormat format, con
 Texture2DPtr Texture2D::create(const char* path)
 {
     Texture2DPtr ret;
-
-    int w, h, ch;
-    byte* data = stbi_load(path, &w, &h, &ch, 0);
-    if (data) {
-        if (ch == 1) {
-            ret = create(w, h, TextureFormat::Ru8, data, w * 1);
-        }
-        else if (ch == 4) {
-            ret = create(w, h, TextureFormat::RGBAu8, data, w * 4);
-        }
-        else if (ch == 3) {
-            std::vector<byte> tmp(w * h * 4);
-            for (int i = 0; i < h; ++i) {
-                auto s = data + (w * 3 * i);
-                auto d = tmp.data() + (w * 4 * i);
-                for (int j = 0; j < w; ++j) {
-                    d[0] = s[0];
-                    d[1] = s[1];
-                    d[2] = s[2];
-                    d[3] = 255;
-                    s += 3;
-                    d += 4;
-                }
-            }
-            ret = create(w, h, TextureFormat::RGBAu8, tmp.data(), w * 4);
-        }
-
-        stbi_image_free(data);
-    }
+    ReadImageFile(path, [&ret](int2 size, TextureFormat format, const void* data, int pitch) {
+        ret = create(size.x, size.y, format, data, pitch);
+        });
     return ret;
 }
 
@@ -421,42 +390,7 @@ bool Texture2D::read(const ReadCallback& callback)
 
 bool Texture2D::saveImpl(const std::string& path, int2 size, TextureFormat format, const void* data, int pitch)
 {
-    bool ret = false;
-    if (format == TextureFormat::RGBAu8) {
-        ret = stbi_write_png(path.c_str(), size.x, size.y, 4, data, pitch);
-    }
-    else if (format == TextureFormat::Ru8) {
-        ret = stbi_write_png(path.c_str(), size.x, size.y, 1, data, pitch);
-    }
-    else if (format == TextureFormat::Rf32) {
-        std::vector<byte> buf(size.x * size.y);
-        for (int i = 0; i < size.y; ++i) {
-            auto s = (const float*)((const byte*)data + (pitch * i));
-            auto d = buf.data() + (size.x * i);
-            for (int j = 0; j < size.x; ++j) {
-                *d++ = byte(*s++ * 255.0f);
-            }
-        }
-        ret = stbi_write_png(path.c_str(), size.x, size.y, 1, buf.data(), size.x);
-    }
-    else if (format == TextureFormat::Binary) {
-        // binary to gray scale
-        std::vector<byte> buf(size.x * size.y);
-        for (int i = 0; i < size.y; ++i) {
-            auto s = (const uint32_t*)((const byte*)data + (pitch * i));
-            auto d = buf.data() + (size.x * i);
-            for (int j = 0; j < size.x; ++j) {
-                int pi = j / 32;
-                int bi = j % 32;
-                *d++ = (s[pi] & (1 << bi)) ? 0xff : 0;
-            }
-        }
-        ret = stbi_write_png(path.c_str(), size.x, size.y, 1, buf.data(), size.x);
-    }
-    else {
-        mrDbgPrint("Texture2D::save(): unknown format\n");
-    }
-    return ret;
+    return WriteImageFile(path, size, format, data, pitch);
 }
 
 bool Texture2D::save(const std::string& path)
@@ -606,11 +540,6 @@ DXGI_FORMAT GetDXFormat(TextureFormat f)
     }
 }
 
-bool IsIntFormat(TextureFormat f)
-{
-    return f == mr::TextureFormat::Ri32 || f == mr::TextureFormat::Binary;
-}
-
 void DispatchCopy(ID3D11Resource* dst, ID3D11Resource* src)
 {
     if (!dst || !src)
@@ -684,46 +613,4 @@ bool MapRead(ID3D11Texture2D* src, const std::function<void(const void* data, in
     return false;
 }
 
-mrAPI bool SaveAsPNG(const char* path, int w, int h, PixelFormat format, const void* data, int pitch, bool flip_y)
-{
-    if (!path || !data)
-        return false;
-
-    if (pitch == 0) {
-        switch (format) {
-        case PixelFormat::Ru8: pitch = w * 1; break;
-        case PixelFormat::BGRAu8: pitch = w * 4; break;
-        case PixelFormat::RGBAu8: pitch = w * 4; break;
-        default: break;
-        }
-    }
-
-    if (format == PixelFormat::Ru8) {
-        return stbi_write_png(path, w, h, 1, data, pitch);
-    }
-    else if (format == PixelFormat::BGRAu8) {
-        std::vector<byte> buf(w * h * 4);
-        int dst_pitch = w * 4;
-
-        auto src = (const byte*)data;
-        for (int i = 0; i < h; ++i) {
-            auto s = src + (flip_y ? (pitch * (h - i - 1)) : (pitch * i));
-            auto d = buf.data() + (dst_pitch * i);
-            for (int j = 0; j < w; ++j) {
-                d[0] = s[2];
-                d[1] = s[1];
-                d[2] = s[0];
-                d[3] = s[3];
-                s += 4;
-                d += 4;
-            }
-        }
-        return stbi_write_png(path, w, h, 4, buf.data(), dst_pitch);
-    }
-    else if (format == PixelFormat::RGBAu8) {
-        return stbi_write_png(path, w, h, 4, data, pitch);
-    }
-    return false;
-}
-
 } // namespace mr
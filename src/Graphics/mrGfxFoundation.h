@@ -3,6 +3,7 @@
 #include <winrt/Windows.Foundation.h>
 #include <d3d11.h>
 #include "mrInternal.h"
+#include "mrImage.h"
 using winrt::com_ptr;
 
 #define mrCheck16(T) static_assert(sizeof(T) % 16 == 0)
@@ -233,7 +234,6 @@ public:
 
 TextureFormat GetMRFormat(DXGI_FORMAT f);
 DXGI_FORMAT GetDXFormat(TextureFormat f);
-bool IsIntFormat(TextureFormat f);
 
 void DispatchCopy(ID3D11Resource* dst, ID3D11Resource* src);
 void DispatchCopy(ID3D11Resource* dst, ID3D11Resource* src, int size, int src_offset = 0, int dst_offset = 0);
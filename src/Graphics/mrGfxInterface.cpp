@@ -2,6 +2,7 @@
 #include "mrInternal.h"
 #include "mrShader.h"
 #include "mrScreenCapture.h"
+#include "CPU/mrCPUFoundation.h"
 
 namespace mr {
 
@@ -18,6 +19,7 @@ mrEachCS(Body)
 
     void flush() override;
     void sync(int timeout_ms) override;
+    bool supportsConcurrentDispatch() const override;
 
     void lock() override;
     void unlock() override;
@@ -61,6 +63,11 @@ void GfxInterface::sync(int timeout_ms)
     mrGfxGlobals()->sync(timeout_ms);
 }
 
+bool GfxInterface::supportsConcurrentDispatch() const
+{
+    return false;
+}
+
 void GfxInterface::lock()
 {
     mrGfxGlobals()->lock();
@@ -73,11 +80,42 @@ void GfxInterface::unlock()
 
 
 static IGfxInterfacePtr g_gfx_ifs;
+static GfxBackend g_gfx_backend = GfxBackend::Auto;
+
+mrAPI void SetGfxBackend(GfxBackend v)
+{
+    if (g_gfx_backend == v)
+        return;
+    g_gfx_backend = v;
+    g_gfx_ifs = nullptr;
+}
+
+mrAPI GfxBackend GetGfxBackend()
+{
+    return g_gfx_backend;
+}
+
+mrAPI IGfxInterface* CreateGfxInterface_(GfxBackend backend)
+{
+    if (backend == GfxBackend::Auto)
+        backend = mrGfxGlobals()->valid() ? GfxBackend::D3D11 : GfxBackend::CPU;
+
+    if (backend == GfxBackend::D3D11) {
+        if (!mrGfxGlobals()->valid()) {
+            mrDbgPrint("*** CreateGfxInterface_(): D3D11 is not available ***\n");
+            return nullptr;
+        }
+        return new GfxInterface();
+    }
+    else {
+        return CreateCPUGfxInterface_();
+    }
+}
 
 mrAPI IGfxInterface* GetGfxInterface_()
 {
     if (!g_gfx_ifs) {
-        g_gfx_ifs = make_ref<GfxInterface>();
+        g_gfx_ifs = CreateGfxInterface_(g_gfx_backend);
         AddFinalizeHandler([]() { g_gfx_ifs = nullptr; });
     }
     return g_gfx_ifs;
@@ -0,0 +1,256 @@
+#include "pch.h"
+#include "mrImage.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+namespace mr {
+
+int GetTexelSize(TextureFormat f)
+{
+    switch (f) {
+    case TextureFormat::Ru8: return 1;
+    case TextureFormat::RGBAu8: return 4;
+    case TextureFormat::BGRAu8: return 4;
+    case TextureFormat::Rf16: return 2;
+    case TextureFormat::RGBAf16: return 8;
+    case TextureFormat::Rf32: return 4;
+    case TextureFormat::RGBAf32: return 16;
+    case TextureFormat::Ri32: return 4;
+    case TextureFormat::Binary: return 4;
+    default: return 0;
+    }
+}
+
+bool IsIntFormat(TextureFormat f)
+{
+    return f == mr::TextureFormat::Ri32 || f == mr::TextureFormat::Binary;
+}
+
+bool GetTexelRegion(int2 size, TextureFormat f, Rect region, int2& tl, int2& br)
+{
+    if (region.size == int2::zero())
+        region = { {}, size };
+
+    tl = max(region.pos, int2::zero());
+    br = min(region.pos + region.size, size);
+    if (f == TextureFormat::Binary) {
+        tl.x /= 32;
+        br.x = ceildiv(br.x, 32);
+    }
+    return tl.x < br.x && tl.y < br.y;
+}
+
+void SelectTopK(IReduceTopK::Result& candidates, bool is_float, int max_count, int2 suppression)
+{
+    auto less = [is_float](const IReduceTopK::Candidate& a, const IReduceTopK::Candidate& b) {
+        if (is_float ? a.valf != b.valf : a.vali != b.vali)
+            return is_float ? a.valf < b.valf : a.vali < b.vali;
+        return a.pos.y != b.pos.y ? a.pos.y < b.pos.y : a.pos.x < b.pos.x;
+    };
+    std::sort(candidates.begin(), candidates.end(), less);
+
+    // greedy non-maximum suppression. the best one always survives.
+    IReduceTopK::Result ret;
+    for (auto& c : candidates) {
+        if ((int)ret.size() >= max_count)
+            break;
+        bool overlapped = std::any_of(ret.begin(), ret.end(), [&](auto& r) {
+            return std::abs(r.pos.x - c.pos.x) < suppression.x && std::abs(r.pos.y - c.pos.y) < suppression.y;
+            });
+        if (!overlapped)
+            ret.push_back(c);
+    }
+    candidates = std::move(ret);
+}
+
+std::vector<int> GetDiscRowWidths(float radius)
+{
+    std::vector<int> ret;
+    int r = std::max(int(radius), 0);
+    for (int i = 0; i <= r; ++i) {
+        int w = -1;
+        while (w < r && length(float2{ float(w + 1), float(i) }) <= radius)
+            ++w;
+        if (w < 0)
+            break;
+        ret.push_back(w);
+    }
+    if (ret.empty())
+        ret.push_back(0);
+    return ret;
+}
+
+std::vector<int2> GetDiscRects(float radius, int max_rects)
+{
+    // a rectangle for each row where the width shrinks
+    auto widths = GetDiscRowWidths(radius);
+    std::vector<int2> corners;
+    for (int i = 0; i < (int)widths.size(); ++i) {
+        if (i + 1 == (int)widths.size() || widths[i + 1] != widths[i])
+            corners.push_back({ widths[i], i });
+    }
+    max_rects = std::max(max_rects, 2);
+    if ((int)corners.size() <= max_rects)
+        return corners;
+
+    // too many. pick evenly including the widest and the tallest ones.
+    std::vector<int2> ret;
+    int n = (int)corners.size() - 1;
+    for (int i = 0; i < max_rects; ++i)
+        ret.push_back(corners[(n * i + (max_rects - 1) / 2) / (max_rects - 1)]);
+    return ret;
+}
+
+bool GetFFTPlan(int2 range, int2 template_size, FFTPlan& dst)
+{
+    if (range.x <= 0 || range.y <= 0 || template_size.x <= 0 || template_size.y <= 0)
+        return false;
+
+    // one tile if the whole area fits. otherwise tiles of the max size, which overlap by the template size - 1.
+    for (int i = 0; i < 2; ++i) {
+        int n = std::max((int)std::bit_ceil(uint32_t(range[i] + template_size[i] - 1)), 2);
+        if (n > MaxFFTSize) {
+            if (template_size[i] > MaxFFTSize / 2)
+                return false;
+            n = MaxFFTSize;
+        }
+        dst.fft_size[i] = n;
+        dst.tile_range[i] = std::min(n - template_size[i] + 1, range[i]);
+        dst.tiles[i] = ceildiv(range[i], dst.tile_range[i]);
+    }
+    return true;
+}
+
+double GetFFTMatchCost(const FFTPlan& plan, int channels)
+{
+    // forward transforms of each channel and the sum of squares, and an inverse transform. a real FFT of n points is
+    // n / 4 * log2(n) butterflies, and a butterfly is about as heavy as 4 pixels of direct matching.
+    double n = double(plan.fft_size.x) * double(plan.fft_size.y);
+    double tiles = double(plan.tiles.x) * double(plan.tiles.y);
+    return tiles * double(channels + 2) * n * std::log2(n);
+}
+
+bool ReadImageFile(const char* path, const ImageCallback& callback)
+{
+    bool ret = false;
+
+    int w, h, ch;
+    byte* data = stbi_load(path, &w, &h, &ch, 0);
+    if (data) {
+        if (ch == 1) {
+            callback({ w, h }, TextureFormat::Ru8, data, w * 1);
+            ret = true;
+        }
+        else if (ch == 4) {
+            callback({ w, h }, TextureFormat::RGBAu8, data, w * 4);
+            ret = true;
+        }
+        else if (ch == 3) {
+            std::vector<byte> tmp(w * h * 4);
+            for (int i = 0; i < h; ++i) {
+                auto s = data + (w * 3 * i);
+                auto d = tmp.data() + (w * 4 * i);
+                for (int j = 0; j < w; ++j) {
+                    d[0] = s[0];
+                    d[1] = s[1];
+                    d[2] = s[2];
+                    d[3] = 255;
+                    s += 3;
+                    d += 4;
+                }
+            }
+            callback({ w, h }, TextureFormat::RGBAu8, tmp.data(), w * 4);
+            ret = true;
+        }
+
+        stbi_image_free(data);
+    }
+    return ret;
+}
+
+bool WriteImageFile(const std::string& path, int2 size, TextureFormat format, const void* data, int pitch)
+{
+    bool ret = false;
+    if (format == TextureFormat::RGBAu8) {
+        ret = stbi_write_png(path.c_str(), size.x, size.y, 4, data, pitch);
+    }
+    else if (format == TextureFormat::Ru8) {
+        ret = stbi_write_png(path.c_str(), size.x, size.y, 1, data, pitch);
+    }
+    else if (format == TextureFormat::Rf32) {
+        std::vector<byte> buf(size.x * size.y);
+        for (int i = 0; i < size.y; ++i) {
+            auto s = (const float*)((const byte*)data + (pitch * i));
+            auto d = buf.data() + (size.x * i);
+            for (int j = 0; j < size.x; ++j) {
+                *d++ = byte(*s++ * 255.0f);
+            }
+        }
+        ret = stbi_write_png(path.c_str(), size.x, size.y, 1, buf.data(), size.x);
+    }
+    else if (format == TextureFormat::Binary) {
+        // binary to gray scale
+        std::vector<byte> buf(size.x * size.y);
+        for (int i = 0; i < size.y; ++i) {
+            auto s = (const uint32_t*)((const byte*)data + (pitch * i));
+            auto d = buf.data() + (size.x * i);
+            for (int j = 0; j < size.x; ++j) {
+                int pi = j / 32;
+                int bi = j % 32;
+                *d++ = (s[pi] & (1 << bi)) ? 0xff : 0;
+            }
+        }
+        ret = stbi_write_png(path.c_str(), size.x, size.y, 1, buf.data(), size.x);
+    }
+    else {
+        mrDbgPrint("WriteImageFile(): unknown format\n");
+    }
+    return ret;
+}
+
+mrAPI bool SaveAsPNG(const char* path, int w, int h, PixelFormat format, const void* data, int pitch, bool flip_y)
+{
+    if (!path || !data)
+        return false;
+
+    if (pitch == 0) {
+        switch (format) {
+        case PixelFormat::Ru8: pitch = w * 1; break;
+        case PixelFormat::BGRAu8: pitch = w * 4; break;
+        case PixelFormat::RGBAu8: pitch = w * 4; break;
+        default: break;
+        }
+    }
+
+    if (format == PixelFormat::Ru8) {
+        return stbi_write_png(path, w, h, 1, data, pitch);
+    }
+    else if (format == PixelFormat::BGRAu8) {
+        std::vector<byte> buf(w * h * 4);
+        int dst_pitch = w * 4;
+
+        auto src = (const byte*)data;
+        for (int i = 0; i < h; ++i) {
+            auto s = src + (flip_y ? (pitch * (h - i - 1)) : (pitch * i));
+            auto d = buf.data() + (dst_pitch * i);
+            for (int j = 0; j < w; ++j) {
+                d[0] = s[2];
+                d[1] = s[1];
+                d[2] = s[0];
+                d[3] = s[3];
+                s += 4;
+                d += 4;
+            }
+        }
+        return stbi_write_png(path, w, h, 4, buf.data(), dst_pitch);
+    }
+    else if (format == PixelFormat::RGBAu8) {
+        return stbi_write_png(path, w, h, 4, data, pitch);
+    }
+    return false;
+}
+
+} // namespace mr
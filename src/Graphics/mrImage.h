@@ -0,0 +1,41 @@
+#pragma once
+#include "mrInternal.h"
+
+namespace mr {
+
+int GetTexelSize(TextureFormat f);
+bool IsIntFormat(TextureFormat f);
+// texels covered by region (in pixels) clipped by the texture. x is in uint32 for Binary.
+// empty region means entire texture. returns false if no texels are covered.
+bool GetTexelRegion(int2 size, TextureFormat f, Rect region, int2& tl, int2& br);
+// sort candidates of IReduceTopK by the value (ties in scanline order) and drop ones whose footprint overlaps a better one.
+// shared by all gfx backends so that they give the same result.
+void SelectTopK(IReduceTopK::Result& candidates, bool is_float, int max_count, int2 suppression);
+// half width of each row of the disc "distance(center, pos) <= radius". [0] is the center row, [i] is the rows at +-i.
+std::vector<int> GetDiscRowWidths(float radius);
+// approximates the disc by the union of up to max_rects centered rectangles (half sizes).
+// the rectangles are corners of the disc's outline, so the result is exact as long as the disc has up to max_rects corners (radius < 6 for 4).
+std::vector<int2> GetDiscRects(float radius, int max_rects = 4);
+
+// tiling of ITemplateMatchFFT shared by all gfx backends. positions are split into tiles of tile_range and each tile is
+// done by FFTs of fft_size (power of 2). the template spectrum is shared by all tiles.
+struct FFTPlan
+{
+    int2 fft_size{};
+    int2 tile_range{};
+    int2 tiles{};
+};
+constexpr int MaxFFTSize = 1024;
+// template spectra kept by each ITemplateMatchFFT context
+constexpr int FFTSpectrumCacheSize = 8;
+// returns false if the template doesn't fit (larger than MaxFFTSize / 2).
+bool GetFFTPlan(int2 range, int2 template_size, FFTPlan& dst);
+// rough cost of ITemplateMatchFFT in the unit of a pixel of direct matching (x range x template size x channels).
+double GetFFTMatchCost(const FFTPlan& plan, int channels);
+
+// image file I/O shared by all gfx backends. loaded images are Ru8 or RGBAu8.
+using ImageCallback = std::function<void(int2 size, TextureFormat format, const void* data, int pitch)>;
+bool ReadImageFile(const char* path, const ImageCallback& callback);
+bool WriteImageFile(const std::string& path, int2 size, TextureFormat format, const void* data, int pitch);
+
+} // namespace mr
@@ -10,37 +10,75 @@ class Template : public RefCount<ITemplate>
 {
 public:
     void setMatchPattern(MatchPattern v) override { match_pattern = v; }
-    ITexture2DPtr getImage() const override { return base_image; }
+    void setSampleBudget(int v) override { sample_budget = v; }
+    ITexture2DPtr getImage() const override;
+    int getLocalHitCount() const override { return local_hits; }
+    int getLocalMissCount() const override { return local_misses; }
+    int getImageCount() const override;
 
 public:
     MatchPattern match_pattern{};
+    int sample_budget = 0;
+    std::atomic_int local_hits{ 0 };
+    std::atomic_int local_misses{ 0 };
 
     // make images for each display resolution scales.
     // (normalizing screen image is too erroneous)
+    // images are made on demand, only the parts that the match pattern needs.
 
     struct Image
     {
+        enum class Part : uint32_t
+        {
+            RGB             = 0x01,
+            Grayscale       = 0x02,
+            Binary          = 0x04,
+            ContourBinary   = 0x08, // contour_b, mask and mask_bits
+            RGBLevels       = 0x10,
+            GrayscaleLevels = 0x20,
+            Points          = 0x40, // picked from contour_b. not cached
+            Samples         = 0x80, // picked from grayscale or rgb. not cached
+        };
+        // parts made from other parts. the file is not needed for them.
+        static constexpr uint32_t DerivedParts = uint32_t(Part::Points) | uint32_t(Part::Samples);
+
         float scale_factor{}; // corresponding display scale factor
+        int2 size{};
+        uint32_t parts{}; // parts that are already made
         ITexture2DPtr rgb{};
         ITexture2DPtr grayscale{};
         ITexture2DPtr binary{};
-        ITexture2DPtr contour{};
         ITexture2DPtr contour_b{};
         ITexture2DPtr mask{};
         uint32_t mask_bits{};
+        std::vector<int2> points; // set bits of contour_b in scanline order for chamfer matching
+        std::vector<SparseSample> samples; // the most discriminative pixels first for sparse matching
+        int sample_budget{}; // the budget and the pattern samples were picked for
+        ITemplate::MatchPattern sample_pattern{};
+
+        // downsampled images for pyramid search. levels[i] is 1 / 2^(i+1) size.
+        // coarse levels are matched by grayscale (or rgb) as contours and binaries are unreliable on small images.
+        struct Level
+        {
+            ITexture2DPtr rgb;
+            ITexture2DPtr grayscale;
+        };
+        std::vector<Level> levels;
     };
-    std::vector<Image> images;
-    ITexture2DPtr base_image;
-
-    Image& getImage(float display_scale_factor);
+    std::deque<Image> images; // deque to keep references to images valid while adding new one
+    mutable ITexture2DPtr base_image; // not decoded until needed if images are in the cache
+    std::string path;
+    uint64_t content_hash{}; // hash of the file. only with the cache
 };
 mrConvertile(Template, ITemplate);
+mrDeclPtr(Template);
 
 
 class ScreenMatcher : public RefCount<IScreenMatcher>
 {
 public:
     using DeferredResult = std::future<Result>;
+    using DeferredResults = std::future<std::vector<Result>>;
 
     struct ScreenData
     {
@@ -55,25 +93,120 @@ public:
         ITexture2DPtr binary;
         ITexture2DPtr contour;
         ITexture2DPtr contour_b;
+        ITexture2DPtr distance; // distance map of contour_b for chamfer matching. made on demand.
+        float binary_threshold = -1.0f; // threshold binary was made by with Params::auto_threshold
+        nanosec last_frame{};
+
+        // intermediates of the screen. ones that no template to match needs are not made.
+        enum class Target : uint32_t
+        {
+            RGB             = 0x01,
+            Grayscale       = 0x02,
+            Binary          = 0x04,
+            Contour         = 0x08,
+            ContourBinary   = 0x10,
+            RGBLevels       = 0x20,
+            GrayscaleLevels = 0x40,
+            Distance        = 0x80,
+        };
+        uint32_t updated{}; // targets that are made for last_frame
+
+        // if partial_update is true, only dirty_regions (in pixels of the scaled screen) were changed from prev_frame to last_frame.
+        nanosec prev_frame{};
+        std::vector<Rect> dirty_regions;
+        bool partial_update{};
+
+        // last result of each template. reused if the screen around it didn't change.
+        struct MatchCache
+        {
+            nanosec frame{};
+            Rect area{};
+            ITemplate::MatchPattern pattern{};
+            bool exact{}; // false if the result is from pyramid search
+            // the threshold of match() when the result was made (FLT_MAX if none). scores greater than it are not
+            // needed, so such results may be lower bounds of the minimum (see ITemplateMatchMin::setCutoff()).
+            float threshold{};
+            IReduceMinMax::Result mm{};
+        };
+        std::map<Template*, MatchCache> match_cache;
+
+        // downsampled images for pyramid search. levels[i] is 1 / 2^(i+1) size.
+        // match_f is the score map to pick candidates at the coarsest level.
+        struct Level
+        {
+            ITexture2DPtr rgb;
+            ITexture2DPtr grayscale;
+            ITexture2DPtr match_f;
+        };
+        std::vector<Level> levels;
+
+        // score maps for matchAll(). made on demand.
         ITexture2DPtr match_f;
         ITexture2DPtr match_i;
-        nanosec last_frame{};
+
+        // results of match() in flight. each screen has its own so that screens can be matched concurrently.
+        std::vector<DeferredResult> deferred_results;
+    };
+
+    // textures to match for the match pattern. dst (score map) is only for pyramid levels.
+    struct MatchTargets
+    {
+        ITexture2DPtr dst;
+        ITexture2DPtr src;
+        ITexture2DPtr tmpl;
+        ITexture2DPtr mask;
+        bool is_float{};
     };
 
     ScreenMatcher(const Params& params);
+    ScreenMatcher(const Params& params, std::span<IScreenCapturePtr> captures);
     ~ScreenMatcher();
     bool valid() const;
+    void initScreen(ScreenData& sd);
 
+    void setTemplateCacheDir(const char* dir) override;
+    TemplatePtr loadTemplate(const char* path_to_png) const;
     ITemplatePtr createTemplate(const char* path_to_png) override;
+    std::vector<ITemplatePtr> createTemplates(std::span<const std::string> paths) override;
+    void prepareTemplates(std::span<ITemplatePtr> tmpls) override;
+    Template::Image& addImage(Template& tmpl, float display_scale_factor);
+    Template::Image& getImage(Template& tmpl, float display_scale_factor);
+    std::string getTemplateCachePath(const Template& tmpl, float scale_factor) const;
+    bool loadTemplateCache(Template& tmpl, Template::Image& img);
+    bool saveTemplateCache(Template& tmpl, Template::Image& img);
+
+    // brute force matching deferred by matchImpl() to be dispatched with other templates by matchBatch()
+    struct BatchEntry
+    {
+        ITexture2DPtr src;
+        IFilterSet::MatchMinTarget target;
+        size_t result_index{}; // in ScreenData::deferred_results
+        std::function<Result(const IReduceMinMax::Result&)> finish;
+    };
 
-    IReduceMinMaxPtr pullReduceMinmax();
-    void pushReduceMinmax(IReduceMinMaxPtr v);
-
-    void updateScreen(ScreenData& sd);
-    void matchImpl(Template& tmpl, ScreenData& sd, Rect rect);
-    Result reduceResults(std::span<ITemplatePtr> tmpl);
-    Result match(std::span<ITemplatePtr> tmpl, HMONITOR target) override;
-    Result match(std::span<ITemplatePtr> tmpl, HWND target) override;
+    uint32_t getTargets(std::span<ITemplatePtr> tmpls, ScreenData& sd, bool pyramid);
+    IScreenCapture::FrameInfo getFrame(ScreenData& sd);
+    void updateScreen(ScreenData& sd, const IScreenCapture::FrameInfo& frame, uint32_t targets);
+    void updateScreen(ScreenData& sd, std::span<ITemplatePtr> tmpls, bool pyramid);
+    void matchImpl(Template& tmpl, ScreenData& sd, Rect rect, float threshold, std::vector<BatchEntry>* batch = nullptr);
+    void matchBatch(ScreenData& sd, std::vector<BatchEntry>& batch);
+    std::future<IReduceMinMax::Result> matchMin(Template& tmpl, Template::Image& img, ScreenData& sd, Rect region, float cutoff = -1.0f);
+    bool matchPyramid(Template& tmpl, Template::Image& img, ScreenData& sd, Rect area, IReduceMinMax::Result& result);
+    bool matchSparse(Template& tmpl, Template::Image& img, ScreenData& sd, Rect area, float threshold, IReduceMinMax::Result& result);
+    bool matchFFT(Template& tmpl, Template::Image& img, ScreenData& sd, Rect area, IReduceMinMax::Result& result);
+    bool refineCandidates(Template& tmpl, Template::Image& img, ScreenData& sd, Rect region, const IReduceTopK::Result& candidates, int radius, IReduceMinMax::Result& result);
+    bool matchFull(Template& tmpl, Template::Image& img, ScreenData& sd, Rect area, float threshold, IReduceMinMax::Result& result);
+    Result makeResult(Template& tmpl, Template::Image& img, ScreenData& sd, const IReduceMinMax::Result& mm, Rect rect, float threshold = -1.0f);
+    void matchScreen(std::span<ITemplatePtr> tmpls, ScreenData& sd, Rect rect, float threshold);
+    Result reduceResults(ScreenData& sd);
+    Result match(std::span<ITemplatePtr> tmpl, HMONITOR target, float threshold) override;
+    Result match(std::span<ITemplatePtr> tmpl, HWND target, float threshold) override;
+    Result matchAllScreens(std::span<ITemplatePtr> tmpl, float threshold) override;
+
+    void matchAllImpl(Template& tmpl, ScreenData& sd, Rect rect, float threshold, int max_count);
+    std::vector<Result> reduceAllResults(int max_count);
+    std::vector<Result> matchAll(std::span<ITemplatePtr> tmpl, HMONITOR target, float threshold, int max_count) override;
+    std::vector<Result> matchAll(std::span<ITemplatePtr> tmpl, HWND target, float threshold, int max_count) override;
 
 private:
     // shared with all instances
@@ -90,12 +223,13 @@ private:
 
     IGfxInterfacePtr m_gfx;
     Params m_params;
+    std::vector<IScreenCapturePtr> m_captures; // if not empty, they are the screens instead of the displays
+    std::string m_cache_dir;
 
     std::map<std::string, ITemplatePtr> m_templates;
-    std::map<HMONITOR, ScreenData> m_screens;
+    std::map<HMONITOR, ScreenData> m_screens; // screens of captures are keyed by their indices
 
-    std::deque<IReduceMinMaxPtr> m_reducers;
-    std::vector<DeferredResult> m_deferred_results;
+    std::vector<DeferredResults> m_deferred_all_results;
 };
 
 mrAPI IScreenMatcher* CreateScreenMatcher_(const IScreenMatcher::Params& params)
@@ -108,6 +242,41 @@ mrAPI IScreenMatcher* CreateScreenMatcher_(const IScreenMatcher::Params& params)
     return ret;
 }
 
+mrAPI IScreenMatcher* CreateScreenMatcherForCapture_(const IScreenMatcher::Params& params, IScreenCapture* capture)
+{
+    IScreenCapturePtr captures[] = { capture };
+    return CreateScreenMatcherForCaptures_(params, captures);
+}
+
+mrAPI IScreenMatcher* CreateScreenMatcherForCaptures_(const IScreenMatcher::Params& params, std::span<IScreenCapturePtr> captures)
+{
+    auto ret = new ScreenMatcher(params, captures);
+    if (!ret->valid()) {
+        delete ret;
+        ret = nullptr;
+    }
+    return ret;
+}
+
+ITexture2DPtr Template::getImage() const
+{
+    if (!base_image)
+        base_image = GetGfxInterface()->createTextureFromFile(path.c_str());
+    return base_image;
+}
+
+int Template::getImageCount() const
+{
+    int ret = 0;
+    for (auto& img : images) {
+        for (auto* t : { &img.rgb, &img.grayscale, &img.binary, &img.contour_b, &img.mask })
+            ret += *t ? 1 : 0;
+        for (auto& level : img.levels)
+            ret += (level.rgb ? 1 : 0) + (level.grayscale ? 1 : 0);
+    }
+    return ret;
+}
+
 #ifdef mrDebug
 static bool g_dbg_sm_writeout = false;
 
@@ -117,13 +286,186 @@ void DbgSetScreenMatcherWriteout(bool v)
 }
 #endif // mrDebug
 
-Template::Image& Template::getImage(float display_scale_factor)
+
+// templates smaller than this are not downsampled further in pyramid search
+static const int PyramidMinTemplateSize = 8;
+// search radius around candidates in pyramid search, in pixels of each level
+static const int PyramidRefineRadius = 2;
+// search radius around candidates of FFT matching, in pixels
+static const int FFTRefineRadius = 1;
+// search radius around candidates of sparse matching, in pixels
+static const int SparseRefineRadius = 1;
+
+// changed regions of the screen are updated in units of this. multiple of 32 to align with Binary textures.
+static const int DirtyTileSize = 64;
+// too many regions make too many dispatches. merge them into one if exceeded.
+static const int MaxDirtyRegions = 16;
+
+// convert changed rects of the surface to regions of the scaled screen, quantized to tiles.
+// margin is added to each rect to cover the support of the filter.
+// returns false if most of the screen is changed and updating entire screen is better.
+static bool GetDirtyRegions(const std::vector<Rect>& rects, int2 surface_size, int2 size, std::vector<Rect>& dst)
 {
-    for (auto& i : images) {
-        if (i.scale_factor == display_scale_factor)
-            return i;
+    float2 scale = float2(size) / float2(surface_size);
+    int margin = int(std::ceil(2.0f * std::max(scale.x, scale.y))) + 1;
+
+    int2 tiles = { ceildiv(size.x, DirtyTileSize), ceildiv(size.y, DirtyTileSize) };
+    std::vector<bool> dirty(tiles.x * tiles.y);
+    int num_dirty = 0;
+    for (auto& r : rects) {
+        int2 tl = int2(floor(float2(r.pos) * scale)) - margin;
+        int2 br = int2(ceil(float2(r.pos + r.size) * scale)) + margin;
+        tl = max(tl, int2::zero()) / DirtyTileSize;
+        br = min((br + (DirtyTileSize - 1)) / DirtyTileSize, tiles);
+        for (int ty = tl.y; ty < br.y; ++ty) {
+            for (int tx = tl.x; tx < br.x; ++tx) {
+                if (!dirty[tiles.x * ty + tx]) {
+                    dirty[tiles.x * ty + tx] = true;
+                    ++num_dirty;
+                }
+            }
+        }
+    }
+    if (num_dirty * 2 > tiles.x * tiles.y)
+        return false;
+
+    // make spans of each tile row and merge them with the same span of the previous row
+    std::vector<Rect> regions; // in tiles
+    for (int ty = 0; ty < tiles.y; ++ty) {
+        for (int tx = 0; tx < tiles.x;) {
+            if (!dirty[tiles.x * ty + tx]) {
+                ++tx;
+                continue;
+            }
+            int te = tx;
+            while (te < tiles.x && dirty[tiles.x * ty + te])
+                ++te;
+
+            auto it = std::find_if(regions.begin(), regions.end(), [&](Rect& r) {
+                return r.pos.x == tx && r.size.x == te - tx && r.pos.y + r.size.y == ty;
+                });
+            if (it != regions.end())
+                ++it->size.y;
+            else
+                regions.push_back(Rect{ { tx, ty }, { te - tx, 1 } });
+            tx = te;
+        }
+    }
+
+    if (regions.size() > MaxDirtyRegions) {
+        int2 tl = regions.front().pos;
+        int2 br = tl;
+        for (auto& r : regions) {
+            tl = min(tl, r.pos);
+            br = max(br, r.pos + r.size);
+        }
+        regions = { Rect{ tl, br - tl } };
+    }
+
+    dst.clear();
+    for (auto& r : regions) {
+        int2 tl = r.pos * DirtyTileSize;
+        int2 br = min((r.pos + r.size) * DirtyTileSize, size);
+        dst.push_back(Rect{ tl, br - tl });
+    }
+    return true;
+}
+
+template<class Screen, class Image>
+static ScreenMatcher::MatchTargets SelectTargets(ITemplate::MatchPattern pattern, Screen& sd, Image& img)
+{
+    switch (pattern) {
+    case ITemplate::MatchPattern::RGB:
+        return { nullptr, sd.rgb, img.rgb, nullptr, true };
+    case ITemplate::MatchPattern::Grayscale:
+        return { nullptr, sd.grayscale, img.grayscale, nullptr, true };
+    case ITemplate::MatchPattern::Binary:
+        return { nullptr, sd.binary, img.binary, nullptr, false };
+    case ITemplate::MatchPattern::Chamfer:
+        return { nullptr, sd.distance, img.contour_b, nullptr, true }; // the template is matched by img.points
+    default:
+        return { nullptr, sd.contour_b, img.contour_b, img.mask, false };
+    }
+}
+
+// raw scores of the score map are divided by this to get normalized scores
+static double GetScoreDenominator(ITemplate::MatchPattern pattern, const Template::Image& img)
+{
+    auto tsize = img.size;
+    switch (pattern) {
+    case ITemplate::MatchPattern::RGB:
+    case ITemplate::MatchPattern::Grayscale:
+    case ITemplate::MatchPattern::Binary:
+        return double(tsize.x * tsize.y);
+    case ITemplate::MatchPattern::Chamfer:
+        return double(std::max(img.points.size(), size_t(1)));
+    default:
+        return double(img.mask_bits);
     }
-    return images.front();
+}
+
+// normalized score of the result
+static float GetScore(ITemplate::MatchPattern pattern, const Template::Image& img, const IReduceMinMax::Result& mm)
+{
+    bool is_float = pattern == ITemplate::MatchPattern::RGB || pattern == ITemplate::MatchPattern::Grayscale ||
+        pattern == ITemplate::MatchPattern::Chamfer;
+    double value = is_float ? double(mm.valf_min) : double(mm.vali_min);
+    return float(value / GetScoreDenominator(pattern, img));
+}
+
+// FFT matching is used if it is estimated to be faster than the direct matching of range positions
+static bool ShouldUseFFT(ITemplate::MatchPattern pattern, int2 range, int2 tsize, int candidates)
+{
+    if (candidates <= 0 || (pattern != ITemplate::MatchPattern::RGB && pattern != ITemplate::MatchPattern::Grayscale))
+        return false;
+
+    FFTPlan plan;
+    if (!GetFFTPlan(range, tsize, plan))
+        return false;
+    int channels = pattern == ITemplate::MatchPattern::RGB ? 3 : 1;
+    double direct = double(range.x) * double(range.y) * double(tsize.x) * double(tsize.y) * double(channels);
+    return GetFFTMatchCost(plan, channels) < direct;
+}
+
+// raw score for ITemplateMatchMin::setCutoff(). positions whose score exceeds the threshold of match() don't have to
+// be computed exactly as they are misses anyway. no cutoff if there is no threshold.
+static float GetCutoff(const IScreenMatcher::Params& params, const Template& tmpl, const Template::Image& img, float threshold)
+{
+    if (!params.threshold_cutoff || threshold < 0.0f)
+        return -1.0f;
+    return float(double(threshold) * GetScoreDenominator(tmpl.match_pattern, img));
+}
+
+// pick up to 'count' local minima in ascending order of the value.
+// minima closer than 'distance' to already picked ones are skipped.
+template<class T>
+static std::vector<int2> PickCandidates(const void* data, int pitch, int2 size, int count, int distance)
+{
+    auto get = [&](int x, int y) { return ((const T*)((const byte*)data + (pitch * y)))[x]; };
+
+    std::vector<std::pair<T, int2>> minima;
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            T v = get(x, y);
+            if ((x > 0 && get(x - 1, y) < v) || (x < size.x - 1 && get(x + 1, y) < v) ||
+                (y > 0 && get(x, y - 1) < v) || (y < size.y - 1 && get(x, y + 1) < v))
+                continue;
+            minima.push_back({ v, int2{ x, y } });
+        }
+    }
+    std::stable_sort(minima.begin(), minima.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+    std::vector<int2> ret;
+    for (auto& m : minima) {
+        if ((int)ret.size() >= count)
+            break;
+        bool near = std::any_of(ret.begin(), ret.end(), [&](int2 p) {
+            return std::abs(p.x - m.second.x) < distance && std::abs(p.y - m.second.y) < distance;
+            });
+        if (!near)
+            ret.push_back(m.second);
+    }
+    return ret;
 }
 
 
@@ -153,263 +495,1290 @@ ScreenMatcher::ScreenMatcher(const Params& params)
         data.capture = sd.capture;
 
         data.filter = CreateFilterSet();
+        initScreen(data);
+        m_screens[sd.info.hmon] = std::move(data);
+    }
+}
 
-        int2 size = int2(float2(data.info.rect.size) * m_params.scale);
-        data.grayscale  = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
-        data.biased     = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
-        data.binary     = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
-        data.contour    = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
-        data.contour_b  = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
-        data.match_f    = m_gfx->createTexture(size.x, size.y, TextureFormat::Rf32);
-        data.match_i    = m_gfx->createTexture(size.x, size.y, TextureFormat::Ri32);
+ScreenMatcher::ScreenMatcher(const Params& params, std::span<IScreenCapturePtr> captures)
+    : m_gfx(GetGfxInterface())
+    , m_params(params)
+{
+    for (auto& capture : captures) {
+        if (!capture || (!capture->isCapturing() && !capture->startCapture(HMONITOR{})))
+            return;
+    }
+    m_captures.assign(captures.begin(), captures.end());
 
-        m_screens[sd.info.hmon] = std::move(data);
+    // textures are made when the first frame arrives as the size is unknown until then
+    for (size_t i = 0; i < m_captures.size(); ++i) {
+        ScreenData data;
+        data.info.hmon = (HMONITOR)i;
+        data.info.scale_factor = 1.0f;
+        data.capture = m_captures[i];
+        data.filter = CreateFilterSet();
+        m_screens[data.info.hmon] = std::move(data);
     }
 }
 
 ScreenMatcher::~ScreenMatcher()
 {
-    if (s_data->release() == 0)
+    if (m_captures.empty() && s_data->release() == 0)
         s_data = nullptr;
 }
 
+void ScreenMatcher::initScreen(ScreenData& data)
+{
+    int2 size = int2(float2(data.info.rect.size) * m_params.scale);
+    data.rgb        = m_gfx->createTexture(size.x, size.y, TextureFormat::RGBAu8);
+    data.grayscale  = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
+    data.biased     = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
+    data.binary     = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
+    data.contour    = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
+    data.contour_b  = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
+
+    data.levels.clear();
+    for (int i = 1; i <= m_params.pyramid_levels; ++i) {
+        int2 lsize = size / (1 << i);
+        if (lsize.x <= 0 || lsize.y <= 0)
+            break;
+
+        ScreenData::Level level;
+        level.rgb       = m_gfx->createTexture(lsize.x, lsize.y, TextureFormat::RGBAu8);
+        level.grayscale = m_gfx->createTexture(lsize.x, lsize.y, TextureFormat::Ru8);
+        level.match_f   = m_gfx->createTexture(lsize.x, lsize.y, TextureFormat::Rf32);
+        data.levels.push_back(std::move(level));
+    }
+
+    data.match_f = data.match_i = data.distance = nullptr;
+    data.binary_threshold = -1.0f;
+    data.surface = nullptr;
+    data.last_frame = data.prev_frame = 0;
+    data.updated = 0;
+    data.match_cache.clear();
+}
+
 bool ScreenMatcher::valid() const
 {
     return !m_screens.empty();
 }
 
+// on-disk cache of template images.
+// entries are keyed by the content of the file, params that affect images and the display scale factor.
+// changed files or params just make different keys, so stale entries are never used.
+struct TemplateCacheHeader
+{
+    char magic[4] = { 'M', 'R', 'T', 'C' };
+    uint32_t version = 2;
+    uint64_t content_hash{};
+    float scale{};
+    float scale_factor{};
+    float2 color_range{};
+    float contour_radius{};
+    float expand_radius{};
+    float binarize_threshold{};
+    uint32_t auto_threshold{};
+    // fields above are the key
+    int2 size{};
+    uint32_t mask_bits{};
+    uint32_t pad{};
+};
+static_assert(sizeof(TemplateCacheHeader) == 64);
+static const size_t TemplateCacheKeySize = offsetof(TemplateCacheHeader, size);
+// followed by grayscale (Ru8), binary, contour_b and mask (Binary) without row padding
+
+static const char* s_template_cache_ext = ".mrtc";
+
+// FNV-1a
+static uint64_t HashBytes(const void* data, size_t size, uint64_t h = 0xcbf29ce484222325ull)
+{
+    auto* p = (const byte*)data;
+    for (size_t i = 0; i < size; ++i)
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+static TemplateCacheHeader MakeTemplateCacheKey(const IScreenMatcher::Params& params, uint64_t content_hash, float scale_factor)
+{
+    TemplateCacheHeader ret;
+    ret.content_hash = content_hash;
+    ret.scale = params.scale;
+    ret.scale_factor = scale_factor;
+    ret.color_range = params.color_range;
+    ret.contour_radius = params.contour_radius;
+    ret.expand_radius = params.expand_radius;
+    ret.binarize_threshold = params.binarize_threshold;
+    ret.auto_threshold = params.auto_threshold;
+    return ret;
+}
+
+void ScreenMatcher::setTemplateCacheDir(const char* dir)
+{
+    m_cache_dir = dir ? dir : "";
+}
+
+std::string ScreenMatcher::getTemplateCachePath(const Template& tmpl, float scale_factor) const
+{
+    auto key = MakeTemplateCacheKey(m_params, tmpl.content_hash, scale_factor);
+    return Format("%s/%016llx%s", m_cache_dir.c_str(), (unsigned long long)HashBytes(&key, TemplateCacheKeySize), s_template_cache_ext);
+}
+
+bool ScreenMatcher::loadTemplateCache(Template& tmpl, Template::Image& img)
+{
+    using Part = Template::Image::Part;
+
+    MappedFile file;
+    if (m_cache_dir.empty() || !file.open(getTemplateCachePath(tmpl, img.scale_factor).c_str()))
+        return false;
+
+    auto key = MakeTemplateCacheKey(m_params, tmpl.content_hash, img.scale_factor);
+    auto* header = (const TemplateCacheHeader*)file.data();
+    if (file.size() < sizeof(TemplateCacheHeader) || memcmp(header, &key, TemplateCacheKeySize) != 0)
+        return false;
+
+    int2 size = header->size;
+    int gray_pitch = size.x;
+    int bits_pitch = ceildiv(size.x, 32) * 4;
+    if (size.x <= 0 || size.y <= 0 || file.size() < sizeof(TemplateCacheHeader) + size_t(gray_pitch + bits_pitch * 3) * size.y) {
+        mrDbgPrint("*** ScreenMatcher: broken template cache for %s ***\n", tmpl.path.c_str());
+        return false;
+    }
+
+    auto* data = (const byte*)(header + 1);
+    auto next = [&](TextureFormat format, int pitch) {
+        auto ret = m_gfx->createTexture(size.x, size.y, format, data, pitch);
+        data += pitch * size.y;
+        return ret;
+    };
+    img.size = size;
+    img.grayscale = next(TextureFormat::Ru8, gray_pitch);
+    img.binary = next(TextureFormat::Binary, bits_pitch);
+    img.contour_b = next(TextureFormat::Binary, bits_pitch);
+    img.mask = next(TextureFormat::Binary, bits_pitch);
+    img.mask_bits = header->mask_bits;
+    img.parts = uint32_t(Part::Grayscale) | uint32_t(Part::Binary) | uint32_t(Part::ContourBinary);
+    return true;
+}
+
+bool ScreenMatcher::saveTemplateCache(Template& tmpl, Template::Image& img)
+{
+    auto header = MakeTemplateCacheKey(m_params, tmpl.content_hash, img.scale_factor);
+    header.size = img.size;
+    header.mask_bits = img.mask_bits;
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_cache_dir, ec);
+
+    // write to a temporary file and rename it not to leave broken entries
+    auto path = getTemplateCachePath(tmpl, img.scale_factor);
+    auto tmp_path = path + ".tmp";
+    {
+        std::ofstream ofs(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!ofs)
+            return false;
+        ofs.write((const char*)&header, sizeof(header));
+        for (ITexture2DPtr tex : { img.grayscale, img.binary, img.contour_b, img.mask }) {
+            int row_size = tex->getFormat() == TextureFormat::Binary ? ceildiv(img.size.x, 32) * 4 : img.size.x;
+            tex->read([&](const void* data, int pitch) {
+                for (int y = 0; y < img.size.y; ++y)
+                    ofs.write((const char*)data + pitch * y, row_size);
+                });
+        }
+        if (!ofs)
+            return false;
+    }
+    std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+// doesn't touch m_templates and can be called from multiple threads
+TemplatePtr ScreenMatcher::loadTemplate(const char* path) const
+{
+    auto ret = make_ref<Template>();
+    ret->path = path;
+    bool cached = false;
+    if (!m_cache_dir.empty()) {
+        // the file is not decoded as long as images for all screens are in the cache
+        MappedFile file;
+        if (!file.open(path))
+            return nullptr;
+        ret->content_hash = HashBytes(file.data(), file.size());
+
+        cached = true;
+        auto check = [&](float scale_factor) {
+            cached = cached && std::filesystem::exists(getTemplateCachePath(*ret, scale_factor));
+        };
+        if (m_params.care_display_scale) {
+            for (auto& kvp : m_screens)
+                check(kvp.second.info.scale_factor);
+        }
+        else {
+            check(1.0f);
+        }
+    }
+    if (!cached && !ret->getImage())
+        return nullptr;
+    return ret;
+}
+
 ITemplatePtr ScreenMatcher::createTemplate(const char* path)
 {
     auto it = m_templates.find(path);
     if (it != m_templates.end())
         return it->second;
 
-    auto base_image = m_gfx->createTextureFromFile(path);
-    if (!base_image)
-        return nullptr;
+    auto ret = loadTemplate(path);
+    if (ret)
+        m_templates[path] = ret;
+    return ret;
+}
 
-    auto ret = make_ref<Template>();
-    m_templates[path] = ret;
-    ret->base_image = base_image;
+std::vector<ITemplatePtr> ScreenMatcher::createTemplates(std::span<const std::string> paths)
+{
+    // decoding (or hashing with the cache) files is the heavy part. it runs in parallel and m_templates is updated afterwards.
+    std::vector<std::string> to_load;
+    for (auto& path : paths) {
+        if (!m_templates.contains(path) && std::find(to_load.begin(), to_load.end(), path) == to_load.end())
+            to_load.push_back(path);
+    }
+    std::vector<TemplatePtr> loaded(to_load.size());
+    ParallelFor(0, (int)to_load.size(), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            loaded[i] = loadTemplate(to_load[i].c_str());
+        });
+    for (size_t i = 0; i < to_load.size(); ++i) {
+        if (loaded[i])
+            m_templates[to_load[i]] = loaded[i];
+    }
 
-    auto filter = CreateFilterSet();
-    auto create_image = [&](float scale_factor) {
-        for (auto& i : ret->images) {
-            if (i.scale_factor == scale_factor)
-                return; // already created
+    std::vector<ITemplatePtr> ret;
+    for (auto& path : paths) {
+        auto it = m_templates.find(path);
+        ret.push_back(it != m_templates.end() ? it->second : nullptr);
+    }
+    return ret;
+}
+
+// pick up to 'budget' pixels for sparse matching, the most discriminative first. pixels on strong gradients tell
+// positions apart, and pixels of rare colors in the template tell it apart from other things. neighbors of picked
+// pixels are picked after all others not to spend the budget on one edge.
+static std::vector<SparseSample> PickSamples(const byte* data, int pitch, int2 size, int channels, int budget)
+{
+    auto get = [&](int x, int y, int c) {
+        x = std::clamp(x, 0, size.x - 1);
+        y = std::clamp(y, 0, size.y - 1);
+        return int(data[pitch * y + x * channels + c]);
+    };
+    int num_channels = std::min(channels, 3);
+    auto quantize = [&](int x, int y) {
+        // 16 levels of grayscale or 8 levels of each of rgb
+        if (num_channels == 1)
+            return get(x, y, 0) >> 4;
+        return ((get(x, y, 0) >> 5) << 6) | ((get(x, y, 1) >> 5) << 3) | (get(x, y, 2) >> 5);
+    };
+
+    int num_pixels = size.x * size.y;
+    std::vector<int> histogram(512);
+    for (int y = 0; y < size.y; ++y)
+        for (int x = 0; x < size.x; ++x)
+            ++histogram[quantize(x, y)];
+
+    // weight: gradient in [0, 1] + rarity in [0, 1]
+    std::vector<std::pair<float, int>> weights(num_pixels);
+    double log_n = std::log(double(std::max(num_pixels, 2)));
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            int gradient = 0;
+            for (int c = 0; c < num_channels; ++c) {
+                int g = std::abs(get(x + 1, y, c) - get(x - 1, y, c)) + std::abs(get(x, y + 1, c) - get(x, y - 1, c));
+                gradient = std::max(gradient, g);
+            }
+            double rarity = -std::log(double(histogram[quantize(x, y)]) / double(num_pixels)) / log_n;
+            weights[size.x * y + x] = { float(double(gradient) / 510.0 + rarity), size.x * y + x };
+        }
+    }
+    std::stable_sort(weights.begin(), weights.end(), [](auto& a, auto& b) { return a.first > b.first; });
+
+    std::vector<SparseSample> ret;
+    std::vector<bool> picked(num_pixels);
+    auto pick = [&](int i) {
+        int x = i % size.x, y = i / size.x;
+        SparseSample sample{};
+        sample.pos = { x, y };
+        for (int c = 0; c < 4; ++c)
+            sample.color[c].value = c < channels ? uint8_t(get(x, y, c)) : 0xff;
+        ret.push_back(sample);
+        picked[i] = true;
+    };
+    int n = std::min(budget, num_pixels);
+    for (auto& w : weights) {
+        if ((int)ret.size() >= n)
+            break;
+        int x = w.second % size.x, y = w.second / size.x;
+        bool near = false;
+        for (int dy = -1; dy <= 1 && !near; ++dy) {
+            for (int dx = -1; dx <= 1 && !near; ++dx) {
+                int nx = x + dx, ny = y + dy;
+                near = nx >= 0 && ny >= 0 && nx < size.x && ny < size.y && picked[size.x * ny + nx];
+            }
         }
+        if (!near)
+            pick(w.second);
+    }
+    for (auto& w : weights) {
+        if ((int)ret.size() >= n)
+            break;
+        if (!picked[w.second])
+            pick(w.second);
+    }
+    return ret;
+}
 
-        int2 size = int2(float2(base_image->getSize()) * m_params.scale * scale_factor);
+static uint32_t GetImageParts(const Template& tmpl)
+{
+    using Part = Template::Image::Part;
+    uint32_t samples = tmpl.sample_budget > 0 ? uint32_t(Part::Samples) : 0;
+    switch (tmpl.match_pattern) {
+    case ITemplate::MatchPattern::RGB: return uint32_t(Part::RGB) | uint32_t(Part::RGBLevels) | samples;
+    case ITemplate::MatchPattern::Grayscale: return uint32_t(Part::Grayscale) | uint32_t(Part::GrayscaleLevels) | samples;
+    case ITemplate::MatchPattern::Binary: return uint32_t(Part::Binary) | uint32_t(Part::GrayscaleLevels);
+    case ITemplate::MatchPattern::Chamfer: return uint32_t(Part::ContourBinary) | uint32_t(Part::Points); // no pyramid search
+    default: return uint32_t(Part::ContourBinary) | uint32_t(Part::GrayscaleLevels);
+    }
+}
 
+void ScreenMatcher::prepareTemplates(std::span<ITemplatePtr> tmpls)
+{
+    std::vector<Template*> targets;
+    for (auto& t : tmpls) {
+        if (t && std::find(targets.begin(), targets.end(), cast(t.get())) == targets.end())
+            targets.push_back(cast(t.get()));
+    }
+    std::vector<float> scale_factors;
+    if (m_params.care_display_scale) {
+        for (auto& kvp : m_screens) {
+            float sf = kvp.second.info.scale_factor;
+            if (std::find(scale_factors.begin(), scale_factors.end(), sf) == scale_factors.end())
+                scale_factors.push_back(sf);
+        }
+    }
+    else {
+        scale_factors.push_back(1.0f);
+    }
+
+    // reading the cache and decoding files run in parallel. filters use the device context and are serialized.
+    ParallelFor(0, (int)targets.size(), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            auto& tmpl = *targets[i];
+            for (float sf : scale_factors) {
+                auto& img = addImage(tmpl, sf);
+                if (GetImageParts(tmpl) & ~img.parts & ~Template::Image::DerivedParts)
+                    tmpl.getImage();
+            }
+        }
+        });
+    m_gfx->lock([&]() {
+        for (auto* t : targets)
+            for (float sf : scale_factors)
+                getImage(*t, sf);
+        });
+}
+
+// finds or adds the image for the scale factor. parts are not made but loaded if they are in the cache.
+// templates are independent, so this can be called from multiple threads for different templates.
+Template::Image& ScreenMatcher::addImage(Template& tmpl, float display_scale_factor)
+{
+    float scale_factor = m_params.care_display_scale ? display_scale_factor : 1.0f;
+    auto it = std::find_if(tmpl.images.begin(), tmpl.images.end(), [&](auto& i) { return i.scale_factor == scale_factor; });
+    if (it == tmpl.images.end()) {
         Template::Image img{};
-        img.scale_factor= scale_factor;
-        img.rgb         = m_gfx->createTexture(size.x, size.y, TextureFormat::RGBAu8);
-        img.grayscale   = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
-        img.binary      = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
-        img.contour     = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
-        img.contour_b   = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
-        img.mask        = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
+        img.scale_factor = scale_factor;
+        if (!loadTemplateCache(tmpl, img))
+            img.size = int2(float2(tmpl.getImage()->getSize()) * m_params.scale * scale_factor);
+
+        // too small templates at coarse levels give meaningless results. stop there.
+        for (int i = 1; i <= m_params.pyramid_levels; ++i) {
+            int2 lsize = img.size / (1 << i);
+            if (lsize.x < PyramidMinTemplateSize || lsize.y < PyramidMinTemplateSize)
+                break;
+            img.levels.push_back({});
+        }
+        tmpl.images.push_back(std::move(img));
+        it = tmpl.images.end() - 1;
+    }
+    return *it;
+}
 
-        filter->transform(img.rgb, base_image, false);
-        filter->grayscale(img.grayscale, base_image, m_params.color_range);
-        filter->binarize(img.binary, img.grayscale, m_params.binarize_threshold);
+Template::Image& ScreenMatcher::getImage(Template& tmpl, float display_scale_factor)
+{
+    using Part = Template::Image::Part;
+
+    auto& img = addImage(tmpl, display_scale_factor);
+    if (img.sample_budget != tmpl.sample_budget || img.sample_pattern != tmpl.match_pattern)
+        set_flag(img.parts, Part::Samples, false);
+    uint32_t parts = GetImageParts(tmpl) & ~img.parts;
+    if (!parts)
+        return img;
+
+    // entries of the cache have all of grayscale, binary and contour_b
+    const uint32_t cached_parts = uint32_t(Part::Grayscale) | uint32_t(Part::Binary) | uint32_t(Part::ContourBinary);
+    bool save_cache = !m_cache_dir.empty() && (parts & cached_parts);
+    if (save_cache)
+        parts |= cached_parts & ~img.parts;
+
+    // points are picked from contour_b, and grayscale is the source of others
+    if (get_flag(parts, Part::Points) && !get_flag(img.parts, Part::ContourBinary))
+        set_flag(parts, Part::ContourBinary, true);
+    if ((parts & ~(uint32_t(Part::RGB) | uint32_t(Part::RGBLevels) | Template::Image::DerivedParts)) && !get_flag(img.parts, Part::Grayscale))
+        set_flag(parts, Part::Grayscale, true);
+    if (get_flag(parts, Part::RGBLevels) && !get_flag(img.parts, Part::RGB))
+        set_flag(parts, Part::RGB, true);
 
-        filter->contour(img.contour, img.grayscale, m_params.contour_radius);
-        filter->binarize(img.contour_b, img.contour, m_params.binarize_threshold);
+    auto filter = CreateFilterSet();
+    int2 size = img.size;
+    ITexture2DPtr contour;
+    if (get_flag(parts, Part::RGB)) {
+        img.rgb = m_gfx->createTexture(size.x, size.y, TextureFormat::RGBAu8);
+        filter->transform(img.rgb, tmpl.getImage(), false);
+    }
+    if (get_flag(parts, Part::Grayscale)) {
+        img.grayscale = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
+        filter->grayscale(img.grayscale, tmpl.getImage(), m_params.color_range);
+    }
+    if (get_flag(parts, Part::Binary)) {
+        float threshold = m_params.auto_threshold ? GetOtsuThreshold(filter->histogram(img.grayscale).get()) : m_params.binarize_threshold;
+        img.binary = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
+        filter->binarize(img.binary, img.grayscale, threshold);
+    }
+    if (get_flag(parts, Part::ContourBinary)) {
+        contour         = m_gfx->createTexture(size.x, size.y, TextureFormat::Ru8);
+        img.contour_b   = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
+        img.mask        = m_gfx->createTexture(size.x, size.y, TextureFormat::Binary);
+        filter->contour(contour, img.grayscale, m_params.contour_radius);
+        filter->binarize(img.contour_b, contour, m_params.binarize_threshold);
         filter->expand(img.mask, img.contour_b, m_params.expand_radius);
         img.mask_bits = filter->countBits(img.mask).get();
+    }
+    if (get_flag(parts, Part::Points)) {
+        img.points.clear();
+        img.contour_b->read([&](const void* data, int pitch) {
+            for (int y = 0; y < size.y; ++y) {
+                auto* row = (const uint32_t*)((const byte*)data + pitch * y);
+                for (int x = 0; x < size.x; ++x) {
+                    if ((row[x / 32] >> (x % 32)) & 1)
+                        img.points.push_back({ x, y });
+                }
+            }
+            });
+    }
+
+    bool rgb_levels = get_flag(parts, Part::RGBLevels);
+    bool grayscale_levels = get_flag(parts, Part::GrayscaleLevels);
+    for (size_t i = 0; i < img.levels.size(); ++i) {
+        auto& level = img.levels[i];
+        int2 lsize = size / (1 << (i + 1));
+        if (rgb_levels) {
+            level.rgb = m_gfx->createTexture(lsize.x, lsize.y, TextureFormat::RGBAu8);
+            filter->transform(level.rgb, i == 0 ? img.rgb : img.levels[i - 1].rgb, false, true);
+        }
+        if (grayscale_levels) {
+            level.grayscale = m_gfx->createTexture(lsize.x, lsize.y, TextureFormat::Ru8);
+            filter->transform(level.grayscale, i == 0 ? img.grayscale : img.levels[i - 1].grayscale, false, true);
+        }
+    }
+    if (get_flag(parts, Part::Samples)) {
+        bool rgb = tmpl.match_pattern == ITemplate::MatchPattern::RGB;
+        (rgb ? img.rgb : img.grayscale)->read([&](const void* data, int pitch) {
+            img.samples = PickSamples((const byte*)data, pitch, size, rgb ? 4 : 1, tmpl.sample_budget);
+            });
+        img.sample_budget = tmpl.sample_budget;
+        img.sample_pattern = tmpl.match_pattern;
+    }
+    img.parts |= parts;
+    if (save_cache && !saveTemplateCache(tmpl, img))
+        mrDbgPrint("*** ScreenMatcher: failed to write template cache for %s ***\n", tmpl.path.c_str());
 
 #ifdef mrDebug
-        //if (g_dbg_sm_writeout)
-        {
-            float percent = scale_factor * 100.0f;
+    //if (g_dbg_sm_writeout)
+    {
+        auto& path = tmpl.path;
+        float percent = img.scale_factor * 100.0f;
+        if (get_flag(parts, Part::Grayscale))
             img.grayscale->save(Replace(path, ".png", Format("_grayscale_%.0f.png", percent)));
+        if (get_flag(parts, Part::Binary))
             img.binary->save(Replace(path, ".png", Format("_binary_%.0f.png", percent)));
-            img.contour->save(Replace(path, ".png", Format("_contour_%.0f.png", percent)));
+        if (get_flag(parts, Part::ContourBinary)) {
+            contour->save(Replace(path, ".png", Format("_contour_%.0f.png", percent)));
             img.contour_b->save(Replace(path, ".png", Format("_contour_binary_%.0f.png", percent)));
             img.mask->save(Replace(path, ".png", Format("_mask_%.0f.png", percent)));
         }
+    }
 #endif
-        ret->images.push_back(std::move(img));
-    };
+    return img;
+}
 
-    if (m_params.care_display_scale) {
-        for (auto& kvp : m_screens)
-            create_image(kvp.second.info.scale_factor);
-    }
-    else {
-        create_image(1.0f);
-    }
+uint32_t ScreenMatcher::getTargets(std::span<ITemplatePtr> tmpls, ScreenData& sd, bool pyramid)
+{
+    using Target = ScreenData::Target;
 
+    uint32_t ret = 0;
+    for (auto& t : tmpls) {
+        auto& tmpl = cast(*t);
+        bool rgb = tmpl.match_pattern == ITemplate::MatchPattern::RGB;
+        switch (tmpl.match_pattern) {
+        case ITemplate::MatchPattern::RGB: set_flag(ret, Target::RGB, true); break;
+        case ITemplate::MatchPattern::Grayscale: set_flag(ret, Target::Grayscale, true); break;
+        case ITemplate::MatchPattern::Binary:
+            set_flag(ret, Target::Binary, true);
+            // binary is made from grayscale by the threshold of it
+            if (m_params.auto_threshold)
+                set_flag(ret, Target::Grayscale, true);
+            break;
+        case ITemplate::MatchPattern::Chamfer: ret |= uint32_t(Target::ContourBinary) | uint32_t(Target::Distance); break;
+        default: set_flag(ret, Target::ContourBinary, true); break;
+        }
+        // coarse levels of pyramid search are matched by rgb or grayscale
+        if (pyramid && tmpl.match_pattern != ITemplate::MatchPattern::Chamfer && !sd.levels.empty() && !getImage(tmpl, sd.info.scale_factor).levels.empty()) {
+            set_flag(ret, rgb ? Target::RGB : Target::Grayscale, true);
+            set_flag(ret, rgb ? Target::RGBLevels : Target::GrayscaleLevels, true);
+        }
+    }
+#ifdef mrDebug
+    if (g_dbg_sm_writeout)
+        ret |= uint32_t(Target::Grayscale) | uint32_t(Target::Binary) | uint32_t(Target::Contour);
+#endif
     return ret;
 }
 
-IReduceMinMaxPtr ScreenMatcher::pullReduceMinmax()
+// screens of captures are resized to the frame and laid out again when the size is changed
+IScreenCapture::FrameInfo ScreenMatcher::getFrame(ScreenData& sd)
 {
-    IReduceMinMaxPtr ret;
-    if (!m_reducers.empty()) {
-        ret = m_reducers.front();
-        m_reducers.pop_front();
-    }
-    else {
-        ret = m_gfx->createReduceMinMax();
+    auto frame = sd.capture->getFrame();
+    if (frame.surface && !m_captures.empty() && frame.size != sd.info.rect.size) {
+        sd.info.rect.size = frame.size;
+        initScreen(sd);
+
+        int x = 0;
+        for (auto& kvp : m_screens) {
+            kvp.second.info.rect.pos = { x, 0 };
+            x += kvp.second.info.rect.size.x;
+        }
     }
-    return ret;
+    return frame;
 }
 
-void ScreenMatcher::pushReduceMinmax(IReduceMinMaxPtr v)
+void ScreenMatcher::updateScreen(ScreenData& sd, std::span<ITemplatePtr> tmpls, bool pyramid)
 {
-    m_reducers.push_back(v);
+    // the frame first. the screen is laid out again (and its levels are made) if the size of the frame is changed.
+    auto frame = getFrame(sd);
+    updateScreen(sd, frame, getTargets(tmpls, sd, pyramid));
 }
 
-void ScreenMatcher::updateScreen(ScreenData& sd)
+void ScreenMatcher::updateScreen(ScreenData& sd, const IScreenCapture::FrameInfo& frame, uint32_t targets)
 {
-    auto frame = sd.capture->getFrame();
+    using Target = ScreenData::Target;
+
     if (!frame.surface)
         return;
 
-    if (frame.present_time != sd.last_frame) {
-        // make binarized surface
+    // targets made for the previous frame are updated only in changed regions. others are made from scratch.
+    uint32_t full = 0, partial_targets = 0;
+    std::vector<Rect> regions;
+    bool new_frame = frame.present_time != sd.last_frame;
+    if (new_frame) {
+        // if the capture tells changed regions since the last frame, update only them.
+        bool partial = sd.surface && frame.prev_present_time != 0 && frame.prev_present_time == sd.last_frame &&
+            GetDirtyRegions(frame.dirty_rects, frame.surface->getSize(), sd.grayscale->getSize(), regions);
+        if (partial)
+            partial_targets = targets & sd.updated;
+        full = targets & ~partial_targets;
+
+        sd.prev_frame = sd.last_frame;
         sd.last_frame = frame.present_time;
         sd.surface = frame.surface;
-        sd.filter->transform(sd.rgb, sd.surface, false);
-        sd.filter->grayscale(sd.grayscale, sd.surface, m_params.color_range);
-        sd.filter->binarize(sd.binary, sd.grayscale, m_params.binarize_threshold);
+        sd.updated = 0;
+        sd.partial_update = partial;
+
+        // contour depends on pixels around. dirty regions are extended by the radius.
+        sd.dirty_regions = regions;
+        if (partial) {
+            int halo = int(std::ceil(m_params.contour_radius));
+            Rect screen{ {}, sd.grayscale->getSize() };
+            for (auto& r : sd.dirty_regions)
+                r = r.expand(halo).intersect(screen);
+        }
+        else {
+            sd.dirty_regions = { Rect{} };
+        }
+    }
+    else {
+        // a template needs a target that was not made for this frame
+        full = targets & ~sd.updated;
+    }
+
+    // all intermediates are made in one pass from the surface, except binary with auto_threshold
+    bool auto_threshold = m_params.auto_threshold;
+    auto preprocess = [&](uint32_t t, Rect r) {
+        IFilterSet::PreprocessTargets dst;
+        if (get_flag(t, Target::RGB)) dst.rgb = sd.rgb;
+        if (get_flag(t, Target::Grayscale)) dst.grayscale = sd.grayscale;
+        if (get_flag(t, Target::Binary) && !auto_threshold) dst.binary = sd.binary;
+        if (get_flag(t, Target::Contour)) dst.contour = sd.contour;
+        if (get_flag(t, Target::ContourBinary)) dst.contour_b = sd.contour_b;
+        sd.filter->preprocess(dst, sd.surface, m_params.color_range, m_params.binarize_threshold, m_params.contour_radius, r);
+    };
+    if (partial_targets) {
+        for (auto& r : regions)
+            preprocess(partial_targets, r);
+    }
+    if (full)
+        preprocess(full, {});
+    uint32_t made = full | partial_targets;
+    sd.updated |= made;
+
+    // distances change within the max distance from changed edges
+    if (get_flag(made, Target::Distance)) {
+        int2 size = sd.contour_b->getSize();
+        if (!sd.distance)
+            sd.distance = m_gfx->createTexture(size.x, size.y, TextureFormat::Rf32);
+
+        float max_distance = m_params.chamfer_max_distance;
+        if (get_flag(partial_targets, Target::Distance)) {
+            int halo = int(std::ceil(max_distance));
+            for (auto& r : sd.dirty_regions)
+                sd.filter->distanceTransform(sd.distance, sd.contour_b, max_distance, r.expand(halo).intersect(Rect{ {}, size }));
+        }
+        else {
+            sd.filter->distanceTransform(sd.distance, sd.contour_b, max_distance);
+        }
+    }
 
-        sd.filter->contour(sd.contour, sd.grayscale, m_params.contour_radius);
-        sd.filter->binarize(sd.contour_b, sd.contour, m_params.binarize_threshold);
+    // binary by the Otsu threshold of the whole frame. if the threshold is changed, binary is changed everywhere and
+    // results of the previous frame can't be reused.
+    if (auto_threshold && get_flag(made, Target::Binary)) {
+        float threshold = GetOtsuThreshold(sd.filter->histogram(sd.grayscale).get());
+        if (get_flag(partial_targets, Target::Binary) && threshold == sd.binary_threshold) {
+            for (auto& r : regions)
+                sd.filter->binarize(sd.binary, sd.grayscale, threshold, r);
+        }
+        else {
+            sd.filter->binarize(sd.binary, sd.grayscale, threshold);
+            if (threshold != sd.binary_threshold)
+                sd.partial_update = false;
+        }
+        sd.binary_threshold = threshold;
+    }
+
+    // each level is made from the previous level
+    bool rgb_levels = get_flag(made, Target::RGBLevels);
+    bool grayscale_levels = get_flag(made, Target::GrayscaleLevels);
+    for (size_t i = 0; i < sd.levels.size(); ++i) {
+        auto& level = sd.levels[i];
+        if (rgb_levels)
+            sd.filter->transform(level.rgb, i == 0 ? sd.rgb : sd.levels[i - 1].rgb, false, true);
+        if (grayscale_levels)
+            sd.filter->transform(level.grayscale, i == 0 ? sd.grayscale : sd.levels[i - 1].grayscale, false, true);
+    }
 
 #ifdef mrDebug
-        if (g_dbg_sm_writeout) {
-            mrDbgPrint("writing frame %llu\n", sd.last_frame);
-            sd.grayscale->save(Format("frame_%llu_grayscale.png", sd.last_frame));
-            sd.binary->save(Format("frame_%llu_binary.png", sd.last_frame));
-            sd.contour->save(Format("frame_%llu_contour.png", sd.last_frame));
-        }
-#endif
+    if (g_dbg_sm_writeout && new_frame) {
+        mrDbgPrint("writing frame %llu\n", sd.last_frame);
+        sd.grayscale->save(Format("frame_%llu_grayscale.png", sd.last_frame));
+        sd.binary->save(Format("frame_%llu_binary.png", sd.last_frame));
+        sd.contour->save(Format("frame_%llu_contour.png", sd.last_frame));
     }
+#endif
 }
 
-void ScreenMatcher::matchImpl(Template& tmpl, ScreenData& sd, Rect rect)
+void ScreenMatcher::matchImpl(Template& tmpl, ScreenData& sd, Rect rect, float threshold, std::vector<BatchEntry>* batch)
 {
-    auto& img = tmpl.getImage(sd.info.scale_factor);
+    auto& img = getImage(tmpl, sd.info.scale_factor);
 
     float scale = m_params.scale;
 
-    auto region = Rect{
+    auto area = Rect{
         rect.pos - sd.info.rect.pos,
         rect.size
     } * scale;
-    region.size -= img.grayscale->getSize();
+    auto region = area;
+    region.size -= img.size;
 
     if (region.size.x < 0 || region.size.y < 0) {
         // rect is smaller than template. this should not be happened.
         return;
     }
 
-    // dispatch template match & minmax
-    auto minmax = pullReduceMinmax();
-    minmax->setRegion({ {}, region.size });
+    // no threshold is the same as the infinite one for the match cache: all results are exact.
+    bool has_threshold = threshold >= 0.0f;
+    float cache_threshold = has_threshold ? threshold : std::numeric_limits<float>::max();
+    auto& cache = sd.match_cache[&tmpl];
+    bool cache_valid = cache.frame != 0 && cache.area == area && cache.pattern == tmpl.match_pattern && cache_threshold <= cache.threshold;
+    auto update_cache = [&cache, area, pattern = tmpl.match_pattern, cache_threshold, frame = sd.last_frame](const IReduceMinMax::Result& mm, bool exact) {
+        cache = { frame, area, pattern, exact, cache_threshold, mm };
+    };
+    // results that are lower bounds stay valid lower bounds when they are combined by min, so they work with the match
+    // cache as exact results as long as the threshold is not raised.
+    float cutoff = GetCutoff(m_params, tmpl, img, threshold);
+
+    if (cache_valid && cache.frame == sd.last_frame) {
+        // the screen is not changed since the last match
+        auto mm = cache.mm;
+        auto deferred = std::async(std::launch::deferred,
+            [this, &tmpl, &img, &sd, mm, rect, threshold]() { return makeResult(tmpl, img, sd, mm, rect, threshold); });
+        sd.deferred_results.push_back(std::move(deferred));
+        return;
+    }
 
-    switch (tmpl.match_pattern) {
-    case ITemplate::MatchPattern::RGB:
-        sd.filter->match(sd.match_f, sd.rgb, img.rgb, nullptr, region);
-        minmax->setSrc(sd.match_f);
-        break;
-    case ITemplate::MatchPattern::Grayscale:
-        sd.filter->match(sd.match_f, sd.grayscale, img.grayscale, nullptr, region);
-        minmax->setSrc(sd.match_f);
-        break;
-    case ITemplate::MatchPattern::Binary:
-        sd.filter->match(sd.match_i, sd.binary, img.binary, nullptr, region);
-        minmax->setSrc(sd.match_i);
-        break;
-    default:
-        sd.filter->match(sd.match_i, sd.contour_b, img.contour_b, img.mask, region);
-        minmax->setSrc(sd.match_i);
-        break;
+    auto t = SelectTargets(tmpl.match_pattern, sd, img);
+
+    // if the screen is partially updated, scores of positions whose template window doesn't overlap changed regions are unchanged.
+    // as long as the last minimum is one of them, matching changed positions and comparing with it is enough.
+    if (cache_valid && cache.exact && cache.frame == sd.prev_frame && sd.partial_update) {
+        int2 tsize = t.tmpl->getSize();
+        Rect last_min{ region.pos + cache.mm.pos_min, tsize };
+        bool min_changed = false;
+        std::vector<Rect> windows;
+        // the distance map is changed around changed regions too
+        int halo = tmpl.match_pattern == ITemplate::MatchPattern::Chamfer ? int(std::ceil(m_params.chamfer_max_distance)) : 0;
+        for (auto& dr : sd.dirty_regions) {
+            auto d = dr.expand(halo);
+            if (d.overlaps(last_min)) {
+                min_changed = true;
+                break;
+            }
+            auto w = Rect{ d.pos - tsize + 1, d.size + tsize - 1 }.intersect(region);
+            if (!w.empty())
+                windows.push_back(w);
+        }
+
+        if (!min_changed) {
+            std::vector<std::pair<std::future<IReduceMinMax::Result>, int2>> parts;
+            for (auto& w : windows)
+                parts.push_back({ matchMin(tmpl, img, sd, w, cutoff), w.pos - region.pos });
+
+            auto deferred = std::async(std::launch::deferred,
+                [this, &tmpl, &img, &sd, mm = cache.mm, parts = std::move(parts), update_cache, rect, threshold, is_float = t.is_float]() mutable
+            {
+                for (auto& [part, offset] : parts) {
+                    auto r = part.get();
+
+                    // keep the first one in scanline order on ties as brute force does
+                    int2 pos = offset + r.pos_min;
+                    bool less = is_float ? r.valf_min < mm.valf_min : r.vali_min < mm.vali_min;
+                    bool equal = is_float ? r.valf_min == mm.valf_min : r.vali_min == mm.vali_min;
+                    if (less || (equal && (pos.y < mm.pos_min.y || (pos.y == mm.pos_min.y && pos.x < mm.pos_min.x)))) {
+                        mm.valf_min = r.valf_min; // copies vali_min too
+                        mm.pos_min = pos;
+                    }
+                }
+                update_cache(mm, true);
+                return makeResult(tmpl, img, sd, mm, rect, threshold);
+            });
+            sd.deferred_results.push_back(std::move(deferred));
+            return;
+        }
+    }
+
+    // targets rarely move. if the last result was a hit, search around it first and fall back to the full search if it missed.
+    if (cache_valid && has_threshold && m_params.local_search_radius > 0 && GetScore(cache.pattern, img, cache.mm) <= threshold) {
+        int radius = std::max(int(float(m_params.local_search_radius) * scale), 1);
+        auto window = Rect{ region.pos + cache.mm.pos_min - radius, int2{ radius * 2 + 1, radius * 2 + 1 } }.intersect(region);
+        if (!window.empty()) {
+            auto result = matchMin(tmpl, img, sd, window, cutoff);
+            auto deferred = std::async(std::launch::deferred,
+                [this, &tmpl, &img, &sd, result = std::move(result), update_cache, rect, area, threshold, offset = window.pos - region.pos]() mutable
+            {
+                auto mm = result.get();
+                mm.pos_min += offset;
+                if (GetScore(tmpl.match_pattern, img, mm) <= threshold) {
+                    ++tmpl.local_hits;
+                    update_cache(mm, false); // not necessarily the minimum of the entire area
+                }
+                else {
+                    ++tmpl.local_misses;
+                    bool exact = matchFull(tmpl, img, sd, area, threshold, mm);
+                    update_cache(mm, exact);
+                }
+                return makeResult(tmpl, img, sd, mm, rect, threshold);
+            });
+            sd.deferred_results.push_back(std::move(deferred));
+            return;
+        }
+    }
+
+    if (!img.levels.empty() && !sd.levels.empty()) {
+        IReduceMinMax::Result mm;
+        if (matchPyramid(tmpl, img, sd, area, mm)) {
+            update_cache(mm, false);
+            auto deferred = std::async(std::launch::deferred,
+                [this, &tmpl, &img, &sd, mm, rect, threshold]() { return makeResult(tmpl, img, sd, mm, rect, threshold); });
+            sd.deferred_results.push_back(std::move(deferred));
+            return;
+        }
+        // fall back to brute force
+    }
+
+    {
+        IReduceMinMax::Result mm;
+        if (matchSparse(tmpl, img, sd, area, threshold, mm) || matchFFT(tmpl, img, sd, area, mm)) {
+            update_cache(mm, false);
+            auto deferred = std::async(std::launch::deferred,
+                [this, &tmpl, &img, &sd, mm, rect, threshold]() { return makeResult(tmpl, img, sd, mm, rect, threshold); });
+            sd.deferred_results.push_back(std::move(deferred));
+            return;
+        }
+    }
+
+    auto finish = [this, &tmpl, &img, &sd, update_cache, rect, threshold](const IReduceMinMax::Result& mm) {
+        update_cache(mm, true);
+        return makeResult(tmpl, img, sd, mm, rect, threshold);
+    };
+    if (batch && m_params.batch_match && !t.mask && t.src->getFormat() != TextureFormat::Binary &&
+        tmpl.match_pattern != ITemplate::MatchPattern::Chamfer) {
+        batch->push_back({ t.src, { t.tmpl, region, cutoff }, sd.deferred_results.size(), finish });
+        sd.deferred_results.emplace_back(); // made by matchBatch()
+        return;
     }
-    minmax->dispatch();
+
+    // dispatch fused template match & min reduction. the score map is not made.
+    auto result = matchMin(tmpl, img, sd, region, cutoff);
 
     // make deferred result to dispatch next matching without blocking
     auto deferred = std::async(std::launch::deferred,
-        [this, &tmpl, &img, &sd, minmax, scale, rect]() mutable
+        [result = std::move(result), finish]() mutable { return finish(result.get()); });
+    sd.deferred_results.push_back(std::move(deferred));
+}
+
+// templates that match the same screen image are matched at once. the screen is read once for all of them
+// instead of once for each template.
+void ScreenMatcher::matchBatch(ScreenData& sd, std::vector<BatchEntry>& batch)
+{
+    std::map<ITexture2D*, std::vector<BatchEntry*>> groups;
+    for (auto& e : batch)
+        groups[e.src.get()].push_back(&e);
+
+    for (auto& [src, entries] : groups) {
+        if (entries.size() == 1) {
+            auto& e = *entries.front();
+            auto result = sd.filter->matchMin(e.src, e.target.tmpl, nullptr, e.target.region, e.target.cutoff);
+            sd.deferred_results[e.result_index] = std::async(std::launch::deferred,
+                [result = std::move(result), finish = std::move(e.finish)]() mutable { return finish(result.get()); });
+            continue;
+        }
+
+        std::vector<IFilterSet::MatchMinTarget> targets;
+        for (auto* e : entries)
+            targets.push_back(e->target);
+        auto results = sd.filter->matchMinMulti(entries.front()->src, targets).share();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto& e = *entries[i];
+            sd.deferred_results[e.result_index] = std::async(std::launch::deferred,
+                [results, i, finish = std::move(e.finish)]() { return finish(results.get()[i]); });
+        }
+    }
+    batch.clear();
+}
+
+// fused template match & min reduction of the match pattern. pos_min of the result is relative to region.pos.
+std::future<IReduceMinMax::Result> ScreenMatcher::matchMin(Template& tmpl, Template::Image& img, ScreenData& sd, Rect region, float cutoff)
+{
+    if (tmpl.match_pattern == ITemplate::MatchPattern::Chamfer)
+        return sd.filter->matchChamferMin(sd.distance, img.points, region, cutoff);
+
+    auto t = SelectTargets(tmpl.match_pattern, sd, img);
+    return sd.filter->matchMin(t.src, t.tmpl, t.mask, region, cutoff);
+}
+
+// coarse-to-fine search.
+// find candidates at the coarsest level and then search small windows around them at finer levels.
+// area is the search area in level 0 (not subtracted by template size). mm.pos_min is relative to area.pos.
+// chamfer matching has no coarse levels and returns false.
+bool ScreenMatcher::matchPyramid(Template& tmpl, Template::Image& img, ScreenData& sd, Rect area, IReduceMinMax::Result& mm)
+{
+    if (tmpl.match_pattern == ITemplate::MatchPattern::Chamfer)
+        return false;
+
+    auto get_targets = [&](int level) {
+        if (level == 0)
+            return SelectTargets(tmpl.match_pattern, sd, img);
+
+        auto& sl = sd.levels[level - 1];
+        auto& tl = img.levels[level - 1];
+        if (tmpl.match_pattern == ITemplate::MatchPattern::RGB)
+            return MatchTargets{ sl.match_f, sl.rgb, tl.rgb, nullptr, true };
+        else
+            return MatchTargets{ sl.match_f, sl.grayscale, tl.grayscale, nullptr, true };
+    };
+    auto get_region = [&](int level) {
+        int d = 1 << level;
+        return Rect{ area.pos / d, area.size / d - get_targets(level).tmpl->getSize() };
+    };
+
+    int top = std::min((int)img.levels.size(), (int)sd.levels.size());
+    while (top > 0) {
+        auto r = get_region(top);
+        if (r.size.x > 0 && r.size.y > 0)
+            break;
+        --top;
+    }
+    if (top == 0)
+        return false;
+
+    // find candidates at the coarsest level
+    std::vector<int2> candidates;
     {
-        auto tsize = img.binary->getSize();
-        auto mm = minmax->getResult();
-        pushReduceMinmax(minmax);
-
-        Result ret;
-        ret.surface = sd.surface;
-        ret.region = Rect{
-            rect.pos + int2(float2(mm.pos_min) / scale),
-            int2(float2(tsize) / scale)
+        auto t = get_targets(top);
+        auto region = get_region(top);
+        sd.filter->match(t.dst, t.src, t.tmpl, t.mask, region);
+
+        auto tsize = t.tmpl->getSize();
+        int count = std::max(m_params.pyramid_candidates, 1);
+        int distance = std::max(std::min(tsize.x, tsize.y) / 2, PyramidRefineRadius);
+        t.dst->read([&](const void* data, int pitch) {
+            if (t.is_float)
+                candidates = PickCandidates<float>(data, pitch, region.size, count, distance);
+            else
+                candidates = PickCandidates<uint32_t>(data, pitch, region.size, count, distance);
+            });
+        for (auto& c : candidates)
+            c += region.pos;
+    }
+
+    // refine
+    bool found = false;
+    for (int level = top - 1; level >= 0; --level) {
+        auto t = get_targets(level);
+        auto region = get_region(level);
+
+        struct Window
+        {
+            std::future<IReduceMinMax::Result> result;
+            int2 pos;
         };
+        std::vector<Window> windows;
+        for (auto& c : candidates) {
+            int2 center = c * 2 - region.pos;
+            int2 tl = max(center - PyramidRefineRadius, int2::zero());
+            int2 br = min(center + (PyramidRefineRadius + 1), region.size);
+            if (tl.x >= br.x || tl.y >= br.y)
+                continue;
+
+            Rect window{ region.pos + tl, br - tl };
+            windows.push_back({ sd.filter->matchMin(t.src, t.tmpl, t.mask, window), window.pos });
+        }
 
-        switch (tmpl.match_pattern) {
-        case ITemplate::MatchPattern::Grayscale:
-            ret.score = float(double(mm.valf_min) / double(tsize.x * tsize.y));
-#ifdef mrDebug
-            ret.result = sd.match_f;
-#endif
-            break;
-        case ITemplate::MatchPattern::Binary:
-            ret.score = float(double(mm.vali_min) / double(tsize.x * tsize.y));
-#ifdef mrDebug
-            ret.result = sd.match_i;
-#endif
-            break;
-        default:
-            ret.score = float(double(mm.vali_min) / double(img.mask_bits));
-#ifdef mrDebug
-            ret.result = sd.match_i;
-#endif
-            break;
+        candidates.clear();
+        for (auto& w : windows) {
+            auto r = w.result.get();
+            candidates.push_back(w.pos + r.pos_min);
+
+            if (level == 0) {
+                bool better = t.is_float ? r.valf_min < mm.valf_min : r.vali_min < mm.vali_min;
+                if (!found || better) {
+                    mm = r;
+                    mm.pos_min = w.pos + r.pos_min - region.pos;
+                    found = true;
+                }
+            }
         }
-#ifdef mrDebug
-        //ret.result->save(Format("frame_%llu_result.png", sd.last_frame));
-#endif
+    }
+    return found;
+}
 
-        return ret;
-    });
-    m_deferred_results.push_back(std::move(deferred));
+// candidates are picked from the FFT score map (sum of squared differences) and small windows around them are searched
+// by the direct matching. for a clear match, the minima of both scores are at the same place.
+// returns false if FFT is not suitable for the template. mm.pos_min is relative to area.pos.
+bool ScreenMatcher::matchFFT(Template& tmpl, Template::Image& img, ScreenData& sd, Rect area, IReduceMinMax::Result& mm)
+{
+    auto region = area;
+    region.size -= img.size;
+    if (!ShouldUseFFT(tmpl.match_pattern, region.size, img.size, m_params.fft_candidates))
+        return false;
+
+    auto t = SelectTargets(tmpl.match_pattern, sd, img);
+    if (!sd.match_f) {
+        int2 size = sd.grayscale->getSize();
+        sd.match_f = m_gfx->createTexture(size.x, size.y, TextureFormat::Rf32);
+    }
+    sd.filter->matchFFT(sd.match_f, t.src, t.tmpl, region);
+    auto candidates = sd.filter->topK(sd.match_f, std::numeric_limits<float>::max(), m_params.fft_candidates, img.size, { {}, region.size }).get();
+    return refineCandidates(tmpl, img, sd, region, candidates, FFTRefineRadius, mm);
+}
+
+// templates with samples are matched by them first (see ISparseMatch). the best candidates are verified by the direct
+// matching unless Params::sparse_candidates is 0. positions are rejected as soon as the sum of samples exceeds the
+// threshold scaled to the number of samples, so the most discriminative samples decide most of them.
+// returns false if the template has no samples. mm.pos_min is relative to area.pos.
+bool ScreenMatcher::matchSparse(Template& tmpl, Template::Image& img, ScreenData& sd, Rect area, float threshold, IReduceMinMax::Result& mm)
+{
+    bool supported = tmpl.match_pattern == ITemplate::MatchPattern::RGB || tmpl.match_pattern == ITemplate::MatchPattern::Grayscale;
+    if (!supported || tmpl.sample_budget <= 0 || img.samples.empty())
+        return false;
+
+    auto region = area;
+    region.size -= img.size;
+    auto t = SelectTargets(tmpl.match_pattern, sd, img);
+    if (!sd.match_f) {
+        int2 size = sd.grayscale->getSize();
+        sd.match_f = m_gfx->createTexture(size.x, size.y, TextureFormat::Rf32);
+    }
+    double num_samples = double(img.samples.size());
+    float cutoff = m_params.threshold_cutoff && threshold >= 0.0f ? float(double(threshold) * num_samples) : -1.0f;
+    sd.filter->matchSparse(sd.match_f, t.src, img.samples, region, cutoff);
+
+    if (m_params.sparse_candidates <= 0) {
+        mm = sd.filter->minmax(sd.match_f, Rect{ {}, region.size }).get();
+        // the mean of the samples in the unit of the direct matching
+        mm.valf_min = float(double(mm.valf_min) / num_samples * GetScoreDenominator(tmpl.match_pattern, img));
+        return true;
+    }
+    auto candidates = sd.filter->topK(sd.match_f, std::numeric_limits<float>::max(), m_params.sparse_candidates, img.size, { {}, region.size }).get();
+    return refineCandidates(tmpl, img, sd, region, candidates, SparseRefineRadius, mm);
 }
 
-IScreenMatcher::Result ScreenMatcher::reduceResults(std::span<ITemplatePtr> tmpls)
+// search windows of the radius around candidates (relative to region.pos) by the direct matching and take the best.
+// mm.pos_min is relative to region.pos.
+bool ScreenMatcher::refineCandidates(Template& tmpl, Template::Image& img, ScreenData& sd, Rect region, const IReduceTopK::Result& candidates, int radius, IReduceMinMax::Result& mm)
 {
+    std::vector<std::pair<std::future<IReduceMinMax::Result>, int2>> windows;
+    for (auto& c : candidates) {
+        auto w = Rect{ region.pos + c.pos - radius, int2{ radius * 2 + 1, radius * 2 + 1 } }.intersect(region);
+        if (!w.empty())
+            windows.push_back({ matchMin(tmpl, img, sd, w), w.pos - region.pos });
+    }
+
+    bool found = false;
+    for (auto& [result, offset] : windows) {
+        auto r = result.get();
+
+        // keep the first one in scanline order on ties as brute force does
+        int2 pos = offset + r.pos_min;
+        if (!found || r.valf_min < mm.valf_min ||
+            (r.valf_min == mm.valf_min && (pos.y < mm.pos_min.y || (pos.y == mm.pos_min.y && pos.x < mm.pos_min.x)))) {
+            mm = r;
+            mm.pos_min = pos;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// search the entire area and wait for the result. mm.pos_min is relative to area.pos.
+// returns false if the result is from pyramid or FFT search and may not be the minimum.
+bool ScreenMatcher::matchFull(Template& tmpl, Template::Image& img, ScreenData& sd, Rect area, float threshold, IReduceMinMax::Result& mm)
+{
+    if (!img.levels.empty() && !sd.levels.empty() && matchPyramid(tmpl, img, sd, area, mm))
+        return false;
+    if (matchSparse(tmpl, img, sd, area, threshold, mm) || matchFFT(tmpl, img, sd, area, mm))
+        return false;
+
+    auto region = area;
+    region.size -= img.size;
+    mm = matchMin(tmpl, img, sd, region, GetCutoff(m_params, tmpl, img, threshold)).get();
+    return true;
+}
+
+IScreenMatcher::Result ScreenMatcher::makeResult(Template& tmpl, Template::Image& img, ScreenData& sd, const IReduceMinMax::Result& mm, Rect rect, float threshold)
+{
+    float scale = m_params.scale;
+    auto tsize = img.size;
+
     Result ret;
-    for (auto& dr : m_deferred_results) {
+    ret.surface = sd.surface;
+    ret.region = Rect{
+        rect.pos + int2(float2(mm.pos_min) / scale),
+        int2(float2(tsize) / scale)
+    };
+
+    ret.score = GetScore(tmpl.match_pattern, img, mm);
+    // misses may be lower bounds by the cutoff. they must not be taken for the score of the region.
+    ret.pruned = m_params.threshold_cutoff && threshold >= 0.0f && ret.score > threshold;
+
+    return ret;
+}
+
+void ScreenMatcher::matchScreen(std::span<ITemplatePtr> tmpls, ScreenData& sd, Rect rect, float threshold)
+{
+    std::vector<BatchEntry> batch;
+    for (auto& t : tmpls)
+        matchImpl(cast(*t), sd, rect, threshold, &batch);
+    matchBatch(sd, batch);
+}
+
+IScreenMatcher::Result ScreenMatcher::reduceResults(ScreenData& sd)
+{
+    Result ret;
+    for (auto& dr : sd.deferred_results) {
         auto r = dr.get();
         if (r.score < ret.score)
             ret = r;
     }
-    m_deferred_results.clear();
+    sd.deferred_results.clear();
+    return ret;
+}
+
+IScreenMatcher::Result ScreenMatcher::match(std::span<ITemplatePtr> tmpls, HMONITOR target, float threshold)
+{
+    auto i = !m_captures.empty() ? m_screens.begin() : m_screens.find(target);
+    if (i != m_screens.end()) {
+        auto& sd = i->second;
+        updateScreen(sd, tmpls, true);
+        matchScreen(tmpls, sd, sd.info.rect, threshold);
+        return reduceResults(sd);
+    }
+    return {};
+}
+
+IScreenMatcher::Result ScreenMatcher::match(std::span<ITemplatePtr> tmpls, HWND target, float threshold)
+{
+    auto i = !m_captures.empty() ? m_screens.begin() : m_screens.find(::MonitorFromWindow(target, MONITOR_DEFAULTTONULL));
+    if (i != m_screens.end()) {
+        auto& sd = i->second;
+        updateScreen(sd, tmpls, true);
+        auto rect = !m_captures.empty() ? sd.info.rect : GetRect(target);
+        matchScreen(tmpls, sd, rect, threshold);
+        return reduceResults(sd);
+    }
+    return {};
+}
+
+IScreenMatcher::Result ScreenMatcher::matchAllScreens(std::span<ITemplatePtr> tmpls, float threshold)
+{
+    // frames are taken and template images are made beforehand. workers only touch their own screen after that.
+    std::vector<ScreenData*> screens;
+    std::vector<IScreenCapture::FrameInfo> frames;
+    for (auto& kvp : m_screens) {
+        auto& sd = kvp.second;
+        frames.push_back(getFrame(sd));
+        screens.push_back(&sd);
+        for (auto& t : tmpls)
+            getImage(cast(*t), sd.info.scale_factor);
+    }
+
+    int n = (int)screens.size();
+    std::vector<Result> results(n);
+    auto dispatch = [&](int i) {
+        auto& sd = *screens[i];
+        updateScreen(sd, frames[i], getTargets(tmpls, sd, true));
+        matchScreen(tmpls, sd, sd.info.rect, threshold);
+    };
+    // with a single core, workers only add the overhead of switching between screens
+    bool parallel = m_params.parallel_screens && n > 1 && m_gfx->supportsConcurrentDispatch() && std::thread::hardware_concurrency() > 1;
+    if (parallel) {
+        ParallelFor(0, n, 1, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                dispatch(i);
+                results[i] = reduceResults(*screens[i]);
+            }
+            });
+    }
+    else {
+        // the device works on all screens while results are read back
+        for (int i = 0; i < n; ++i)
+            dispatch(i);
+        for (int i = 0; i < n; ++i)
+            results[i] = reduceResults(*screens[i]);
+    }
+
+    Result ret;
+    for (auto& r : results) {
+        if (r.score < ret.score)
+            ret = r;
+    }
+    return ret;
+}
+
+void ScreenMatcher::matchAllImpl(Template& tmpl, ScreenData& sd, Rect rect, float threshold, int max_count)
+{
+    auto& img = getImage(tmpl, sd.info.scale_factor);
+
+    auto area = Rect{
+        rect.pos - sd.info.rect.pos,
+        rect.size
+    } * m_params.scale;
+    auto region = area;
+    region.size -= img.size;
+    if (region.size.x < 0 || region.size.y < 0)
+        return;
+
+    // all positions are needed. pyramid search and the match cache don't help here.
+    auto t = SelectTargets(tmpl.match_pattern, sd, img);
+    auto& dst = t.is_float ? sd.match_f : sd.match_i;
+    if (!dst) {
+        int2 size = sd.grayscale->getSize();
+        dst = m_gfx->createTexture(size.x, size.y, t.is_float ? TextureFormat::Rf32 : TextureFormat::Ri32);
+    }
+    if (tmpl.match_pattern == ITemplate::MatchPattern::Chamfer)
+        sd.filter->matchChamfer(dst, t.src, img.points, region);
+    else
+        sd.filter->match(dst, t.src, t.tmpl, t.mask, region);
+
+    // the score map is reused by the next template. reducing it is dispatched before that and only the readback is deferred.
+    float raw_threshold = float(double(threshold) * GetScoreDenominator(tmpl.match_pattern, img));
+    auto result = sd.filter->topK(dst, raw_threshold, max_count, t.tmpl->getSize(), { {}, region.size });
+    auto deferred = std::async(std::launch::deferred,
+        [this, &tmpl, &img, &sd, result = std::move(result), rect]() mutable
+    {
+        std::vector<Result> ret;
+        for (auto& c : result.get()) {
+            IReduceMinMax::Result mm{};
+            mm.pos_min = c.pos;
+            mm.vali_min = c.vali; // copies valf_min too
+            ret.push_back(makeResult(tmpl, img, sd, mm, rect));
+        }
+        return ret;
+    });
+    m_deferred_all_results.push_back(std::move(deferred));
+}
+
+std::vector<IScreenMatcher::Result> ScreenMatcher::reduceAllResults(int max_count)
+{
+    std::vector<Result> all;
+    for (auto& dr : m_deferred_all_results) {
+        auto r = dr.get();
+        all.insert(all.end(), std::make_move_iterator(r.begin()), std::make_move_iterator(r.end()));
+    }
+    m_deferred_all_results.clear();
+
+    // results of each template don't overlap each other. suppress results of other templates found at the same place.
+    std::stable_sort(all.begin(), all.end(), [](auto& a, auto& b) { return a.score < b.score; });
+    std::vector<Result> ret;
+    for (auto& r : all) {
+        if ((int)ret.size() >= max_count)
+            break;
+        int2 center = r.region.getCenter();
+        bool suppressed = std::any_of(ret.begin(), ret.end(), [&](auto& v) {
+            return v.region.overlaps(Rect{ center, { 1, 1 } });
+            });
+        if (!suppressed)
+            ret.push_back(std::move(r));
+    }
     return ret;
 }
 
-IScreenMatcher::Result ScreenMatcher::match(std::span<ITemplatePtr> tmpls, HMONITOR target)
+std::vector<IScreenMatcher::Result> ScreenMatcher::matchAll(std::span<ITemplatePtr> tmpls, HMONITOR target, float threshold, int max_count)
 {
-    auto i = m_screens.find(target);
+    auto i = !m_captures.empty() ? m_screens.begin() : m_screens.find(target);
     if (i != m_screens.end()) {
         auto& sd = i->second;
-        updateScreen(sd);
+        updateScreen(sd, tmpls, false);
         for (auto& t : tmpls)
-            matchImpl(cast(*t), sd, sd.info.rect);
+            matchAllImpl(cast(*t), sd, sd.info.rect, threshold, max_count);
     }
-    return reduceResults(tmpls);
+    return reduceAllResults(max_count);
 }
 
-IScreenMatcher::Result ScreenMatcher::match(std::span<ITemplatePtr> tmpls, HWND target)
+std::vector<IScreenMatcher::Result> ScreenMatcher::matchAll(std::span<ITemplatePtr> tmpls, HWND target, float threshold, int max_count)
 {
-    auto i = m_screens.find(::MonitorFromWindow(target, MONITOR_DEFAULTTONULL));
+    auto i = !m_captures.empty() ? m_screens.begin() : m_screens.find(::MonitorFromWindow(target, MONITOR_DEFAULTTONULL));
     if (i != m_screens.end()) {
         auto& sd = i->second;
-        updateScreen(sd);
-        auto rect = GetRect(target);
+        updateScreen(sd, tmpls, false);
+        auto rect = !m_captures.empty() ? sd.info.rect : GetRect(target);
         for (auto& t : tmpls)
-            matchImpl(cast(*t), sd, rect);
+            matchAllImpl(cast(*t), sd, rect, threshold, max_count);
     }
-    return reduceResults(tmpls);
+    return reduceAllResults(max_count);
 }
 
 
@@ -49,6 +49,7 @@ public:
 
 private:
     ComputeShader m_cs;
+    ComputeShader m_cs_minmax;
 };
 
 
@@ -62,6 +63,32 @@ public:
 private:
     ComputeShader m_cs_grayscale;
     ComputeShader m_cs_binary;
+    ComputeShader m_cs_minmax;
+};
+
+
+class DistanceTransformCS : public ICompute
+{
+public:
+    DistanceTransformCS();
+    void dispatch(ICSContext& ctx) override;
+    IDistanceTransformPtr createContext();
+
+private:
+    ComputeShader m_cs_cols;
+    ComputeShader m_cs_rows;
+};
+
+
+class PreprocessCS : public ICompute
+{
+public:
+    PreprocessCS();
+    void dispatch(ICSContext& ctx) override;
+    IPreprocessPtr createContext();
+
+private:
+    ComputeShader m_cs;
 };
 
 
@@ -79,6 +106,86 @@ private:
 };
 
 
+class TemplateMatchMinCS : public ICompute
+{
+public:
+    TemplateMatchMinCS();
+    void dispatch(ICSContext& ctx) override;
+    ITemplateMatchMinPtr createContext();
+
+private:
+    ComputeShader m_cs_grayscale;
+    ComputeShader m_cs_binary;
+    ComputeShader m_cs_rgb;
+    ComputeShader m_cs_reduce;
+};
+
+
+class TemplateMatchMinMultiCS : public ICompute
+{
+public:
+    TemplateMatchMinMultiCS();
+    void dispatch(ICSContext& ctx) override;
+    ITemplateMatchMinMultiPtr createContext();
+
+private:
+    ComputeShader m_cs_grayscale;
+    ComputeShader m_cs_rgb;
+    ComputeShader m_cs_reduce;
+};
+
+
+class TemplateMatchFFTCS : public ICompute
+{
+public:
+    TemplateMatchFFTCS();
+    void dispatch(ICSContext& ctx) override;
+    ITemplateMatchFFTPtr createContext();
+
+private:
+    ComputeShader m_cs_rows;
+    ComputeShader m_cs_cols;
+    ComputeShader m_cs_rows_inv;
+    ComputeShader m_cs_sum_sq;
+};
+
+
+class ChamferMatchCS : public ICompute
+{
+public:
+    ChamferMatchCS();
+    void dispatch(ICSContext& ctx) override;
+    IChamferMatchPtr createContext();
+
+private:
+    ComputeShader m_cs;
+};
+
+
+class ChamferMatchMinCS : public ICompute
+{
+public:
+    ChamferMatchMinCS();
+    void dispatch(ICSContext& ctx) override;
+    IChamferMatchMinPtr createContext();
+
+private:
+    ComputeShader m_cs;
+    ComputeShader m_cs_reduce;
+};
+
+
+class SparseMatchCS : public ICompute
+{
+public:
+    SparseMatchCS();
+    void dispatch(ICSContext& ctx) override;
+    ISparseMatchPtr createContext();
+
+private:
+    ComputeShader m_cs;
+};
+
 class ShapeCS : public ICompute
 {
 public:
@@ -134,5 +241,32 @@ private:
     ComputeShader m_cs_ipass2;
 };
 
+
+class ReduceTopKCS : public ICompute
+{
+public:
+    ReduceTopKCS();
+    void dispatch(ICSContext& ctx) override;
+    IReduceTopKPtr createContext();
+
+private:
+    ComputeShader m_cs_fpass1;
+    ComputeShader m_cs_ipass1;
+    ComputeShader m_cs_clear;
+};
+
+
+class ReduceHistogramCS : public ICompute
+{
+public:
+    ReduceHistogramCS();
+    void dispatch(ICSContext& ctx) override;
+    IReduceHistogramPtr createContext();
+
+private:
+    ComputeShader m_cs_pass1;
+    ComputeShader m_cs_clear;
+};
+
 } // namespace mr
 
@@ -21,6 +21,9 @@ std::string OpRecord::toText() const
         case ITemplate::MatchPattern::RGB:
             ret += " Pattern:\"RGB\"";
             break;
+        case ITemplate::MatchPattern::Chamfer:
+            ret += " Pattern:\"Chamfer\"";
+            break;
         default:
             break;
         }
@@ -71,10 +74,10 @@ std::string OpRecord::toText() const
     }
 
     case OpType::MouseMoveMatch:
-        return Format("%u: MouseMoveMatch") + templates_to_string();
+        return Format("%u: MouseMoveMatch", time) + templates_to_string();
 
     case OpType::WaitUntilMatch:
-        return Format("%u: WaitUntilMatch") + templates_to_string();
+        return Format("%u: WaitUntilMatch", time) + templates_to_string();
 
     case OpType::Wait:
         return Format("%u: Wait %d", time, exdata.wait_time);
@@ -90,16 +93,118 @@ std::string OpRecord::toText() const
     }
 }
 
+// strtol() for base 10 without locale overhead. advances src and returns false if there are no digits.
+template<class T>
+static inline bool ParseInt(const char*& src, T& dst)
+{
+    const char* p = src;
+    while (*p == ' ' || (*p >= '\t' && *p <= '\r'))
+        ++p;
+    bool neg = false;
+    if (*p == '+' || *p == '-')
+        neg = *p++ == '-';
+    if (*p < '0' || *p > '9')
+        return false;
+
+    T r = 0;
+    while (*p >= '0' && *p <= '9')
+        r = r * 10 + T(*p++ - '0');
+    dst = neg ? T(0) - r : r;
+    src = p;
+    return true;
+}
+
 bool OpRecord::fromText(const std::string& v)
 {
     type = OpType::Unknown;
     if (v.empty() || v.front() == '\r' || v.front() == '\n' || v.front() == '#')
         return false;
 
+    // "<time>: <keyword> <args>". MatchParams has no time.
+    // the time and the keyword are read once and args are parsed based on the keyword.
+    enum class Args
+    {
+        Int,
+        Int2,
+        Templates,
+        MatchParams,
+    };
+    struct OpDesc
+    {
+        std::string_view name;
+        OpType type;
+        Args args;
+    };
+    static const OpDesc s_ops[]{
+        { "KeyDown", OpType::KeyDown, Args::Int },
+        { "KeyUp", OpType::KeyUp, Args::Int },
+        { "MouseDown", OpType::MouseDown, Args::Int },
+        { "MouseUp", OpType::MouseUp, Args::Int },
+        { "MouseMoveAbs", OpType::MouseMoveAbs, Args::Int2 },
+        { "MouseMoveRel", OpType::MouseMoveRel, Args::Int2 },
+        { "SaveMousePos", OpType::SaveMousePos, Args::Int },
+        { "LoadMousePos", OpType::LoadMousePos, Args::Int },
+        { "MatchParams", OpType::MatchParams, Args::MatchParams },
+        { "MouseMoveMatch", OpType::MouseMoveMatch, Args::Templates },
+        { "WaitUntilMatch", OpType::WaitUntilMatch, Args::Templates },
+        { "Wait", OpType::Wait, Args::Int },
+        { "TimeShift", OpType::TimeShift, Args::Int },
+        { "Repeat", OpType::Repeat, Args::Int },
+    };
+
     const char* src = v.c_str();
 
-    auto scan_templates = [this, &src]() {
-        ScanKVP(src, [this](std::string k, std::string v) {
+    bool has_time = false;
+    uint32_t t = 0;
+    const char* p = src;
+    if (ParseInt(p, t) && *p == ':') {
+        has_time = true;
+        src = p + 1;
+    }
+    while (*src == ' ' || (*src >= '\t' && *src <= '\r'))
+        ++src;
+
+    const char* keyword = src;
+    while ((*src >= 'a' && *src <= 'z') || (*src >= 'A' && *src <= 'Z'))
+        ++src;
+    std::string_view name(keyword, src - keyword);
+    auto desc = std::find_if(std::begin(s_ops), std::end(s_ops), [&](auto& d) { return d.name == name; });
+    if (desc == std::end(s_ops))
+        return false;
+    // only MatchParams can omit the time, and it requires a space after the keyword
+    if (desc->args == Args::MatchParams ? *src != ' ' : !has_time)
+        return false;
+
+    auto read_int = [&src](int& dst) { return ParseInt(src, dst); };
+
+    switch (desc->args) {
+    case Args::Int:
+    {
+        int* dst = nullptr;
+        switch (desc->type) {
+        case OpType::KeyDown:
+        case OpType::KeyUp: dst = &data.key.code; break;
+        case OpType::MouseDown:
+        case OpType::MouseUp: dst = &data.mouse.button; break;
+        case OpType::SaveMousePos:
+        case OpType::LoadMousePos: dst = &exdata.save_slot; break;
+        case OpType::Wait: dst = &exdata.wait_time; break;
+        case OpType::TimeShift: dst = &exdata.time_shift; break;
+        case OpType::Repeat: dst = &exdata.repeat_point; break;
+        default: break;
+        }
+        if (!dst || !read_int(*dst))
+            return false;
+        break;
+    }
+
+    case Args::Int2:
+        if (!read_int(data.mouse.pos.x) || !read_int(data.mouse.pos.y))
+            return false;
+        break;
+
+    case Args::Templates:
+        ScanKVP(src, [this](std::string_view k, std::string_view v) {
             if (k == "Threshold") {
                 exdata.match_threshold = ToValue<float>(v);
             }
@@ -113,32 +218,17 @@ bool OpRecord::fromText(const std::string& v)
                     exdata.match_pattern = ITemplate::MatchPattern::Grayscale;
                 else if (p == "RGB")
                     exdata.match_pattern = ITemplate::MatchPattern::RGB;
+                else if (p == "Chamfer")
+                    exdata.match_pattern = ITemplate::MatchPattern::Chamfer;
             }
             else if (k == "Template") {
                 exdata.templates.push_back({ ToValue<std::string>(v) });
             }
             });
-    };
+        break;
 
-    if (sscanf(src, "%u: KeyDown %d", &time, &data.key.code) == 2)
-        type = OpType::KeyDown;
-    else if (sscanf(src, "%u: KeyUp %d", &time, &data.key.code) == 2)
-        type = OpType::KeyUp;
-    else if (sscanf(src, "%u: MouseDown %d", &time, &data.mouse.button) == 2)
-        type = OpType::MouseDown;
-    else if (sscanf(src, "%u: MouseUp %d", &time, &data.mouse.button) == 2)
-        type = OpType::MouseUp;
-    else if (sscanf(src, "%u: MouseMoveAbs %d %d", &time, &data.mouse.pos.x, &data.mouse.pos.y) == 3)
-        type = OpType::MouseMoveAbs;
-    else if (sscanf(src, "%u: MouseMoveRel %d %d", &time, &data.mouse.pos.x, &data.mouse.pos.y) == 3)
-        type = OpType::MouseMoveRel;
-    else if (sscanf(src, "%u: SaveMousePos %d", &time, &exdata.save_slot) == 2)
-        type = OpType::SaveMousePos;
-    else if (sscanf(src, "%u: LoadMousePos %d", &time, &exdata.save_slot) == 2)
-        type = OpType::LoadMousePos;
-    else if (std::strstr(src, "MatchParams ")) {
-        type = OpType::MatchParams;
-        ScanKVP(src, [this](std::string k, std::string v) {
+    case Args::MatchParams:
+        ScanKVP(src, [this](std::string_view k, std::string_view v) {
             auto& p = exdata.match_params;
             if (k == "Scale")
                 p.scale = ToValue<float>(v);
@@ -153,23 +243,13 @@ bool OpRecord::fromText(const std::string& v)
             else if (k == "BinarizeThreshold")
                 p.binarize_threshold = ToValue<float>(v);
             });
+        break;
     }
-    else if (std::strstr(src, "MouseMoveMatch") && sscanf(src, "%u: ", &time) == 1) {
-        type = OpType::MouseMoveMatch;
-        scan_templates();
-    }
-    else if (std::strstr(src, "WaitUntilMatch") && sscanf(src, "%u: ", &time) == 1) {
-        type = OpType::WaitUntilMatch;
-        scan_templates();
-    }
-    else if (sscanf(src, "%u: Wait %d", &time, &exdata.wait_time) == 2)
-        type = OpType::Wait;
-    else if (sscanf(src, "%u: TimeShift %d", &time, &exdata.time_shift) == 2)
-        type = OpType::TimeShift;
-    else if (sscanf(src, "%u: Repeat %d", &time, &exdata.repeat_point) == 2)
-        type = OpType::Repeat;
-
-    return type != OpType::Unknown;
+
+    if (has_time)
+        time = t;
+    type = desc->type;
+    return true;
 }
 
 std::map<Key, std::string> LoadKeymap(const char* path, const std::function<void(Key key, std::string path)>& body)
@@ -0,0 +1,183 @@
+#include "pch.h"
+#include "mrInternal.h"
+
+namespace mr {
+
+class Win32InputSink : public RefCount<IInputSink>
+{
+public:
+    Win32InputSink();
+    ~Win32InputSink() override;
+    int2 getCursorPos() override;
+    void send(const InputEvent& e) override;
+    void flush() override;
+
+private:
+    float2 m_screen_to_normalized{};
+    std::vector<INPUT> m_queue;
+};
+
+Win32InputSink::Win32InputSink()
+{
+    // http://msdn.microsoft.com/en-us/library/ms646260(VS.85).aspx
+    // If MOUSEEVENTF_ABSOLUTE value is specified, dx and dy contain normalized absolute coordinates between 0 and 65,535.
+    // The event procedure maps these coordinates onto the display surface.
+    // Coordinate (0,0) maps onto the upper-left corner of the display surface, (65535,65535) maps onto the lower-right corner.
+    m_screen_to_normalized = 65535.0f / float2{
+        float(::GetSystemMetrics(SM_CXSCREEN)),
+        float(::GetSystemMetrics(SM_CYSCREEN))
+    };
+}
+
+Win32InputSink::~Win32InputSink()
+{
+    flush();
+}
+
+int2 Win32InputSink::getCursorPos()
+{
+    CURSORINFO ci;
+    ci.cbSize = sizeof(ci);
+    ::GetCursorInfo(&ci);
+    return (int2&)ci.ptScreenPos;
+}
+
+void Win32InputSink::send(const InputEvent& e)
+{
+    INPUT input{};
+    switch (e.type) {
+    case InputEvent::Type::MouseMove:
+    {
+        int2 cpos = int2(float2(e.pos) * m_screen_to_normalized);
+        input.type = INPUT_MOUSE;
+        input.mi.dx = cpos.x;
+        input.mi.dy = cpos.y;
+        input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+        break;
+    }
+
+    case InputEvent::Type::MouseDown:
+        input.type = INPUT_MOUSE;
+        switch (e.code) {
+        case 1: input.mi.dwFlags |= MOUSEEVENTF_LEFTDOWN; break;
+        case 2: input.mi.dwFlags |= MOUSEEVENTF_RIGHTDOWN; break;
+        case 3: input.mi.dwFlags |= MOUSEEVENTF_MIDDLEDOWN; break;
+        default: break;
+        }
+        break;
+
+    case InputEvent::Type::MouseUp:
+        input.type = INPUT_MOUSE;
+        switch (e.code) {
+        case 1: input.mi.dwFlags |= MOUSEEVENTF_LEFTUP; break;
+        case 2: input.mi.dwFlags |= MOUSEEVENTF_RIGHTUP; break;
+        case 3: input.mi.dwFlags |= MOUSEEVENTF_MIDDLEUP; break;
+        default: break;
+        }
+        break;
+
+    case InputEvent::Type::KeyDown:
+    case InputEvent::Type::KeyUp:
+        input.type = INPUT_KEYBOARD;
+        input.ki.wVk = (WORD)e.code;
+        if (e.type == InputEvent::Type::KeyUp)
+            input.ki.dwFlags |= KEYEVENTF_KEYUP;
+        break;
+    }
+    m_queue.push_back(input);
+}
+
+void Win32InputSink::flush()
+{
+    if (m_queue.empty())
+        return;
+    // one call for all events keeps them in order and not interleaved with other input
+    ::SendInput((UINT)m_queue.size(), m_queue.data(), sizeof(INPUT));
+    m_queue.clear();
+}
+
+mrAPI IInputSink* CreateWin32InputSink_()
+{
+    return new Win32InputSink();
+}
+
+
+class RecordingInputSink : public RefCount<IRecordingInputSink>
+{
+public:
+    RecordingInputSink(IClock* clock);
+    int2 getCursorPos() override;
+    void send(const InputEvent& e) override;
+    void flush() override;
+
+    std::vector<Event> getEvents() const override;
+    uint32_t getBatchCount() const override;
+    void clear() override;
+
+private:
+    IClockPtr m_clock;
+    int2 m_cursor_pos{};
+    std::vector<Event> m_queue;
+    mutable std::mutex m_mutex;
+    std::vector<Event> m_events;
+    uint32_t m_batch_count = 0;
+};
+
+RecordingInputSink::RecordingInputSink(IClock* clock)
+    : m_clock(clock)
+{
+}
+
+int2 RecordingInputSink::getCursorPos()
+{
+    return m_cursor_pos;
+}
+
+void RecordingInputSink::send(const InputEvent& e)
+{
+    if (e.type == InputEvent::Type::MouseMove)
+        m_cursor_pos = e.pos;
+    m_queue.push_back({ m_clock->now(), 0, e });
+}
+
+void RecordingInputSink::flush()
+{
+    if (m_queue.empty())
+        return;
+    std::unique_lock l(m_mutex);
+    for (auto& e : m_queue)
+        e.batch = m_batch_count;
+    m_events.insert(m_events.end(), m_queue.begin(), m_queue.end());
+    m_queue.clear();
+    ++m_batch_count;
+}
+
+std::vector<IRecordingInputSink::Event> RecordingInputSink::getEvents() const
+{
+    std::unique_lock l(m_mutex);
+    return m_events;
+}
+
+uint32_t RecordingInputSink::getBatchCount() const
+{
+    std::unique_lock l(m_mutex);
+    return m_batch_count;
+}
+
+void RecordingInputSink::clear()
+{
+    std::unique_lock l(m_mutex);
+    m_events.clear();
+    m_batch_count = 0;
+}
+
+mrAPI IRecordingInputSink* CreateRecordingInputSink_(IClock* clock)
+{
+    if (!clock) {
+        mrDbgPrint("*** CreateRecordingInputSink(): clock is null ***\n");
+        return nullptr;
+    }
+    return new RecordingInputSink(clock);
+}
+
+} // namespace mr
@@ -0,0 +1,245 @@
+#include "pch.h"
+#include "mrInternal.h"
+
+namespace mr {
+
+// binary replay file layout:
+//   OpFileHeader
+//   OpFileRecord records[record_count]
+//   OpFileParams params[params_count]
+//   uint32_t templates[template_count] (offsets in the string table)
+//   char strings[string_size] (null terminated strings)
+// all sections are fixed size, so loading is just mapping the file and copying fields.
+struct OpFileHeader
+{
+    char magic[4] = { 'M', 'R', 'O', 'P' };
+    uint32_t version = 1;
+    uint32_t record_count{};
+    uint32_t params_count{};
+    uint32_t template_count{};
+    uint32_t string_size{};
+};
+
+struct OpFileRecord
+{
+    OpType type;
+    uint32_t time;
+    int32_t data[3]; // OpRecord::data as is
+    int32_t value; // wait_time, time_shift, repeat_point, save_slot or index of params depending on type
+    float match_threshold;
+    ITemplate::MatchPattern match_pattern;
+    uint32_t template_first;
+    uint32_t template_count;
+};
+static_assert(sizeof(OpFileRecord) == 40);
+
+struct OpFileParams
+{
+    float scale;
+    int32_t care_display_scale;
+    float2 color_range;
+    float contour_radius;
+    float expand_radius;
+    float binarize_threshold;
+    int32_t pyramid_levels;
+    int32_t pyramid_candidates;
+};
+
+static const char* s_binary_ext = ".mrop";
+
+
+OpFileFormat GetOpFileFormat(const char* path)
+{
+    auto ext = std::filesystem::path(path).extension().string();
+    return _stricmp(ext.c_str(), s_binary_ext) == 0 ? OpFileFormat::Binary : OpFileFormat::Text;
+}
+
+// exdata field that is stored in OpFileRecord::value. nullptr if the type has none.
+static int* GetValuePtr(OpRecord& rec)
+{
+    switch (rec.type) {
+    case OpType::Wait: return &rec.exdata.wait_time;
+    case OpType::TimeShift: return &rec.exdata.time_shift;
+    case OpType::Repeat: return &rec.exdata.repeat_point;
+    case OpType::SaveMousePos:
+    case OpType::LoadMousePos: return &rec.exdata.save_slot;
+    default: return nullptr;
+    }
+}
+
+static bool SaveOpRecordsText(const char* path, std::span<const OpRecord> records)
+{
+    std::ofstream ofs(path, std::ios::out);
+    if (!ofs)
+        return false;
+
+    for (auto& rec : records)
+        ofs << rec.toText() << '\n';
+    return (bool)ofs;
+}
+
+static bool LoadOpRecordsText(const char* path, std::vector<OpRecord>& dst)
+{
+    std::ifstream ifs(path, std::ios::in);
+    if (!ifs)
+        return false;
+
+    std::string l;
+    while (std::getline(ifs, l)) {
+        OpRecord rec;
+        if (rec.fromText(l))
+            dst.push_back(std::move(rec));
+    }
+    return true;
+}
+
+static bool SaveOpRecordsBinary(const char* path, std::span<const OpRecord> records)
+{
+    OpFileHeader header;
+    std::vector<OpFileRecord> frecords;
+    std::vector<OpFileParams> fparams;
+    std::vector<uint32_t> ftemplates;
+    std::string strings;
+    std::map<std::string, uint32_t> string_offsets;
+
+    frecords.reserve(records.size());
+    for (auto& rec : records) {
+        OpFileRecord fr{};
+        fr.type = rec.type;
+        fr.time = rec.time;
+        memcpy(fr.data, &rec.data, sizeof(fr.data));
+        if (auto* v = GetValuePtr(const_cast<OpRecord&>(rec)))
+            fr.value = *v;
+        fr.match_threshold = rec.exdata.match_threshold;
+        fr.match_pattern = rec.exdata.match_pattern;
+
+        if (rec.type == OpType::MatchParams) {
+            auto& p = rec.exdata.match_params;
+            fr.value = (int32_t)fparams.size();
+            fparams.push_back({ p.scale, p.care_display_scale, p.color_range, p.contour_radius, p.expand_radius,
+                p.binarize_threshold, p.pyramid_levels, p.pyramid_candidates });
+        }
+
+        fr.template_first = (uint32_t)ftemplates.size();
+        fr.template_count = (uint32_t)rec.exdata.templates.size();
+        for (auto& t : rec.exdata.templates) {
+            auto it = string_offsets.find(t.path);
+            if (it == string_offsets.end()) {
+                it = string_offsets.insert({ t.path, (uint32_t)strings.size() }).first;
+                strings.append(t.path.c_str(), t.path.size() + 1);
+            }
+            ftemplates.push_back(it->second);
+        }
+        frecords.push_back(fr);
+    }
+    header.record_count = (uint32_t)frecords.size();
+    header.params_count = (uint32_t)fparams.size();
+    header.template_count = (uint32_t)ftemplates.size();
+    header.string_size = (uint32_t)strings.size();
+
+    std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs)
+        return false;
+    ofs.write((const char*)&header, sizeof(header));
+    ofs.write((const char*)frecords.data(), sizeof(OpFileRecord) * frecords.size());
+    ofs.write((const char*)fparams.data(), sizeof(OpFileParams) * fparams.size());
+    ofs.write((const char*)ftemplates.data(), sizeof(uint32_t) * ftemplates.size());
+    ofs.write(strings.data(), strings.size());
+    return (bool)ofs;
+}
+
+static bool LoadOpRecordsBinary(const MappedFile& file, std::vector<OpRecord>& dst)
+{
+    OpFileHeader expected;
+    auto* header = (const OpFileHeader*)file.data();
+    if (file.size() < sizeof(OpFileHeader) ||
+        memcmp(header->magic, expected.magic, sizeof(expected.magic)) != 0 ||
+        header->version != expected.version)
+        return false;
+
+    size_t required = sizeof(OpFileHeader) +
+        sizeof(OpFileRecord) * header->record_count +
+        sizeof(OpFileParams) * header->params_count +
+        sizeof(uint32_t) * header->template_count +
+        header->string_size;
+    if (file.size() < required) {
+        mrDbgPrint("*** LoadOpRecords(): broken file ***\n");
+        return false;
+    }
+    auto* records = (const OpFileRecord*)(header + 1);
+    auto* params = (const OpFileParams*)(records + header->record_count);
+    auto* templates = (const uint32_t*)(params + header->params_count);
+    auto* strings = (const char*)(templates + header->template_count);
+    if (header->string_size && strings[header->string_size - 1] != '\0')
+        return false;
+
+    dst.reserve(dst.size() + header->record_count);
+    for (uint32_t ri = 0; ri < header->record_count; ++ri) {
+        auto& fr = records[ri];
+        OpRecord rec;
+        rec.type = fr.type;
+        rec.time = fr.time;
+        memcpy(&rec.data, fr.data, sizeof(fr.data));
+        if (auto* v = GetValuePtr(rec))
+            *v = fr.value;
+        rec.exdata.match_threshold = fr.match_threshold;
+        rec.exdata.match_pattern = fr.match_pattern;
+
+        if (fr.type == OpType::MatchParams && (uint32_t)fr.value < header->params_count) {
+            auto& fp = params[fr.value];
+            auto& p = rec.exdata.match_params;
+            p.scale = fp.scale;
+            p.care_display_scale = fp.care_display_scale != 0;
+            p.color_range = fp.color_range;
+            p.contour_radius = fp.contour_radius;
+            p.expand_radius = fp.expand_radius;
+            p.binarize_threshold = fp.binarize_threshold;
+            p.pyramid_levels = fp.pyramid_levels;
+            p.pyramid_candidates = fp.pyramid_candidates;
+        }
+
+        if (fr.template_count) {
+            if (size_t(fr.template_first) + fr.template_count > header->template_count)
+                return false;
+            for (uint32_t ti = 0; ti < fr.template_count; ++ti) {
+                uint32_t offset = templates[fr.template_first + ti];
+                if (offset >= header->string_size)
+                    return false;
+                rec.exdata.templates.push_back({ strings + offset });
+            }
+        }
+        dst.push_back(std::move(rec));
+    }
+    return true;
+}
+
+bool LoadOpRecords(const char* path, std::vector<OpRecord>& dst)
+{
+    // the format is determined by the content, not the extension
+    MappedFile file;
+    if (file.open(path) && file.size() >= sizeof(OpFileHeader)) {
+        OpFileHeader expected;
+        if (memcmp(file.data(), expected.magic, sizeof(expected.magic)) == 0)
+            return LoadOpRecordsBinary(file, dst);
+    }
+    file.close();
+    return LoadOpRecordsText(path, dst);
+}
+
+bool SaveOpRecords(const char* path, std::span<const OpRecord> records, OpFileFormat format)
+{
+    if (format == OpFileFormat::Binary)
+        return SaveOpRecordsBinary(path, records);
+    else
+        return SaveOpRecordsText(path, records);
+}
+
+bool ConvertOpRecords(const char* src_path, const char* dst_path, OpFileFormat format)
+{
+    std::vector<OpRecord> records;
+    if (!LoadOpRecords(src_path, records))
+        return false;
+    return SaveOpRecords(dst_path, records, format);
+}
+
+} // namespace mr
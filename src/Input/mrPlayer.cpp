@@ -1,8 +1,12 @@
 #include "pch.h"
 #include "mrInternal.h"
 
+#pragma comment(lib, "winmm.lib")
+
 namespace mr {
 
+inline nanosec MS2NS(int64_t v) { return nanosec(v * 1000000); }
+
 class Player : public RefCount<IPlayer>
 {
 public:
@@ -14,18 +18,50 @@ public:
     bool update() override;
     bool load(const char* path) override;
     void setMatchTarget(MatchTarget v) override;
-
+    void setScreenCapture(IScreenCapturePtr v) override;
+    void setTemplateCacheDir(const char* v) override;
+    void setClock(IClockPtr v) override;
+    void setInputSink(IInputSinkPtr v) override;
+    TimingStats getTimingStats() const override;
+    void setTimingCapacity(uint32_t v) override;
+    std::vector<EventTiming> getTimings() const override;
+    void addTiming(uint32_t record_index, int64_t error);
+
+    void playbackThread();
+    bool waitUntil(nanosec deadline);
     bool execRecord(const OpRecord& rec);
 
+    void requestMatch(const OpRecord& rec, bool wait_vsync);
+    bool waitMatch(IScreenMatcher::Result& dst);
+    void cancelMatch();
+    bool resolveMouseMoveMatch();
+
 private:
-    bool m_playing = false;
-    millisec m_time_start_real = 0;
-    millisec m_time_start = 0;
-    millisec m_time_wait = 0;
+    std::thread m_thread;
+    std::atomic_bool m_playing{ false };
+    std::atomic_bool m_stop_requested{ false };
+    nanosec m_time_base = 0; // deadline of a record is m_time_base + record time
     uint32_t m_record_index = 0;
     uint32_t m_loop_required = 0, m_loop_count = 0;
     std::vector<OpRecord> m_records;
 
+    IClockPtr m_clock;
+    IInputSinkPtr m_sink;
+
+    // written only by the playback thread and read by getTimingStats() / getTimings() from others without locks.
+    // per-record timings are a ring buffer of m_timing_capacity entries and m_timing_head is the total written.
+    struct TimingSlot
+    {
+        std::atomic<uint32_t> record_index{};
+        std::atomic<int64_t> error{};
+    };
+    std::atomic<uint64_t> m_timing_count{ 0 };
+    std::atomic<int64_t> m_timing_total{ 0 };
+    std::atomic<int64_t> m_timing_max{ 0 };
+    uint32_t m_timing_capacity = 0;
+    std::unique_ptr<TimingSlot[]> m_timings;
+    std::atomic<uint64_t> m_timing_head{ 0 };
+
     struct State
     {
         int2 mouse_pos{};
@@ -35,6 +71,16 @@ private:
 
     MatchTarget m_match_target = MatchTarget::EntireScreen;
     IScreenMatcherPtr m_smatch;
+    IScreenCapturePtr m_capture;
+    std::string m_template_cache_dir;
+
+    // template matching runs on ThreadPool so that it doesn't stall the playback thread. at most one is in flight.
+    struct MatchRequest
+    {
+        const OpRecord* rec = nullptr;
+        std::future<IScreenMatcher::Result> result;
+    };
+    MatchRequest m_match;
 };
 
 
@@ -44,33 +90,47 @@ Player::Player()
 
 Player::~Player()
 {
+    stop();
 }
 
 bool Player::start(uint32_t loop)
 {
     if (m_playing || m_records.empty())
         return false;
+    // join the thread of the last playback
+    stop();
+
+    if (!m_clock)
+        m_clock = GetSystemClock();
+    if (!m_sink)
+        m_sink = CreateWin32InputSink();
 
-    m_time_start_real = m_time_start = NowMS();
     m_loop_required = loop;
     m_loop_count = 0;
     m_record_index = 0;
+    m_state.mouse_pos = m_sink->getCursorPos();
+    m_timing_count = 0;
+    m_timing_total = 0;
+    m_timing_max = 0;
+    m_timing_head = 0;
+    if (m_timing_capacity)
+        m_timings = std::make_unique<TimingSlot[]>(m_timing_capacity);
+
+    m_stop_requested = false;
     m_playing = true;
-
-    CURSORINFO ci;
-    ci.cbSize = sizeof(ci);
-    ::GetCursorInfo(&ci);
-    m_state.mouse_pos = (int2&)ci.ptScreenPos;
+    m_time_base = m_clock->now();
+    m_thread = std::thread([this]() { playbackThread(); });
     return true;
 }
 
 bool Player::stop()
 {
-    if (!m_playing)
-        return false;
-
-    m_playing = false;
-    return true;
+    bool ret = m_playing;
+    m_stop_requested = true;
+    if (m_thread.joinable())
+        m_thread.join();
+    cancelMatch();
+    return ret;
 }
 
 bool Player::isPlaying() const
@@ -80,168 +140,133 @@ bool Player::isPlaying() const
 
 bool Player::update()
 {
-    if (!m_playing || m_records.empty())
-        return false;
+    return isPlaying();
+}
 
+void Player::playbackThread()
+{
+    ::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+    ::timeBeginPeriod(1);
 
-    // execute records
-    for (;;) {
+    while (!m_stop_requested) {
         const auto& rec = m_records[m_record_index];
+        nanosec deadline = m_time_base + MS2NS(rec.time);
+        if (!waitUntil(deadline))
+            break;
 
-        millisec time_before_exec = NowMS();
-        millisec time_rec = time_before_exec - m_time_start;
-
-        if (time_rec >= rec.time) {
-            auto go_next = execRecord(rec);
+        // keyboard events and waits go on while MouseMoveMatch is in flight. others need its result first.
+        switch (rec.type) {
+        case OpType::KeyDown:
+        case OpType::KeyUp:
+        case OpType::Wait:
+        case OpType::TimeShift:
+            break;
+        default:
+            if (!resolveMouseMoveMatch())
+                m_stop_requested = true;
+            break;
+        }
+        if (m_stop_requested)
+            break;
 
-            millisec time_after_exec = NowMS();
-            millisec timestamp = time_after_exec - m_time_start_real;
-            millisec elapsed = time_after_exec - time_before_exec;
-            if (!go_next) {
-                m_time_start = time_after_exec - rec.time;
-                break;
-            }
-            else if (!m_playing) {
-                break;
-            }
+        nanosec time_before_exec = m_clock->now();
+        addTiming(m_record_index, int64_t(time_before_exec - deadline));
+        if (!execRecord(rec))
+            break;
+        nanosec time_after_exec = m_clock->now();
+        mrDbgPrint("record executed (%.2f ms late): %s\n", float(double(time_before_exec - deadline) / 1000000.0), rec.toText().c_str());
+        ++m_record_index;
 
-            mrDbgPrint("record executed (%ld %ld ms): %s\n", timestamp, elapsed, rec.toText().c_str());
-            ++m_record_index;
+        // records that shift the time line
+        if (rec.type == OpType::Wait) {
+            m_time_base += MS2NS(rec.exdata.wait_time);
+        }
+        else if (rec.type == OpType::WaitUntilMatch) {
+            m_time_base = time_after_exec - MS2NS(rec.time);
+        }
+        else if (rec.type == OpType::TimeShift) {
+            m_time_base = time_after_exec - MS2NS(rec.time) + MS2NS(rec.exdata.time_shift);
+        }
+        else if (rec.type == OpType::Repeat) {
+            // rewind time and record index
+            m_time_base = time_after_exec - MS2NS(rec.exdata.repeat_point);
 
-            if (rec.type == OpType::MouseMoveMatch) {
-                // adjust time if MouseMoveMatch because it is very slow and causes input hiccup
-                m_time_start += elapsed;
-            }
-            else if (rec.type == OpType::TimeShift) {
-                // handle time shift
-                m_time_start = time_after_exec - rec.time + rec.exdata.time_shift;
-            }
-            else if (rec.type == OpType::Repeat) {
-                // rewind time and record index
-                m_time_start = NowMS() - rec.exdata.repeat_point;
+            auto it = std::lower_bound(m_records.begin(), m_records.end(), rec.exdata.repeat_point,
+                [](const OpRecord& r, int t) { return r.time < t; });
+            m_record_index = (uint32_t)std::distance(m_records.begin(), it);
+        }
 
-                auto it = std::lower_bound(m_records.begin(), m_records.end(), rec.exdata.repeat_point,
-                    [](const OpRecord& r, int t) { return r.time < t; });
-                m_record_index = (uint32_t)std::distance(m_records.begin(), it);
+        if (m_record_index >= m_records.size()) {
+            // go next loop or stop
+            if (!resolveMouseMoveMatch())
                 break;
-            }
+            m_record_index = 0;
+            m_time_base = m_clock->now();
+            if (++m_loop_count >= m_loop_required)
+                break;
+        }
+    }
 
-            if (m_record_index >= m_records.size()) {
-                // go next loop or stop
-                m_record_index = 0;
-                m_time_start = NowMS();
-                ++m_loop_count;
-                if (m_loop_count >= m_loop_required) {
-                    m_playing = false;
-                    return false;
-                }
-                else {
-                    break;
-                }
-            }
+    m_sink->flush();
+    ::timeEndPeriod(1);
+    m_playing = false;
+}
+
+// returns false if stopped while waiting
+bool Player::waitUntil(nanosec deadline)
+{
+    // sleep in slices to respond to stop(), then wait precisely for the last slice
+    const nanosec SliceLength = MS2NS(50);
+    for (;;) {
+        if (m_stop_requested)
+            return false;
+        nanosec now = m_clock->now();
+        if (now >= deadline)
+            return true;
+        // nothing more is due in this tick. deliver the batch before sleeping.
+        m_sink->flush();
+        if (deadline - now > SliceLength) {
+            m_clock->sleepFor(SliceLength);
         }
         else {
-            break;
+            m_clock->sleepUntil(deadline);
+            return !m_stop_requested;
         }
     }
-    return true;
 }
 
+// returns false if playback should stop
 bool Player::execRecord(const OpRecord& rec)
 {
-    auto send = [](INPUT& v) {
-        ::SendInput(1, &v, sizeof(INPUT));
-    };
-
-    auto make_mouse_move = [](INPUT& input, int2 screen_pos) {
-        // http://msdn.microsoft.com/en-us/library/ms646260(VS.85).aspx
-        // If MOUSEEVENTF_ABSOLUTE value is specified, dx and dy contain normalized absolute coordinates between 0 and 65,535.
-        // The event procedure maps these coordinates onto the display surface.
-        // Coordinate (0,0) maps onto the upper-left corner of the display surface, (65535,65535) maps onto the lower-right corner.
-
-        static float2 s2c = 65535.0f / float2{
-            float(::GetSystemMetrics(SM_CXSCREEN)),
-            float(::GetSystemMetrics(SM_CYSCREEN))
-        };
-        int2 cpos = int2(float2(screen_pos) * s2c);
-        input.mi.dx = cpos.x;
-        input.mi.dy = cpos.y;
-        input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
-    };
-
-    auto do_match = [this, &rec]() {
-        std::vector<ITemplatePtr> templates;
-        for (auto& i : rec.exdata.templates)
-            if (i.tmpl)
-                templates.push_back(i.tmpl);
-
-        auto match_target = ::GetForegroundWindow();
-        auto r = m_smatch->match(templates, match_target);
-        mrDbgPrint("match score: %.2f (%d, %d)\n", r.score, r.region.getCenter().x, r.region.getCenter().y);
-        return r;
+    auto send = [this](InputEvent::Type type, int2 pos = {}, int code = 0) {
+        m_sink->send({ type, pos, code });
     };
 
     bool ret = true;
     switch (rec.type)
     {
     case OpType::MouseDown:
-    {
-        INPUT input{ INPUT_MOUSE };
-        switch (rec.data.mouse.button) {
-        case 1: input.mi.dwFlags |= MOUSEEVENTF_LEFTDOWN; break;
-        case 2: input.mi.dwFlags |= MOUSEEVENTF_RIGHTDOWN; break;
-        case 3: input.mi.dwFlags |= MOUSEEVENTF_MIDDLEDOWN; break;
-        default: break;
-        }
-        send(input);
+        send(InputEvent::Type::MouseDown, {}, rec.data.mouse.button);
         break;
-    }
 
     case OpType::MouseUp:
-    {
-        INPUT input{ INPUT_MOUSE };
-        switch (rec.data.mouse.button) {
-        case 1: input.mi.dwFlags |= MOUSEEVENTF_LEFTUP; break;
-        case 2: input.mi.dwFlags |= MOUSEEVENTF_RIGHTUP; break;
-        case 3: input.mi.dwFlags |= MOUSEEVENTF_MIDDLEUP; break;
-        default: break;
-        }
-        send(input);
+        send(InputEvent::Type::MouseUp, {}, rec.data.mouse.button);
         break;
-    }
 
     case OpType::MouseMoveAbs:
-    {
-        INPUT input{ INPUT_MOUSE };
         m_state.mouse_pos = rec.data.mouse.pos;
-        make_mouse_move(input, m_state.mouse_pos);
-        send(input);
+        send(InputEvent::Type::MouseMove, m_state.mouse_pos);
         break;
-    }
 
     case OpType::MouseMoveRel:
-    {
-        INPUT input{ INPUT_MOUSE };
         m_state.mouse_pos += rec.data.mouse.pos;
-        make_mouse_move(input, m_state.mouse_pos);
-        send(input);
+        send(InputEvent::Type::MouseMove, m_state.mouse_pos);
         break;
-    }
 
     case OpType::MouseMoveMatch:
-    {
-        INPUT input{ INPUT_MOUSE };
-        auto r = do_match();
-        if (r.score <= rec.exdata.match_threshold) {
-            m_state.mouse_pos = r.region.getCenter();
-            make_mouse_move(input, m_state.mouse_pos);
-            send(input);
-        }
-        else {
-            stop();
-        }
+        // the mouse moves when the result is needed. see resolveMouseMoveMatch().
+        requestMatch(rec, false);
         break;
-    }
 
     case OpType::SaveMousePos:
     {
@@ -254,51 +279,35 @@ bool Player::execRecord(const OpRecord& rec)
         if (i != m_mouse_state_slots.end()) {
             m_state = i->second;
 
-            INPUT input{};
-            input.type = INPUT_MOUSE;
-            make_mouse_move(input, m_state.mouse_pos);
-
-            // it seems single mouse move can't step over display boundary. so SendInput twice.
-            send(input);
-            send(input);
+            // it seems single mouse move can't step over display boundary. so send twice.
+            send(InputEvent::Type::MouseMove, m_state.mouse_pos);
+            send(InputEvent::Type::MouseMove, m_state.mouse_pos);
         }
         break;
     }
 
     case OpType::KeyDown:
+        send(InputEvent::Type::KeyDown, {}, rec.data.key.code);
+        break;
+
     case OpType::KeyUp:
-    {
-        INPUT input{ INPUT_KEYBOARD };
-        input.ki.wVk = (WORD)rec.data.key.code;
-        if (rec.type == OpType::KeyUp)
-            input.ki.dwFlags |= KEYEVENTF_KEYUP;
-        send(input);
+        send(InputEvent::Type::KeyUp, {}, rec.data.key.code);
         break;
-    }
 
     case OpType::Wait:
-    {
-        if (m_time_wait == 0)
-            m_time_wait = NowMS();
-
-        if ((NowMS() - m_time_wait) >= rec.exdata.wait_time) {
-            m_time_wait = 0;
-        }
-        else {
-            ret = false;
-        }
+        ret = waitUntil(m_time_base + MS2NS(rec.time + rec.exdata.wait_time));
         break;
-    }
 
     case OpType::WaitUntilMatch:
     {
-        auto r = do_match();
-        if (r.score <= rec.exdata.match_threshold) {
-            // ok
-        }
-        else {
-            WaitVSync();
-            ret = false;
+        // match again on the next frame until it hits
+        for (bool retry = false;; retry = true) {
+            requestMatch(rec, retry);
+            IScreenMatcher::Result r;
+            if (!waitMatch(r))
+                return false;
+            if (!r.pruned && r.score <= rec.exdata.match_threshold)
+                break;
         }
         break;
     }
@@ -309,39 +318,132 @@ bool Player::execRecord(const OpRecord& rec)
     return ret;
 }
 
+// a request for the record already in flight is not restarted
+void Player::requestMatch(const OpRecord& rec, bool wait_vsync)
+{
+    if (m_match.rec == &rec && m_match.result.valid())
+        return;
+    cancelMatch();
+
+    m_match.rec = &rec;
+    m_match.result = ThreadPool::instance().async([this, &rec, wait_vsync]() {
+        IScreenMatcher::Result ret;
+        if (!m_smatch)
+            return ret;
+        if (wait_vsync)
+            WaitVSync();
+
+        std::vector<ITemplatePtr> templates;
+        for (auto& i : rec.exdata.templates)
+            if (i.tmpl)
+                templates.push_back(i.tmpl);
+
+        // templates are shared by records. the threshold is of this record.
+        float threshold = rec.exdata.match_threshold;
+        // matchers of other players may run at the same time
+        GetGfxInterface()->lock([&]() {
+            if (m_match_target == MatchTarget::EntireScreen)
+                ret = m_smatch->matchAllScreens(templates, threshold);
+            else
+                ret = m_smatch->match(templates, ::GetForegroundWindow(), threshold);
+            });
+        mrDbgPrint("match score: %.2f (%d, %d)\n", ret.score, ret.region.getCenter().x, ret.region.getCenter().y);
+        return ret;
+        });
+}
+
+// returns false if stopped while waiting
+bool Player::waitMatch(IScreenMatcher::Result& dst)
+{
+    m_sink->flush();
+    while (m_match.result.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+        if (m_stop_requested)
+            return false;
+    }
+    dst = m_match.result.get();
+    m_match.rec = nullptr;
+    return true;
+}
+
+void Player::cancelMatch()
+{
+    // the task refers this player. it can't be abandoned.
+    if (m_match.result.valid())
+        m_match.result.wait();
+    m_match = {};
+}
+
+// move the mouse to the result of MouseMoveMatch in flight. returns false if it missed or stopped.
+bool Player::resolveMouseMoveMatch()
+{
+    if (!m_match.rec || m_match.rec->type != OpType::MouseMoveMatch)
+        return true;
+
+    float threshold = m_match.rec->exdata.match_threshold;
+    IScreenMatcher::Result r;
+    if (!waitMatch(r) || r.pruned || r.score > threshold)
+        return false;
+
+    m_state.mouse_pos = r.region.getCenter();
+    m_sink->send({ InputEvent::Type::MouseMove, m_state.mouse_pos });
+    return true;
+}
+
 bool Player::load(const char* path)
 {
+    stop();
     m_records.clear();
-
-    std::ifstream ifs(path, std::ios::in);
-    if (!ifs)
+    if (!LoadOpRecords(path, m_records))
         return false;
 
-    std::string l;
-    while (std::getline(ifs, l)) {
-        OpRecord rec;
-        if (rec.fromText(l)) {
-            if (rec.type == OpType::MatchParams) {
-                m_smatch = CreateScreenMatcher(rec.exdata.match_params);
+    // collect unique templates of each matcher first. decoding & preprocessing them run in parallel afterwards.
+    struct TemplateBatch
+    {
+        IScreenMatcherPtr matcher;
+        std::vector<std::string> paths;
+        std::vector<OpRecord*> records;
+    };
+    std::vector<TemplateBatch> batches;
+    for (auto& rec : m_records) {
+        if (rec.type == OpType::MatchParams) {
+            m_smatch = m_capture ?
+                CreateScreenMatcher(rec.exdata.match_params, m_capture) :
+                CreateScreenMatcher(rec.exdata.match_params);
+            m_smatch->setTemplateCacheDir(m_template_cache_dir.c_str());
+        }
+
+        if (!rec.exdata.templates.empty()) {
+            if (!m_smatch) {
+                m_smatch = m_capture ? CreateScreenMatcher({}, m_capture) : CreateScreenMatcher();
+                m_smatch->setTemplateCacheDir(m_template_cache_dir.c_str());
             }
+            if (batches.empty() || batches.back().matcher != m_smatch)
+                batches.push_back({ m_smatch });
 
-            if (!rec.exdata.templates.empty()) {
-                if (!m_smatch)
-                    m_smatch = CreateScreenMatcher();
-
-                for (auto& id : rec.exdata.templates) {
-                    id.tmpl = m_smatch->createTemplate(id.path.c_str());
-                    if (id.tmpl) {
-                        id.tmpl->setMatchPattern(rec.exdata.match_pattern);
-                    }
-                    else {
-                        mrDbgPrint("*** failed to load template %s ***\n", id.path.c_str());
-                    }
-                }
+            auto& batch = batches.back();
+            for (auto& id : rec.exdata.templates) {
+                if (std::find(batch.paths.begin(), batch.paths.end(), id.path) == batch.paths.end())
+                    batch.paths.push_back(id.path);
             }
+            batch.records.push_back(&rec);
+        }
+    }
 
-            m_records.push_back(rec);
+    for (auto& batch : batches) {
+        auto templates = batch.matcher->createTemplates(batch.paths);
+        for (auto* rec : batch.records) {
+            for (auto& id : rec->exdata.templates) {
+                auto i = std::find(batch.paths.begin(), batch.paths.end(), id.path) - batch.paths.begin();
+                id.tmpl = templates[i];
+                if (id.tmpl) {
+                    id.tmpl->setMatchPattern(rec->exdata.match_pattern);
+                }
+                else {
+                    mrDbgPrint("*** failed to load template %s ***\n", id.path.c_str());
+                }
+            }
         }
+        batch.matcher->prepareTemplates(templates);
     }
     std::stable_sort(m_records.begin(), m_records.end(),
         [](auto& a, auto& b) { return a.time < b.time; });
@@ -354,6 +456,86 @@ void Player::setMatchTarget(MatchTarget v)
     m_match_target = v;
 }
 
+void Player::setScreenCapture(IScreenCapturePtr v)
+{
+    m_capture = v;
+}
+
+void Player::setTemplateCacheDir(const char* v)
+{
+    m_template_cache_dir = v ? v : "";
+}
+
+void Player::setClock(IClockPtr v)
+{
+    m_clock = v;
+}
+
+void Player::setInputSink(IInputSinkPtr v)
+{
+    m_sink = v;
+}
+
+void Player::addTiming(uint32_t record_index, int64_t error)
+{
+    // only the playback thread writes. plain load + store instead of read-modify-write.
+    m_timing_count.store(m_timing_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_timing_total.store(m_timing_total.load(std::memory_order_relaxed) + error, std::memory_order_relaxed);
+    if (error > m_timing_max.load(std::memory_order_relaxed))
+        m_timing_max.store(error, std::memory_order_relaxed);
+
+    if (m_timing_capacity) {
+        uint64_t head = m_timing_head.load(std::memory_order_relaxed);
+        auto& slot = m_timings[head % m_timing_capacity];
+        slot.record_index.store(record_index, std::memory_order_relaxed);
+        slot.error.store(error, std::memory_order_relaxed);
+        m_timing_head.store(head + 1, std::memory_order_release);
+    }
+}
+
+IPlayer::TimingStats Player::getTimingStats() const
+{
+    TimingStats ret;
+    ret.count = m_timing_count.load(std::memory_order_relaxed);
+    ret.total_error = m_timing_total.load(std::memory_order_relaxed);
+    ret.max_error = m_timing_max.load(std::memory_order_relaxed);
+    return ret;
+}
+
+void Player::setTimingCapacity(uint32_t v)
+{
+    if (m_playing) {
+        mrDbgPrint("*** Player::setTimingCapacity(): can't be changed while playing ***\n");
+        return;
+    }
+    m_timing_capacity = v;
+    m_timings.reset();
+    m_timing_head = 0;
+}
+
+std::vector<IPlayer::EventTiming> Player::getTimings() const
+{
+    std::vector<EventTiming> ret;
+    if (!m_timing_capacity || !m_timings)
+        return ret;
+
+    // copy the last entries, then drop the ones the playback thread may have overwritten while copying
+    bool playing = m_playing;
+    uint64_t head = m_timing_head.load(std::memory_order_acquire);
+    uint64_t first = head > m_timing_capacity ? head - m_timing_capacity : 0;
+    ret.reserve(size_t(head - first));
+    for (uint64_t i = first; i < head; ++i) {
+        auto& slot = m_timings[i % m_timing_capacity];
+        ret.push_back({ slot.record_index.load(std::memory_order_relaxed), slot.error.load(std::memory_order_relaxed) });
+    }
+    // the slot of head_after may be being written if playing
+    uint64_t head_after = m_timing_head.load(std::memory_order_acquire) + (playing ? 1 : 0);
+    uint64_t first_valid = head_after > m_timing_capacity ? head_after - m_timing_capacity : 0;
+    if (first_valid > first)
+        ret.erase(ret.begin(), ret.begin() + size_t(std::min(first_valid - first, uint64_t(ret.size()))));
+    return ret;
+}
+
 mrAPI IPlayer* CreatePlayer_()
 {
     return new Player();
@@ -84,13 +84,7 @@ void Recorder::addRecord(const OpRecord& rec)
 
 bool Recorder::save(const char* path) const
 {
-    std::ofstream ofs(path, std::ios::out);
-    if (!ofs)
-        return false;
-
-    for (auto& rec : m_records)
-        ofs << rec.toText() << std::endl;
-    return true;
+    return SaveOpRecords(path, m_records, GetOpFileFormat(path));
 }
 
 mrAPI IRecorder* CreateRecorder_()
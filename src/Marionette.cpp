@@ -33,6 +33,7 @@ public:
     mr::IRecorderPtr m_recorder;
     mr::IPlayerPtr m_player;
     std::string m_data_path = "replay.txt";
+    std::string m_template_cache_dir = "template_cache";
     bool m_finished = false;
 
     HBRUSH m_brush_recording = nullptr;
@@ -205,6 +206,7 @@ void MarionetteApp::start()
 {
     mr::LoadKeymap("keymap.txt", [this](mr::Key k, std::string path) {
         auto player = mr::CreatePlayer();
+        player->setTemplateCacheDir(m_template_cache_dir.c_str());
         if (player->load(path.c_str())) {
             player->setMatchTarget(mr::MatchTarget::ForegroundWindow);
             m_keymap[k] = player;
@@ -310,6 +312,7 @@ bool MarionetteApp::togglePlaying()
     }
     else {
         m_player = mr::CreatePlayer();
+        m_player->setTemplateCacheDir(m_template_cache_dir.c_str());
         m_player->load(m_data_path.c_str());
         m_player->start();
 
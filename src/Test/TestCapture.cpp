@@ -1,6 +1,6 @@
 #include "pch.h"
 #include "Test.h"
-#include "Marionette.h"
+#include "TestImage.h"
 
 using mr::unorm8;
 using mr::unorm8x4;
@@ -250,6 +250,1237 @@ testCase(Filter)
     wait_async_ops();
 }
 
+testCase(CPUBackend)
+{
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    // random blocks to get stable contours
+    const int2 size{ 640, 480 };
+    std::vector<unorm8x4> pixels(size.x * size.y);
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            uint32_t h = test::CellHash(x, y, 16);
+            float v = float((h >> 16) & 0xff) / 255.0f;
+            pixels[size.x * y + x] = { v, v, v, 1.0f };
+        }
+    }
+
+    const int2 tpos{ 123, 77 };
+    const int2 tsize{ 60, 40 };
+
+    struct Result
+    {
+        mr::IReduceMinMax::Result match;
+        uint32_t bits;
+        std::vector<uint32_t> binary;
+    };
+    auto run = [&](mr::IGfxInterfacePtr gfx) {
+        Result ret{};
+        auto src = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels.data(), size.x * 4);
+        auto gray = gfx->createTexture(size.x, size.y, mr::TextureFormat::Ru8);
+        auto contour = gfx->createTexture(size.x, size.y, mr::TextureFormat::Ru8);
+        auto binary = gfx->createTexture(size.x, size.y, mr::TextureFormat::Binary);
+        auto tmpl_gray = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::Ru8);
+        auto tmpl_contour = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::Ru8);
+        auto tmpl_binary = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::Binary);
+        auto tmpl_mask = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::Binary);
+        auto match = gfx->createTexture(size.x, size.y, mr::TextureFormat::Ri32);
+
+        auto transform = gfx->createTransform();
+        transform->setSrc(src);
+        transform->setDst(gray);
+        transform->setGrayscale(true);
+        transform->dispatch();
+        transform->setDst(tmpl_gray);
+        transform->setSrcRegion({ tpos, tsize });
+        transform->dispatch();
+
+        auto contour_filter = gfx->createContour();
+        auto binarize = gfx->createBinarize();
+        binarize->setThreshold(0.2f);
+        auto make_binary = [&](auto g, auto c, auto b) {
+            contour_filter->setSrc(g);
+            contour_filter->setDst(c);
+            contour_filter->dispatch();
+            binarize->setSrc(c);
+            binarize->setDst(b);
+            binarize->dispatch();
+        };
+        make_binary(gray, contour, binary);
+        make_binary(tmpl_gray, tmpl_contour, tmpl_binary);
+
+        auto expand = gfx->createExpand();
+        expand->setSrc(tmpl_binary);
+        expand->setDst(tmpl_mask);
+        expand->dispatch();
+
+        Rect region{ {}, size - tsize };
+        auto tm = gfx->createTemplateMatch();
+        tm->setSrc(binary);
+        tm->setDst(match);
+        tm->setTemplate(tmpl_binary);
+        tm->setMask(tmpl_mask);
+        tm->setRegion(region);
+        tm->dispatch();
+
+        auto minmax = gfx->createReduceMinMax();
+        minmax->setSrc(match);
+        minmax->setRegion(region);
+        minmax->dispatch();
+        ret.match = minmax->getResult();
+
+        auto count_bits = gfx->createReduceCountBits();
+        count_bits->setSrc(binary);
+        count_bits->dispatch();
+        ret.bits = count_bits->getResult();
+
+        binary->read([&](const void* data, int pitch) {
+            int w = mr::ceildiv(size.x, 32);
+            for (int y = 0; y < size.y; ++y) {
+                auto row = (const uint32_t*)((const byte*)data + (pitch * y));
+                ret.binary.insert(ret.binary.end(), row, row + w);
+            }
+            });
+        return ret;
+    };
+
+    Result rc;
+    test::TestScope("CPU", [&]() { rc = run(cpu); });
+    testPrint("CPU: match %d at (%d, %d), bits %d\n", rc.match.vali_min, rc.match.pos_min.x, rc.match.pos_min.y, rc.bits);
+    testExpect(rc.match.vali_min == 0 && rc.match.pos_min == tpos);
+
+    if (gpu) {
+        Result rg;
+        test::TestScope("GPU", [&]() { rg = run(gpu); });
+        testPrint("GPU: match %d at (%d, %d), bits %d\n", rg.match.vali_min, rg.match.pos_min.x, rg.match.pos_min.y, rg.bits);
+        testExpect(rg.match.pos_min == rc.match.pos_min);
+
+        // filtering may differ slightly on precision. allow 0.1% of pixels to be different.
+        uint32_t diff = 0;
+        for (size_t i = 0; i < rc.binary.size(); ++i)
+            diff += std::popcount(rc.binary[i] ^ rg.binary[i]);
+        testPrint("different pixels: %d\n", diff);
+        testExpect(diff <= uint32_t(size.x * size.y / 1000));
+    }
+}
+
+testCase(CPUBinaryMatch)
+{
+    // CPU's binary template matching must give exactly same results as the shader.
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    uint32_t seed = 1;
+    auto random_bits = [&](int2 size) {
+        std::vector<uint32_t> ret(mr::ceildiv(size.x, 32) * size.y);
+        for (auto& v : ret) {
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            v = seed;
+        }
+        return ret;
+    };
+
+    const int2 size{ 1920, 1080 };
+    auto image = random_bits(size);
+
+    for (int width : { 17, 32, 45, 64, 100 }) {
+        const int2 tsize{ width, 40 };
+        auto tmpl = random_bits(tsize);
+        auto mask = random_bits(tsize);
+
+        for (int use_mask = 0; use_mask < 2; ++use_mask) {
+            Rect region{ { 35, 3 }, size - tsize - int2{ 35, 3 } };
+            auto run = [&](mr::IGfxInterfacePtr gfx) {
+                int ipitch = mr::ceildiv(size.x, 32) * 4;
+                int tpitch = mr::ceildiv(tsize.x, 32) * 4;
+                auto src = gfx->createTexture(size.x, size.y, mr::TextureFormat::Binary, image.data(), ipitch);
+                auto tex_tmpl = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::Binary, tmpl.data(), tpitch);
+                auto tex_mask = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::Binary, mask.data(), tpitch);
+                auto dst = gfx->createTexture(region.size.x, region.size.y, mr::TextureFormat::Ri32);
+
+                auto tm = gfx->createTemplateMatch();
+                tm->setSrc(src);
+                tm->setDst(dst);
+                tm->setTemplate(tex_tmpl);
+                if (use_mask)
+                    tm->setMask(tex_mask);
+                tm->setRegion(region);
+                test::TestScope("CPUBinaryMatch", [&]() { tm->dispatch(); gfx->sync(); });
+
+                std::vector<uint32_t> ret;
+                dst->read([&](const void* data, int pitch) {
+                    for (int y = 0; y < region.size.y; ++y) {
+                        auto row = (const uint32_t*)((const byte*)data + (pitch * y));
+                        ret.insert(ret.end(), row, row + region.size.x);
+                    }
+                    });
+                return ret;
+            };
+
+            testPrint("width %d, mask %d\n", width, use_mask);
+            auto rc = run(cpu);
+            if (gpu) {
+                auto rg = run(gpu);
+                testExpect(rc == rg);
+            }
+        }
+    }
+}
+
+testCase(TemplateMatchMin)
+{
+    // fused match + min reduction must give the first minimum in scanline order of the score map.
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 40, 30 };
+    const int2 tpos{ 345, 217 };
+    std::vector<unorm8x4> pixels(size.x * size.y);
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            uint32_t h = test::CellHash(x, y, 8);
+            pixels[size.x * y + x] = { float((h >> 8) & 0xff) / 255.0f, float((h >> 16) & 0xff) / 255.0f, float((h >> 24) & 0xff) / 255.0f, 1.0f };
+        }
+    }
+
+    auto run = [&](mr::IGfxInterfacePtr gfx, mr::TextureFormat format, bool use_mask) {
+        auto rgba = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels.data(), size.x * 4);
+        auto transform = gfx->createTransform();
+        auto binarize = gfx->createBinarize();
+        binarize->setThreshold(0.5f);
+        auto make = [&](Rect region) {
+            bool rgb = format == mr::TextureFormat::RGBAu8;
+            auto ret = gfx->createTexture(region.size.x, region.size.y, rgb ? mr::TextureFormat::RGBAu8 : mr::TextureFormat::Ru8);
+            transform->setSrc(rgba);
+            transform->setDst(ret);
+            transform->setSrcRegion(region);
+            transform->setGrayscale(!rgb);
+            transform->dispatch();
+            if (format == mr::TextureFormat::Binary) {
+                auto gray = ret;
+                ret = gfx->createTexture(region.size.x, region.size.y, mr::TextureFormat::Binary);
+                binarize->setSrc(gray);
+                binarize->setDst(ret);
+                binarize->dispatch();
+            }
+            return ret;
+        };
+        auto src = make({ {}, size });
+        auto tmpl = make({ tpos, tsize });
+        auto mask = use_mask ? make({ tpos + 3, tsize }) : nullptr;
+        Rect region{ { 7, 5 }, size - tsize - int2{ 7, 5 } };
+        bool is_float = format != mr::TextureFormat::Binary;
+        int num_try = gfx == gpu ? 5 : 1; // CPU RGB matching takes seconds
+
+        // reference: score map + scan
+        auto map = gfx->createTexture(region.size.x, region.size.y, is_float ? mr::TextureFormat::Rf32 : mr::TextureFormat::Ri32);
+        auto tm = gfx->createTemplateMatch();
+        tm->setSrc(src);
+        tm->setDst(map);
+        tm->setTemplate(tmpl);
+        tm->setMask(mask);
+        tm->setRegion(region);
+        auto minmax = gfx->createReduceMinMax();
+        minmax->setSrc(map);
+        minmax->setRegion({ {}, region.size });
+        test::TestScope("match + minmax", [&]() { tm->dispatch(); minmax->dispatch(); minmax->getResult(); }, num_try);
+
+        auto scan = [&]() {
+            mr::IReduceMinMax::Result ret{};
+            bool first = true;
+            map->read([&](const void* data, int pitch) {
+                for (int y = 0; y < region.size.y; ++y) {
+                    auto row = (const uint32_t*)((const byte*)data + (pitch * y));
+                    for (int x = 0; x < region.size.x; ++x) {
+                        // float scores are not negative. they can be compared by bits.
+                        if (first || row[x] < ret.vali_min) {
+                            ret.vali_min = row[x];
+                            ret.pos_min = { x, y };
+                            first = false;
+                        }
+                    }
+                }
+                });
+            return ret;
+        };
+        auto expected = scan();
+
+        auto tmm = gfx->createTemplateMatchMin();
+        tmm->setSrc(src);
+        tmm->setTemplate(tmpl);
+        tmm->setMask(mask);
+        tmm->setRegion(region);
+        mr::IReduceMinMax::Result r{};
+        test::TestScope("match min", [&]() { tmm->dispatch(); r = tmm->getResult(); }, num_try);
+        testPrint("score %u (%d, %d), expected %u (%d, %d)\n", r.vali_min, r.pos_min.x, r.pos_min.y,
+            expected.vali_min, expected.pos_min.x, expected.pos_min.y);
+        testExpect(r.vali_min == expected.vali_min && r.pos_min == expected.pos_min);
+        if (!use_mask)
+            testExpect(r.pos_min + region.pos == tpos);
+
+        // a template that isn't exactly on the screen (the minimum is not 0) and one that isn't there at all (inverted).
+        // positions are rejected by the best found so far, and the first minimum in scanline order must still win.
+        if (format == mr::TextureFormat::RGBAu8) {
+            for (bool inverted : { false, true }) {
+                std::vector<unorm8x4> tpixels(tsize.x * tsize.y);
+                for (int y = 0; y < tsize.y; ++y) {
+                    for (int x = 0; x < tsize.x; ++x) {
+                        auto p = pixels[size.x * (tpos.y + y) + (tpos.x + x)];
+                        if (inverted) {
+                            for (int c = 0; c < 3; ++c)
+                                p[c].value = uint8_t(255 - p[c].value);
+                        }
+                        else if ((x + y) % 5 == 0) {
+                            p.x.value = uint8_t(std::min(p.x.value + 25, 255));
+                        }
+                        tpixels[tsize.x * y + x] = p;
+                    }
+                }
+                auto t = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::RGBAu8, tpixels.data(), tsize.x * 4);
+                tm->setTemplate(t);
+                tm->dispatch();
+                expected = scan();
+                tmm->setTemplate(t);
+                tmm->dispatch();
+                r = tmm->getResult();
+                testPrint("%s: score %u (%d, %d), expected %u (%d, %d)\n", inverted ? "inverted" : "noisy", r.vali_min, r.pos_min.x, r.pos_min.y,
+                    expected.vali_min, expected.pos_min.x, expected.pos_min.y);
+                testExpect(r.vali_min == expected.vali_min && r.pos_min == expected.pos_min);
+            }
+        }
+    };
+
+    for (auto gfx : { cpu, gpu }) {
+        if (!gfx)
+            continue;
+        testPrint("%s\n", gfx == cpu ? "CPU" : "GPU");
+        run(gfx, mr::TextureFormat::Binary, false);
+        run(gfx, mr::TextureFormat::Binary, true);
+        run(gfx, mr::TextureFormat::Ru8, false);
+        run(gfx, mr::TextureFormat::RGBAu8, false);
+    }
+}
+
+testCase(TemplateMatchMinPruning)
+{
+    // the CPU matcher skips positions by lower bounds of the score. results must be same as the full scan,
+    // and most positions of a UI-like screen should be rejected early.
+    auto gfx = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(gfx != nullptr);
+
+    // flat background, buttons and lines of "text"
+    const int2 size{ 1280, 720 };
+    const int2 tsize{ 64, 40 };
+    std::vector<uint8_t> pixels(size.x * size.y, 230);
+    auto fill = [&](Rect r, auto&& f) {
+        for (int y = r.pos.y; y < r.pos.y + r.size.y; ++y)
+            for (int x = r.pos.x; x < r.pos.x + r.size.x; ++x)
+                pixels[size.x * y + x] = f(x, y);
+    };
+    for (int i = 0; i < 24; ++i) {
+        Rect button{ { 40 + (i % 6) * 200, 40 + (i / 6) * 170 }, { 160, 60 } };
+        fill(button, [i](int, int) { return uint8_t(60 + i * 7); });
+        fill(Rect{ button.pos + int2{ 16, 20 }, { 128, 20 } }, [i](int x, int y) {
+            uint32_t h = test::CellHash(x, y, 3, uint32_t(i));
+            return uint8_t((h >> 16) & 1 ? 250 : 20);
+            });
+    }
+    const int2 tpos{ 40 + 3 * 200 + 40, 40 + 2 * 170 + 10 };
+    auto src = gfx->createTexture(size.x, size.y, mr::TextureFormat::Ru8, pixels.data(), size.x);
+    std::vector<uint8_t> tpixels(tsize.x * tsize.y);
+    for (int y = 0; y < tsize.y; ++y)
+        for (int x = 0; x < tsize.x; ++x)
+            tpixels[tsize.x * y + x] = pixels[size.x * (tpos.y + y) + tpos.x + x];
+    auto tmpl = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::Ru8, tpixels.data(), tsize.x);
+    Rect region{ {}, size - tsize };
+
+    // reference: score map + scan
+    auto map = gfx->createTexture(region.size.x, region.size.y, mr::TextureFormat::Rf32);
+    auto tm = gfx->createTemplateMatch();
+    tm->setSrc(src);
+    tm->setDst(map);
+    tm->setTemplate(tmpl);
+    tm->setRegion(region);
+    auto minmax = gfx->createReduceMinMax();
+    minmax->setSrc(map);
+    minmax->setRegion({ {}, region.size });
+    mr::IReduceMinMax::Result expected{};
+    test::TestScope("match + minmax", [&]() { tm->dispatch(); minmax->dispatch(); expected = minmax->getResult(); });
+
+    auto tmm = gfx->createTemplateMatchMin();
+    tmm->setSrc(src);
+    tmm->setTemplate(tmpl);
+    tmm->setRegion(region);
+    mr::IReduceMinMax::Result r{};
+    test::TestScope("match min", [&]() { tmm->dispatch(); r = tmm->getResult(); }, 5);
+    testPrint("score %f (%d, %d), expected %f (%d, %d), pruned %.2f%%\n", r.valf_min, r.pos_min.x, r.pos_min.y,
+        expected.valf_min, expected.pos_min.x, expected.pos_min.y, tmm->getPruningRate() * 100.0f);
+    testExpect(r.valf_min == expected.valf_min && r.pos_min == tpos);
+    testExpect(tmm->getPruningRate() > 0.9f);
+
+    // not exactly same as the screen. the minimum is not 0.
+    for (int i = 0; i < (int)tpixels.size(); i += 7)
+        tpixels[i] = uint8_t(std::min(tpixels[i] + 9, 255));
+    auto noisy = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::Ru8, tpixels.data(), tsize.x);
+    tm->setTemplate(noisy);
+    tm->dispatch();
+    minmax->dispatch();
+    expected = minmax->getResult();
+    tmm->setTemplate(noisy);
+    tmm->dispatch();
+    r = tmm->getResult();
+    testPrint("score %f (%d, %d), expected %f (%d, %d), pruned %.2f%%\n", r.valf_min, r.pos_min.x, r.pos_min.y,
+        expected.valf_min, expected.pos_min.x, expected.pos_min.y, tmm->getPruningRate() * 100.0f);
+    testExpect(r.valf_min == expected.valf_min && r.pos_min == expected.pos_min);
+
+    // a template that is not on the screen. with the cutoff, the result must still be a miss.
+    for (auto& p : tpixels)
+        p = 255 - p;
+    auto absent = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::Ru8, tpixels.data(), tsize.x);
+    const float cutoff = 0.1f * float(tsize.x * tsize.y);
+    tmm->setTemplate(absent);
+    tmm->dispatch();
+    auto full = tmm->getResult();
+    tmm->setCutoff(cutoff);
+    test::TestScope("match min (cutoff)", [&]() { tmm->dispatch(); r = tmm->getResult(); }, 5);
+    testPrint("score %f, without cutoff %f, pruned %.2f%%\n", r.valf_min, full.valf_min, tmm->getPruningRate() * 100.0f);
+    testExpect(r.valf_min > cutoff && r.valf_min <= full.valf_min);
+}
+
+testCase(TemplateMatchMinMulti)
+{
+    // matching multiple templates at once must give the same results as matching them one by one.
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    const int2 size{ 320, 240 };
+    std::vector<unorm8x4> pixels(size.x * size.y);
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            uint32_t h = test::CellHash(x, y, 6);
+            pixels[size.x * y + x] = { float((h >> 8) & 0xff) / 255.0f, float((h >> 16) & 0xff) / 255.0f, float((h >> 24) & 0xff) / 255.0f, 1.0f };
+        }
+    }
+    const Rect crops[]{
+        { { 17, 30 }, { 16, 12 } },
+        { { 200, 41 }, { 24, 16 } },
+        { { 90, 150 }, { 20, 20 } },
+        { { 250, 190 }, { 32, 24 } },
+        { { 5, 200 }, { 12, 28 } },
+        { { 140, 99 }, { 28, 12 } },
+    };
+
+    auto run = [&](mr::IGfxInterfacePtr gfx, mr::TextureFormat format) {
+        auto rgba = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels.data(), size.x * 4);
+        auto transform = gfx->createTransform();
+        auto make = [&](Rect region) {
+            auto ret = gfx->createTexture(region.size.x, region.size.y, format);
+            transform->setSrc(rgba);
+            transform->setDst(ret);
+            transform->setSrcRegion(region);
+            transform->setGrayscale(format != mr::TextureFormat::RGBAu8);
+            transform->dispatch();
+            return ret;
+        };
+        auto src = make({ {}, size });
+        std::vector<mr::ITexture2DPtr> tmpls;
+        std::vector<Rect> regions;
+        for (auto& c : crops) {
+            tmpls.push_back(make(c));
+            regions.push_back({ {}, size - c.size });
+        }
+        // partially out of src
+        regions[2] = { { -8, -8 }, size - crops[2].size + 16 };
+
+        std::vector<mr::IReduceMinMax::Result> expected(tmpls.size());
+        auto tmm = gfx->createTemplateMatchMin();
+        tmm->setSrc(src);
+        test::TestScope("one by one", [&]() {
+            for (size_t i = 0; i < tmpls.size(); ++i) {
+                tmm->setTemplate(tmpls[i]);
+                tmm->setRegion(regions[i]);
+                tmm->dispatch();
+                expected[i] = tmm->getResult();
+            }
+            });
+
+        std::vector<mr::IReduceMinMax::Result> r;
+        auto multi = gfx->createTemplateMatchMinMulti();
+        multi->setSrc(src);
+        for (size_t i = 0; i < tmpls.size(); ++i)
+            multi->addTemplate(tmpls[i], regions[i]);
+        test::TestScope("multi", [&]() { multi->dispatch(); r = multi->getResult(); });
+
+        testExpect(r.size() == tmpls.size());
+        for (size_t i = 0; i < r.size(); ++i) {
+            testPrint("%d: score %u (%d, %d), expected %u (%d, %d)\n", (int)i, r[i].vali_min, r[i].pos_min.x, r[i].pos_min.y,
+                expected[i].vali_min, expected[i].pos_min.x, expected[i].pos_min.y);
+            testExpect(r[i].vali_min == expected[i].vali_min && r[i].pos_min == expected[i].pos_min);
+            testExpect(r[i].pos_min + regions[i].pos == crops[i].pos);
+        }
+
+        // the atlas and the buffers are reused. the templates in other order must be repacked, not read from old places.
+        multi->clearTemplates();
+        for (size_t i = tmpls.size(); i-- > 1;)
+            multi->addTemplate(tmpls[i], regions[i]);
+        multi->dispatch();
+        r = multi->getResult();
+        testExpect(r.size() == tmpls.size() - 1);
+        for (size_t i = 0; i < r.size(); ++i) {
+            size_t ti = tmpls.size() - 1 - i;
+            testExpect(r[i].vali_min == expected[ti].vali_min && r[i].pos_min == expected[ti].pos_min);
+        }
+    };
+
+    for (auto gfx : { cpu, gpu }) {
+        if (!gfx)
+            continue;
+        testPrint("%s\n", gfx == cpu ? "CPU" : "GPU");
+        run(gfx, mr::TextureFormat::Ru8);
+        run(gfx, mr::TextureFormat::RGBAu8);
+    }
+}
+
+testCase(TemplateMatchFFT)
+{
+    // FFT scores must be the sum of squared differences. the area is wider than MaxFFTSize, so it is split into tiles.
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    const int2 size{ 1200, 160 };
+    const int2 tsize{ 48, 32 };
+    const int2 tpos{ 1000, 70 };
+    std::vector<unorm8x4> pixels(size.x * size.y);
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            uint32_t h = test::CellHash(x, y, 8);
+            pixels[size.x * y + x] = { float((h >> 8) & 0xff) / 255.0f, float((h >> 16) & 0xff) / 255.0f, float((h >> 24) & 0xff) / 255.0f, 1.0f };
+        }
+    }
+
+    auto run = [&](mr::IGfxInterfacePtr gfx, mr::TextureFormat format) {
+        bool rgb = format == mr::TextureFormat::RGBAu8;
+        int channels = rgb ? 3 : 1;
+        auto rgba = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels.data(), size.x * 4);
+        auto transform = gfx->createTransform();
+        auto make = [&](Rect region) {
+            auto ret = gfx->createTexture(region.size.x, region.size.y, format);
+            transform->setSrc(rgba);
+            transform->setDst(ret);
+            transform->setSrcRegion(region);
+            transform->setGrayscale(!rgb);
+            transform->dispatch();
+            return ret;
+        };
+        auto src = make({ {}, size });
+        auto tmpl = make({ tpos, tsize });
+        Rect region{ { 7, 5 }, size - tsize - int2{ 7, 5 } };
+
+        auto map = gfx->createTexture(region.size.x, region.size.y, mr::TextureFormat::Rf32);
+        auto fft = gfx->createTemplateMatchFFT();
+        fft->setSrc(src);
+        fft->setDst(map);
+        fft->setTemplate(tmpl);
+        fft->setRegion(region);
+        test::TestScope("match fft", [&]() { fft->dispatch(); gfx->sync(); }, 5);
+
+        // reference: brute force on the CPU
+        auto read = [](mr::ITexture2DPtr tex, int texel_size) {
+            int2 s = tex->getSize();
+            std::vector<byte> ret(s.x * s.y * texel_size);
+            tex->read([&](const void* data, int pitch) {
+                for (int y = 0; y < s.y; ++y)
+                    memcpy(&ret[s.x * texel_size * y], (const byte*)data + (pitch * y), s.x * texel_size);
+                });
+            return ret;
+        };
+        int texel_size = rgb ? 4 : 1;
+        auto s = read(src, texel_size);
+        auto t = read(tmpl, texel_size);
+        auto scores = read(map, 4);
+
+        double max_error = 0.0;
+        int2 best{};
+        float best_score = std::numeric_limits<float>::max();
+        for (int y = 0; y < region.size.y; ++y) {
+            for (int x = 0; x < region.size.x; ++x) {
+                double expected = 0.0;
+                for (int i = 0; i < tsize.y; ++i) {
+                    auto* srow = &s[(size.x * (region.pos.y + y + i) + region.pos.x + x) * texel_size];
+                    auto* trow = &t[tsize.x * i * texel_size];
+                    for (int j = 0; j < tsize.x; ++j) {
+                        for (int c = 0; c < channels; ++c) {
+                            double d = double(int(srow[j * texel_size + c]) - int(trow[j * texel_size + c])) / 255.0;
+                            expected += d * d;
+                        }
+                    }
+                }
+                float v = ((const float*)scores.data())[region.size.x * y + x];
+                max_error = std::max(max_error, std::abs(double(v) - expected));
+                if (v < best_score) {
+                    best_score = v;
+                    best = { x, y };
+                }
+            }
+        }
+        testPrint("max error %f, min %f (%d, %d)\n", max_error, best_score, best.x, best.y);
+        testExpect(max_error < 0.01 * channels);
+        testExpect(best + region.pos == tpos);
+
+        std::vector<float> ret(region.size.x * region.size.y);
+        memcpy(ret.data(), scores.data(), ret.size() * sizeof(float));
+        return ret;
+    };
+
+    // the GPU branch must give the same map as the CPU, not only a map close to the brute force
+    for (auto format : { mr::TextureFormat::Ru8, mr::TextureFormat::RGBAu8 }) {
+        int channels = format == mr::TextureFormat::RGBAu8 ? 3 : 1;
+        testPrint("CPU\n");
+        auto cpu_scores = run(cpu, format);
+        if (!gpu)
+            continue;
+        testPrint("GPU\n");
+        auto gpu_scores = run(gpu, format);
+
+        double max_diff = 0.0;
+        for (size_t i = 0; i < cpu_scores.size(); ++i)
+            max_diff = std::max(max_diff, std::abs(double(cpu_scores[i]) - double(gpu_scores[i])));
+        testPrint("max CPU/GPU difference %f\n", max_diff);
+        testExpect(max_diff < 0.01 * channels);
+    }
+}
+
+testCase(TemplateMatchChamfer)
+{
+    // distance maps must be the exact euclidean distance clamped to the max distance, and chamfer matching must find
+    // the position where all the points are on edges.
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    const int2 size{ 320, 200 };
+    const int2 tsize{ 48, 32 };
+    const int2 tpos{ 201, 123 };
+    const float max_distance = 5.5f;
+    const int pitch = mr::ceildiv(size.x, 32);
+    std::vector<uint32_t> bits(pitch * size.y);
+    auto set_bits = [&](Rect r, uint32_t salt) {
+        for (int y = r.pos.y; y < r.pos.y + r.size.y; ++y) {
+            for (int x = r.pos.x; x < r.pos.x + r.size.x; ++x) {
+                uint32_t h = test::CellHash(x, y, 1, salt);
+                uint32_t bit = 1u << (x % 32);
+                bits[pitch * y + x / 32] = ((h >> 16) % 61 == 0) ? (bits[pitch * y + x / 32] | bit) : (bits[pitch * y + x / 32] & ~bit);
+            }
+        }
+    };
+    auto get_bit = [&](int x, int y) { return (bits[pitch * y + x / 32] >> (x % 32)) & 1; };
+    set_bits({ {}, size }, 0);
+
+    std::vector<int2> points;
+    for (int y = 0; y < tsize.y; ++y)
+        for (int x = 0; x < tsize.x; ++x)
+            if (get_bit(tpos.x + x, tpos.y + y))
+                points.push_back({ x, y });
+
+    // reference: brute force
+    auto check_distance = [&](mr::ITexture2DPtr map) {
+        int r = (int)std::ceil(max_distance);
+        double max_error = 0.0;
+        map->read([&](const void* data, int map_pitch) {
+            for (int y = 0; y < size.y; ++y) {
+                auto row = (const float*)((const byte*)data + (map_pitch * y));
+                for (int x = 0; x < size.x; ++x) {
+                    float d = max_distance;
+                    for (int sy = std::max(y - r, 0); sy < std::min(y + r + 1, size.y); ++sy)
+                        for (int sx = std::max(x - r, 0); sx < std::min(x + r + 1, size.x); ++sx)
+                            if (get_bit(sx, sy))
+                                d = std::min(d, std::sqrt(float((sx - x) * (sx - x) + (sy - y) * (sy - y))));
+                    max_error = std::max(max_error, std::abs(double(row[x]) - double(d / max_distance)));
+                }
+            }
+            });
+        return max_error;
+    };
+
+    auto run = [&](mr::IGfxInterfacePtr gfx) {
+        set_bits({ {}, size }, 0);
+        auto src = gfx->createTexture(size.x, size.y, mr::TextureFormat::Binary, bits.data(), pitch * 4);
+        auto map = gfx->createTexture(size.x, size.y, mr::TextureFormat::Rf32);
+        auto dt = gfx->createDistanceTransform();
+        dt->setSrc(src);
+        dt->setDst(map);
+        dt->setMaxDistance(max_distance);
+        test::TestScope("distance transform", [&]() { dt->dispatch(); gfx->sync(); }, 5);
+        double error = check_distance(map);
+        testPrint("distance max error %f\n", error);
+        testExpect(error < 1e-5);
+
+        // partial update: change bits in a rect and update the rect expanded by the max distance.
+        // the second one is at the bottom right corner, so the expanded region and the columns of pass 1 are clipped.
+        uint32_t salt = 1;
+        for (Rect changed : { Rect{ { 40, 30 }, { 64, 50 } }, Rect{ { 290, 180 }, { 30, 20 } } }) {
+            set_bits(changed, salt++);
+            src = gfx->createTexture(size.x, size.y, mr::TextureFormat::Binary, bits.data(), pitch * 4);
+            dt->setSrc(src);
+            dt->setDstRegion(changed.expand((int)std::ceil(max_distance)));
+            dt->dispatch();
+            error = check_distance(map);
+            testPrint("partial update max error %f\n", error);
+            testExpect(error < 1e-5);
+        }
+
+        // the template was taken from the unchanged part
+        set_bits({ {}, size }, 0);
+        src = gfx->createTexture(size.x, size.y, mr::TextureFormat::Binary, bits.data(), pitch * 4);
+        dt->setSrc(src);
+        dt->setDstRegion({});
+        dt->dispatch();
+
+        Rect region{ { 3, 2 }, size - tsize - int2{ 3, 2 } };
+        auto scores = gfx->createTexture(region.size.x, region.size.y, mr::TextureFormat::Rf32);
+        auto cm = gfx->createChamferMatch();
+        cm->setSrc(map);
+        cm->setDst(scores);
+        cm->setPoints(points);
+        cm->setRegion(region);
+        test::TestScope("chamfer match", [&]() { cm->dispatch(); gfx->sync(); }, 5);
+        auto expected = MinMax_Reference(scores);
+
+        auto cmm = gfx->createChamferMatchMin();
+        cmm->setSrc(map);
+        cmm->setPoints(points);
+        cmm->setRegion(region);
+        mr::IReduceMinMax::Result r{};
+        test::TestScope("chamfer match min", [&]() { cmm->dispatch(); r = cmm->getResult(); }, 5);
+        testPrint("%d points, score %f (%d, %d), expected %f (%d, %d)\n", (int)points.size(), r.valf_min, r.pos_min.x, r.pos_min.y,
+            expected.valf_min, expected.pos_min.x, expected.pos_min.y);
+        testExpect(r.valf_min == expected.valf_min && r.pos_min == expected.pos_min);
+        testExpect(r.valf_min == 0.0f && r.pos_min + region.pos == tpos);
+
+        std::vector<float> ret(region.size.x * region.size.y);
+        scores->read([&](const void* data, int score_pitch) {
+            for (int y = 0; y < region.size.y; ++y)
+                memcpy(&ret[region.size.x * y], (const byte*)data + (score_pitch * y), region.size.x * sizeof(float));
+            });
+        return ret;
+    };
+
+    testPrint("CPU\n");
+    auto cpu_scores = run(cpu);
+    if (gpu) {
+        testPrint("GPU\n");
+        // points are summed in the same order, so the score maps must be identical
+        testExpect(run(gpu) == cpu_scores);
+    }
+}
+
+testCase(TemplateMatchSparse)
+{
+    // all pixels as samples must give the scores of ITemplateMatch. scores stopped at the cutoff must be lower bounds
+    // greater than it, and the minimum must stay.
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    const int2 size{ 320, 240 };
+    const int2 tsize{ 24, 16 };
+    const int2 tpos{ 150, 97 };
+    std::vector<unorm8x4> pixels(size.x * size.y);
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            uint32_t h = test::CellHash(x, y, 4);
+            pixels[size.x * y + x] = { float((h >> 8) & 0xff) / 255.0f, float((h >> 16) & 0xff) / 255.0f, float((h >> 24) & 0xff) / 255.0f, 1.0f };
+        }
+    }
+
+    auto run = [&](mr::IGfxInterfacePtr gfx, mr::TextureFormat format) {
+        bool rgb = format == mr::TextureFormat::RGBAu8;
+        auto rgba = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels.data(), size.x * 4);
+        auto transform = gfx->createTransform();
+        auto make = [&](Rect region) {
+            auto ret = gfx->createTexture(region.size.x, region.size.y, format);
+            transform->setSrc(rgba);
+            transform->setDst(ret);
+            transform->setSrcRegion(region);
+            transform->setGrayscale(!rgb);
+            transform->dispatch();
+            return ret;
+        };
+        auto src = make({ {}, size });
+        auto tmpl = make({ tpos, tsize });
+        Rect region{ { 5, 3 }, size - tsize - int2{ 5, 3 } };
+
+        std::vector<mr::SparseSample> samples;
+        tmpl->read([&](const void* data, int pitch) {
+            for (int y = 0; y < tsize.y; ++y) {
+                for (int x = 0; x < tsize.x; ++x) {
+                    auto* p = (const byte*)data + (pitch * y) + x * (rgb ? 4 : 1);
+                    mr::SparseSample s{};
+                    s.pos = { x, y };
+                    for (int c = 0; c < 4; ++c)
+                        s.color[c].value = rgb || c == 0 ? p[c] : 0;
+                    samples.push_back(s);
+                }
+            }
+            });
+
+        auto read = [&](mr::ITexture2DPtr map) {
+            std::vector<float> ret(region.size.x * region.size.y);
+            map->read([&](const void* data, int pitch) {
+                for (int y = 0; y < region.size.y; ++y)
+                    memcpy(&ret[region.size.x * y], (const byte*)data + (pitch * y), region.size.x * 4);
+                });
+            return ret;
+        };
+
+        auto dense = gfx->createTexture(region.size.x, region.size.y, mr::TextureFormat::Rf32);
+        auto tm = gfx->createTemplateMatch();
+        tm->setSrc(src);
+        tm->setDst(dense);
+        tm->setTemplate(tmpl);
+        tm->setRegion(region);
+        test::TestScope("match", [&]() { tm->dispatch(); gfx->sync(); });
+        auto expected = read(dense);
+
+        auto sparse = gfx->createTexture(region.size.x, region.size.y, mr::TextureFormat::Rf32);
+        auto sm = gfx->createSparseMatch();
+        sm->setSrc(src);
+        sm->setDst(sparse);
+        sm->setSamples(samples);
+        sm->setRegion(region);
+        test::TestScope("sparse match", [&]() { sm->dispatch(); gfx->sync(); });
+        auto scores = read(sparse);
+        double max_error = 0.0;
+        for (size_t i = 0; i < scores.size(); ++i)
+            max_error = std::max(max_error, std::abs(double(scores[i]) - double(expected[i])));
+
+        const float cutoff = 20.0f;
+        sm->setCutoff(cutoff);
+        test::TestScope("sparse match with cutoff", [&]() { sm->dispatch(); gfx->sync(); });
+        auto bounds = read(sparse);
+        int num_bound = 0;
+        bool valid = true;
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            if (expected[i] <= cutoff) {
+                valid = valid && std::abs(bounds[i] - expected[i]) < 0.01f;
+            }
+            else {
+                valid = valid && bounds[i] > cutoff && bounds[i] <= expected[i] + 0.01f;
+                ++num_bound;
+            }
+        }
+        testPrint("max error %f, %d of %d positions stopped at the cutoff\n", max_error, num_bound, (int)bounds.size());
+        testExpect(max_error < 0.01);
+        testExpect(valid);
+        testExpect(expected[region.size.x * (tpos.y - region.pos.y) + (tpos.x - region.pos.x)] == 0.0f);
+    };
+
+    for (auto gfx : { cpu, gpu }) {
+        if (!gfx)
+            continue;
+        testPrint("%s\n", gfx == cpu ? "CPU" : "GPU");
+        run(gfx, mr::TextureFormat::Ru8);
+        run(gfx, mr::TextureFormat::RGBAu8);
+    }
+}
+
+testCase(ReduceHistogram)
+{
+    // counts of each region must be same as brute force, and the Otsu threshold of a bimodal image must separate the modes.
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    // not multiples of the tile size. modes are 44-75 and 164-195.
+    const int2 size{ 333, 241 };
+    std::vector<uint8_t> pixels(size.x * size.y);
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            uint32_t h = test::CellHash(x, y);
+            pixels[size.x * y + x] = uint8_t(((h >> 16) & 1 ? 164 : 44) + ((h >> 8) & 0x1f));
+        }
+    }
+    // the same as Rf32. some texels are out of 0-1 and must be saturated.
+    std::vector<float> fpixels(pixels.size());
+    for (size_t i = 0; i < pixels.size(); ++i)
+        fpixels[i] = i % 17 == 0 ? (i % 2 ? 1.5f : -0.5f) : float(pixels[i]) / 255.0f;
+
+    auto reference = [&](Rect region, bool is_float) {
+        mr::IReduceHistogram::Result ret{};
+        if (region.size == int2::zero())
+            region = { {}, size };
+        for (int y = std::max(region.pos.y, 0); y < std::min(region.pos.y + region.size.y, size.y); ++y) {
+            for (int x = std::max(region.pos.x, 0); x < std::min(region.pos.x + region.size.x, size.x); ++x) {
+                int i = size.x * y + x;
+                ++ret[is_float ? uint32_t(std::clamp(fpixels[i], 0.0f, 1.0f) * 255.0f + 0.5f) : pixels[i]];
+            }
+        }
+        return ret;
+    };
+
+    // the last two regions stick out of the texture
+    const Rect regions[]{ {}, { { 40, 30 }, { 100, 70 } }, { { 300, 200 }, { 100, 100 } }, { { -20, -10 }, { 80, 60 } } };
+    for (auto gfx : { cpu, gpu }) {
+        if (!gfx)
+            continue;
+        auto fsrc = gfx->createTexture(size.x, size.y, mr::TextureFormat::Rf32, fpixels.data(), size.x * 4);
+        auto src = gfx->createTexture(size.x, size.y, mr::TextureFormat::Ru8, pixels.data(), size.x);
+        auto histogram = gfx->createReduceHistogram();
+        for (auto& region : regions) {
+            histogram->setRegion(region);
+            histogram->setSrc(fsrc);
+            histogram->dispatch();
+            testExpect(histogram->getResult() == reference(region, true));
+
+            histogram->setSrc(src);
+            test::TestScope(gfx == cpu ? "CPU" : "GPU", [&]() { histogram->dispatch(); });
+            testExpect(histogram->getResult() == reference(region, false));
+        }
+
+        histogram->setRegion({});
+        histogram->dispatch();
+        float threshold = mr::GetOtsuThreshold(histogram->getResult());
+        testPrint("%s: threshold %.4f\n", gfx == cpu ? "CPU" : "GPU", threshold);
+        testExpect(threshold > 75.0f / 255.0f && threshold < 164.0f / 255.0f);
+    }
+}
+
+testCase(FilterDstRegion)
+{
+    // updating changed regions of the previous results must give the same results as updating entire image.
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    const int2 size{ 320, 200 };
+    const Rect changed{ { 100, 60 }, { 30, 20 } };
+    auto make_pixels = [&](bool change) {
+        std::vector<unorm8x4> ret(size.x * size.y);
+        for (int y = 0; y < size.y; ++y) {
+            for (int x = 0; x < size.x; ++x) {
+                bool in_changed = x >= changed.pos.x && y >= changed.pos.y && x < changed.pos.x + changed.size.x && y < changed.pos.y + changed.size.y;
+                uint32_t h = test::CellHash(x, y, 8, change && in_changed ? 0x5bd1e995 : 0);
+                float v = float((h >> 16) & 0xff) / 255.0f;
+                ret[size.x * y + x] = { v, v, v, 1.0f };
+            }
+        }
+        return ret;
+    };
+    auto pixels1 = make_pixels(false);
+    auto pixels2 = make_pixels(true);
+
+    auto read = [](mr::ITexture2DPtr tex) {
+        std::vector<byte> ret;
+        tex->read([&](const void* data, int pitch) {
+            ret.assign((const byte*)data, (const byte*)data + (pitch * tex->getSize().y));
+            });
+        return ret;
+    };
+
+    auto run = [&](mr::IGfxInterfacePtr gfx, float radius) {
+        // downscale with filtering. the region must cover the filter support around the changed rect.
+        const int2 dsize = size / 2;
+        const Rect region{ { 32, 16 }, { 64, 48 } };
+
+        auto src1 = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels1.data(), size.x * 4);
+        auto src2 = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels2.data(), size.x * 4);
+        auto transform = gfx->createTransform();
+        auto binarize = gfx->createBinarize();
+        auto contour = gfx->createContour();
+        transform->setGrayscale(true);
+        transform->setFiltering(true);
+        binarize->setThreshold(0.5f);
+        contour->setRadius(radius);
+
+        auto process = [&](mr::ITexture2DPtr src, mr::ITexture2DPtr gray, mr::ITexture2DPtr cont, mr::ITexture2DPtr bin, Rect r) {
+            transform->setSrc(src);
+            transform->setDst(gray);
+            transform->setDstRegion(r);
+            transform->dispatch();
+
+            contour->setSrc(gray);
+            contour->setDst(cont);
+            contour->setDstRegion(r.size.x ? r.expand(int(radius)) : r);
+            contour->dispatch();
+
+            binarize->setSrc(cont);
+            binarize->setDst(bin);
+            binarize->setDstRegion(r.size.x ? r.expand(int(radius)) : r);
+            binarize->dispatch();
+        };
+
+        std::vector<mr::ITexture2DPtr> full, partial;
+        for (auto* v : { &full, &partial }) {
+            v->push_back(gfx->createTexture(dsize.x, dsize.y, mr::TextureFormat::Ru8));
+            v->push_back(gfx->createTexture(dsize.x, dsize.y, mr::TextureFormat::Ru8));
+            v->push_back(gfx->createTexture(dsize.x, dsize.y, mr::TextureFormat::Binary));
+        }
+        process(src2, full[0], full[1], full[2], {});
+        process(src1, partial[0], partial[1], partial[2], {});
+        process(src2, partial[0], partial[1], partial[2], region);
+
+        for (int i = 0; i < 3; ++i)
+            testExpect(read(full[i]) == read(partial[i]));
+    };
+
+    // radius 5 takes several rectangles and passes of the running min & max, each on its own region
+    for (float radius : { 1.0f, 5.0f }) {
+        run(cpu, radius);
+        if (gpu)
+            run(gpu, radius);
+    }
+}
+
+testCase(Morphology)
+{
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+
+    const int2 size{ 200, 150 };
+    const int pitch_bits = mr::ceildiv(size.x, 32);
+    std::vector<byte> gray(size.x * size.y);
+    std::vector<uint32_t> bits(pitch_bits * size.y);
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            uint32_t h = test::CellHash(x, y);
+            gray[size.x * y + x] = byte(h >> 24);
+            if ((h >> 8) % 97 == 0)
+                bits[pitch_bits * y + x / 32] |= 1u << (x % 32);
+        }
+    }
+
+    // brute force references
+    auto disc_minmax = [&](float radius, int2 p) {
+        int r = int(radius);
+        int2 ret{ 255, 0 };
+        for (int i = -r; i <= r; ++i) {
+            for (int j = -r; j <= r; ++j) {
+                int2 q = p + int2{ j, i };
+                if (q.x >= 0 && q.y >= 0 && q.x < size.x && q.y < size.y && mr::length(float2{ float(j), float(i) }) <= radius) {
+                    int c = gray[size.x * q.y + q.x];
+                    ret = { std::min(ret.x, c), std::max(ret.y, c) };
+                }
+            }
+        }
+        return ret;
+    };
+    auto disc_any = [&](float radius, int2 p) {
+        int r = int(radius);
+        for (int i = -r; i <= r; ++i) {
+            for (int j = -r; j <= r; ++j) {
+                int2 q = p + int2{ j, i };
+                if (q.x >= 0 && q.y >= 0 && q.x < size.x && q.y < size.y && mr::length(float2{ float(j), float(i) }) <= radius &&
+                    (bits[pitch_bits * q.y + q.x / 32] & (1u << (q.x % 32))))
+                    return true;
+            }
+        }
+        return false;
+    };
+
+    auto read = [](mr::ITexture2DPtr tex, int elem_size) {
+        std::vector<byte> ret;
+        tex->read([&](const void* data, int pitch) {
+            int w = tex->getFormat() == mr::TextureFormat::Binary ? mr::ceildiv(tex->getSize().x, 32) : tex->getSize().x;
+            for (int y = 0; y < tex->getSize().y; ++y)
+                ret.insert(ret.end(), (const byte*)data + pitch * y, (const byte*)data + pitch * y + w * elem_size);
+            });
+        return ret;
+    };
+
+    auto run = [&](mr::IGfxInterfacePtr gfx) {
+        auto src = gfx->createTexture(size.x, size.y, mr::TextureFormat::Ru8, gray.data(), size.x);
+        auto bsrc = gfx->createTexture(size.x, size.y, mr::TextureFormat::Binary, bits.data(), pitch_bits * 4);
+        auto cont = gfx->createTexture(size.x, size.y, mr::TextureFormat::Ru8);
+        auto exp = gfx->createTexture(size.x, size.y, mr::TextureFormat::Ru8);
+        auto bexp = gfx->createTexture(size.x, size.y, mr::TextureFormat::Binary);
+
+        auto contour = gfx->createContour();
+        auto expand = gfx->createExpand();
+
+        // up to 4 corners in the disc. grayscale results must be exact.
+        for (float radius : { 0.5f, 1.0f, 1.5f, 2.0f, 3.0f, 4.5f, 5.0f, 12.0f }) {
+            contour->setSrc(src);
+            contour->setDst(cont);
+            contour->setRadius(radius);
+            contour->dispatch();
+
+            expand->setRadius(radius);
+            expand->setSrc(src);
+            expand->setDst(exp);
+            expand->dispatch();
+            expand->setSrc(bsrc);
+            expand->setDst(bexp);
+            expand->dispatch();
+
+            auto rc = read(cont, 1);
+            auto re = read(exp, 1);
+            auto rb = read(bexp, 4);
+            int errors_gray = 0, errors_binary = 0;
+            for (int y = 0; y < size.y; ++y) {
+                for (int x = 0; x < size.x; ++x) {
+                    if (radius <= 5.0f) {
+                        int2 mm = disc_minmax(radius, { x, y });
+                        if (rc[size.x * y + x] != mm.y - mm.x || re[size.x * y + x] != mm.y)
+                            ++errors_gray;
+                    }
+                    bool b = (((const uint32_t*)rb.data())[pitch_bits * y + x / 32] & (1u << (x % 32))) != 0;
+                    if (b != disc_any(radius, { x, y }))
+                        ++errors_binary;
+                }
+            }
+            testPrint("radius %.1f: errors %d %d\n", radius, errors_gray, errors_binary);
+            testExpect(errors_gray == 0 && errors_binary == 0);
+        }
+
+        // the cost should not depend on the radius
+        for (float radius : { 2.0f, 24.0f }) {
+            char name[64];
+            snprintf(name, sizeof(name), "Contour (radius %.0f)", radius);
+            contour->setRadius(radius);
+            test::TestScope(name, [&]() {
+                contour->dispatch();
+                gfx->sync();
+                }, 5);
+        }
+    };
+
+    run(cpu);
+    if (gpu)
+        run(gpu);
+}
+
+testCase(Preprocess)
+{
+    // the fused pass must give the same results as the separate filters, for entire images and changed regions.
+    auto gpu = mr::CreateGfxInterface(mr::GfxBackend::D3D11);
+    auto cpu = mr::CreateGfxInterface(mr::GfxBackend::CPU);
+    testExpect(cpu != nullptr);
+
+    const int2 size{ 320, 200 };
+    const Rect changed{ { 100, 60 }, { 30, 20 } };
+    auto make_pixels = [&](bool change) {
+        std::vector<unorm8x4> ret(size.x * size.y);
+        for (int y = 0; y < size.y; ++y) {
+            for (int x = 0; x < size.x; ++x) {
+                bool in_changed = x >= changed.pos.x && y >= changed.pos.y && x < changed.pos.x + changed.size.x && y < changed.pos.y + changed.size.y;
+                uint32_t h = test::CellHash(x, y, 6, change && in_changed ? 0x5bd1e995 : 0);
+                ret[size.x * y + x] = { float((h >> 8) & 0xff) / 255.0f, float((h >> 16) & 0xff) / 255.0f, float(h >> 24) / 255.0f, 1.0f };
+            }
+        }
+        return ret;
+    };
+    auto pixels1 = make_pixels(false);
+    auto pixels2 = make_pixels(true);
+
+    auto read = [](mr::ITexture2DPtr tex) {
+        std::vector<byte> ret;
+        tex->read([&](const void* data, int pitch) {
+            ret.assign((const byte*)data, (const byte*)data + (pitch * tex->getSize().y));
+            });
+        return ret;
+    };
+
+    auto run = [&](mr::IGfxInterfacePtr gfx) {
+        const float2 color_range{ 0.1f, 0.9f };
+        const float threshold = 0.3f;
+        // changed rect and the filter support around it
+        const Rect region{ { 88, 48 }, { 56, 44 } };
+
+        auto src1 = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels1.data(), size.x * 4);
+        auto src2 = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels2.data(), size.x * 4);
+        auto transform = gfx->createTransform();
+        auto grayscale = gfx->createTransform();
+        auto binarize = gfx->createBinarize();
+        auto contour = gfx->createContour();
+        auto preprocess = gfx->createPreprocess();
+        grayscale->setGrayscale(true);
+        grayscale->setColorRange(color_range);
+        binarize->setThreshold(threshold);
+        preprocess->setColorRange(color_range);
+        preprocess->setThreshold(threshold);
+
+        // radius 10 is beyond the halo of the fused pass on GPU
+        for (int2 dsize : { size, size / 2 }) {
+            for (float radius : { 1.0f, 10.0f }) {
+                std::vector<mr::ITexture2DPtr> separate, full, partial;
+                for (auto* v : { &separate, &full, &partial }) {
+                    v->push_back(gfx->createTexture(dsize.x, dsize.y, mr::TextureFormat::RGBAu8));
+                    v->push_back(gfx->createTexture(dsize.x, dsize.y, mr::TextureFormat::Ru8));
+                    v->push_back(gfx->createTexture(dsize.x, dsize.y, mr::TextureFormat::Binary));
+                    v->push_back(gfx->createTexture(dsize.x, dsize.y, mr::TextureFormat::Ru8));
+                    v->push_back(gfx->createTexture(dsize.x, dsize.y, mr::TextureFormat::Binary));
+                }
+
+                transform->setSrc(src2);
+                transform->setDst(separate[0]);
+                transform->setFiltering(dsize.x != size.x);
+                transform->dispatch();
+                grayscale->setSrc(src2);
+                grayscale->setDst(separate[1]);
+                grayscale->setFiltering(dsize.x < size.x);
+                grayscale->dispatch();
+                binarize->setSrc(separate[1]);
+                binarize->setDst(separate[2]);
+                binarize->dispatch();
+                contour->setSrc(separate[1]);
+                contour->setDst(separate[3]);
+                contour->setRadius(radius);
+                contour->dispatch();
+                binarize->setSrc(separate[3]);
+                binarize->setDst(separate[4]);
+                binarize->dispatch();
+
+                auto process = [&](mr::ITexture2DPtr src, std::vector<mr::ITexture2DPtr>& dst, Rect r) {
+                    preprocess->setSrc(src);
+                    preprocess->setRGB(dst[0]);
+                    preprocess->setGrayscale(dst[1]);
+                    preprocess->setBinary(dst[2]);
+                    preprocess->setContour(dst[3]);
+                    preprocess->setContourBinary(dst[4]);
+                    preprocess->setContourRadius(radius);
+                    preprocess->setDstRegion(r);
+                    preprocess->dispatch();
+                };
+                process(src2, full, {});
+                process(src1, partial, {});
+                process(src2, partial, region * (float(dsize.x) / float(size.x)));
+
+                for (int i = 0; i < 5; ++i) {
+                    auto s = read(separate[i]);
+                    testExpect(read(full[i]) == s);
+                    testExpect(read(partial[i]) == s);
+                }
+            }
+        }
+
+        // only the contour is needed
+        auto cont_b = gfx->createTexture(size.x, size.y, mr::TextureFormat::Binary);
+        preprocess->setSrc(src2);
+        preprocess->setRGB(nullptr);
+        preprocess->setGrayscale(nullptr);
+        preprocess->setBinary(nullptr);
+        preprocess->setContour(nullptr);
+        preprocess->setContourBinary(cont_b);
+        preprocess->setContourRadius(1.0f);
+        preprocess->setDstRegion({});
+        test::TestScope("Preprocess (contour only)", [&]() {
+            preprocess->dispatch();
+            gfx->sync();
+            }, 5);
+    };
+
+    run(cpu);
+    if (gpu)
+        run(gpu);
+}
+
 testCase(Lanczos3)
 {
     static const float PI = 3.14159265359f;
@@ -380,6 +1611,56 @@ testCase(ScreenCapture)
     wait_async_ops();
 }
 
+testCase(FileScreenCapture)
+{
+    // record some frames of the primary monitor, then replay them.
+    // replaying a file makes ScreenMatcher benchmarks reproducible.
+    const char* path = "Frames.mrfr";
+    auto gfx = mr::GetGfxInterface();
+    std::vector<uint64_t> times;
+    {
+        auto scap = gfx->createScreenCapture();
+        auto writer = mr::CreateFrameFileWriter(path);
+        testExpect(scap != nullptr && writer != nullptr);
+        if (!scap->startCapture(mr::GetPrimaryMonitor()))
+            return;
+        for (int i = 0; i < 10; ++i) {
+            auto frame = scap->waitNextFrame();
+            if (frame.surface && writer->write(frame.surface, frame.present_time))
+                times.push_back(frame.present_time);
+        }
+        scap->stopCapture();
+        testExpect(writer->getFrameCount() == (int)times.size());
+    }
+
+    mr::IFileScreenCapture::Params params;
+    params.realtime = false;
+    auto fcap = mr::CreateFileScreenCapture(path, params);
+    testExpect(fcap != nullptr);
+    testExpect(fcap->getFrameCount() == (int)times.size());
+    testExpect(fcap->startCapture(HMONITOR{}));
+
+    std::vector<uint64_t> replayed;
+    while (fcap->isCapturing()) {
+        auto frame = fcap->waitNextFrame();
+        if (!frame.surface)
+            break;
+        testExpect(frame.size == fcap->getFrameSize());
+        replayed.push_back(frame.present_time);
+    }
+    testExpect(replayed == times);
+
+    // match against the replayed frames
+    auto matcher = mr::CreateScreenMatcher({}, mr::CreateFileScreenCapture(path, params));
+    testExpect(matcher != nullptr);
+    auto tmpl = matcher->createTemplate("template.png");
+    if (tmpl) {
+        mr::IScreenMatcher::Result r;
+        test::TestScope("match (file)", [&]() { r = matcher->match(tmpl, HMONITOR{}); }, 10);
+        testPrint("score %.4f (%d, %d)\n", r.score, r.region.pos.x, r.region.pos.y);
+    }
+}
+
 
 
 class Window
@@ -597,3 +1878,521 @@ testCase(ScreenMatcher)
     }
 #endif
 }
+
+testCase(ScreenMatcherPyramid)
+{
+    // pyramid search should find the same position as brute force, faster.
+    mr::IScreenMatcher::Params params;
+    auto brute_force = mr::CreateScreenMatcher(params);
+    params.pyramid_levels = 2;
+    auto pyramid = mr::CreateScreenMatcher(params);
+    testExpect(brute_force != nullptr && pyramid != nullptr);
+
+    auto tmpl_bf = brute_force->createTemplate("template.png");
+    auto tmpl_py = pyramid->createTemplate("template.png");
+    testExpect(tmpl_bf != nullptr && tmpl_py != nullptr);
+
+    auto target = mr::GetPrimaryMonitor();
+    // first match includes capture & preprocess
+    brute_force->match(tmpl_bf, target);
+    pyramid->match(tmpl_py, target);
+
+    mr::IScreenMatcher::Result rb, rp;
+    test::TestScope("brute force", [&]() { rb = brute_force->match(tmpl_bf, target); }, 10);
+    test::TestScope("pyramid", [&]() { rp = pyramid->match(tmpl_py, target); }, 10);
+    testPrint("brute force: score %.4f (%d, %d)\n", rb.score, rb.region.pos.x, rb.region.pos.y);
+    testPrint("pyramid: score %.4f (%d, %d)\n", rp.score, rp.region.pos.x, rp.region.pos.y);
+    testExpect(rp.region == rb.region || rp.score == rb.score);
+}
+
+testCase(ScreenMatcherMatchAll)
+{
+    // an icon placed at several positions, like rows of a list. every instance should be found.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 48, 32 };
+    const std::vector<int2> positions{ { 100, 100 }, { 100, 140 }, { 100, 180 }, { 400, 300 } };
+    auto pixels = test::NoiseImage(size, 4, test::Noise::BlackWhite);
+    auto tpixels = test::NoiseImage(tsize, 4, test::Noise::BlackWhite, 12345);
+    for (auto p : positions)
+        test::Paste(pixels, size, tpixels, tsize, p);
+    testExpect(test::WriteFrames("match_all.mrfr", size, { pixels }));
+    testExpect(test::SaveImage("match_all.png", tsize, tpixels));
+
+    auto matcher = test::CreateFileMatcher("match_all.mrfr", {}, true);
+    testExpect(matcher != nullptr);
+    auto tmpl = matcher->createTemplate("match_all.png");
+    testExpect(tmpl != nullptr);
+
+    using MatchPattern = mr::ITemplate::MatchPattern;
+    for (auto pattern : { MatchPattern::BinaryContour, MatchPattern::Binary, MatchPattern::Grayscale, MatchPattern::RGB }) {
+        tmpl->setMatchPattern(pattern);
+        std::vector<mr::IScreenMatcher::Result> results;
+        test::TestScope("matchAll", [&]() { results = matcher->matchAll(tmpl, HMONITOR{}, 0.15f); });
+        testPrint("pattern %d: %d results\n", (int)pattern, (int)results.size());
+        testExpect(results.size() == positions.size());
+        for (auto p : positions) {
+            bool found = std::any_of(results.begin(), results.end(), [p](auto& r) { return r.region.pos == p; });
+            testExpect(found);
+        }
+        for (size_t i = 1; i < results.size(); ++i)
+            testExpect(results[i - 1].score <= results[i].score);
+
+        testExpect(matcher->matchAll(tmpl, HMONITOR{}, 0.15f, 2).size() == 2);
+    }
+}
+
+testCase(ScreenMatcherLocalSearch)
+{
+    // the icon moves a little, then jumps far. the first move should be found by the local search around the last hit
+    // and the jump by the full search after the local search missed.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 48, 32 };
+    const std::vector<int2> positions{ { 200, 120 }, { 206, 124 }, { 480, 360 } };
+    auto tpixels = test::NoiseImage(tsize, 4, test::Noise::BlackWhite, 12345);
+    std::vector<std::vector<uint32_t>> frames;
+    for (auto p : positions) {
+        frames.push_back(test::NoiseImage(size, 4, test::Noise::BlackWhite));
+        test::Paste(frames.back(), size, tpixels, tsize, p);
+    }
+    testExpect(test::WriteFrames("local_search.mrfr", size, frames));
+    testExpect(test::SaveImage("local_search.png", tsize, tpixels));
+
+    auto matcher = test::CreateFileMatcher("local_search.mrfr");
+    testExpect(matcher != nullptr);
+    auto tmpl = matcher->createTemplate("local_search.png");
+    testExpect(tmpl != nullptr);
+
+    // each match steps to the next frame
+    for (size_t i = 0; i < positions.size(); ++i) {
+        auto r = matcher->match(tmpl, HMONITOR{}, 0.15f);
+        testPrint("frame %d: score %.4f (%d, %d), local hit %d miss %d\n", (int)i, r.score, r.region.pos.x, r.region.pos.y,
+            tmpl->getLocalHitCount(), tmpl->getLocalMissCount());
+        testExpect(r.region.pos == positions[i] && r.score <= 0.15f);
+    }
+    testExpect(tmpl->getLocalHitCount() == 1 && tmpl->getLocalMissCount() == 1);
+}
+
+testCase(ScreenMatcherLazyTemplate)
+{
+    // template images are made for the match pattern on the first match, and the ones of other patterns when the
+    // pattern is changed. levels are 1/2 and 1/4 size.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 128, 96 };
+    const int2 pos{ 120, 320 };
+    auto pixels = test::NoiseImage(size, 16, test::Noise::BlackWhite);
+    testExpect(test::WriteFrames("lazy_template.mrfr", size, { pixels }));
+    testExpect(test::SaveImage("lazy_template.png", tsize, test::Crop(pixels, size, { pos, tsize })));
+
+    mr::IScreenMatcher::Params params;
+    params.pyramid_levels = 2;
+    auto matcher = test::CreateFileMatcher("lazy_template.mrfr", params);
+    auto tmpl = matcher->createTemplate("lazy_template.png");
+    testExpect(tmpl->getImageCount() == 0);
+
+    using MP = mr::ITemplate::MatchPattern;
+    struct Step
+    {
+        MP pattern;
+        int image_count;
+    };
+    const Step steps[]{
+        { MP::Grayscale, 3 },       // grayscale and its 2 levels
+        { MP::Grayscale, 3 },       // nothing new
+        { MP::RGB, 6 },             // + rgb and its 2 levels
+        { MP::BinaryContour, 8 },   // + contour_b and mask. grayscale levels are shared
+        { MP::Binary, 9 },          // + binary
+    };
+    for (auto& step : steps) {
+        tmpl->setMatchPattern(step.pattern);
+        auto r = matcher->match(tmpl, HMONITOR{}, 0.05f);
+        testPrint("pattern %d: score %.4f (%d, %d), %d images\n", (int)step.pattern, r.score, r.region.pos.x, r.region.pos.y, tmpl->getImageCount());
+        testExpect(r.region.pos == pos && r.score <= 0.05f);
+        testExpect(tmpl->getImageCount() == step.image_count);
+    }
+}
+
+testCase(ScreenMatcherFFT)
+{
+    // large templates are matched by FFT. the results must be same as the direct matching.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 96, 64 };
+    const int2 pos{ 300, 200 };
+    auto pixels = test::NoiseImage(size, 8, test::Noise::RGB);
+    testExpect(test::WriteFrames("fft.mrfr", size, { pixels }));
+    testExpect(test::SaveImage("fft.png", tsize, test::Crop(pixels, size, { pos, tsize })));
+
+    auto run = [&](const char* name, int fft_candidates, mr::ITemplate::MatchPattern pattern) {
+        mr::IScreenMatcher::Params params;
+        params.fft_candidates = fft_candidates;
+        auto matcher = test::CreateFileMatcher("fft.mrfr", params);
+        auto tmpl = matcher->createTemplate("fft.png");
+        tmpl->setMatchPattern(pattern);
+        mr::IScreenMatcher::Result r;
+        test::TestScope(name, [&]() { r = matcher->match(tmpl, HMONITOR{}, 0.05f); });
+        testPrint("%s: score %.4f (%d, %d)\n", name, r.score, r.region.pos.x, r.region.pos.y);
+        return r;
+    };
+
+    for (auto pattern : { mr::ITemplate::MatchPattern::Grayscale, mr::ITemplate::MatchPattern::RGB }) {
+        auto direct = run("direct", 0, pattern);
+        auto fft = run("fft", 4, pattern);
+        testExpect(fft.region == direct.region && fft.score == direct.score && fft.region.pos == pos);
+    }
+}
+
+testCase(ScreenMatcherChamfer)
+{
+    // outlines of shapes are found by chamfer matching, also at a lower scale where binary contours fall apart.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 80, 64 };
+    const int2 pos{ 360, 240 };
+    auto gfx = mr::GetGfxInterface();
+    {
+        std::vector<uint32_t> pixels(size.x * size.y, 0xff303030);
+        auto screen = gfx->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels.data(), size.x * 4);
+        for (int i = 0; i < 12; ++i) {
+            int2 p{ 40 + (i % 4) * 150, 50 + (i / 4) * 150 };
+            float4 color{ 0.3f + 0.05f * i, 0.9f - 0.05f * i, 0.8f, 1.0f };
+            if (i % 2)
+                DrawCircle(gfx, screen, p + 25, 12.0f + float(i), 3.0f, color);
+            else
+                DrawRect(screen, Rect{ p, { 30 + i * 2, 40 - i } }, 3.0f, color);
+        }
+        DrawCircle(gfx, screen, pos + int2{ 24, 32 }, 18.0f, 3.0f, { 1.0f, 1.0f, 1.0f, 1.0f });
+        DrawRect(screen, Rect{ pos + int2{ 44, 12 }, { 28, 40 } }, 3.0f, { 1.0f, 1.0f, 1.0f, 1.0f });
+
+        auto writer = mr::CreateFrameFileWriter("chamfer.mrfr");
+        testExpect(writer->write(screen, 1));
+        auto crop = gfx->createTexture(tsize.x, tsize.y, mr::TextureFormat::RGBAu8);
+        mr::CreateFilterSet()->copy(crop, screen, Rect{ pos, tsize });
+        testExpect(crop->save("chamfer.png"));
+    }
+
+    auto run = [&](const char* name, float scale) {
+        mr::IScreenMatcher::Params params;
+        params.scale = scale;
+        auto matcher = test::CreateFileMatcher("chamfer.mrfr", params);
+        auto tmpl = matcher->createTemplate("chamfer.png");
+        tmpl->setMatchPattern(mr::ITemplate::MatchPattern::Chamfer);
+        mr::IScreenMatcher::Result r;
+        test::TestScope(name, [&]() { r = matcher->match(tmpl, HMONITOR{}, 0.1f); });
+        testPrint("%s: score %.4f (%d, %d)\n", name, r.score, r.region.pos.x, r.region.pos.y);
+
+        // matchAll() scores positions by the score map instead
+        auto all = matcher->matchAll(tmpl, HMONITOR{}, 0.1f, 4);
+        testExpect(all.size() == 1 && all[0].region == r.region && all[0].score == r.score);
+        return r;
+    };
+
+    auto full = run("scale 1", 1.0f);
+    testExpect(full.score == 0.0f && full.region.pos == pos);
+    auto half = run("scale 0.5", 0.5f);
+    testExpect(half.score <= 0.1f && std::abs(half.region.pos.x - pos.x) <= 2 && std::abs(half.region.pos.y - pos.y) <= 2);
+}
+
+testCase(ScreenMatcherSparse)
+{
+    // templates with a sample budget are matched by the samples and verified by all pixels. the results must be same
+    // as the direct matching.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 48, 40 };
+    const int2 pos{ 410, 170 };
+    auto pixels = test::NoiseImage(size, 8, test::Noise::RGB);
+    testExpect(test::WriteFrames("sparse.mrfr", size, { pixels }));
+    testExpect(test::SaveImage("sparse.png", tsize, test::Crop(pixels, size, { pos, tsize })));
+
+    auto run = [&](const char* name, int budget, int candidates, mr::ITemplate::MatchPattern pattern) {
+        mr::IScreenMatcher::Params params;
+        params.fft_candidates = 0;
+        params.sparse_candidates = candidates;
+        auto matcher = test::CreateFileMatcher("sparse.mrfr", params);
+        auto tmpl = matcher->createTemplate("sparse.png");
+        tmpl->setMatchPattern(pattern);
+        tmpl->setSampleBudget(budget);
+        mr::IScreenMatcher::Result r;
+        test::TestScope(name, [&]() { r = matcher->match(tmpl, HMONITOR{}, 0.05f); });
+        testPrint("%s: score %.4f (%d, %d)\n", name, r.score, r.region.pos.x, r.region.pos.y);
+        return r;
+    };
+
+    for (auto pattern : { mr::ITemplate::MatchPattern::Grayscale, mr::ITemplate::MatchPattern::RGB }) {
+        auto direct = run("direct", 0, 4, pattern);
+        auto verified = run("sparse", 64, 4, pattern);
+        auto unverified = run("sparse without verification", 64, 0, pattern);
+        testExpect(verified.region == direct.region && verified.score == direct.score && direct.region.pos == pos);
+        testExpect(unverified.region == direct.region && unverified.score <= 0.05f);
+    }
+
+    // the cutoff of the samples follows the threshold of each call, not the one of the previous call on the template.
+    // the brightened template scores about 0.07: a hit for 0.3 and a miss for 0.05.
+    auto tpixels = test::Crop(pixels, size, { pos, tsize });
+    for (auto& p : tpixels) {
+        uint32_t v = 0xff000000;
+        for (int c = 0; c < 24; c += 8)
+            v |= std::min(((p >> c) & 0xff) + 20u, 255u) << c;
+        p = v;
+    }
+    testExpect(test::SaveImage("sparse_bright.png", tsize, tpixels));
+    mr::IScreenMatcher::Params params;
+    params.fft_candidates = 0;
+    auto matcher = test::CreateFileMatcher("sparse.mrfr", params);
+    auto tmpl = matcher->createTemplate("sparse_bright.png");
+    tmpl->setMatchPattern(mr::ITemplate::MatchPattern::Grayscale);
+    tmpl->setSampleBudget(64);
+    for (float threshold : { 0.3f, 0.05f, 0.3f }) {
+        auto r = matcher->match(tmpl, HMONITOR{}, threshold);
+        testPrint("threshold %.2f: score %.4f (%d, %d)%s\n", threshold, r.score, r.region.pos.x, r.region.pos.y, r.pruned ? " pruned" : "");
+        if (threshold == 0.3f) {
+            testExpect(!r.pruned && r.score <= threshold && r.region.pos == pos);
+        }
+        else {
+            testExpect(r.score > threshold);
+        }
+    }
+}
+
+testCase(ScreenMatcherAutoThreshold)
+{
+    // the fixed threshold makes the whole template white, and the dimmed frame doesn't match it. the threshold of each
+    // image follows the brightness.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 48, 32 };
+    const int2 pos{ 300, 220 };
+    const float levels[2][2]{ { 0.35f, 0.9f }, { 0.15f, 0.45f } };
+    // the black and white noise with the levels as black and white
+    std::vector<std::vector<uint32_t>> frames;
+    for (int i = 0; i < 2; ++i) {
+        frames.push_back(test::NoiseImage(size, 4, test::Noise::BlackWhite));
+        for (auto& p : frames.back()) {
+            uint32_t v = uint32_t(unorm8(levels[i][p & 1]).value);
+            p = 0xff000000 | (v << 16) | (v << 8) | v;
+        }
+    }
+    testExpect(test::WriteFrames("auto_threshold.mrfr", size, frames));
+    testExpect(test::SaveImage("auto_threshold.png", tsize, test::Crop(frames[0], size, { pos, tsize })));
+
+    auto run = [&](const char* name, bool auto_threshold) {
+        mr::IScreenMatcher::Params params;
+        params.auto_threshold = auto_threshold;
+        auto matcher = test::CreateFileMatcher("auto_threshold.mrfr", params);
+        auto tmpl = matcher->createTemplate("auto_threshold.png");
+        tmpl->setMatchPattern(mr::ITemplate::MatchPattern::Binary);
+
+        // each match steps to the next frame
+        std::vector<mr::IScreenMatcher::Result> ret;
+        for (int i = 0; i < 2; ++i) {
+            ret.push_back(matcher->match(tmpl, HMONITOR{}, 0.05f));
+            testPrint("%s: frame %d: score %.4f (%d, %d)\n", name, i, ret[i].score, ret[i].region.pos.x, ret[i].region.pos.y);
+        }
+        return ret;
+    };
+
+    auto fixed = run("fixed", false);
+    testExpect(fixed[1].score > 0.05f);
+    auto adaptive = run("auto", true);
+    for (auto& r : adaptive)
+        testExpect(r.score == 0.0f && r.region.pos == pos);
+}
+
+testCase(ScreenMatcherBatch)
+{
+    // Grayscale and RGB templates of one match() are matched at once. results must be same as one by one.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 32, 24 };
+    const int2 positions[]{ { 40, 60 }, { 500, 100 }, { 300, 200 }, { 120, 400 }, { 560, 420 }, { 250, 30 } };
+    auto gfx = mr::GetGfxInterface();
+    auto pixels = test::NoiseImage(size, 8, test::Noise::RGB);
+    testExpect(test::WriteFrames("batch.mrfr", size, { pixels }));
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < std::size(positions); ++i) {
+        auto crop = test::CreateImage(tsize, test::Crop(pixels, size, { positions[i], tsize }));
+        // all but the last are slightly different from the screen
+        if (i + 1 < std::size(positions))
+            DrawCircle(gfx, crop, tsize / 2, 3.0f, 1.0f, { 1.0f, 1.0f, 1.0f, 1.0f });
+        paths.push_back(mr::Format("batch%d.png", (int)i));
+        testExpect(crop->save(paths.back()));
+    }
+
+    auto run = [&](const char* name, bool batch) {
+        mr::IScreenMatcher::Params params;
+        params.batch_match = batch;
+        params.local_search_radius = 0;
+        auto matcher = test::CreateFileMatcher("batch.mrfr", params);
+        auto tmpls = matcher->createTemplates(paths);
+        for (size_t i = 0; i < tmpls.size(); ++i)
+            tmpls[i]->setMatchPattern(i % 2 ? mr::ITemplate::MatchPattern::RGB : mr::ITemplate::MatchPattern::Grayscale);
+        matcher->prepareTemplates(tmpls);
+        mr::IScreenMatcher::Result r;
+        test::TestScope(name, [&]() { r = matcher->match(tmpls, HMONITOR{}, 0.05f); });
+        testPrint("%s: score %.4f (%d, %d)\n", name, r.score, r.region.pos.x, r.region.pos.y);
+        return r;
+    };
+
+    auto single = run("one by one", false);
+    auto batch = run("batch", true);
+    testExpect(batch.region == single.region && batch.score == single.score);
+    testExpect(batch.region.pos == positions[std::size(positions) - 1]);
+}
+
+testCase(ScreenMatcherMultiScreen)
+{
+    // matchAllScreens() with 2-4 screens. each screen is matched on its own worker where the backend supports it,
+    // and the results must be same as matching screens one after another.
+    const int2 size{ 1280, 720 };
+    const int2 tsize{ 64, 48 };
+    const int2 pos{ 800, 400 };
+    const int max_screens = 4;
+    const int target_screen = 1;
+    const int num_frames = 5; // the first one is to warm up
+    auto tpixels = test::NoiseImage(tsize, 4, test::Noise::RGB, 777);
+    testExpect(test::SaveImage("multiscreen.png", tsize, tpixels));
+    for (int s = 0; s < max_screens; ++s) {
+        // every frame is different so that nothing is reused from the previous match
+        std::vector<std::vector<uint32_t>> frames;
+        for (int f = 0; f < num_frames; ++f) {
+            frames.push_back(test::NoiseImage(size, 4, test::Noise::RGB, s * 100 + f + 1));
+            if (s == target_screen)
+                test::Paste(frames.back(), size, tpixels, tsize, pos);
+        }
+        testExpect(test::WriteFrames(mr::Format("multiscreen%d.mrfr", s).c_str(), size, frames));
+    }
+
+    auto run = [&](int num_screens, bool parallel, float& elapsed) {
+        mr::IScreenMatcher::Params params;
+        params.parallel_screens = parallel;
+        params.local_search_radius = 0;
+        std::vector<mr::IScreenCapturePtr> captures;
+        for (int s = 0; s < num_screens; ++s)
+            captures.push_back(test::CreateFileCapture(mr::Format("multiscreen%d.mrfr", s).c_str()));
+        auto matcher = mr::CreateScreenMatcher(params, captures);
+        std::vector<mr::ITemplatePtr> tmpls{ matcher->createTemplate("multiscreen.png") };
+        tmpls[0]->setMatchPattern(mr::ITemplate::MatchPattern::Grayscale);
+        matcher->prepareTemplates(tmpls);
+
+        std::vector<mr::IScreenMatcher::Result> ret;
+        ret.push_back(matcher->matchAllScreens(tmpls, 0.05f));
+        auto begin = test::Now();
+        for (int f = 1; f < num_frames; ++f)
+            ret.push_back(matcher->matchAllScreens(tmpls, 0.05f));
+        elapsed = test::NS2MS(test::Now() - begin) / float(num_frames - 1);
+        return ret;
+    };
+
+    // the speedup depends on the number of cores and is only printed
+    const int2 expected{ size.x * target_screen + pos.x, pos.y }; // screens are placed side by side
+    for (int n = 2; n <= max_screens; ++n) {
+        float sequential, parallel;
+        auto rs = run(n, false, sequential);
+        auto rp = run(n, true, parallel);
+        testPrint("%d screens: sequential %.2fms, parallel %.2fms (x%.2f)\n", n, sequential, parallel, sequential / parallel);
+        for (int f = 0; f < num_frames; ++f) {
+            testExpect(rp[f].region == rs[f].region && rp[f].score == rs[f].score && rp[f].pruned == rs[f].pruned);
+            testExpect(rp[f].region.pos == expected && rp[f].score <= 0.05f);
+        }
+    }
+}
+
+testCase(TemplateCache)
+{
+    // templates from the cache must give the same results. changed files or params must not hit old entries.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 48, 32 };
+    const int2 pos{ 300, 200 };
+    auto tpixels = test::NoiseImage(tsize, 4, test::Noise::BlackWhite, 12345);
+    auto pixels = test::NoiseImage(size, 4, test::Noise::BlackWhite);
+    test::Paste(pixels, size, tpixels, tsize, pos);
+    testExpect(test::WriteFrames("template_cache.mrfr", size, { pixels }));
+    testExpect(test::SaveImage("template_cache.png", tsize, tpixels));
+
+    const char* cache_dir = "template_cache";
+    std::error_code ec;
+    std::filesystem::remove_all(cache_dir, ec);
+    auto count_entries = [&]() {
+        int ret = 0;
+        for (auto& e : std::filesystem::directory_iterator(cache_dir, ec))
+            ++ret;
+        return ret;
+    };
+    auto run = [&](const char* name, const mr::IScreenMatcher::Params& params, mr::ITemplate::MatchPattern pattern) {
+        auto matcher = test::CreateFileMatcher("template_cache.mrfr", params);
+        matcher->setTemplateCacheDir(cache_dir);
+        mr::IScreenMatcher::Result r;
+        test::TestScope(name, [&]() {
+            auto tmpl = matcher->createTemplate("template_cache.png");
+            tmpl->setMatchPattern(pattern);
+            r = matcher->match(tmpl, HMONITOR{});
+            });
+        testPrint("%s: score %.4f (%d, %d), %d entries\n", name, r.score, r.region.pos.x, r.region.pos.y, count_entries());
+        return r;
+    };
+
+    mr::IScreenMatcher::Params params;
+    for (auto pattern : { mr::ITemplate::MatchPattern::BinaryContour, mr::ITemplate::MatchPattern::Binary }) {
+        std::filesystem::remove_all(cache_dir, ec);
+        auto cold = run("cold", params, pattern);
+        testExpect(count_entries() == 1);
+        auto warm = run("warm", params, pattern);
+        testExpect(count_entries() == 1);
+        testExpect(warm.region == cold.region && warm.score == cold.score && warm.region.pos == pos);
+    }
+
+    auto changed_params = params;
+    changed_params.binarize_threshold = 0.3f;
+    run("params changed", changed_params, mr::ITemplate::MatchPattern::Binary);
+    testExpect(count_entries() == 2);
+
+    for (int y = 0; y < 4; ++y)
+        for (int x = 0; x < 4; ++x)
+            tpixels[tsize.x * y + x] ^= 0x00ffffff;
+    testExpect(test::SaveImage("template_cache.png", tsize, tpixels));
+    run("file changed", params, mr::ITemplate::MatchPattern::Binary);
+    testExpect(count_entries() == 3);
+}
+
+testCase(CreateTemplates)
+{
+    // loading templates in parallel must give the same templates as loading them one by one.
+    const int2 size{ 640, 480 };
+    const int2 tsize{ 48, 32 };
+    const int num_templates = 16;
+    auto pixels = test::NoiseImage(size, 4, test::Noise::BlackWhite);
+    testExpect(test::WriteFrames("create_templates.mrfr", size, { pixels }));
+
+    // crops of the frame. the same path twice must give the same template.
+    std::vector<std::string> paths;
+    for (int i = 0; i < num_templates; ++i) {
+        paths.push_back(mr::Format("create_templates_%d.png", i));
+        testExpect(test::SaveImage(paths.back().c_str(), tsize, test::Crop(pixels, size, { { 32 * i, 16 * i }, tsize })));
+    }
+    paths.push_back(paths.front());
+    paths.push_back("create_templates_not_exist.png");
+
+    auto run = [&](const char* name, bool parallel) {
+        auto matcher = test::CreateFileMatcher("create_templates.mrfr");
+        std::vector<mr::ITemplatePtr> templates;
+        test::TestScope(name, [&]() {
+            if (parallel) {
+                templates = matcher->createTemplates(paths);
+                matcher->prepareTemplates(templates);
+            }
+            else {
+                for (auto& path : paths) {
+                    auto tmpl = matcher->createTemplate(path.c_str());
+                    if (tmpl)
+                        matcher->prepareTemplates(mr::MakeSpan(tmpl));
+                    templates.push_back(tmpl);
+                }
+            }
+            });
+        testExpect(templates.size() == paths.size() && templates.front() == templates[num_templates] && !templates.back());
+
+        std::vector<mr::IScreenMatcher::Result> ret;
+        for (int i = 0; i < num_templates; ++i)
+            ret.push_back(matcher->match(templates[i], HMONITOR{}));
+        return ret;
+    };
+    auto serial = run("serial", false);
+    auto parallel = run("parallel", true);
+    for (int i = 0; i < num_templates; ++i)
+        testExpect(parallel[i].region == serial[i].region && parallel[i].score == serial[i].score && parallel[i].region.pos == int2(32 * i, 16 * i));
+}
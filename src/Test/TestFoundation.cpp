@@ -1,13 +1,13 @@
 #include "pch.h"
 #include "Test.h"
-#include "Marionette.h"
+#include "TestImage.h"
 
 testCase(String)
 {
     std::string data = R"(Name:0.2 WithSpace: "hoge.png" Parenthesis : {"hage.png", 2})";
 
     int n = 0;
-    mr::ScanKVP(data, [&](std::string k, std::string v) {
+    mr::ScanKVP(data, [&](std::string_view k, std::string_view v) {
         if (n == 0) {
             testExpect(k == "Name" && mr::ToValue<float>(v) == 0.2f);
         }
@@ -21,6 +21,552 @@ testCase(String)
         });
 }
 
+// the sscanf + regex parser that OpRecord::fromText() used to be
+static bool FromText_Reference(mr::OpRecord& rec, const std::string& v)
+{
+    using mr::OpType;
+    using mr::ITemplate;
+
+    auto scan_kvp = [](const char* s, const std::function<void(std::string k, std::string v)>& body) {
+        auto ex_key = std::regex(R"((\w+)\s*:\s*)");
+        auto ex_value = std::regex(R"(^([^ ]+))");
+        auto ex_parenthesis = std::regex(R"(^\{([^}]+)\})");
+        std::cmatch match;
+        for (;;) {
+            std::regex_search(s, match, ex_key);
+            if (match.empty())
+                break;
+            std::string key = match.str(1);
+            s += match.position() + match.length();
+            if (!std::regex_search(s, match, ex_parenthesis) && !std::regex_search(s, match, ex_value))
+                break;
+            s += match.position() + match.length();
+            body(key, match.str(1));
+        }
+    };
+
+    auto& type = rec.type;
+    auto& time = rec.time;
+    auto& data = rec.data;
+    auto& exdata = rec.exdata;
+    type = OpType::Unknown;
+    if (v.empty() || v.front() == '\r' || v.front() == '\n' || v.front() == '#')
+        return false;
+
+    const char* src = v.c_str();
+    auto scan_templates = [&]() {
+        scan_kvp(src, [&](std::string k, std::string v) {
+            if (k == "Threshold")
+                exdata.match_threshold = mr::ToValue<float>(v);
+            else if (k == "Pattern") {
+                auto p = mr::ToValue<std::string>(v);
+                if (p == "BinaryContour")
+                    exdata.match_pattern = ITemplate::MatchPattern::BinaryContour;
+                else if (p == "Binary")
+                    exdata.match_pattern = ITemplate::MatchPattern::Binary;
+                else if (p == "Grayscale")
+                    exdata.match_pattern = ITemplate::MatchPattern::Grayscale;
+                else if (p == "RGB")
+                    exdata.match_pattern = ITemplate::MatchPattern::RGB;
+            }
+            else if (k == "Template")
+                exdata.templates.push_back({ mr::ToValue<std::string>(v) });
+            });
+    };
+
+    if (sscanf(src, "%u: KeyDown %d", &time, &data.key.code) == 2)
+        type = OpType::KeyDown;
+    else if (sscanf(src, "%u: KeyUp %d", &time, &data.key.code) == 2)
+        type = OpType::KeyUp;
+    else if (sscanf(src, "%u: MouseDown %d", &time, &data.mouse.button) == 2)
+        type = OpType::MouseDown;
+    else if (sscanf(src, "%u: MouseUp %d", &time, &data.mouse.button) == 2)
+        type = OpType::MouseUp;
+    else if (sscanf(src, "%u: MouseMoveAbs %d %d", &time, &data.mouse.pos.x, &data.mouse.pos.y) == 3)
+        type = OpType::MouseMoveAbs;
+    else if (sscanf(src, "%u: MouseMoveRel %d %d", &time, &data.mouse.pos.x, &data.mouse.pos.y) == 3)
+        type = OpType::MouseMoveRel;
+    else if (sscanf(src, "%u: SaveMousePos %d", &time, &exdata.save_slot) == 2)
+        type = OpType::SaveMousePos;
+    else if (sscanf(src, "%u: LoadMousePos %d", &time, &exdata.save_slot) == 2)
+        type = OpType::LoadMousePos;
+    else if (std::strstr(src, "MatchParams ")) {
+        type = OpType::MatchParams;
+        scan_kvp(src, [&](std::string k, std::string v) {
+            auto& p = exdata.match_params;
+            if (k == "Scale")
+                p.scale = mr::ToValue<float>(v);
+            else if (k == "CareDisplayScale")
+                p.care_display_scale = mr::ToValue<bool>(v);
+            else if (k == "ColorRange")
+                p.color_range = mr::ToValue<mr::float2>(v);
+            else if (k == "ContourRadius")
+                p.contour_radius = mr::ToValue<float>(v);
+            else if (k == "ExpandRadius")
+                p.expand_radius = mr::ToValue<float>(v);
+            else if (k == "BinarizeThreshold")
+                p.binarize_threshold = mr::ToValue<float>(v);
+            });
+    }
+    else if (std::strstr(src, "MouseMoveMatch") && sscanf(src, "%u: ", &time) == 1) {
+        type = OpType::MouseMoveMatch;
+        scan_templates();
+    }
+    else if (std::strstr(src, "WaitUntilMatch") && sscanf(src, "%u: ", &time) == 1) {
+        type = OpType::WaitUntilMatch;
+        scan_templates();
+    }
+    else if (sscanf(src, "%u: Wait %d", &time, &exdata.wait_time) == 2)
+        type = OpType::Wait;
+    else if (sscanf(src, "%u: TimeShift %d", &time, &exdata.time_shift) == 2)
+        type = OpType::TimeShift;
+    else if (sscanf(src, "%u: Repeat %d", &time, &exdata.repeat_point) == 2)
+        type = OpType::Repeat;
+    return type != OpType::Unknown;
+}
+
+testCase(OpRecordParse)
+{
+    std::vector<std::string> lines{
+        "MatchParams Scale:0.50 CareDisplayScale:true ColorRange:{0.10,0.90} ContourRadius:1.50 ExpandRadius:2.00 BinarizeThreshold:0.30",
+        "  MatchParams  Scale : 0.25",
+        "12: KeyDown 65",
+        "13:KeyUp   65",
+        "14: MouseDown 1",
+        "15: MouseUp 1",
+        "16: MouseMoveAbs 100 -200",
+        "17: MouseMoveRel -5 7 trailing",
+        "18: SaveMousePos 2",
+        "19: LoadMousePos 2",
+        "20: MouseMoveMatch Threshold:0.30 Pattern:\"Binary\" Template:\"a.png\" Template:\"b c.png\"",
+        "21: WaitUntilMatch Template:\"x.png\"",
+        "22: Wait 100",
+        "23: Wait5",
+        "24: TimeShift -50",
+        "25: Repeat 3",
+        "# comment",
+        "",
+        "26: KeyDown",
+        "27: Unknown 1",
+        "KeyDown 1",
+        "28 KeyDown 1",
+    };
+
+    // results must be identical to the old parser
+    for (auto& l : lines) {
+        mr::OpRecord a, b;
+        bool ra = a.fromText(l);
+        bool rb = FromText_Reference(b, l);
+        testExpect(ra == rb);
+        if (ra) {
+            testExpect(a.type == b.type && a.time == b.time);
+            testExpect(a.toText() == b.toText());
+        }
+    }
+
+    // invalid numbers throw like std::stoi() / std::stof() do
+    auto throws = [](const std::string& l, auto ex) {
+        try {
+            mr::OpRecord rec;
+            rec.fromText(l);
+        }
+        catch (const decltype(ex)&) {
+            return true;
+        }
+        return false;
+    };
+    testExpect(throws("MatchParams Scale:abc", std::invalid_argument("")));
+    testExpect(throws("MatchParams ContourRadius:. ExpandRadius:2", std::invalid_argument("")));
+    testExpect(throws("MatchParams CareDisplayScale:yes", std::invalid_argument("")));
+    testExpect(throws("20: MouseMoveMatch Threshold:x Template:\"a.png\"", std::invalid_argument("")));
+    testExpect(throws("MatchParams Scale:1e99", std::out_of_range("")));
+    testExpect(throws("MatchParams CareDisplayScale:99999999999", std::out_of_range("")));
+    testExpect(mr::ToValue<int>("-12px") == std::stoi("-12px"));
+    testExpect(mr::ToValue<float>(" 0.5x") == std::stof(" 0.5x"));
+
+    // throughput. best of some runs to keep the ratio stable.
+    std::vector<std::string> data;
+    for (int i = 0; i < 100000; ++i) {
+        if (i % 1000 == 0)
+            data.push_back(mr::Format("%d: MouseMoveMatch Threshold:0.20 Pattern:\"BinaryContour\" Template:\"t%d.png\"", i, i));
+        else
+            data.push_back(mr::Format("%d: MouseMoveAbs %d %d", i, i % 1920, i % 1080));
+    }
+    int n = 0, n_ref = 0;
+    float elapsed = std::numeric_limits<float>::max(), elapsed_ref = std::numeric_limits<float>::max();
+    for (int run = 0; run < 3; ++run) {
+        n = n_ref = 0;
+        auto begin = test::Now();
+        for (auto& l : data) {
+            mr::OpRecord rec;
+            n += rec.fromText(l);
+        }
+        auto mid = test::Now();
+        for (auto& l : data) {
+            mr::OpRecord rec;
+            n_ref += FromText_Reference(rec, l);
+        }
+        auto end = test::Now();
+        elapsed = std::min(elapsed, test::NS2MS(mid - begin));
+        elapsed_ref = std::min(elapsed_ref, test::NS2MS(end - mid));
+    }
+    testExpect(n == (int)data.size() && n_ref == n);
+    testPrint("fromText: %.2fms, reference: %.2fms (x%.1f)\n", elapsed, elapsed_ref, elapsed_ref / elapsed);
+    testExpect(elapsed_ref / elapsed >= 20.0f);
+}
+
+testCase(OpRecordFile)
+{
+    // long recording: mostly mouse moves with some matches
+    std::vector<mr::OpRecord> records;
+    {
+        mr::OpRecord rec;
+        rec.type = mr::OpType::MatchParams;
+        rec.exdata.match_params.scale = 0.25f;
+        rec.exdata.match_params.contour_radius = 1.5f;
+        records.push_back(rec);
+    }
+    for (uint32_t i = 0; i < 300000; ++i) {
+        mr::OpRecord rec;
+        rec.time = i;
+        if (i % 1000 == 999) {
+            rec.type = mr::OpType::MouseMoveMatch;
+            rec.exdata.match_threshold = 0.3f;
+            rec.exdata.match_pattern = mr::ITemplate::MatchPattern::Binary;
+            rec.exdata.templates.push_back({ "button.png" });
+            rec.exdata.templates.push_back({ mr::Format("icon%d.png", i % 7) });
+        }
+        else if (i % 100 == 99) {
+            rec.type = mr::OpType::Wait;
+            rec.exdata.wait_time = 10;
+        }
+        else {
+            rec.type = mr::OpType::MouseMoveAbs;
+            rec.data.mouse.pos = { int(i % 1920), int(i % 1080) };
+        }
+        records.push_back(rec);
+    }
+
+    test::TestScope("save text", [&]() { testExpect(mr::SaveOpRecords("replay.txt", records, mr::OpFileFormat::Text)); });
+    test::TestScope("save binary", [&]() { testExpect(mr::SaveOpRecords("replay.mrop", records, mr::OpFileFormat::Binary)); });
+
+    std::vector<mr::OpRecord> from_text, from_binary;
+    test::TestScope("load text", [&]() { testExpect(mr::LoadOpRecords("replay.txt", from_text)); });
+    test::TestScope("load binary", [&]() { testExpect(mr::LoadOpRecords("replay.mrop", from_binary)); });
+
+    testExpect(from_text.size() == records.size());
+    testExpect(from_binary.size() == records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        testExpect(from_binary[i].toText() == records[i].toText());
+        testExpect(from_text[i].toText() == records[i].toText());
+    }
+
+    // binary -> text conversion gives the same text as saving directly
+    testExpect(mr::GetOpFileFormat("replay.mrop") == mr::OpFileFormat::Binary);
+    testExpect(mr::ConvertOpRecords("replay.mrop", "replay_converted.txt", mr::OpFileFormat::Text));
+    auto read_all = [](const char* path) {
+        std::ifstream ifs(path, std::ios::in | std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    };
+    testExpect(read_all("replay_converted.txt") == read_all("replay.txt"));
+}
+
+// IObject implementation for test objects
+template<class T>
+class TestObject : public T
+{
+public:
+    int addRef() override { return ++m_ref; }
+    int release() override { int r = --m_ref; if (r == 0) delete this; return r; }
+    int getRef() const override { return m_ref; }
+
+private:
+    std::atomic_int m_ref{ 0 };
+};
+
+// time advances only by sleeping. makes playback deterministic and instant.
+class VirtualClock : public TestObject<mr::IClock>
+{
+public:
+    mr::nanosec now() override { return m_now; }
+    void sleepFor(mr::nanosec duration) override { m_now += duration; }
+    void sleepUntil(mr::nanosec time) override { m_now = std::max(m_now.load(), time); }
+
+    std::atomic<mr::nanosec> m_now{ 1000000000 };
+};
+
+testCase(PlayerTiming)
+{
+    // 1000Hz mouse moves with a key press and a wait in the middle
+    std::vector<mr::OpRecord> records;
+    for (uint32_t t = 0; t < 1000; ++t) {
+        mr::OpRecord rec;
+        rec.time = t;
+        if (t == 500) {
+            rec.type = mr::OpType::Wait;
+            rec.exdata.wait_time = 100;
+        }
+        else if (t == 600 || t == 601) {
+            rec.type = t == 600 ? mr::OpType::KeyDown : mr::OpType::KeyUp;
+            rec.data.key.code = 'A';
+        }
+        else {
+            rec.type = mr::OpType::MouseMoveAbs;
+            rec.data.mouse.pos = { int(t), int(t) };
+        }
+        records.push_back(rec);
+    }
+    testExpect(mr::SaveOpRecords("player_timing.mrop", records, mr::OpFileFormat::Binary));
+
+    auto play = [&](mr::IClockPtr clock) {
+        auto sink = mr::CreateRecordingInputSink(clock);
+        auto player = mr::CreatePlayer();
+        player->setClock(clock);
+        player->setInputSink(sink);
+        player->setTimingCapacity((uint32_t)records.size());
+        testExpect(player->load("player_timing.mrop"));
+
+        auto time_start = clock->now();
+        testExpect(player->start());
+        while (player->isPlaying())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        auto events = sink->getEvents();
+        testExpect(events.size() == records.size() - 1);
+        auto timings = player->getTimings();
+        testExpect(timings.size() == records.size());
+        testExpect(player->getTimingStats().count == records.size());
+        return std::make_tuple(time_start, events, timings);
+    };
+
+    {
+        // virtual clock: every event must be exactly on time
+        auto [time_start, events, timings] = play(mr::make_ref<VirtualClock>());
+        for (auto& [time, batch, e] : events) {
+            mr::nanosec expected = e.type == mr::InputEvent::Type::MouseMove ? mr::nanosec(e.pos.x) : 600;
+            if (e.type == mr::InputEvent::Type::KeyUp)
+                expected = 601;
+            if (expected > 500)
+                expected += 100; // Wait
+            testExpect(time - time_start == expected * 1000000);
+        }
+        for (auto& t : timings)
+            testExpect(t.error == 0);
+    }
+    {
+        // looping playback keeps the last timings only, and the stats cover all of the loops
+        auto clock = mr::make_ref<VirtualClock>();
+        auto player = mr::CreatePlayer();
+        player->setClock(clock);
+        player->setInputSink(mr::CreateRecordingInputSink(clock));
+        player->setTimingCapacity(100);
+        testExpect(player->load("player_timing.mrop"));
+        testExpect(player->start(3));
+        while (player->isPlaying())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        auto timings = player->getTimings();
+        testExpect(timings.size() == 100);
+        for (size_t i = 0; i < timings.size(); ++i)
+            testExpect(timings[i].record_index == uint32_t(records.size() - timings.size() + i));
+        auto stats = player->getTimingStats();
+        testExpect(stats.count == records.size() * 3);
+        testExpect(stats.max_error == 0 && stats.total_error == 0);
+
+        // not kept by default
+        player->setTimingCapacity(0);
+        testExpect(player->start());
+        while (player->isPlaying())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        testExpect(player->getTimings().empty() && player->getTimingStats().count == records.size());
+    }
+    {
+        // system clock: measure the timing error
+        auto [time_start, events, timings] = play(mr::GetSystemClock());
+        int64_t max_error = 0;
+        double total_error = 0;
+        for (auto& t : timings) {
+            max_error = std::max(max_error, t.error);
+            total_error += double(t.error);
+        }
+        testPrint("timing error: mean %.3fms, max %.3fms\n",
+            total_error / timings.size() / 1000000.0, double(max_error) / 1000000.0);
+    }
+}
+
+
+testCase(PlayerAsyncMatch)
+{
+    // MouseMoveMatch against a recorded frame. the key events after it must not wait for the match.
+    const mr::int2 size{ 640, 480 };
+    const mr::Rect tregion{ { 200, 150 }, { 80, 60 } };
+    auto pixels = test::NoiseImage(size, 16, test::Noise::Gray);
+    testExpect(test::WriteFrames("player_match.mrfr", size, { pixels }));
+    testExpect(test::SaveImage("player_match.png", tregion.size, test::Crop(pixels, size, tregion)));
+
+    std::vector<mr::OpRecord> records(5);
+    records[0].type = mr::OpType::MouseMoveMatch;
+    records[0].exdata.templates.push_back({ "player_match.png" });
+    records[1].type = mr::OpType::KeyDown;
+    records[2].type = mr::OpType::KeyUp;
+    records[1].data.key.code = records[2].data.key.code = 'A';
+    records[3].type = mr::OpType::MouseDown;
+    records[4].type = mr::OpType::MouseUp;
+    records[3].data.mouse.button = records[4].data.mouse.button = 1;
+    for (uint32_t i = 0; i < records.size(); ++i)
+        records[i].time = i;
+    testExpect(mr::SaveOpRecords("player_match.txt", records, mr::OpFileFormat::Text));
+
+    auto clock = mr::make_ref<VirtualClock>();
+    auto sink = mr::CreateRecordingInputSink(clock);
+    auto player = mr::CreatePlayer();
+    player->setClock(clock);
+    player->setInputSink(sink);
+    player->setTimingCapacity(16);
+    player->setScreenCapture(test::CreateFileCapture("player_match.mrfr", true));
+    testExpect(player->load("player_match.txt"));
+    testExpect(player->start());
+    while (player->isPlaying())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    using Type = mr::InputEvent::Type;
+    auto events = sink->getEvents();
+    auto find = [&](Type t) {
+        return std::find_if(events.begin(), events.end(), [t](auto& v) { return v.event.type == t; });
+    };
+    testExpect(events.size() == 5);
+    auto move = find(Type::MouseMove);
+    testExpect(move != events.end() && move->event.pos == tregion.getCenter());
+    testExpect(move < find(Type::MouseDown));
+    testExpect(find(Type::KeyDown) != events.end() && find(Type::KeyUp) != events.end());
+    for (auto& t : player->getTimings())
+        testPrint("record %u: error %.3fms\n", t.record_index, double(t.error) / 1000000.0);
+}
+
+
+testCase(PlayerSharedTemplate)
+{
+    // records with different thresholds share one template. the template is brighter than the screen, so the best
+    // score is about 0.15: a hit for 0.3 and a miss for 0.05. each record must be judged by its own threshold.
+    const mr::int2 size{ 640, 480 };
+    const mr::Rect tregion{ { 300, 200 }, { 64, 48 } };
+    auto pixels = test::NoiseImage(size, 8, test::Noise::Gray);
+    auto tpixels = test::Crop(pixels, size, tregion);
+    for (auto& p : tpixels) {
+        uint32_t v = std::min((p & 0xff) + 40u, 255u);
+        p = 0xff000000 | (v << 16) | (v << 8) | v;
+    }
+    testExpect(test::WriteFrames("player_shared.mrfr", size, { pixels }));
+    testExpect(test::SaveImage("player_shared.png", tregion.size, tpixels));
+
+    {
+        // the same template matched with both thresholds, in both orders
+        auto matcher = test::CreateFileMatcher("player_shared.mrfr", {}, true);
+        auto tmpl = matcher->createTemplate("player_shared.png");
+        tmpl->setMatchPattern(mr::ITemplate::MatchPattern::Grayscale);
+        for (float first : { 0.3f, 0.05f }) {
+            for (float threshold : { first, first == 0.3f ? 0.05f : 0.3f }) {
+                auto r = matcher->match(tmpl, HMONITOR{}, threshold);
+                testPrint("threshold %.2f: score %.4f (%d, %d)%s\n", threshold, r.score, r.region.pos.x, r.region.pos.y, r.pruned ? " pruned" : "");
+                if (threshold == 0.3f) {
+                    testExpect(!r.pruned && r.score <= threshold && r.region.pos == tregion.pos);
+                }
+                else {
+                    testExpect(r.pruned && r.score > threshold);
+                }
+            }
+        }
+    }
+
+    // the first record hits and moves the mouse. the second misses and stops the playback before MouseDown.
+    std::vector<mr::OpRecord> records(3);
+    records[0].type = mr::OpType::MouseMoveMatch;
+    records[0].exdata.match_threshold = 0.3f;
+    records[1].type = mr::OpType::MouseMoveMatch;
+    records[1].exdata.match_threshold = 0.05f;
+    for (int i = 0; i < 2; ++i) {
+        records[i].exdata.match_pattern = mr::ITemplate::MatchPattern::Grayscale;
+        records[i].exdata.templates.push_back({ "player_shared.png" });
+    }
+    records[2].type = mr::OpType::MouseDown;
+    records[2].data.mouse.button = 1;
+    for (uint32_t i = 0; i < records.size(); ++i)
+        records[i].time = i;
+    testExpect(mr::SaveOpRecords("player_shared.txt", records, mr::OpFileFormat::Text));
+
+    auto clock = mr::make_ref<VirtualClock>();
+    auto sink = mr::CreateRecordingInputSink(clock);
+    auto player = mr::CreatePlayer();
+    player->setClock(clock);
+    player->setInputSink(sink);
+    player->setScreenCapture(test::CreateFileCapture("player_shared.mrfr", true));
+    testExpect(player->load("player_shared.txt"));
+    testExpect(player->start());
+    while (player->isPlaying())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    auto events = sink->getEvents();
+    testExpect(events.size() == 1);
+    testExpect(events[0].event.type == mr::InputEvent::Type::MouseMove && events[0].event.pos == tregion.getCenter());
+}
+
+
+testCase(InputSink)
+{
+    // events due in the same tick are delivered in one batch
+    std::vector<mr::OpRecord> records;
+    for (uint32_t t = 0; t < 100; ++t) {
+        for (int i = 0; i < 4; ++i) {
+            mr::OpRecord rec;
+            rec.type = mr::OpType::MouseMoveAbs;
+            rec.time = t * 10;
+            rec.data.mouse.pos = { int(t), i };
+            records.push_back(rec);
+        }
+    }
+    testExpect(mr::SaveOpRecords("input_sink.mrop", records, mr::OpFileFormat::Binary));
+
+    auto clock = mr::make_ref<VirtualClock>();
+    auto sink = mr::CreateRecordingInputSink(clock);
+    auto player = mr::CreatePlayer();
+    player->setClock(clock);
+    player->setInputSink(sink);
+    testExpect(player->load("input_sink.mrop"));
+    testExpect(player->start());
+    while (player->isPlaying())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    auto events = sink->getEvents();
+    testExpect(events.size() == records.size());
+    testExpect(sink->getBatchCount() == 100);
+    for (auto& e : events)
+        testExpect(e.batch == uint32_t(e.event.pos.x));
+    testExpect(sink->getCursorPos() == records.back().data.mouse.pos);
+
+    // throughput of the playback loop itself. no sleep with the virtual clock.
+    const uint32_t num_records = 1000000;
+    records.clear();
+    for (uint32_t i = 0; i < num_records; ++i) {
+        mr::OpRecord rec;
+        rec.type = i % 2 ? mr::OpType::KeyUp : mr::OpType::KeyDown;
+        rec.time = i / 10;
+        rec.data.key.code = 'A';
+        records.push_back(rec);
+    }
+    testExpect(mr::SaveOpRecords("input_sink.mrop", records, mr::OpFileFormat::Binary));
+    testExpect(player->load("input_sink.mrop"));
+    sink->clear();
+
+    auto time_begin = mr::NowNS();
+    testExpect(player->start());
+    while (player->isPlaying())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    auto elapsed = mr::NowNS() - time_begin;
+    testExpect(sink->getEvents().size() == num_records);
+    testPrint("%u events in %.2fms (%.2f M events/sec), %u batches\n",
+        num_records, double(elapsed) / 1000000.0, double(num_records) / (double(elapsed) / 1000000000.0) / 1000000.0, sink->getBatchCount());
+}
+
 
 struct Hoge
 {
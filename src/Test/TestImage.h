@@ -0,0 +1,104 @@
+#pragma once
+#include "Marionette.h"
+
+namespace test {
+
+// hash of the block x block cell that contains (x, y). salt gives another pattern.
+inline uint32_t CellHash(int x, int y, int block = 1, uint32_t salt = 0)
+{
+    uint32_t h = (uint32_t(x / block) * 73856093u) ^ (uint32_t(y / block) * 19349663u) ^ salt;
+    return h * 1664525u + 1013904223u;
+}
+
+enum class Noise
+{
+    BlackWhite, // to make binary patterns distinctive
+    Gray,
+    RGB,
+};
+
+// pixel of NoiseImage(). RGBAu8 in memory.
+inline uint32_t NoisePixel(int x, int y, int block, Noise type, uint32_t salt = 0)
+{
+    uint32_t h = CellHash(x, y, block, salt);
+    switch (type) {
+    case Noise::BlackWhite:
+    {
+        uint32_t v = (h >> 16) & 1 ? 0xff : 0x00;
+        return 0xff000000 | (v << 16) | (v << 8) | v;
+    }
+    case Noise::Gray:
+    {
+        uint32_t v = (h >> 16) & 0xff;
+        return 0xff000000 | (v << 16) | (v << 8) | v;
+    }
+    default:
+        return 0xff000000 | (h >> 8);
+    }
+}
+
+// blocky noise. RGBAu8 pixels.
+inline std::vector<uint32_t> NoiseImage(mr::int2 size, int block, Noise type, uint32_t salt = 0)
+{
+    std::vector<uint32_t> ret(size.x * size.y);
+    for (int y = 0; y < size.y; ++y)
+        for (int x = 0; x < size.x; ++x)
+            ret[size.x * y + x] = NoisePixel(x, y, block, type, salt);
+    return ret;
+}
+
+inline void Paste(std::vector<uint32_t>& dst, mr::int2 dst_size, const std::vector<uint32_t>& src, mr::int2 src_size, mr::int2 pos)
+{
+    for (int y = 0; y < src_size.y; ++y)
+        for (int x = 0; x < src_size.x; ++x)
+            dst[dst_size.x * (pos.y + y) + (pos.x + x)] = src[src_size.x * y + x];
+}
+
+inline std::vector<uint32_t> Crop(const std::vector<uint32_t>& src, mr::int2 src_size, mr::Rect region)
+{
+    std::vector<uint32_t> ret(region.size.x * region.size.y);
+    for (int y = 0; y < region.size.y; ++y)
+        for (int x = 0; x < region.size.x; ++x)
+            ret[region.size.x * y + x] = src[src_size.x * (region.pos.y + y) + (region.pos.x + x)];
+    return ret;
+}
+
+inline mr::ITexture2DPtr CreateImage(mr::int2 size, const std::vector<uint32_t>& pixels)
+{
+    return mr::GetGfxInterface()->createTexture(size.x, size.y, mr::TextureFormat::RGBAu8, pixels.data(), size.x * 4);
+}
+
+inline bool SaveImage(const char* path, mr::int2 size, const std::vector<uint32_t>& pixels)
+{
+    return CreateImage(size, pixels)->save(path);
+}
+
+// frame file for IFileScreenCapture. frame i is presented at time i + 1.
+inline bool WriteFrames(const char* path, mr::int2 size, const std::vector<std::vector<uint32_t>>& frames)
+{
+    auto writer = mr::CreateFrameFileWriter(path);
+    if (!writer)
+        return false;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (!writer->write(CreateImage(size, frames[i]), i + 1))
+            return false;
+    }
+    return true;
+}
+
+// capture of a frame file that isn't paced by the clock. each capture steps to the next frame, and it stays at the
+// last frame unless loop is true.
+inline mr::IScreenCapturePtr CreateFileCapture(const char* path, bool loop = false)
+{
+    mr::IFileScreenCapture::Params cparams;
+    cparams.realtime = false;
+    cparams.loop = loop;
+    return mr::CreateFileScreenCapture(path, cparams);
+}
+
+inline mr::IScreenMatcherPtr CreateFileMatcher(const char* path, const mr::IScreenMatcher::Params& params = {}, bool loop = false)
+{
+    return mr::CreateScreenMatcher(params, CreateFileCapture(path, loop));
+}
+
+} // namespace test
@@ -21,6 +21,7 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <filesystem>
 #include <thread>
 #include <condition_variable>
 #include <future>
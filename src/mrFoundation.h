@@ -47,12 +47,13 @@ void Split(const std::string& str, const std::string& separator, const std::func
 const char* Scan(const char* s, const std::regex& exp, const std::function<void(std::cmatch& m)>& body);
 const char* Scan(const std::string& str, const std::regex& exp, const std::function<void(std::cmatch& m)>& body);
 const char* Scan(const std::string& str, const std::regex& exp, const std::function<void(std::string s)>& body);
-const char* ScanKVP(const char* s, const std::function<void(std::string k, std::string v)>& body);
-const char* ScanKVP(const std::string& str, const std::function<void(std::string k, std::string v)>& body);
+// scan "Key:Value" or "Key:{Value}" pairs. k and v point into s.
+const char* ScanKVP(const char* s, const std::function<void(std::string_view k, std::string_view v)>& body);
+const char* ScanKVP(const std::string& str, const std::function<void(std::string_view k, std::string_view v)>& body);
 std::string Replace(const std::string& str, const std::string& before, const std::string& after);
 
 // T: bool, int, float, float2, std::string
-template<class T> T ToValue(const std::string& str);
+template<class T> T ToValue(std::string_view str);
 
 template<class T> inline std::span<T> MakeSpan(T& v) { return { &v, 1 }; }
 template<class T> inline std::span<T> MakeSpan(std::vector<T>& v) { return { v.data(), v.size() }; }
@@ -69,4 +70,17 @@ protected:
     virtual ~IObject() {}
 };
 
+mrDeclPtr(IClock);
+
+// time source. Player takes it as a parameter so that tests can run without real waits.
+class IClock : public IObject
+{
+public:
+    virtual nanosec now() = 0;
+    virtual void sleepFor(nanosec duration) = 0; // coarse. may oversleep by the scheduler quantum.
+    virtual void sleepUntil(nanosec time) = 0; // precise. sleeps first and spins the last part.
+};
+mrAPI IClock* GetSystemClock_();
+mrDefShared(GetSystemClock);
+
 } // namespace mr
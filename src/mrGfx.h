@@ -7,6 +7,8 @@ mrDeclPtr(IGfxInterface);
 mrDeclPtr(ITexture2D);
 mrDeclPtr(IBuffer);
 mrDeclPtr(IScreenCapture);
+mrDeclPtr(IFileScreenCapture);
+mrDeclPtr(IFrameFileWriter);
 
 struct Rect
 {
@@ -21,6 +23,25 @@ struct Rect
     {
         return Rect{ pos - v, size + (v * 2), };
     }
+    bool empty() const { return size.x <= 0 || size.y <= 0; }
+    Rect intersect(const Rect& v) const
+    {
+        int2 tl = max(pos, v.pos);
+        int2 br = min(pos + size, v.pos + v.size);
+        return Rect{ tl, max(br - tl, int2::zero()) };
+    }
+    bool overlaps(const Rect& v) const { return !intersect(v).empty(); }
+    // bounding box of both. empty one is ignored.
+    Rect merge(const Rect& v) const
+    {
+        if (empty())
+            return v;
+        if (v.empty())
+            return *this;
+        int2 tl = min(pos, v.pos);
+        int2 br = max(pos + size, v.pos + v.size);
+        return Rect{ tl, br - tl };
+    }
 
     bool operator==(const Rect& v) const { return pos == v.pos && size == v.size; }
     bool operator!=(const Rect& v) const { return pos != v.pos || size != v.size; }
@@ -87,6 +108,11 @@ public:
         ITexture2DPtr surface;
         int2 size{}; // maybe not equal with surface->getSize()
         uint64_t present_time{};
+
+        // regions (in pixels of the surface) that changed since the frame of prev_present_time.
+        // prev_present_time is 0 if the capture can't tell, and the entire surface should be considered changed.
+        std::vector<Rect> dirty_rects;
+        uint64_t prev_present_time{};
     };
     using Callback = std::function<void(FrameInfo&)>;
 
@@ -100,6 +126,38 @@ public:
     virtual void setOnFrameArrived(const Callback& cb) = 0;
 };
 
+// replays recorded frames. the source is a directory of PNGs (in order of file names) or a frame file made by IFrameFileWriter.
+// the capture target given to startCapture() is ignored.
+// present_time is in nanoseconds. for PNGs, the last number in the file name is used if any (e.g. "frame_123456789.png"),
+// otherwise frames are 60 fps.
+class IFileScreenCapture : public IScreenCapture
+{
+public:
+    struct Params
+    {
+        // if true, frames are presented in the recorded timing and waitNextFrame() sleeps until the next frame.
+        // if false, each getFrame() and waitNextFrame() steps to the next frame immediately. (for benchmarks)
+        bool realtime = true;
+        bool loop = false;
+    };
+
+    virtual int getFrameCount() const = 0;
+    virtual int2 getFrameSize() const = 0;
+};
+mrAPI IFileScreenCapture* CreateFileScreenCapture_(const char* path, const IFileScreenCapture::Params& params);
+inline IFileScreenCapturePtr CreateFileScreenCapture(const char* path, const IFileScreenCapture::Params& params = {}) { return CreateFileScreenCapture_(path, params); }
+
+// writes frames to a file that IFileScreenCapture can replay.
+// all frames must have the same size and format as the first one.
+class IFrameFileWriter : public IObject
+{
+public:
+    virtual bool write(ITexture2DPtr surface, uint64_t present_time = 0) = 0; // 0: current time
+    virtual int getFrameCount() const = 0;
+};
+mrAPI IFrameFileWriter* CreateFrameFileWriter_(const char* path);
+inline IFrameFileWriterPtr CreateFrameFileWriter(const char* path) { return CreateFrameFileWriter_(path); }
+
 
 #define mrEachCS(Body)\
     Body(Transform)\
@@ -107,11 +165,21 @@ public:
     Body(Binarize)\
     Body(Contour)\
     Body(Expand)\
+    Body(DistanceTransform)\
+    Body(Preprocess)\
     Body(TemplateMatch)\
+    Body(TemplateMatchMin)\
+    Body(TemplateMatchMinMulti)\
+    Body(TemplateMatchFFT)\
+    Body(ChamferMatch)\
+    Body(ChamferMatchMin)\
+    Body(SparseMatch)\
     Body(Shape)\
     Body(ReduceTotal)\
     Body(ReduceCountBits)\
     Body(ReduceMinMax)\
+    Body(ReduceTopK)\
+    Body(ReduceHistogram)\
 
 #define Body(CS) mrDeclPtr(I##CS)
 mrEachCS(Body)
@@ -150,6 +218,7 @@ public:
     virtual void setGrayscale(bool v) = 0;
     virtual void setFillAlpha(bool v) = 0;
     virtual void setFiltering(bool v) = 0;
+    virtual void setDstRegion(Rect v) = 0; // only pixels in this region are updated. empty region means entire texture.
 };
 
 class INormalize : public IFilter
@@ -163,6 +232,7 @@ class IBinarize : public IFilter
 {
 public:
     virtual void setThreshold(float v) = 0;
+    virtual void setDstRegion(Rect v) = 0; // in pixels. x is expanded to multiple of 32.
 };
 
 class IExpand : public IFilter
@@ -175,6 +245,37 @@ class IContour : public IFilter
 {
 public:
     virtual void setRadius(float v) = 0;
+    virtual void setDstRegion(Rect v) = 0;
+};
+
+// euclidean distance to the nearest set bit of a Binary src, divided by the max distance and clamped to 1.
+// dst is Rf32 of the same size. computed by two separable passes (distances in each column, then the nearest of them
+// in each row) that only look within the max distance, so the cost is O(max distance) per pixel.
+// pixels in the dst region are updated.
+class IDistanceTransform : public IFilter
+{
+public:
+    virtual void setMaxDistance(float v) = 0;
+    virtual void setDstRegion(Rect v) = 0;
+};
+
+// transform -> grayscale -> binarize -> contour -> binarize of a captured surface in one pass.
+// outputs that are not set are skipped (intermediates are made on the fly).
+// grayscale and contour are rounded to 8 bits as if they went through Ru8 textures, so results are same as separate filters.
+// all outputs must be the same size. pixels in the dst region expanded by the contour radius are updated.
+class IPreprocess : public ICSContext
+{
+public:
+    virtual void setSrc(ITexture2DPtr v) = 0;
+    virtual void setRGB(ITexture2DPtr v) = 0;           // RGBAu8. filtered if the size differs from src
+    virtual void setGrayscale(ITexture2DPtr v) = 0;     // Ru8. filtered if smaller than src
+    virtual void setBinary(ITexture2DPtr v) = 0;        // Binary. grayscale > threshold
+    virtual void setContour(ITexture2DPtr v) = 0;       // Ru8. contour of grayscale
+    virtual void setContourBinary(ITexture2DPtr v) = 0; // Binary. contour > threshold
+    virtual void setColorRange(float2 v) = 0;
+    virtual void setThreshold(float v) = 0;
+    virtual void setContourRadius(float v) = 0;
+    virtual void setDstRegion(Rect v) = 0;
 };
 
 class ITemplateMatch : public IFilter
@@ -225,6 +326,128 @@ public:
     virtual Result getResult() = 0;
 };
 
+// local minima of a score map that are not greater than the threshold, best first.
+// a candidate whose footprint (suppression size at its position) overlaps a better one is dropped.
+// this is for finding all occurrences of a template: the suppression size should be the template size.
+class IReduceTopK : public IReducer
+{
+public:
+    struct Candidate
+    {
+        int2 pos{}; // relative to the region
+        union {
+            float valf;
+            uint32_t vali;
+        };
+        uint32_t pad{};
+    };
+    using Result = std::vector<Candidate>;
+
+    virtual void setThreshold(float v) = 0; // in the unit of the score map. rounded down for int formats.
+    virtual void setMaxCount(int v) = 0;
+    virtual void setSuppressionSize(int2 v) = 0;
+    virtual Result getResult() = 0;
+};
+
+// 256 bins histogram of a single channel texture in 0-1 (Ru8 or float formats). a texel of value v is counted in the bin
+// round(saturate(v) * 255). texels out of the texture are not counted.
+class IReduceHistogram : public IReducer
+{
+public:
+    using Result = std::array<uint32_t, 256>;
+
+    virtual Result getResult() = 0;
+};
+
+// template matching fused with min reduction. the score map is not written and only the best (minimum) score
+// and its position (relative to the region) are output. same as TemplateMatch + ReduceMinMax except that
+// ties are resolved in scanline order. the max fields of the result are not used.
+class ITemplateMatchMin : public ICSContext
+{
+public:
+    virtual void setSrc(ITexture2DPtr v) = 0;
+    virtual void setTemplate(ITexture2DPtr v) = 0;
+    virtual void setMask(ITexture2DPtr v) = 0;
+    virtual void setRegion(Rect v) = 0;
+    // scores greater than this are not needed (e.g. the match threshold). positions that can't be the minimum or
+    // not greater than it may be skipped. if no score is not greater than it, the result is a lower bound of the minimum
+    // (still greater than it). negative disables it (default). only the CPU backend makes use of it for Ru8 without mask.
+    virtual void setCutoff(float v) = 0;
+    virtual IReduceMinMax::Result getResult() = 0;
+    // ratio of template pixels skipped by the last dispatch. 0 if all scores were fully computed.
+    virtual float getPruningRate() = 0;
+};
+
+// ITemplateMatchMin for multiple templates on the same src. each template has its own region and cutoff, and results
+// are in the order of addTemplate(). src is read once for all templates: the CPU backend matches all templates row band
+// by row band (and makes the integral image for pruning only once), and the D3D11 backend packs the templates into an
+// atlas and each group matches all of them for its tile. grayscale and RGBAu8 only (not Binary), and masks are not supported.
+class ITemplateMatchMinMulti : public ICSContext
+{
+public:
+    virtual void setSrc(ITexture2DPtr v) = 0;
+    virtual void addTemplate(ITexture2DPtr tmpl, Rect region, float cutoff = -1.0f) = 0;
+    virtual void clearTemplates() = 0;
+    virtual std::vector<IReduceMinMax::Result> getResult() = 0;
+};
+
+// sum of squared differences by FFT. the cost doesn't depend on the template size, so this is much faster than
+// ITemplateMatch for large templates. src and template are grayscale (Ru8, Rf16, Rf32) or RGBAu8 (squared differences
+// of rgb are summed up) of the same format, and dst is Rf32. masks are not supported.
+// scores are not comparable with ITemplateMatch's (sum of absolute differences) and have small errors of float FFT.
+// out of bounds texels are 0 as ITemplateMatch. the spectra of recently used templates are cached, so a template
+// must not be modified while it is used.
+class ITemplateMatchFFT : public IFilter
+{
+public:
+    virtual void setTemplate(ITexture2DPtr v) = 0;
+    virtual void setRegion(Rect v) = 0;
+};
+
+// chamfer matching. the template is a sparse list of points (offsets in the template, e.g. its edge pixels), and the
+// score of a position is the sum of src (a distance map made by IDistanceTransform) at the points placed there.
+// scores grow smoothly with misalignment instead of jumping as mismatching bits do. only the points are tested, so
+// areas dense with edges score low too. dst is Rf32 and the score of region.pos + (x, y) is written to (x, y).
+class IChamferMatch : public IFilter
+{
+public:
+    virtual void setPoints(std::span<const int2> v) = 0;
+    virtual void setRegion(Rect v) = 0;
+};
+
+// IChamferMatch fused with min reduction as ITemplateMatchMin. scores only grow while points are added, so the CPU
+// backend stops at the cutoff (see ITemplateMatchMin::setCutoff()).
+class IChamferMatchMin : public ICSContext
+{
+public:
+    virtual void setSrc(ITexture2DPtr v) = 0;
+    virtual void setPoints(std::span<const int2> v) = 0;
+    virtual void setRegion(Rect v) = 0;
+    virtual void setCutoff(float v) = 0;
+    virtual IReduceMinMax::Result getResult() = 0;
+};
+
+// a sample of ISparseMatch: an offset in the template and the color of the template there
+struct SparseSample
+{
+    int2 pos;
+    unorm8x4 color;
+};
+static_assert(sizeof(SparseSample) == 12);
+
+// ITemplateMatch that tests only samples of the template. the score of a sample is same as the one of the pixel
+// in ITemplateMatch (no masks), so the score is ITemplateMatch's if all pixels are given. src is Ru8 (color.x is
+// compared) or RGBAu8. samples are summed in the order and the sum of a position stops as soon as it exceeds the
+// cutoff, so more discriminative samples should come first. such scores are lower bounds greater than the cutoff.
+// negative cutoff disables it (default). dst is Rf32 and the score of region.pos + (x, y) is written to (x, y).
+class ISparseMatch : public IFilter
+{
+public:
+    virtual void setSamples(std::span<const SparseSample> v) = 0;
+    virtual void setRegion(Rect v) = 0;
+    virtual void setCutoff(float v) = 0;
+};
+
 class IShape : public ICSContext
 {
 public:
@@ -249,6 +472,9 @@ public:
 
     virtual void flush() = 0;
     virtual void sync(int timeout_ms = 1000) = 0;
+    // true if filters of different contexts can be dispatched from multiple threads at once.
+    // D3D11 dispatches go to the immediate context and have to be serialized.
+    virtual bool supportsConcurrentDispatch() const = 0;
 
     virtual void lock() = 0;
     virtual void unlock() = 0;
@@ -260,6 +486,19 @@ public:
         body();
     }
 };
+
+enum class GfxBackend
+{
+    Auto, // D3D11 if available, CPU otherwise
+    D3D11,
+    CPU,
+};
+// GetGfxInterface() returns the interface of this backend. must be called before any gfx objects are created.
+mrAPI void SetGfxBackend(GfxBackend v);
+mrAPI GfxBackend GetGfxBackend();
+mrAPI IGfxInterface* CreateGfxInterface_(GfxBackend backend);
+inline IGfxInterfacePtr CreateGfxInterface(GfxBackend backend) { return CreateGfxInterface_(backend); }
+
 mrAPI IGfxInterface* GetGfxInterface_();
 mrDefShared(GetGfxInterface);
 
@@ -292,15 +531,43 @@ public:
     virtual void copy(ITexture2DPtr dst, ITexture2DPtr src, Rect src_region) = 0;
     inline  void copy(ITexture2DPtr dst, ITexture2DPtr src, int2 size) { return copy(dst, src, Rect{ {}, size }); }
     inline  void copy(ITexture2DPtr dst, ITexture2DPtr src) { return copy(dst, src, Rect{}); }
-    virtual void transform(ITexture2DPtr dst, ITexture2DPtr src, bool grayscale, bool filtering, Rect src_region = {}) = 0;
+    virtual void transform(ITexture2DPtr dst, ITexture2DPtr src, bool grayscale, bool filtering, Rect src_region = {}, Rect dst_region = {}) = 0;
     inline  void transform(ITexture2DPtr dst, ITexture2DPtr src, bool grayscale) { return transform(dst, src, grayscale, dst->getSize().x != src->getSize().x); }
-    virtual void grayscale(ITexture2DPtr dst, ITexture2DPtr src, float2 range = { 0.0f, 1.0f }) = 0;
+    virtual void grayscale(ITexture2DPtr dst, ITexture2DPtr src, float2 range = { 0.0f, 1.0f }, Rect dst_region = {}) = 0;
 
     virtual void normalize(ITexture2DPtr dst, ITexture2DPtr src, float denom) = 0;
-    virtual void binarize(ITexture2DPtr dst, ITexture2DPtr src, float threshold) = 0;
-    virtual void contour(ITexture2DPtr dst, ITexture2DPtr src, float radius) = 0;
+    virtual void binarize(ITexture2DPtr dst, ITexture2DPtr src, float threshold, Rect dst_region = {}) = 0;
+    virtual void contour(ITexture2DPtr dst, ITexture2DPtr src, float radius, Rect dst_region = {}) = 0;
     virtual void expand(ITexture2DPtr dst, ITexture2DPtr src, float radius) = 0;
+    virtual void distanceTransform(ITexture2DPtr dst, ITexture2DPtr src, float max_distance, Rect dst_region = {}) = 0;
+    // see IPreprocess. null outputs are skipped.
+    struct PreprocessTargets
+    {
+        ITexture2DPtr rgb;
+        ITexture2DPtr grayscale;
+        ITexture2DPtr binary;
+        ITexture2DPtr contour;
+        ITexture2DPtr contour_b;
+    };
+    virtual void preprocess(const PreprocessTargets& dst, ITexture2DPtr src, float2 color_range, float threshold, float contour_radius, Rect dst_region = {}) = 0;
     virtual void match(ITexture2DPtr dst, ITexture2DPtr src, ITexture2DPtr tmp, ITexture2DPtr mask = nullptr, Rect region = {}) = 0;
+    // match + minmax without the score map. pos_min of the result is relative to region.pos. see ITemplateMatchMin for cutoff.
+    virtual std::future<IReduceMinMax::Result> matchMin(ITexture2DPtr src, ITexture2DPtr tmp, ITexture2DPtr mask = nullptr, Rect region = {}, float cutoff = -1.0f) = 0;
+    // matchMin() for multiple templates at once. see ITemplateMatchMinMulti.
+    struct MatchMinTarget
+    {
+        ITexture2DPtr tmpl;
+        Rect region{};
+        float cutoff = -1.0f;
+    };
+    virtual std::future<std::vector<IReduceMinMax::Result>> matchMinMulti(ITexture2DPtr src, std::span<const MatchMinTarget> targets) = 0;
+    // see ITemplateMatchFFT. dst is Rf32.
+    virtual void matchFFT(ITexture2DPtr dst, ITexture2DPtr src, ITexture2DPtr tmp, Rect region = {}) = 0;
+    // see IChamferMatch and IChamferMatchMin. pos_min of the result is relative to region.pos.
+    virtual void matchChamfer(ITexture2DPtr dst, ITexture2DPtr src, std::span<const int2> points, Rect region = {}) = 0;
+    virtual std::future<IReduceMinMax::Result> matchChamferMin(ITexture2DPtr src, std::span<const int2> points, Rect region = {}, float cutoff = -1.0f) = 0;
+    // see ISparseMatch. dst is Rf32.
+    virtual void matchSparse(ITexture2DPtr dst, ITexture2DPtr src, std::span<const SparseSample> samples, Rect region = {}, float cutoff = -1.0f) = 0;
 
     virtual std::future<IReduceTotal::Result> total(ITexture2DPtr src, Rect region) = 0;
     inline  std::future<IReduceTotal::Result> total(ITexture2DPtr src, int2 region = {}) { return total(src, Rect{ int2{}, region }); }
@@ -308,10 +575,17 @@ public:
     inline  std::future<IReduceCountBits::Result> countBits(ITexture2DPtr src, int2 region = {}) { return countBits(src, Rect{ int2{}, region }); }
     virtual std::future<IReduceMinMax::Result> minmax(ITexture2DPtr src, Rect region) = 0;
     inline  std::future<IReduceMinMax::Result> minmax(ITexture2DPtr src, int2 region = {}) { return minmax(src, Rect{ int2{}, region }); }
+    virtual std::future<IReduceTopK::Result> topK(ITexture2DPtr src, float threshold, int max_count, int2 suppression, Rect region = {}) = 0;
+    virtual std::future<IReduceHistogram::Result> histogram(ITexture2DPtr src, Rect region) = 0;
+    inline  std::future<IReduceHistogram::Result> histogram(ITexture2DPtr src, int2 region = {}) { return histogram(src, Rect{ int2{}, region }); }
 };
 mrAPI IFilterSet* CreateFilterSet_();
 inline IFilterSetPtr CreateFilterSet() { return CreateFilterSet_(); }
 
+// binarization threshold (in 0-1, for IBinarize) by Otsu's method: bins above it are separated from bins below it with
+// the maximum between-class variance. 0.5 if the histogram has less than two distinct values.
+mrAPI float GetOtsuThreshold(const IReduceHistogram::Result& hist);
+
 
 struct MonitorInfo
 {
@@ -336,10 +610,23 @@ public:
         Binary,
         Grayscale,
         RGB,
+        // edges (as BinaryContour) scored by the mean distance to the nearest edge of the screen (see IChamferMatch).
+        // tolerant of small misalignment, so it holds up at lower Params::scale.
+        Chamfer,
     };
 
     virtual void setMatchPattern(MatchPattern v) = 0;
+    // Grayscale and RGB: if not 0, only this many pixels of the template are tested first (see ISparseMatch). pixels on
+    // strong gradients and of rare colors are picked. see IScreenMatcher::Params::sparse_candidates for the results.
+    virtual void setSampleBudget(int v) = 0;
     virtual ITexture2DPtr getImage() const = 0;
+
+    // local search around the last hit: how many times it hit, and missed and fell back to the full search
+    virtual int getLocalHitCount() const = 0;
+    virtual int getLocalMissCount() const = 0;
+    // number of images made from the file for matching, of all display scales and pyramid levels. they are made on
+    // demand for the match pattern, so this grows as other patterns are matched.
+    virtual int getImageCount() const = 0;
 };
 
 class IScreenMatcher : public IObject
@@ -353,12 +640,56 @@ public:
         float contour_radius = 1.0f;
         float expand_radius = 1.0f;
         float binarize_threshold = 0.2f;
+        // binary images (Binary pattern) are made by the Otsu threshold (see GetOtsuThreshold()) of the grayscale
+        // instead of binarize_threshold: the screen's is taken from each frame and a template's from the template, so
+        // they follow theme and brightness changes. contours keep binarize_threshold.
+        bool auto_threshold = false;
+
+        // coarse-to-fine search. pyramid_levels is the number of downsampled levels (each is half size of the previous)
+        // and 0 disables it. candidates are picked at the coarsest level and refined at finer levels.
+        int pyramid_levels = 0;
+        int pyramid_candidates = 4;
+
+        // large Grayscale and RGB templates are matched by FFT (sum of squared differences) if it is estimated to be
+        // faster than the direct matching. the best fft_candidates positions of it are verified by the direct matching,
+        // so scores are in the same unit as without it. 0 disables it.
+        int fft_candidates = 4;
+
+        // templates with a sample budget (see ITemplate::setSampleBudget()) are matched by the samples, and the best
+        // sparse_candidates positions of it are verified by the matching of all pixels. 0 takes the best position of
+        // the samples as is, and its score is the mean of the samples then.
+        int sparse_candidates = 4;
+
+        // matching of a position is stopped as soon as its score turns out to be greater than the threshold of match()
+        // where possible (CPU backend and Grayscale). scores of misses may be lower bounds of the minimum then,
+        // which are still greater than the threshold (see Result::pruned).
+        bool threshold_cutoff = true;
+
+        // brute force matching of Grayscale and RGB templates in one match() is done at once for all of them
+        // (see ITemplateMatchMinMulti). results are same as one by one.
+        bool batch_match = true;
+
+        // distances to the nearest edge are clamped to this (in pixels of the scaled screen) for Chamfer.
+        // the score is the mean distance at the edges of the template divided by this.
+        float chamfer_max_distance = 4.0f;
+
+        // matchAllScreens() updates and matches each screen on its own worker if the backend supports concurrent
+        // dispatch (see IGfxInterface::supportsConcurrentDispatch()) and the machine has more than one core. otherwise
+        // screens are dispatched one after another before any result is read back.
+        bool parallel_screens = true;
+
+        // targets rarely move between frames. if the last result of a template was a hit by the threshold of match(),
+        // positions within this radius (in pixels of the screen) around it are searched first. 0 disables it.
+        int local_search_radius = 16;
     };
 
     struct Result
     {
         Rect region{};
         float score = 1.0f;
+        // the score is greater than the threshold of match() and may be a lower bound of the minimum (see
+        // Params::threshold_cutoff). the region is not necessarily the best position then. never a hit.
+        bool pruned = false;
 
         ITexture2DPtr surface;
 #ifdef mrDebug
@@ -366,17 +697,48 @@ public:
 #endif
     };
 
+    // preprocessed template images are stored in and loaded from this directory. null or empty disables it (default).
+    // affects templates created after this.
+    virtual void setTemplateCacheDir(const char* dir) = 0;
     virtual ITemplatePtr createTemplate(const char* path_to_png) = 0;
-    virtual Result match(std::span<ITemplatePtr> tmpl, HMONITOR target) = 0;
-    virtual Result match(std::span<ITemplatePtr> tmpl, HWND target) = 0;
-    inline Result match(ITemplatePtr tmpl, HMONITOR target) { return match(MakeSpan(tmpl), target); }
-    inline Result match(ITemplatePtr tmpl, HWND target) { return match(MakeSpan(tmpl), target); }
-    inline Result match(std::vector<ITemplatePtr>& tmpl, HMONITOR target) { return match(MakeSpan(tmpl), target); }
-    inline Result match(std::vector<ITemplatePtr>& tmpl, HWND target) { return match(MakeSpan(tmpl), target); }
+    // createTemplate() for each path. files are decoded in parallel. ret[i] is null if paths[i] failed.
+    virtual std::vector<ITemplatePtr> createTemplates(std::span<const std::string> paths) = 0;
+    // make images for the current match pattern of each template so that the first match doesn't have to.
+    // takes IGfxInterface::lock() inside.
+    virtual void prepareTemplates(std::span<ITemplatePtr> tmpls) = 0;
+    // the best position of the templates. results with the score not greater than the threshold are hits. it is used
+    // to skip work on misses (see Params::threshold_cutoff and Params::local_search_radius). negative means no
+    // threshold: every result is exact and there is no local search.
+    // the threshold is of each call, so templates can be shared by callers with different thresholds.
+    virtual Result match(std::span<ITemplatePtr> tmpl, HMONITOR target, float threshold = -1.0f) = 0;
+    virtual Result match(std::span<ITemplatePtr> tmpl, HWND target, float threshold = -1.0f) = 0;
+    inline Result match(ITemplatePtr tmpl, HMONITOR target, float threshold = -1.0f) { return match(MakeSpan(tmpl), target, threshold); }
+    inline Result match(ITemplatePtr tmpl, HWND target, float threshold = -1.0f) { return match(MakeSpan(tmpl), target, threshold); }
+    inline Result match(std::vector<ITemplatePtr>& tmpl, HMONITOR target, float threshold = -1.0f) { return match(MakeSpan(tmpl), target, threshold); }
+    inline Result match(std::vector<ITemplatePtr>& tmpl, HWND target, float threshold = -1.0f) { return match(MakeSpan(tmpl), target, threshold); }
+    // match() for every screen. the best result of all screens is returned.
+    virtual Result matchAllScreens(std::span<ITemplatePtr> tmpl, float threshold = -1.0f) = 0;
+    inline Result matchAllScreens(ITemplatePtr tmpl, float threshold = -1.0f) { return matchAllScreens(MakeSpan(tmpl), threshold); }
+    inline Result matchAllScreens(std::vector<ITemplatePtr>& tmpl, float threshold = -1.0f) { return matchAllScreens(MakeSpan(tmpl), threshold); }
+
+    // all occurrences whose score is not greater than the threshold, best first. up to max_count results.
+    // results that overlap a better one (of any template) are dropped.
+    virtual std::vector<Result> matchAll(std::span<ITemplatePtr> tmpl, HMONITOR target, float threshold, int max_count = 32) = 0;
+    virtual std::vector<Result> matchAll(std::span<ITemplatePtr> tmpl, HWND target, float threshold, int max_count = 32) = 0;
+    inline std::vector<Result> matchAll(ITemplatePtr tmpl, HMONITOR target, float threshold, int max_count = 32) { return matchAll(MakeSpan(tmpl), target, threshold, max_count); }
+    inline std::vector<Result> matchAll(ITemplatePtr tmpl, HWND target, float threshold, int max_count = 32) { return matchAll(MakeSpan(tmpl), target, threshold, max_count); }
 };
 mrAPI IScreenMatcher* CreateScreenMatcher_(const IScreenMatcher::Params& params);
 inline IScreenMatcherPtr CreateScreenMatcher(const IScreenMatcher::Params& params = {}) { return CreateScreenMatcher_(params); }
 
+// matcher that uses the given capture (e.g. IFileScreenCapture) instead of the displays.
+// it is treated as a single screen of the frame size placed at (0, 0). any match target means the entire frame.
+mrAPI IScreenMatcher* CreateScreenMatcherForCapture_(const IScreenMatcher::Params& params, IScreenCapture* capture);
+inline IScreenMatcherPtr CreateScreenMatcher(const IScreenMatcher::Params& params, IScreenCapturePtr capture) { return CreateScreenMatcherForCapture_(params, capture); }
+// each capture is a screen. they are placed side by side from left in the order. any match target means the first one.
+mrAPI IScreenMatcher* CreateScreenMatcherForCaptures_(const IScreenMatcher::Params& params, std::span<IScreenCapturePtr> captures);
+inline IScreenMatcherPtr CreateScreenMatcher(const IScreenMatcher::Params& params, std::span<IScreenCapturePtr> captures) { return CreateScreenMatcherForCaptures_(params, captures); }
+
 #ifdef mrDebug
 void DbgSetScreenMatcherWriteout(bool v);
 #endif // mrDebug
@@ -64,9 +64,59 @@ struct OpRecord
 };
 using OpRecordHandler = std::function<bool (OpRecord& rec)>;
 
+struct InputEvent
+{
+    enum class Type
+    {
+        MouseMove,
+        MouseDown,
+        MouseUp,
+        KeyDown,
+        KeyUp,
+    };
+    Type type{};
+    int2 pos{}; // MouseMove: screen position
+    int code{}; // MouseDown/Up: button (1: left, 2: right, 3: middle). KeyDown/Up: virtual key code
+};
+
+mrDeclPtr(IInputSink);
+mrDeclPtr(IRecordingInputSink);
+
+// destination of the input that Player plays back.
+// send() may queue events and flush() delivers them. Player flushes when no more events are due.
+class IInputSink : public IObject
+{
+public:
+    virtual int2 getCursorPos() = 0;
+    virtual void send(const InputEvent& e) = 0;
+    virtual void flush() = 0;
+};
+// events queued in a flush are delivered by one SendInput()
+mrAPI IInputSink* CreateWin32InputSink_();
+mrDefShared(CreateWin32InputSink);
+
+// keeps events in memory instead of sending them. for tests and benchmarks.
+class IRecordingInputSink : public IInputSink
+{
+public:
+    struct Event
+    {
+        nanosec time; // time of send()
+        uint32_t batch; // index of the flush() that delivered the event
+        InputEvent event;
+    };
+
+    // delivered events only. events not flushed yet are not included.
+    virtual std::vector<Event> getEvents() const = 0;
+    virtual uint32_t getBatchCount() const = 0;
+    virtual void clear() = 0;
+};
+mrAPI IRecordingInputSink* CreateRecordingInputSink_(IClock* clock);
+inline IRecordingInputSinkPtr CreateRecordingInputSink(IClockPtr clock = GetSystemClock()) { return CreateRecordingInputSink_(clock); }
+
 enum class MatchTarget
 {
-    EntireScreen,
+    EntireScreen, // all screens (see IScreenMatcher::matchAllScreens())
     ForegroundWindow,
 };
 
@@ -89,15 +139,45 @@ mrAPI IRecorder* CreateRecorder_();
 mrDefShared(CreateRecorder);
 
 
+// playback runs on its own thread and each record is executed at its deadline (start time + record time) in nanoseconds.
 class IPlayer : public IObject
 {
 public:
+    struct EventTiming
+    {
+        uint32_t record_index;
+        int64_t error; // actual - scheduled time in nanoseconds
+    };
+    struct TimingStats
+    {
+        uint64_t count = 0; // number of executed records
+        int64_t total_error = 0;
+        int64_t max_error = 0;
+
+        double meanError() const { return count ? double(total_error) / double(count) : 0.0; }
+    };
+
     virtual bool start(uint32_t loop = 1) = 0;
     virtual bool stop() = 0;
     virtual bool isPlaying() const = 0;
-    virtual bool update() = 0;
+    virtual bool update() = 0; // just returns isPlaying(). kept for compatibility.
     virtual bool load(const char* path) = 0;
     virtual void setMatchTarget(MatchTarget v) = 0;
+    // match templates against frames from this capture (e.g. IFileScreenCapture) instead of the displays.
+    // must be called before load().
+    virtual void setScreenCapture(IScreenCapturePtr v) = 0;
+    // cache of preprocessed templates (see IScreenMatcher::setTemplateCacheDir()). must be called before load().
+    virtual void setTemplateCacheDir(const char* v) = 0;
+
+    // system clock and Win32 input by default. must be set before start().
+    virtual void setClock(IClockPtr v) = 0;
+    virtual void setInputSink(IInputSinkPtr v) = 0;
+    // timing errors of all executed records of the current or last playback
+    virtual TimingStats getTimingStats() const = 0;
+    // keep the timing of each of the last v executed records (0 by default: not kept). must be called before start().
+    virtual void setTimingCapacity(uint32_t v) = 0;
+    // timings kept by setTimingCapacity() of the current or last playback, oldest first
+    virtual std::vector<EventTiming> getTimings() const = 0;
 };
 mrAPI IPlayer* CreatePlayer_();
 mrDefShared(CreatePlayer);
@@ -131,4 +211,16 @@ inline bool operator==(const Key& a, const Key& b) { return (uint32_t&)a == (uin
 
 std::map<Key, std::string> LoadKeymap(const char* path, const std::function<void(Key key, std::string path)>& body);
 
+// replay files.
+// Text: one OpRecord::toText() per line. Binary: fixed size records + string table, loaded by mapping the file.
+enum class OpFileFormat
+{
+    Text,
+    Binary,
+};
+OpFileFormat GetOpFileFormat(const char* path); // ".mrop" is Binary, others are Text
+bool LoadOpRecords(const char* path, std::vector<OpRecord>& dst); // format is detected from the content
+bool SaveOpRecords(const char* path, std::span<const OpRecord> records, OpFileFormat format);
+bool ConvertOpRecords(const char* src_path, const char* dst_path, OpFileFormat format);
+
 } // namespace mr
@@ -80,6 +80,66 @@ protected:
     std::atomic_int m_ref{ 0 };
 };
 
+// fixed size worker pool shared by CPU kernels and background jobs.
+class ThreadPool
+{
+public:
+    static ThreadPool& instance();
+
+    ThreadPool(int num_threads = 0); // 0: std::thread::hardware_concurrency()
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    int getConcurrency() const;
+
+    void enqueue(const std::function<void()>& v);
+
+    template<class Body>
+    auto async(Body&& body) -> std::future<decltype(body())>
+    {
+        using R = decltype(body());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<Body>(body));
+        auto ret = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return ret;
+    }
+
+private:
+    void process();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+};
+
+// split [begin, end) into chunks of grain and process them on ThreadPool. the calling thread also takes chunks.
+// body: [](int begin, int end) -> void
+void ParallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+// read-only memory mapped file
+class MappedFile
+{
+public:
+    MappedFile() {}
+    MappedFile(const char* path) { open(path); }
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path);
+    void close();
+    bool valid() const { return m_data != nullptr; }
+    const byte* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+    const byte* m_data = nullptr;
+    size_t m_size = 0;
+};
+
 void AddInitializeHandler(const std::function<void()>& v);
 void AddFinalizeHandler(const std::function<void()>& v);
 
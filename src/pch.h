@@ -3,20 +3,25 @@
 #include <cstdio>
 #include <cstdint>
 #include <fstream>
+#include <filesystem>
 #include <string>
 #include <vector>
+#include <array>
 #include <deque>
 #include <map>
 #include <algorithm>
+#include <bit>
 #include <functional>
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <future>
 #include <tuple>
 #include <regex>
 #include <type_traits>
 #include <span>
+#include <complex>
 #include <ranges>
 
 #define NOMINMAX